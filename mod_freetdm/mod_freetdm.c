@@ -3669,6 +3669,8 @@ static switch_status_t load_config(void)
 			int polarity_delay = 600;
 			int callwaiting = 1;
 			int dialtone_timeout = 5000;
+			const char *engine = "thread";
+			int engine_workers = 0;
 
 			uint32_t span_id = 0, to = 0, max = 0;
 			ftdm_span_t *span = NULL;
@@ -3759,6 +3761,10 @@ static switch_status_t load_config(void)
 					hotline = val;
 				} else if (!strcasecmp(var, "callwaiting")) {
 					callwaiting = switch_true(val) ? 1 : 0;
+				} else if (!strcasecmp(var, "engine")) {
+					engine = val;
+				} else if (!strcasecmp(var, "engine-workers")) {
+					engine_workers = atoi(val);
 				} else if (!strcasecmp(var, "enable-analog-option")) {
 					analog_options = enable_analog_option(val, analog_options);
 				}
@@ -3815,6 +3821,8 @@ static switch_status_t load_config(void)
 								   "polarity_delay", &polarity_delay,
 								   "callwaiting", &callwaiting,
 								   "wait_dialtone_timeout", &dialtone_timeout,
+								   "engine", engine,
+								   "engine_workers", &engine_workers,
 								   FTDM_TAG_END) != FTDM_SUCCESS) {
 				LOAD_ERROR("Error configuring FreeTDM analog span %s\n", ftdm_span_get_name(span));
 				continue;
@@ -3868,6 +3876,7 @@ static switch_status_t load_config(void)
 			char *answer_supervision = str_false;
 			char *immediate_ringback = str_false;
 			char *ringback_file = str_empty;
+			const char *engine = "thread";
 			uint32_t span_id = 0, to = 0, max = 0, dial_timeout_int = 0, release_guard_time_ms_int = 0;
 			ftdm_span_t *span = NULL;
 			analog_option_t analog_options = ANALOG_OPTION_NONE;
@@ -3902,6 +3911,8 @@ static switch_status_t load_config(void)
 					immediate_ringback = val;
 				} else if (!strcasecmp(var, "ringback-file")) {
 					ringback_file = val;
+				} else if (!strcasecmp(var, "engine")) {
+					engine = val;
 				} else if (!strcasecmp(var, "enable-analog-option")) {
 					analog_options = enable_analog_option(val, analog_options);
 				}
@@ -3965,6 +3976,7 @@ static switch_status_t load_config(void)
 								   "dial_timeout", &dial_timeout_int,
 								   "release_guard_time_ms", &release_guard_time_ms_int,
 								   "max_dialstr", &max,
+								   "engine", engine,
 								   FTDM_TAG_END) != FTDM_SUCCESS) {
 				LOAD_ERROR("Error starting FreeTDM span %d\n", span_id);
 				continue;
@@ -5488,6 +5500,7 @@ static ftdm_cli_entry_t ftdm_cli_options[] =
 	{ "core flag", "[!]<flag-int-value|flag-name> [<span_id|span_name>] [<chan_id>]", "", NULL, NULL, NULL },
 	{ "core spanflag", "[!]<flag-int-value|flag-name> [<span_id|span_name>]", "", NULL, NULL, NULL },
 	{ "core calls", "", "", NULL, NULL, NULL },
+	{ "core metrics", "[json|openmetrics] [<span_id|span_name> [<chan_id>]]", "", NULL, NULL, NULL },
 };
 
 static void print_usage(switch_stream_handle_t *stream, ftdm_cli_entry_t *cli)
@@ -0,0 +1,121 @@
+#include "private/ftdm_core.h"
+
+/* decode the binary channel recorder dumps written by 'ftdm core recorder dump' or on ftdm_assert() */
+
+typedef struct {
+	ftdm_recorder_dump_header_t header;
+	ftdm_recorder_entry_t entry;
+} decoded_event_t;
+
+static void print_event(const ftdm_recorder_dump_header_t *header, const ftdm_recorder_entry_t *entry, int with_channel)
+{
+	char desc[128];
+	uint64_t age = header->dump_time > entry->time ? header->dump_time - entry->time : 0;
+	uint64_t wall = header->dump_wall_time - (age / 1000000);
+	time_t secs = (time_t)(wall / 1000);
+	struct tm tm;
+	char when[32];
+
+#ifdef WIN32
+	localtime_s(&tm, &secs);
+#else
+	localtime_r(&secs, &tm);
+#endif
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+	if (with_channel) {
+		printf("%s.%03u -%12.3fms %3u:%-3u t%-3u %s\n", when, (unsigned)(wall % 1000), (double)age / 1000000.0,
+				header->span_id, header->chan_id, entry->thread, ftdm_recorder_entry_str(entry, desc, sizeof(desc)));
+	} else {
+		printf("%10u %s.%03u -%12.3fms t%-3u %s\n", entry->seq, when, (unsigned)(wall % 1000), (double)age / 1000000.0,
+				entry->thread, ftdm_recorder_entry_str(entry, desc, sizeof(desc)));
+	}
+}
+
+static int compare_events(const void *a, const void *b)
+{
+	const decoded_event_t *ea = a;
+	const decoded_event_t *eb = b;
+
+	if (ea->entry.time == eb->entry.time) {
+		return 0;
+	}
+	return ea->entry.time < eb->entry.time ? -1 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	ftdm_recorder_dump_header_t header;
+	ftdm_recorder_entry_t entry;
+	decoded_event_t *events = NULL;
+	size_t count = 0, size = 0, i;
+	const char *path;
+	int merge = 0;
+	uint32_t e;
+	FILE *file;
+
+	if (argc > 2 && !strcmp(argv[1], "-m")) {
+		merge = 1;
+		path = argv[2];
+	} else if (argc == 2) {
+		path = argv[1];
+	} else {
+		fprintf(stderr, "usage: %s [-m] <dump file>\n", argv[0]);
+		fprintf(stderr, "  -m  merge the events of all the channels in a single timeline\n");
+		exit(-1);
+	}
+
+	if (!(file = fopen(path, "rb"))) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		exit(-1);
+	}
+
+	while (fread(&header, sizeof(header), 1, file) == 1) {
+		if (memcmp(header.magic, FTDM_RECORDER_DUMP_MAGIC, sizeof(header.magic)) ||
+		    header.entry_size != sizeof(ftdm_recorder_entry_t)) {
+			fprintf(stderr, "%s is not a recorder dump or was written by an incompatible version\n", path);
+			exit(-1);
+		}
+		header.span_name[sizeof(header.span_name) - 1] = '\0';
+
+		if (!merge) {
+			printf("%u:%u (%u:%u) span %s, %u events\n", header.span_id, header.chan_id,
+					header.physical_span_id, header.physical_chan_id, header.span_name, header.count);
+		}
+		for (e = 0; e < header.count; e++) {
+			if (fread(&entry, sizeof(entry), 1, file) != 1) {
+				fprintf(stderr, "Truncated dump, %u events missing for channel %u:%u\n",
+						header.count - e, header.span_id, header.chan_id);
+				goto done;
+			}
+			if (!merge) {
+				print_event(&header, &entry, 0);
+				continue;
+			}
+			if (count == size) {
+				decoded_event_t *grown;
+
+				size = size ? size * 2 : 1024;
+				if (!(grown = realloc(events, size * sizeof(*events)))) {
+					fprintf(stderr, "Out of memory\n");
+					exit(-1);
+				}
+				events = grown;
+			}
+			events[count].header = header;
+			events[count].entry = entry;
+			count++;
+		}
+	}
+
+done:
+	if (merge) {
+		qsort(events, count, sizeof(*events), compare_events);
+		for (i = 0; i < count; i++) {
+			print_event(&events[i].header, &events[i].entry, 1);
+		}
+	}
+	free(events);
+	fclose(file);
+	return 0;
+}
@@ -42,10 +42,18 @@
 #include "fsk.h"
 #include "uart.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define DSP_FSK_SSE
+#endif
+
 #ifndef M_PI
 #define M_PI        3.14159265358979323846
 #endif
 
+/* number of (downsampled) samples correlated at once */
+#define DSP_FSK_BLOCK_SIZE	160
+
 fsk_modem_definition_t fsk_modem_definitions[] =
 {
     { /* FSK_V23_FORWARD_MODE1	*/	1700,	1300,	600		},
@@ -157,7 +165,7 @@ dsp_fsk_handle_t *dsp_fsk_create(dsp_fsk_attr_t *attr)
 
 	/* allocate the correlation sin/cos arrays and initialize */
 	for (i = 0; i < 4; i++) {
-		handle->correlates[i] = ftdm_malloc(sizeof(double) * handle->corrsize);
+		handle->correlates[i] = ftdm_malloc(sizeof(float) * handle->corrsize);
 		if (handle->correlates[i] == NULL) {
 			/* some failed, back out memory allocations */
 			dsp_fsk_destroy(&handle);
@@ -170,20 +178,19 @@ dsp_fsk_handle_t *dsp_fsk_create(dsp_fsk_attr_t *attr)
 	phi_space = 2. * M_PI / ((double) attr->sample_rate / (double) handle->downsampling_count / (double) fsk_modem_definitions[FSK_BELL202].freq_space);
 
 	for (i = 0; i < handle->corrsize; i++) {
-		handle->correlates[0][i] = sin(phi_mark * (double) i);
-		handle->correlates[1][i] = cos(phi_mark * (double) i);
-		handle->correlates[2][i] = sin(phi_space * (double) i);
-		handle->correlates[3][i] = cos(phi_space * (double) i);
+		handle->correlates[0][i] = (float) sin(phi_mark * (double) i);
+		handle->correlates[1][i] = (float) cos(phi_mark * (double) i);
+		handle->correlates[2][i] = (float) sin(phi_space * (double) i);
+		handle->correlates[3][i] = (float) cos(phi_space * (double) i);
 	}
 
-	/* initialize the ring buffer */
-	handle->buffer = ftdm_malloc(sizeof(double) * handle->corrsize);
-	if (!handle->buffer) {				/* failed; back out memory allocations */
+	/* initialize the sample window (history + one block) */
+	handle->window = ftdm_malloc(sizeof(float) * (handle->corrsize - 1 + DSP_FSK_BLOCK_SIZE));
+	if (!handle->window) {				/* failed; back out memory allocations */
 		dsp_fsk_destroy(&handle);
 		return NULL;
 	}
-	memset(handle->buffer, 0, sizeof(double) * handle->corrsize);
-	handle->ringstart = 0;
+	memset(handle->window, 0, sizeof(float) * (handle->corrsize - 1 + DSP_FSK_BLOCK_SIZE));
 
 	/* initalize intra-cell position */
 	handle->cellpos = 0;
@@ -231,9 +238,9 @@ void dsp_fsk_destroy(dsp_fsk_handle_t **handle)
 		}
 	}
 
-	if ((*handle)->buffer != NULL) {
-		ftdm_safe_free((*handle)->buffer);
-		(*handle)->buffer = NULL;
+	if ((*handle)->window != NULL) {
+		ftdm_safe_free((*handle)->window);
+		(*handle)->window = NULL;
 	}
 
 	if ((*handle)->attr.bytehandler) {
@@ -246,57 +253,17 @@ void dsp_fsk_destroy(dsp_fsk_handle_t **handle)
 }
 
 /*
- *	dsp_fsk_sample
- *
- *	This is the main processing entry point.  The function accepts a normalized
- *	sample (i.e., one whose range is between -1 and +1).  The function performs
- *	the Bell-202 FSK modem decode processing, and, if it detects a valid bit,
- *	will call the bithandler associated with the attributes structure.
+ *	dsp_fsk_bit
  *
- *	For the Bell-202 standard, a logical zero (space) is 2200 Hz, and a logical
- *	one (mark) is 1200 Hz.
+ *	Walks the bit cell along for one (downsampled) sample and, once a full cell
+ *	has been seen, runs the channel seizure / carrier signal / data state machine.
 */
 
-void
-dsp_fsk_sample (dsp_fsk_handle_t *handle, double normalized_sample)
+static __inline__ void dsp_fsk_bit(dsp_fsk_handle_t *handle, int bit)
 {
-	double	val;
-	double	factors[4];
-	int		i, j;
-
-	/* if we can avoid processing samples, do so */
-	if (handle->downsampling_count != 1) {
-		if (handle->current_downsample < handle->downsampling_count) {
-			handle->current_downsample++;
-			return;												/* throw this sample out */
-		}
-		handle->current_downsample = 1;
-	}
-
-	/* store sample in buffer */
-	handle->buffer[handle->ringstart++] = normalized_sample;
-	if (handle->ringstart >= handle->corrsize) {
-		handle->ringstart = 0;
-	}
-
-	/* do the correlation calculation */
-	factors[0] = factors[1] = factors[2] = factors[3] = 0;	/* clear out intermediate sums */
-	j = handle->ringstart;
-	for (i = 0; i < handle->corrsize; i++) {
-		if (j >= handle->corrsize) {
-			j = 0;
-		}
-		val = handle->buffer[j];
-		factors[0] += handle->correlates[0][i] * val;
-		factors[1] += handle->correlates[1][i] * val;
-		factors[2] += handle->correlates[2][i] * val;
-		factors[3] += handle->correlates[3][i] * val;
-		j++;
-	}
-
-	/* store the bit (bit value is comparison of the two sets of correlate factors) */
+	/* store the bit */
 	handle->previous_bit = handle->current_bit;
-	handle->current_bit = (factors[0] * factors[0] + factors[1] * factors[1] > factors[2] * factors[2] + factors[3] * factors[3]);
+	handle->current_bit = bit;
 
 	/* if there's a transition, we can synchronize the cell position */
 	if (handle->previous_bit != handle->current_bit) {
@@ -349,3 +316,158 @@ dsp_fsk_sample (dsp_fsk_handle_t *handle, double normalized_sample)
 	}
 }
 
+/*
+ *	dsp_fsk_process
+ *
+ *	Correlates the count samples following the history in the sample window
+ *	(the window of sample n starts at window[n], the oldest sample matches
+ *	correlate 0).  With SSE four consecutive samples are correlated at once,
+ *	the bits are then fed one by one to the cell state machine.
+*/
+
+static void dsp_fsk_process(dsp_fsk_handle_t *handle, int count)
+{
+	unsigned char	bits[DSP_FSK_BLOCK_SIZE];
+	const float		*window = handle->window;
+	int				i, n = 0;
+
+#ifdef DSP_FSK_SSE
+	for (; n + 4 <= count; n += 4) {
+		__m128	ms = _mm_setzero_ps(), mc = _mm_setzero_ps();
+		__m128	ss = _mm_setzero_ps(), sc = _mm_setzero_ps();
+		__m128	mark, space;
+		int		mask;
+
+		for (i = 0; i < handle->corrsize; i++) {
+			const __m128 v = _mm_loadu_ps(window + n + i);
+
+			ms = _mm_add_ps(ms, _mm_mul_ps(_mm_set1_ps(handle->correlates[0][i]), v));
+			mc = _mm_add_ps(mc, _mm_mul_ps(_mm_set1_ps(handle->correlates[1][i]), v));
+			ss = _mm_add_ps(ss, _mm_mul_ps(_mm_set1_ps(handle->correlates[2][i]), v));
+			sc = _mm_add_ps(sc, _mm_mul_ps(_mm_set1_ps(handle->correlates[3][i]), v));
+		}
+
+		mark = _mm_add_ps(_mm_mul_ps(ms, ms), _mm_mul_ps(mc, mc));
+		space = _mm_add_ps(_mm_mul_ps(ss, ss), _mm_mul_ps(sc, sc));
+		mask = _mm_movemask_ps(_mm_cmpgt_ps(mark, space));
+
+		bits[n] = mask & 1;
+		bits[n + 1] = (mask >> 1) & 1;
+		bits[n + 2] = (mask >> 2) & 1;
+		bits[n + 3] = (mask >> 3) & 1;
+	}
+#endif
+
+	for (; n < count; n++) {
+		float	factors[4] = { 0, 0, 0, 0 };
+		const float	*x = window + n;
+
+		for (i = 0; i < handle->corrsize; i++) {
+			factors[0] += handle->correlates[0][i] * x[i];
+			factors[1] += handle->correlates[1][i] * x[i];
+			factors[2] += handle->correlates[2][i] * x[i];
+			factors[3] += handle->correlates[3][i] * x[i];
+		}
+
+		/* bit value is comparison of the two sets of correlate factors */
+		bits[n] = (factors[0] * factors[0] + factors[1] * factors[1] > factors[2] * factors[2] + factors[3] * factors[3]);
+	}
+
+	for (n = 0; n < count; n++) {
+		dsp_fsk_bit(handle, bits[n]);
+	}
+
+	/* keep the last samples as history for the next block */
+	memmove(handle->window, handle->window + count, sizeof(float) * (handle->corrsize - 1));
+}
+
+/*
+ *	dsp_fsk_block
+ *
+ *	This is the main processing entry point.  The function accepts a block of
+ *	linear samples and performs the Bell-202 FSK modem decode processing, and,
+ *	if it detects a valid bit, will call the bithandler associated with the
+ *	attributes structure.
+ *
+ *	For the Bell-202 standard, a logical zero (space) is 2200 Hz, and a logical
+ *	one (mark) is 1200 Hz.
+*/
+
+void
+dsp_fsk_block (dsp_fsk_handle_t *handle, const int16_t *samples, int count)
+{
+	float	*block = handle->window + handle->corrsize - 1;
+	int		x, len = 0;
+
+	/* samples fed one by one left the history further in the window */
+	if (handle->window_pos) {
+		memmove(handle->window, handle->window + handle->window_pos, sizeof(float) * (handle->corrsize - 1));
+		handle->window_pos = 0;
+	}
+
+	for (x = 0; x < count; x++) {
+		/* if we can avoid processing samples, do so */
+		if (handle->downsampling_count != 1) {
+			if (handle->current_downsample < handle->downsampling_count) {
+				handle->current_downsample++;
+				continue;										/* throw this sample out */
+			}
+			handle->current_downsample = 1;
+		}
+
+		block[len++] = (float) samples[x] * (1.0f / 32767.0f);
+		if (len == DSP_FSK_BLOCK_SIZE) {
+			dsp_fsk_process(handle, len);
+			len = 0;
+		}
+	}
+
+	if (len) {
+		dsp_fsk_process(handle, len);
+	}
+}
+
+/*
+ *	dsp_fsk_sample
+ *
+ *	Same as dsp_fsk_block, for a single normalized sample (i.e., one whose
+ *	range is between -1 and +1).  The samples are appended to the block part
+ *	of the window, the history is only moved back once the block is full.
+*/
+
+void
+dsp_fsk_sample (dsp_fsk_handle_t *handle, double normalized_sample)
+{
+	const float	*ms = handle->correlates[0], *mc = handle->correlates[1];
+	const float	*ss = handle->correlates[2], *sc = handle->correlates[3];
+	const float	*x;
+	float	f0 = 0, f1 = 0, f2 = 0, f3 = 0;
+	int		i, corrsize = handle->corrsize;
+
+	/* if we can avoid processing samples, do so */
+	if (handle->downsampling_count != 1) {
+		if (handle->current_downsample < handle->downsampling_count) {
+			handle->current_downsample++;
+			return;												/* throw this sample out */
+		}
+		handle->current_downsample = 1;
+	}
+
+	if (handle->window_pos == DSP_FSK_BLOCK_SIZE) {
+		memmove(handle->window, handle->window + DSP_FSK_BLOCK_SIZE, sizeof(float) * (corrsize - 1));
+		handle->window_pos = 0;
+	}
+
+	x = handle->window + handle->window_pos++;
+	handle->window[handle->window_pos + corrsize - 2] = (float) normalized_sample;
+
+	for (i = 0; i < corrsize; i++) {
+		f0 += ms[i] * x[i];
+		f1 += mc[i] * x[i];
+		f2 += ss[i] * x[i];
+		f3 += sc[i] * x[i];
+	}
+
+	/* bit value is comparison of the two sets of correlate factors */
+	dsp_fsk_bit(handle, f0 * f0 + f1 * f1 > f2 * f2 + f3 * f3);
+}
@@ -30,7 +30,7 @@ static void fsk_byte_handler (void *x, int data)
 
  add_byte:
 
-	if (state->bpos <= state->dlen) {
+	if (!state->dlen || state->bpos < state->dlen) {
 		state->buf[state->bpos++] = byte;
 	} else {
 		state->init = 3;
@@ -148,19 +148,16 @@ FT_DECLARE(ftdm_status_t) ftdm_fsk_data_parse(ftdm_fsk_data_state_t *state, ftdm
 
 FT_DECLARE(ftdm_status_t) ftdm_fsk_demod_feed(ftdm_fsk_data_state_t *state, int16_t *data, ftdm_size_t samples)
 {
-	uint32_t x;
-	int16_t *sp = data;
-
 	if (state->init == 3) {
 		return FTDM_FAIL;
 	}
 
-	for (x = 0; x < samples; x++) {
-		dsp_fsk_sample (state->fsk1200_handle, (double) *sp++ / 32767.0);
-		if (state->dlen && state->bpos >= state->dlen) {
-			state->init = 3;
-			return FTDM_FAIL;
-		}
+	dsp_fsk_block(state->fsk1200_handle, data, (int)samples);
+
+	/* the byte handler ignores anything received after the message */
+	if (state->dlen && state->bpos >= state->dlen) {
+		state->init = 3;
+		return FTDM_FAIL;
 	}
 
 	return FTDM_SUCCESS;
@@ -108,6 +108,8 @@ static val_str_t channel_flag_strs[] =  {
 	{ "media",  FTDM_CHANNEL_DIGITAL_MEDIA},
 	{ "native-sigbridge",  FTDM_CHANNEL_NATIVE_SIGBRIDGE},
 	{ "sig-dtmf-detection", FTDM_CHANNEL_SIG_DTMF_DETECTION},
+	{ "async", FTDM_CHANNEL_ASYNC},
+	{ "ind-chain", FTDM_CHANNEL_IND_CHAIN},
 	{ "invalid",  FTDM_CHANNEL_MAX_FLAG},
 };
 
@@ -127,6 +129,7 @@ static val_str_t span_flag_strs[] =  {
 	{ "skip-state", FTDM_SPAN_USE_SKIP_STATES},
 	{ "non-stoppable", FTDM_SPAN_NON_STOPPABLE},
 	{ "use-transfer", FTDM_SPAN_USE_TRANSFER},
+	{ "use-dirty-map", FTDM_SPAN_USE_DIRTY_MAP},
 };
 
 static ftdm_status_t ftdm_call_set_call_id(ftdm_channel_t *fchan, ftdm_caller_data_t *caller_data);
@@ -260,27 +263,27 @@ static ftdm_status_t start_chan_io_dump(ftdm_channel_t *chan, ftdm_io_dump_t *du
 
 static void close_dtmf_debug_file(ftdm_channel_t *ftdmchan)
 {
-	if (ftdmchan->dtmfdbg.file) {
+	if (ftdmchan->cold->dtmfdbg.file) {
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "closing debug dtmf file\n");
-		fclose(ftdmchan->dtmfdbg.file);
-		ftdmchan->dtmfdbg.file = NULL;
+		fclose(ftdmchan->cold->dtmfdbg.file);
+		ftdmchan->cold->dtmfdbg.file = NULL;
 	}
 }
 
 static ftdm_status_t disable_dtmf_debug(ftdm_channel_t *ftdmchan)
 {
-	if (!ftdmchan->dtmfdbg.enabled) {
+	if (!ftdmchan->cold->dtmfdbg.enabled) {
 		return FTDM_SUCCESS;
 	}
 
-	if (!ftdmchan->rxdump.buffer) {
+	if (!ftdmchan->cold->rxdump.buffer) {
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "DTMF debug enabled but no rx dump?\n");	
 		return FTDM_FAIL;
 	}
 
 	close_dtmf_debug_file(ftdmchan);
-	stop_chan_io_dump(&ftdmchan->rxdump);
-	ftdmchan->dtmfdbg.enabled = 0;
+	stop_chan_io_dump(&ftdmchan->cold->rxdump);
+	ftdmchan->cold->dtmfdbg.enabled = 0;
 	return FTDM_SUCCESS;
 }
 
@@ -295,11 +298,28 @@ typedef struct {
 	ftdm_interrupt_t *interrupt;
 } cpu_monitor_t;
 
+typedef struct {
+	const char *name;
+	void *obj;
+} ftdm_name_slot_t;
+
+/*
+ * Immutable name index (open addressing, at most half full), a new copy is published on every change.
+ * Replaced copies are kept in the retired list and freed on shutdown since readers do not lock,
+ * spans and groups are only added at configuration time so the list stays short
+ */
+typedef struct ftdm_name_index ftdm_name_index_t;
+struct ftdm_name_index {
+	uint32_t size;
+	uint32_t count;
+	ftdm_name_slot_t *slots;
+	ftdm_name_index_t *retired;
+};
+
 static struct {
 	ftdm_hash_t *interface_hash;
 	ftdm_hash_t *module_hash;
 	ftdm_hash_t *span_hash;
-	ftdm_hash_t *group_hash;
 	ftdm_mutex_t *mutex;
 	ftdm_mutex_t *span_mutex;
 	ftdm_mutex_t *group_mutex;
@@ -309,12 +329,22 @@ static struct {
 	uint32_t running;
 	ftdm_span_t *spans;
 	ftdm_group_t *groups;
+	/* lookup tables written under the span/group mutex and read without locking */
+	ftdm_span_t * volatile span_table[FTDM_MAX_SPANS_INTERFACE+1];
+	ftdm_group_t * volatile group_table[FTDM_MAX_GROUPS_INTERFACE+1];
+	ftdm_name_index_t * volatile span_names;
+	ftdm_name_index_t * volatile group_names;
 	cpu_monitor_t cpu_monitor;
 	
-	ftdm_caller_data_t *call_ids[MAX_CALLIDS+1];
-	ftdm_mutex_t *call_id_mutex;
-	uint32_t last_call_id;
+	/* call registry, slots are claimed and released with atomic operations, see ftdm_call_set_call_id() */
+	ftdm_caller_data_t * volatile call_ids[MAX_CALLIDS+1];
+	volatile uint32_t last_call_id;
 	char dtmfdebug_directory[1024];
+	/* OpenMetrics export */
+	ftdm_metric_t calls_metric;
+	char metrics_file[1024];
+	int metrics_interval;
+	ftdm_timer_id_t metrics_timer;
 } globals;
 
 enum ftdm_enum_cpu_alarm_action_flags
@@ -581,6 +611,8 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_set_caller_data(ftdm_channel_t *ftdmchan,
 
 FT_DECLARE_DATA ftdm_logger_t ftdm_log = null_logger;
 
+FT_DECLARE_DATA int ftdm_log_threshold = FTDM_LOG_LEVEL_DEBUG;
+
 FT_DECLARE(void) ftdm_global_set_crash_policy(ftdm_crash_policy_t policy)
 {
 	g_ftdm_crash_policy |= policy;
@@ -611,6 +643,9 @@ FT_DECLARE(void) ftdm_global_set_logger(ftdm_logger_t logger)
 	} else {
 		ftdm_log = null_logger;
 	}
+	/* the logger does its own filtering */
+	ftdm_log_threshold = FTDM_LOG_LEVEL_DEBUG;
+	ftdm_log_async_stop();
 }
 
 FT_DECLARE(void) ftdm_global_set_default_logger(int level)
@@ -621,6 +656,33 @@ FT_DECLARE(void) ftdm_global_set_default_logger(int level)
 
 	ftdm_log = default_logger;
 	ftdm_log_level = level;
+	ftdm_log_threshold = level;
+	ftdm_log_async_stop();
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_global_set_async_logger(ftdm_logger_t logger, int level)
+{
+	if (level < 0 || level > 7) {
+		level = 7;
+	}
+
+	if (ftdm_log_async_start(logger ? logger : default_logger) != FTDM_SUCCESS) {
+		return FTDM_FAIL;
+	}
+
+	ftdm_log_level = level;
+	ftdm_log_threshold = level;
+	ftdm_log = ftdm_log_async_write;
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(void) ftdm_global_set_log_level(int level)
+{
+	if (level < 0 || level > 7) {
+		level = 7;
+	}
+
+	ftdm_log_threshold = level;
 }
 
 FT_DECLARE_NONSTD(int) ftdm_hash_equalkeys(void *k1, void *k2)
@@ -641,6 +703,83 @@ FT_DECLARE_NONSTD(uint32_t) ftdm_hash_hashfromstring(void *ky)
     return hash;
 }
 
+static void ftdm_name_index_insert(ftdm_name_index_t *index, const char *name, void *obj)
+{
+	uint32_t i = ftdm_hash_hashfromstring((void *)name) & (index->size - 1);
+
+	while (index->slots[i].name) {
+		i = (i + 1) & (index->size - 1);
+	}
+	index->slots[i].name = name;
+	index->slots[i].obj = obj;
+	index->count++;
+}
+
+/*! \brief Publish a copy of the index with the name added (or removed if obj is NULL), the caller serialises writers */
+static void ftdm_name_index_update(ftdm_name_index_t * volatile *indexp, const char *name, void *obj)
+{
+	ftdm_name_index_t *old = *indexp;
+	ftdm_name_index_t *index = NULL;
+	uint32_t size = 8;
+	uint32_t i;
+
+	while (size < ((old ? old->count : 0) + 1) * 2) {
+		size <<= 1;
+	}
+
+	index = ftdm_calloc(1, sizeof(*index) + (size * sizeof(ftdm_name_slot_t)));
+	if (!index) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to allocate name index, %s will not be found by name\n", name);
+		return;
+	}
+	index->size = size;
+	index->slots = (ftdm_name_slot_t *)(index + 1);
+
+	for (i = 0; old && i < old->size; i++) {
+		if (old->slots[i].name && strcmp(old->slots[i].name, name)) {
+			ftdm_name_index_insert(index, old->slots[i].name, old->slots[i].obj);
+		}
+	}
+	if (obj) {
+		ftdm_name_index_insert(index, name, obj);
+	}
+
+	index->retired = old;
+	ftdm_atomic_cas_ptr((void * volatile *)indexp, old, index);
+}
+
+static void *ftdm_name_index_find(ftdm_name_index_t * volatile *indexp, const char *name)
+{
+	ftdm_name_index_t *index = ftdm_atomic_get_ptr((void * volatile *)indexp);
+	uint32_t i;
+
+	if (!index) {
+		return NULL;
+	}
+
+	i = ftdm_hash_hashfromstring((void *)name) & (index->size - 1);
+	while (index->slots[i].name) {
+		if (!strcmp(index->slots[i].name, name)) {
+			return index->slots[i].obj;
+		}
+		i = (i + 1) & (index->size - 1);
+	}
+	return NULL;
+}
+
+static void ftdm_name_index_destroy(ftdm_name_index_t * volatile *indexp)
+{
+	ftdm_name_index_t *index = *indexp;
+	ftdm_name_index_t *retired = NULL;
+
+	while (index) {
+		retired = index->retired;
+		ftdm_free(index);
+		index = retired;
+	}
+	*indexp = NULL;
+}
+
 static ftdm_status_t ftdm_channel_destroy(ftdm_channel_t *ftdmchan)
 {
 
@@ -663,9 +802,9 @@ static ftdm_status_t ftdm_channel_destroy(ftdm_channel_t *ftdmchan)
 
 		ftdm_safe_free(ftdmchan->dtmf_hangup_buf);
 
-		if (ftdmchan->tone_session.buffer) {
-			teletone_destroy_session(&ftdmchan->tone_session);
-			memset(&ftdmchan->tone_session, 0, sizeof(ftdmchan->tone_session));
+		if (ftdmchan->cold->tone_session.buffer) {
+			teletone_destroy_session(&ftdmchan->cold->tone_session);
+			memset(&ftdmchan->cold->tone_session, 0, sizeof(ftdmchan->cold->tone_session));
 		}
 
 		
@@ -706,6 +845,7 @@ static ftdm_status_t ftdm_span_destroy(ftdm_span_t *span)
 			if (ftdm_test_flag(cur_chan, FTDM_CHANNEL_CONFIGURED)) {
 				ftdm_channel_destroy(cur_chan);
 			}
+			ftdm_safe_free(cur_chan->cold);
 			ftdm_safe_free(cur_chan);
 			cur_chan = NULL;
 		}
@@ -723,6 +863,9 @@ static ftdm_status_t ftdm_span_destroy(ftdm_span_t *span)
 	if (span->pendingchans) {
 		ftdm_queue_destroy(&span->pendingchans);
 	}
+	if (span->dirty.interrupt) {
+		ftdm_interrupt_destroy(&span->dirty.interrupt);
+	}
 	if (span->pendingsignals) {
 		ftdm_sigmsg_t *sigmsg = NULL;
 		while ((sigmsg = ftdm_queue_dequeue(span->pendingsignals))) {
@@ -812,6 +955,8 @@ static void ftdm_span_add(ftdm_span_t *span)
 		globals.spans = span;
 	}
 	hashtable_insert(globals.span_hash, (void *)span->name, span, HASHTABLE_FLAG_FREE_VALUE);
+	ftdm_name_index_update(&globals.span_names, span->name, span);
+	ftdm_atomic_cas_ptr((void * volatile *)&globals.span_table[span->span_id], NULL, span);
 	ftdm_mutex_unlock(globals.span_mutex);
 }
 
@@ -1089,6 +1234,10 @@ FT_DECLARE(ftdm_status_t) ftdm_span_add_channel(ftdm_span_t *span, ftdm_socket_t
 				return FTDM_FAIL;
 			}
 #endif
+			if (!(new_chan->cold = ftdm_calloc(1, sizeof(*new_chan->cold)))) {
+				ftdm_safe_free(new_chan);
+				return FTDM_FAIL;
+			}
 			span->channels[span->chan_count] = new_chan;
 		}
 
@@ -1142,9 +1291,8 @@ FT_DECLARE(ftdm_status_t) ftdm_span_find_by_name(const char *name, ftdm_span_t *
 {
 	ftdm_status_t status = FTDM_FAIL;
 
-	ftdm_mutex_lock(globals.span_mutex);
 	if (!ftdm_strlen_zero(name)) {
-		if ((*span = hashtable_search(globals.span_hash, (void *)name))) {
+		if ((*span = ftdm_name_index_find(&globals.span_names, name))) {
 			status = FTDM_SUCCESS;
 		} else {
 			int span_id = atoi(name);
@@ -1155,27 +1303,19 @@ FT_DECLARE(ftdm_status_t) ftdm_span_find_by_name(const char *name, ftdm_span_t *
 			}
 		}
 	}
-	ftdm_mutex_unlock(globals.span_mutex);
-	
+
 	return status;
 }
 
 FT_DECLARE(ftdm_status_t) ftdm_span_find(uint32_t id, ftdm_span_t **span)
 {
-	ftdm_span_t *fspan = NULL, *sp;
+	ftdm_span_t *fspan = NULL;
 
 	if (id > FTDM_MAX_SPANS_INTERFACE) {
 		return FTDM_FAIL;
 	}
 
-	ftdm_mutex_lock(globals.span_mutex);
-	for (sp = globals.spans; sp; sp = sp->next) {
-		if (sp->span_id == id) {
-			fspan = sp;
-			break;
-		}
-	}
-	ftdm_mutex_unlock(globals.span_mutex);
+	fspan = ftdm_atomic_get_ptr((void * volatile *)&globals.span_table[id]);
 
 	if (!fspan || !ftdm_test_flag(fspan, FTDM_SPAN_CONFIGURED)) {
 		return FTDM_FAIL;
@@ -1212,6 +1352,7 @@ static __inline__ ftdm_status_t ftdm_event_handle_oob(ftdm_event_t *event)
 	sigmsg.span_id = span->span_id;
 	sigmsg.chan_id = fchan->chan_id;
 	sigmsg.channel = fchan;
+	ftdm_channel_record(fchan, FTDM_RECORDER_OOB, event->enum_id, 0);
 	switch (event->enum_id) {
 	case FTDM_OOB_ALARM_CLEAR:
 		{
@@ -1324,18 +1465,18 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_clear_token(ftdm_channel_t *ftdmchan, con
 	
 	ftdm_mutex_lock(ftdmchan->mutex);
 	if (token == NULL) {
-		memset(ftdmchan->tokens, 0, sizeof(ftdmchan->tokens));
+		memset(ftdmchan->cold->tokens, 0, sizeof(ftdmchan->cold->tokens));
 		ftdmchan->token_count = 0;
 	} else if (*token != '\0') {
 		char tokens[FTDM_MAX_TOKENS][FTDM_TOKEN_STRLEN];
 		int32_t i, count = ftdmchan->token_count;
-		memcpy(tokens, ftdmchan->tokens, sizeof(tokens));
-		memset(ftdmchan->tokens, 0, sizeof(ftdmchan->tokens));
+		memcpy(tokens, ftdmchan->cold->tokens, sizeof(tokens));
+		memset(ftdmchan->cold->tokens, 0, sizeof(ftdmchan->cold->tokens));
 		ftdmchan->token_count = 0;		
 
 		for (i = 0; i < count; i++) {
 			if (strcmp(tokens[i], token)) {
-				ftdm_copy_string(ftdmchan->tokens[ftdmchan->token_count], tokens[i], sizeof(ftdmchan->tokens[ftdmchan->token_count]));
+				ftdm_copy_string(ftdmchan->cold->tokens[ftdmchan->token_count], tokens[i], sizeof(ftdmchan->cold->tokens[ftdmchan->token_count]));
 				ftdmchan->token_count++;
 			}
 		}
@@ -1350,9 +1491,9 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_clear_token(ftdm_channel_t *ftdmchan, con
 FT_DECLARE(void) ftdm_channel_rotate_tokens(ftdm_channel_t *ftdmchan)
 {
 	if (ftdmchan->token_count) {
-		memmove(ftdmchan->tokens[1], ftdmchan->tokens[0], ftdmchan->token_count * FTDM_TOKEN_STRLEN);
-		ftdm_copy_string(ftdmchan->tokens[0], ftdmchan->tokens[ftdmchan->token_count], FTDM_TOKEN_STRLEN);
-		*ftdmchan->tokens[ftdmchan->token_count] = '\0';
+		memmove(ftdmchan->cold->tokens[1], ftdmchan->cold->tokens[0], ftdmchan->token_count * FTDM_TOKEN_STRLEN);
+		ftdm_copy_string(ftdmchan->cold->tokens[0], ftdmchan->cold->tokens[ftdmchan->token_count], FTDM_TOKEN_STRLEN);
+		*ftdmchan->cold->tokens[ftdmchan->token_count] = '\0';
 	}
 }
 
@@ -1362,8 +1503,8 @@ FT_DECLARE(void) ftdm_channel_replace_token(ftdm_channel_t *ftdmchan, const char
 
 	if (ftdmchan->token_count) {
 		for(i = 0; i < ftdmchan->token_count; i++) {
-			if (!strcmp(ftdmchan->tokens[i], old_token)) {
-				ftdm_copy_string(ftdmchan->tokens[i], new_token, FTDM_TOKEN_STRLEN);
+			if (!strcmp(ftdmchan->cold->tokens[i], old_token)) {
+				ftdm_copy_string(ftdmchan->cold->tokens[i], new_token, FTDM_TOKEN_STRLEN);
 				break;
 			}
 		}
@@ -1427,7 +1568,7 @@ FT_DECLARE(const char *) ftdm_channel_get_token(const ftdm_channel_t *ftdmchan,
 		return NULL;
 	}
 
-	token = ftdmchan->tokens[tokenid];
+	token = ftdmchan->cold->tokens[tokenid];
 	ftdm_mutex_unlock(ftdmchan->mutex);
 	return token;
 }
@@ -1439,10 +1580,10 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_add_token(ftdm_channel_t *ftdmchan, char
 	ftdm_mutex_lock(ftdmchan->mutex);
 	if (ftdmchan->token_count < FTDM_MAX_TOKENS) {
 		if (end) {
-			ftdm_copy_string(ftdmchan->tokens[ftdmchan->token_count++], token, FTDM_TOKEN_STRLEN);
+			ftdm_copy_string(ftdmchan->cold->tokens[ftdmchan->token_count++], token, FTDM_TOKEN_STRLEN);
 		} else {
-			memmove(ftdmchan->tokens[1], ftdmchan->tokens[0], ftdmchan->token_count * FTDM_TOKEN_STRLEN);
-			ftdm_copy_string(ftdmchan->tokens[0], token, FTDM_TOKEN_STRLEN);
+			memmove(ftdmchan->cold->tokens[1], ftdmchan->cold->tokens[0], ftdmchan->token_count * FTDM_TOKEN_STRLEN);
+			ftdm_copy_string(ftdmchan->cold->tokens[0], token, FTDM_TOKEN_STRLEN);
 			ftdmchan->token_count++;
 		}
 		status = FTDM_SUCCESS;
@@ -2260,6 +2401,8 @@ FT_DECLARE(void) ftdm_ack_indication(ftdm_channel_t *fchan, ftdm_channel_indicat
 	ftdm_log_chan(fchan, FTDM_LOG_DEBUG, "Acknowledging indication %s in state %s (rc = %d)\n",
 			ftdm_channel_indication2str(indication), ftdm_channel_state2str(fchan->state), status);
 	ftdm_clear_flag(fchan, FTDM_CHANNEL_IND_ACK_PENDING);
+	ftdm_clear_flag(fchan, FTDM_CHANNEL_IND_CHAIN);
+	ftdm_channel_record(fchan, FTDM_RECORDER_INDICATE_DONE, indication, (uint16_t)status);
 	memset(&msg, 0, sizeof(msg));
 	msg.channel = fchan;
 	msg.event_id = FTDM_SIGEVENT_INDICATION_COMPLETED;
@@ -2284,6 +2427,10 @@ static ftdm_status_t _ftdm_channel_call_answer_nl(const char *file, const char *
 				status = FTDM_ECANCELED;
 				goto done;
 			}
+			if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_IND_ACK_PENDING)) {
+				/* non-blocking, PROGRESS_MEDIA and UP are set by the core as each state is completed */
+				goto done;
+			}
 		}
 
 		/* set state unlocks the channel so we need to re-confirm that the channel hasn't gone to hell */
@@ -2299,6 +2446,9 @@ static ftdm_status_t _ftdm_channel_call_answer_nl(const char *file, const char *
 				status = FTDM_ECANCELED;
 				goto done;
 			}
+			if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_IND_ACK_PENDING)) {
+				goto done;
+			}
 		}
 
 		/* set state unlocks the channel so we need to re-confirm that the channel hasn't gone to hell */
@@ -2361,6 +2511,8 @@ static ftdm_status_t _ftdm_channel_call_hangup_nl(const char *file, const char *
 {
 	ftdm_status_t status = FTDM_SUCCESS;
 
+	ftdm_channel_record(chan, FTDM_RECORDER_HANGUP, chan->caller_data.hangup_cause, 0);
+
 	/* In native sigbridge mode we ignore hangup requests from the user and hangup only when the signaling module decides it */
 	if (ftdm_test_flag(chan, FTDM_CHANNEL_NATIVE_SIGBRIDGE) && chan->state != FTDM_CHANNEL_STATE_TERMINATING) {
 
@@ -2428,6 +2580,21 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_hangup(const char *file, const char
 	return status;
 }
 
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_hangup_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_call_cause_t cause, ftdm_usrmsg_t *usrmsg)
+{
+	ftdm_status_t status = FTDM_SUCCESS;
+	ftdm_channel_lock(ftdmchan);
+
+	ftdmchan->caller_data.hangup_cause = cause;
+	ftdm_set_flag(ftdmchan, FTDM_CHANNEL_ASYNC);
+
+	status = _ftdm_channel_call_hangup_nl(file, func, line, ftdmchan, usrmsg);
+
+	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_ASYNC);
+	ftdm_channel_unlock(ftdmchan);
+	return status;
+}
+
 FT_DECLARE(const char *) ftdm_channel_get_last_error(const ftdm_channel_t *ftdmchan)
 {
 	return ftdmchan->last_error;
@@ -2515,16 +2682,16 @@ FT_DECLARE(uint32_t) ftdm_channel_get_ph_span_id(const ftdm_channel_t *ftdmchan)
  * someone *MUST* acknowledge the indication, either the signaling stack, this function or the core
  * at some later point
  * */
-FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_indication_t indication, ftdm_usrmsg_t *usrmsg)
+/* must be called with the channel lock held, the lock recursivity must be 1 (blocking state changes unlock the channel) */
+static ftdm_status_t _ftdm_channel_call_indicate_nl(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_indication_t indication, ftdm_usrmsg_t *usrmsg)
 {
 	ftdm_status_t status = FTDM_SUCCESS;
-
-	ftdm_assert_return(ftdmchan, FTDM_FAIL, "Null channel\n");
+	ftdm_bool_t ack_pending = FTDM_FALSE;
 
 	ftdm_log_chan_ex(ftdmchan, file, func, line, FTDM_LOG_LEVEL_DEBUG, "Indicating %s in state %s\n",
 			ftdm_channel_indication2str(indication), ftdm_channel_state2str(ftdmchan->state));
 
-	ftdm_channel_lock(ftdmchan);
+	ftdm_channel_record(ftdmchan, FTDM_RECORDER_INDICATE, indication, 0);
 
 	if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_NATIVE_SIGBRIDGE)) {
 		ftdm_log_chan_ex(ftdmchan, file, func, line, FTDM_LOG_LEVEL_DEBUG, 
@@ -2545,8 +2712,9 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate(const char *file, const ch
 	}
 
 	ftdmchan->indication = indication;
-	if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_NONBLOCK)) {
+	if (ftdm_test_flag(ftdmchan, (FTDM_CHANNEL_NONBLOCK | FTDM_CHANNEL_ASYNC))) {
 		ftdm_set_flag(ftdmchan, FTDM_CHANNEL_IND_ACK_PENDING);
+		ack_pending = FTDM_TRUE;
 	}
 
 	if (indication != FTDM_CHANNEL_INDICATE_FACILITY &&
@@ -2592,6 +2760,10 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate(const char *file, const ch
 				if (status != FTDM_SUCCESS) {
 					goto done;
 				}
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_IND_ACK_PENDING)) {
+					/* non-blocking, PROGRESS_MEDIA is set by the core once PROGRESS is completed */
+					goto done;
+				}
 			}
 
 			/* set state unlocks the channel so we need to re-confirm that the channel hasn't gone to hell */
@@ -2620,11 +2792,50 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate(const char *file, const ch
 	}
 
 done:
+	if (ack_pending && status != FTDM_SUCCESS) {
+		/* the request failed right away, no completion will be delivered */
+		ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_IND_ACK_PENDING);
+	}
+	return status;
+}
+
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_indication_t indication, ftdm_usrmsg_t *usrmsg)
+{
+	ftdm_status_t status;
+
+	ftdm_assert_return(ftdmchan, FTDM_FAIL, "Null channel\n");
+
+	ftdm_channel_lock(ftdmchan);
+
+	status = _ftdm_channel_call_indicate_nl(file, func, line, ftdmchan, indication, usrmsg);
+
 	ftdm_channel_unlock(ftdmchan);
 
 	return status;
 }
 
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_indication_t indication, ftdm_usrmsg_t *usrmsg)
+{
+	ftdm_status_t status;
+
+	ftdm_assert_return(ftdmchan, FTDM_FAIL, "Null channel\n");
+
+	ftdm_channel_lock(ftdmchan);
+	ftdm_set_flag(ftdmchan, FTDM_CHANNEL_ASYNC);
+
+	status = _ftdm_channel_call_indicate_nl(file, func, line, ftdmchan, indication, usrmsg);
+
+	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_ASYNC);
+	ftdm_channel_unlock(ftdmchan);
+
+	return status;
+}
+
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_answer_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_usrmsg_t *usrmsg)
+{
+	return _ftdm_channel_call_indicate_async(file, func, line, ftdmchan, FTDM_CHANNEL_INDICATE_ANSWER, usrmsg);
+}
+
 FT_DECLARE(ftdm_status_t) _ftdm_channel_reset(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_usrmsg_t *usrmsg)
 {
 	ftdm_assert_return(ftdmchan != NULL, FTDM_FAIL, "null channel");
@@ -2690,6 +2901,8 @@ static ftdm_status_t _ftdm_channel_call_place_nl(const char *file, const char *f
 	ftdm_assert_return(ftdmchan != NULL, FTDM_FAIL, "null channel");
 	ftdm_assert_return(ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND), FTDM_FAIL, "Call place, but outbound flag not set\n");
 
+	ftdm_channel_record(ftdmchan, FTDM_RECORDER_PLACE, 0, 0);
+
 	if (!ftdmchan->span->outgoing_call) {
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "outgoing_call method not implemented in this span!\n");
 		status = FTDM_ENOSYS;
@@ -2733,13 +2946,13 @@ static ftdm_status_t _ftdm_channel_call_place_nl(const char *file, const char *f
 
 	/* if the signaling stack left the channel in state down on success, is expecting us to move to DIALING */
 	if (ftdmchan->state == FTDM_CHANNEL_STATE_DOWN) {
-		if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_NONBLOCK)) {
+		if (!ftdm_test_flag(ftdmchan, (FTDM_CHANNEL_NONBLOCK | FTDM_CHANNEL_ASYNC))) {
 			ftdm_channel_set_state(file, func, line, ftdmchan, FTDM_CHANNEL_STATE_DIALING, 1, usrmsg);	
 		} else {
 			ftdm_channel_set_state(file, func, line, ftdmchan, FTDM_CHANNEL_STATE_DIALING, 0, usrmsg);	
 		}
 	} else if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE) &&
-		   !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_NONBLOCK)) {
+		   !ftdm_test_flag(ftdmchan, (FTDM_CHANNEL_NONBLOCK | FTDM_CHANNEL_ASYNC))) {
 		
 		ftdm_channel_unlock(ftdmchan);
 
@@ -2767,8 +2980,8 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_place(const char *file, const char
 	return status;
 }
 
-FT_DECLARE(ftdm_status_t) _ftdm_call_place(const char *file, const char *func, int line, 
-		   ftdm_caller_data_t *caller_data, ftdm_hunting_scheme_t *hunting, ftdm_usrmsg_t *usrmsg)
+static ftdm_status_t ftdm_call_place_hunt(const char *file, const char *func, int line,
+		   ftdm_caller_data_t *caller_data, ftdm_hunting_scheme_t *hunting, ftdm_usrmsg_t *usrmsg, ftdm_bool_t async)
 {
 	ftdm_status_t status = FTDM_SUCCESS;
 	ftdm_channel_t *fchan = NULL;
@@ -2804,6 +3017,10 @@ FT_DECLARE(ftdm_status_t) _ftdm_call_place(const char *file, const char *func, i
 
 	ftdm_channel_set_caller_data(fchan, caller_data);
 
+	if (async) {
+		ftdm_set_flag(fchan, FTDM_CHANNEL_ASYNC);
+	}
+
 	/* be aware that _ftdm_channl_call_place_nl can unlock/lock the channel quickly if working in blocking mode  */
 	status = _ftdm_channel_call_place_nl(file, func, line, fchan, usrmsg);
 	if (status != FTDM_SUCCESS) {
@@ -2815,11 +3032,24 @@ FT_DECLARE(ftdm_status_t) _ftdm_call_place(const char *file, const char *func, i
 	caller_data->fchan = fchan;
 	caller_data->call_id = fchan->caller_data.call_id;
 done:
+	ftdm_clear_flag(fchan, FTDM_CHANNEL_ASYNC);
 	ftdm_channel_unlock(fchan);
 
 	return status;
 }
 
+FT_DECLARE(ftdm_status_t) _ftdm_call_place(const char *file, const char *func, int line, 
+		   ftdm_caller_data_t *caller_data, ftdm_hunting_scheme_t *hunting, ftdm_usrmsg_t *usrmsg)
+{
+	return ftdm_call_place_hunt(file, func, line, caller_data, hunting, usrmsg, FTDM_FALSE);
+}
+
+FT_DECLARE(ftdm_status_t) _ftdm_call_place_async(const char *file, const char *func, int line,
+		   ftdm_caller_data_t *caller_data, ftdm_hunting_scheme_t *hunting, ftdm_usrmsg_t *usrmsg)
+{
+	return ftdm_call_place_hunt(file, func, line, caller_data, hunting, usrmsg, FTDM_TRUE);
+}
+
 FT_DECLARE(ftdm_status_t) ftdm_channel_set_sig_status(ftdm_channel_t *fchan, ftdm_signaling_status_t sigstatus)
 {
 	ftdm_status_t res;
@@ -2914,6 +3144,7 @@ static ftdm_status_t ftdm_channel_done(ftdm_channel_t *ftdmchan)
 
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_OPEN);
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_DTMF_DETECT);
+	ftdmchan->cold->metrics.last_read = 0;
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_SUPRESS_DTMF);
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_INUSE);
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND);
@@ -2970,7 +3201,7 @@ static ftdm_status_t ftdm_channel_done(ftdm_channel_t *ftdmchan)
 
 	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_HOLD);
 
-	memset(ftdmchan->tokens, 0, sizeof(ftdmchan->tokens));
+	memset(ftdmchan->cold->tokens, 0, sizeof(ftdmchan->cold->tokens));
 	ftdmchan->token_count = 0;
 
 	ftdm_channel_flush_dtmf(ftdmchan);
@@ -3060,24 +3291,36 @@ static ftdm_status_t ftdmchan_activate_dtmf_buffer(ftdm_channel_t *ftdmchan)
 	}
 
 	
-	if (!ftdmchan->tone_session.buffer) {
-		memset(&ftdmchan->tone_session, 0, sizeof(ftdmchan->tone_session));
-		teletone_init_session(&ftdmchan->tone_session, 0, NULL, NULL);
+	if (!ftdmchan->cold->tone_session.buffer) {
+		memset(&ftdmchan->cold->tone_session, 0, sizeof(ftdmchan->cold->tone_session));
+		teletone_init_session(&ftdmchan->cold->tone_session, 0, NULL, NULL);
 	}
 
-	ftdmchan->tone_session.rate = ftdmchan->rate;
-	ftdmchan->tone_session.duration = ftdmchan->dtmf_on * (ftdmchan->tone_session.rate / 1000);
-	ftdmchan->tone_session.wait = ftdmchan->dtmf_off * (ftdmchan->tone_session.rate / 1000);
-	ftdmchan->tone_session.volume = -7;
+	ftdmchan->cold->tone_session.rate = ftdmchan->rate;
+	ftdmchan->cold->tone_session.duration = ftdmchan->dtmf_on * (ftdmchan->cold->tone_session.rate / 1000);
+	ftdmchan->cold->tone_session.wait = ftdmchan->dtmf_off * (ftdmchan->cold->tone_session.rate / 1000);
+	ftdmchan->cold->tone_session.volume = -7;
 
 	/*
-	  ftdmchan->tone_session.debug = 1;
-	  ftdmchan->tone_session.debug_stream = stdout;
+	  ftdmchan->cold->tone_session.debug = 1;
+	  ftdmchan->cold->tone_session.debug_stream = stdout;
 	*/
 
 	return FTDM_SUCCESS;
 }
 
+/*
+ * DTMF is written to ftdmchan->dtmf_buffer in the native codec of the channel when it is G.711
+ * (pre-rendered by the tone cache), linear otherwise
+ */
+static __inline__ ftdm_codec_t ftdm_channel_dtmf_codec(const ftdm_channel_t *ftdmchan)
+{
+	if (ftdmchan->native_codec == FTDM_CODEC_ULAW || ftdmchan->native_codec == FTDM_CODEC_ALAW) {
+		return ftdmchan->native_codec;
+	}
+	return FTDM_CODEC_SLIN;
+}
+
 /*
  * ftdmchan_activate_dtmf_buffer to initialize ftdmchan->dtmf_buffer should be called prior to
  * calling ftdm_insert_dtmf_pause
@@ -3085,7 +3328,7 @@ static ftdm_status_t ftdmchan_activate_dtmf_buffer(ftdm_channel_t *ftdmchan)
 static ftdm_status_t ftdm_insert_dtmf_pause(ftdm_channel_t *ftdmchan, ftdm_size_t pausems)
 {
 	void *data = NULL;
-	ftdm_size_t datalen = pausems * sizeof(uint16_t);
+	ftdm_size_t datalen = pausems * (ftdm_channel_dtmf_codec(ftdmchan) == FTDM_CODEC_SLIN ? sizeof(uint16_t) : 1);
 
 	data = ftdm_malloc(datalen);
 	ftdm_assert(data, "Failed to allocate memory\n");
@@ -3111,7 +3354,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	case FTDM_COMMAND_ENABLE_CALLERID_DETECT:
 		{
 			if (!ftdm_channel_test_feature(ftdmchan, FTDM_CHANNEL_FEATURE_CALLERID)) {
-				if (ftdm_fsk_demod_init(&ftdmchan->fsk, ftdmchan->rate, ftdmchan->fsk_buf, sizeof(ftdmchan->fsk_buf)) != FTDM_SUCCESS) {
+				if (ftdm_fsk_demod_init(&ftdmchan->cold->fsk, ftdmchan->rate, ftdmchan->cold->fsk_buf, sizeof(ftdmchan->cold->fsk_buf)) != FTDM_SUCCESS) {
 					snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "%s", strerror(errno));
 					GOTO_STATUS(done, FTDM_FAIL);
 				}
@@ -3123,7 +3366,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	case FTDM_COMMAND_DISABLE_CALLERID_DETECT:
 		{
 			if (!ftdm_channel_test_feature(ftdmchan, FTDM_CHANNEL_FEATURE_CALLERID)) {
-				ftdm_fsk_demod_destroy(&ftdmchan->fsk);
+				ftdm_fsk_demod_destroy(&ftdmchan->cold->fsk);
 				ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_CALLERID_DETECT);
 				GOTO_STATUS(done, FTDM_SUCCESS);
 			}
@@ -3180,19 +3423,19 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	/*!< Enable DTMF debugging */
 	case FTDM_COMMAND_ENABLE_DEBUG_DTMF:
 		{
-			if (ftdmchan->dtmfdbg.enabled) {
+			if (ftdmchan->cold->dtmfdbg.enabled) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Cannot enable debug DTMF again\n");	
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (ftdmchan->rxdump.buffer) {
+			if (ftdmchan->cold->rxdump.buffer) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Cannot debug DTMF if Rx dumping is already enabled\n");	
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (start_chan_io_dump(ftdmchan, &ftdmchan->rxdump, FTDM_IO_DUMP_DEFAULT_BUFF_SIZE) != FTDM_SUCCESS) {
+			if (start_chan_io_dump(ftdmchan, &ftdmchan->cold->rxdump, FTDM_IO_DUMP_DEFAULT_BUFF_SIZE) != FTDM_SUCCESS) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Failed to enable rx dump for DTMF debugging\n");	
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			ftdmchan->dtmfdbg.enabled = 1;
+			ftdmchan->cold->dtmfdbg.enabled = 1;
 			ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Enabled DTMF debugging\n");	
 			GOTO_STATUS(done, FTDM_SUCCESS);
 		}
@@ -3201,7 +3444,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	/*!< Disable DTMF debugging (if not disabled explicitly, it is disabled automatically when calls hangup) */
 	case FTDM_COMMAND_DISABLE_DEBUG_DTMF:
 		{
-			if (!ftdmchan->dtmfdbg.enabled) {
+			if (!ftdmchan->cold->dtmfdbg.enabled) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "DTMF debug is already disabled\n");	
 				GOTO_STATUS(done, FTDM_SUCCESS);
 			}
@@ -3217,11 +3460,11 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	case FTDM_COMMAND_ENABLE_INPUT_DUMP:
 		{
 			ftdm_size_t size = obj ? FTDM_COMMAND_OBJ_SIZE : FTDM_IO_DUMP_DEFAULT_BUFF_SIZE;
-			if (ftdmchan->rxdump.buffer) {
+			if (ftdmchan->cold->rxdump.buffer) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Input dump is already enabled\n");
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (start_chan_io_dump(ftdmchan, &ftdmchan->rxdump, size) != FTDM_SUCCESS) {
+			if (start_chan_io_dump(ftdmchan, &ftdmchan->cold->rxdump, size) != FTDM_SUCCESS) {
 				ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "Failed to enable input dump of size %"FTDM_SIZE_FMT"\n", size);
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
@@ -3233,13 +3476,13 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	/*!< Stop dumping all input to a circular buffer. */
 	case FTDM_COMMAND_DISABLE_INPUT_DUMP:
 		{
-			if (!ftdmchan->rxdump.buffer) {
+			if (!ftdmchan->cold->rxdump.buffer) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "No need to disable input dump\n");
 				GOTO_STATUS(done, FTDM_SUCCESS);
 			}
 			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Disabled input dump of size %"FTDM_SIZE_FMT"\n", 
-					ftdmchan->rxdump.size);
-			stop_chan_io_dump(&ftdmchan->rxdump);
+					ftdmchan->cold->rxdump.size);
+			stop_chan_io_dump(&ftdmchan->cold->rxdump);
 			GOTO_STATUS(done, FTDM_SUCCESS);
 		}
 		break;
@@ -3248,11 +3491,11 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	case FTDM_COMMAND_ENABLE_OUTPUT_DUMP:
 		{
 			ftdm_size_t size = obj ? FTDM_COMMAND_OBJ_SIZE : FTDM_IO_DUMP_DEFAULT_BUFF_SIZE;
-			if (ftdmchan->txdump.buffer) {
+			if (ftdmchan->cold->txdump.buffer) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Output dump is already enabled\n");
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (start_chan_io_dump(ftdmchan, &ftdmchan->txdump, size) != FTDM_SUCCESS) {
+			if (start_chan_io_dump(ftdmchan, &ftdmchan->cold->txdump, size) != FTDM_SUCCESS) {
 				ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "Failed to enable output dump of size %"FTDM_SIZE_FMT"\n", size);
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
@@ -3264,12 +3507,12 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	/*!< Stop dumping all output to a circular buffer. */
 	case FTDM_COMMAND_DISABLE_OUTPUT_DUMP:
 		{
-			if (!ftdmchan->txdump.buffer) {
+			if (!ftdmchan->cold->txdump.buffer) {
 				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "No need to disable output dump\n");
 				GOTO_STATUS(done, FTDM_SUCCESS);
 			}
-			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Disabled output dump of size %"FTDM_SIZE_FMT"\n", ftdmchan->rxdump.size);
-			stop_chan_io_dump(&ftdmchan->txdump);
+			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Disabled output dump of size %"FTDM_SIZE_FMT"\n", ftdmchan->cold->rxdump.size);
+			stop_chan_io_dump(&ftdmchan->cold->txdump);
 			GOTO_STATUS(done, FTDM_SUCCESS);
 		}
 		break;
@@ -3280,12 +3523,12 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 			if (!obj) {
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (!ftdmchan->rxdump.buffer) {
+			if (!ftdmchan->cold->rxdump.buffer) {
 				ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "Not dumped input to file %p, input dump is not enabled\n", obj);
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			dump_chan_io_to_file(ftdmchan, &ftdmchan->rxdump, obj);
-			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Dumped input of size %"FTDM_SIZE_FMT" to file %p\n", ftdmchan->rxdump.size, obj);
+			dump_chan_io_to_file(ftdmchan, &ftdmchan->cold->rxdump, obj);
+			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Dumped input of size %"FTDM_SIZE_FMT" to file %p\n", ftdmchan->cold->rxdump.size, obj);
 			GOTO_STATUS(done, FTDM_SUCCESS);
 		}
 		break;
@@ -3296,12 +3539,12 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 			if (!obj) {
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			if (!ftdmchan->txdump.buffer) {
+			if (!ftdmchan->cold->txdump.buffer) {
 				ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "Not dumped output to file %p, output dump is not enabled\n", obj);
 				GOTO_STATUS(done, FTDM_FAIL);
 			}
-			dump_chan_io_to_file(ftdmchan, &ftdmchan->txdump, obj);
-			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Dumped input of size %"FTDM_SIZE_FMT" to file %p\n", ftdmchan->txdump.size, obj);
+			dump_chan_io_to_file(ftdmchan, &ftdmchan->cold->txdump, obj);
+			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Dumped input of size %"FTDM_SIZE_FMT" to file %p\n", ftdmchan->cold->txdump.size, obj);
 			GOTO_STATUS(done, FTDM_SUCCESS);
 		}
 		break;
@@ -3400,7 +3643,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 			/* if they don't have thier own, use ours */
 			if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
 				if (FTDM_CHANNEL_SW_DTMF_ALLOWED(ftdmchan)) {
-					teletone_dtmf_detect_init (&ftdmchan->dtmf_detect, ftdmchan->rate);
+					teletone_dtmf_detect_init (&ftdmchan->cold->dtmf_detect, ftdmchan->rate);
 					ftdm_set_flag(ftdmchan, FTDM_CHANNEL_DTMF_DETECT);
 					ftdm_set_flag(ftdmchan, FTDM_CHANNEL_SUPRESS_DTMF);
 					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Enabled software DTMF detector\n");
@@ -3413,7 +3656,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 		{
 			if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
 				if (FTDM_CHANNEL_SW_DTMF_ALLOWED(ftdmchan)) {
-					teletone_dtmf_detect_init (&ftdmchan->dtmf_detect, ftdmchan->rate);
+					teletone_dtmf_detect_init (&ftdmchan->cold->dtmf_detect, ftdmchan->rate);
 					ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_DTMF_DETECT);
 					ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_SUPRESS_DTMF);
 					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Disabled software DTMF detector\n");
@@ -3491,6 +3734,10 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_command(ftdm_channel_t *ftdmchan, ftdm_co
 	case FTDM_COMMAND_SEND_DTMF:
 		{
 			char *digits = FTDM_COMMAND_OBJ_CHAR_P;
+			const char *p;
+			for (p = digits; p && *p; p++) {
+				ftdm_channel_record(ftdmchan, FTDM_RECORDER_DTMF_TX, (uint8_t)*p, 0);
+			}
 			if (ftdmchan->span->sig_send_dtmf) {
 				status = ftdmchan->span->sig_send_dtmf(ftdmchan, digits);
 				GOTO_STATUS(done, status);
@@ -3803,18 +4050,22 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_queue_dtmf(ftdm_channel_t *ftdmchan, cons
 	
 	ftdm_assert_return(ftdmchan != NULL, FTDM_FAIL, "No channel\n");
 
-	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Queuing DTMF %s (debug = %d)\n", dtmf, ftdmchan->dtmfdbg.enabled);
+	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Queuing DTMF %s (debug = %d)\n", dtmf, ftdmchan->cold->dtmfdbg.enabled);
+
+	for (p = dtmf; *p; p++) {
+		ftdm_channel_record(ftdmchan, FTDM_RECORDER_DTMF_RX, (uint8_t)*p, 0);
+	}
 
 	if (ftdmchan->span->sig_queue_dtmf && (ftdmchan->span->sig_queue_dtmf(ftdmchan, dtmf) == FTDM_BREAK)) {
 		/* Signalling module wants to absorb this DTMF event */
 		return FTDM_SUCCESS;
 	}
 
-	if (!ftdmchan->dtmfdbg.enabled) {
+	if (!ftdmchan->cold->dtmfdbg.enabled) {
 		goto skipdebug;
 	}
 
-	if (!ftdmchan->dtmfdbg.file) {
+	if (!ftdmchan->cold->dtmfdbg.file) {
 		struct tm currtime;
 		time_t currsec;
 		char dfile[1138];
@@ -3840,16 +4091,16 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_queue_dtmf(ftdm_channel_t *ftdmchan, cons
 					currtime.tm_year-100, currtime.tm_mon+1, currtime.tm_mday,
 					currtime.tm_hour, currtime.tm_min, currtime.tm_sec, ftdmchan->native_codec == FTDM_CODEC_ULAW ? "ulaw" : ftdmchan->native_codec == FTDM_CODEC_ALAW ? "alaw" : "sln");
 		}
-		ftdmchan->dtmfdbg.file = fopen(dfile, "wb");	
-		if (!ftdmchan->dtmfdbg.file) {
+		ftdmchan->cold->dtmfdbg.file = fopen(dfile, "wb");	
+		if (!ftdmchan->cold->dtmfdbg.file) {
 			ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "failed to open debug dtmf file %s\n", dfile);
 		} else {
-			ftdmchan->dtmfdbg.closetimeout = DTMF_DEBUG_TIMEOUT;
-			ftdm_channel_command(ftdmchan, FTDM_COMMAND_DUMP_INPUT, ftdmchan->dtmfdbg.file);
+			ftdmchan->cold->dtmfdbg.closetimeout = DTMF_DEBUG_TIMEOUT;
+			ftdm_channel_command(ftdmchan, FTDM_COMMAND_DUMP_INPUT, ftdmchan->cold->dtmfdbg.file);
 			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Dumped initial DTMF output to %s\n", dfile);
 		}
 	} else {
-		ftdmchan->dtmfdbg.closetimeout = DTMF_DEBUG_TIMEOUT;
+		ftdmchan->cold->dtmfdbg.closetimeout = DTMF_DEBUG_TIMEOUT;
 	}
 
 skipdebug:
@@ -3899,6 +4150,8 @@ skipdebug:
 FT_DECLARE(ftdm_status_t) ftdm_raw_write (ftdm_channel_t *ftdmchan, void *data, ftdm_size_t *datalen)
 {
 	int dlen = (int) *datalen;
+	ftdm_status_t status;
+	uint64_t start;
 
 	if (ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_WRITE)) {
 		ftdm_clear_io_flag(ftdmchan, FTDM_CHANNEL_IO_WRITE);
@@ -3919,18 +4172,40 @@ FT_DECLARE(ftdm_status_t) ftdm_raw_write (ftdm_channel_t *ftdmchan, void *data,
 			ftdm_log(FTDM_LOG_WARNING, "Raw output trace failed to write all of the %d bytes\n", dlen);
 		}
 	}
-	write_chan_io_dump(&ftdmchan->txdump, data, dlen);
-	return ftdmchan->fio->write(ftdmchan, data, datalen);
+	write_chan_io_dump(&ftdmchan->cold->txdump, data, dlen);
+	start = ftdm_metrics_now();
+	status = ftdmchan->fio->write(ftdmchan, data, datalen);
+	ftdm_histogram_record_since(&ftdmchan->cold->metrics.write, start);
+	if (status != FTDM_SUCCESS && status != FTDM_TIMEOUT) {
+		ftdm_channel_record(ftdmchan, FTDM_RECORDER_WRITE_ERROR, status, (uint16_t)errno);
+	}
+	return status;
 }
 
 FT_DECLARE(ftdm_status_t) ftdm_raw_read (ftdm_channel_t *ftdmchan, void *data, ftdm_size_t *datalen)
 {
 	ftdm_status_t  status;
+	ftdm_channel_metrics_t *metrics = &ftdmchan->cold->metrics;
+	uint64_t start, now;
 	
 	if (ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ)) {
 		ftdm_clear_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ);
 	}
+	start = ftdm_metrics_now();
 	status = ftdmchan->fio->read(ftdmchan, data, datalen);
+	now = ftdm_histogram_record_since(&metrics->read, start);
+
+	if (status == FTDM_SUCCESS) {
+		/* inter-arrival deviation from the channel interval */
+		if (metrics->last_read) {
+			uint64_t interval = (uint64_t)ftdmchan->effective_interval * 1000000;
+			uint64_t elapsed = now - metrics->last_read;
+			ftdm_histogram_record(&metrics->jitter, elapsed > interval ? elapsed - interval : interval - elapsed);
+		}
+		metrics->last_read = now;
+	} else if (status != FTDM_TIMEOUT) {
+		ftdm_channel_record(ftdmchan, FTDM_RECORDER_READ_ERROR, status, (uint16_t)errno);
+	}
 
 	if (status == FTDM_SUCCESS && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_USE_RX_GAIN)
 	   && (ftdmchan->native_codec == FTDM_CODEC_ALAW || ftdmchan->native_codec == FTDM_CODEC_ULAW)) {
@@ -3956,17 +4231,17 @@ FT_DECLARE(ftdm_status_t) ftdm_raw_read (ftdm_channel_t *ftdmchan, void *data, f
 		ftdm_size_t dlen = *datalen;
 		ftdm_size_t rc = 0;
 
-		write_chan_io_dump(&ftdmchan->rxdump, data, (int)dlen);
+		write_chan_io_dump(&ftdmchan->cold->rxdump, data, (int)dlen);
 
 		/* if dtmf debug is enabled and initialized, write there too */
-		if (ftdmchan->dtmfdbg.file) {
-			rc = fwrite(data, 1, dlen, ftdmchan->dtmfdbg.file);
+		if (ftdmchan->cold->dtmfdbg.file) {
+			rc = fwrite(data, 1, dlen, ftdmchan->cold->dtmfdbg.file);
 			if (rc != dlen) {
 				ftdm_log(FTDM_LOG_WARNING, "DTMF debugger wrote only %"FTDM_SIZE_FMT" out of %"FTDM_SIZE_FMT" bytes: %s\n",
 					rc, *datalen, strerror(errno));
 			}
-			ftdmchan->dtmfdbg.closetimeout--;
-			if (!ftdmchan->dtmfdbg.closetimeout) {
+			ftdmchan->cold->dtmfdbg.closetimeout--;
+			if (!ftdmchan->cold->dtmfdbg.closetimeout) {
 				close_dtmf_debug_file(ftdmchan);
 			}
 		}
@@ -3982,7 +4257,7 @@ static ftdm_status_t handle_tone_generation(ftdm_channel_t *ftdmchan)
 	 *          is called from the ftdm_channel_read function)
 	 * dblen: size currently in use in any of the tone generation buffers (data available in the buffer)
 	 * gen_dtmf_buffer: buffer holding the raw ASCII digits that the user requested to generate
-	 * dtmf_buffer: raw linear tone data generated by teletone to be written to the devices
+	 * dtmf_buffer: tone data to be written to the devices (native codec when G.711, see ftdm_channel_dtmf_codec)
 	 * fsk_buffer: raw linear FSK modulated data for caller id
 	 */
 	ftdm_buffer_t *buffer = NULL;
@@ -4011,8 +4286,24 @@ static ftdm_status_t handle_tone_generation(ftdm_channel_t *ftdmchan)
 				} else if (*cur == 'W') {
 					ftdm_insert_dtmf_pause(ftdmchan, FTDM_FULL_DTMF_PAUSE);
 				} else {
-					if ((wrote = teletone_mux_tones(&ftdmchan->tone_session, &ftdmchan->tone_session.TONES[(int)*cur]))) {
-						ftdm_buffer_write(ftdmchan->dtmf_buffer, ftdmchan->tone_session.buffer, wrote * 2);
+					ftdm_codec_t codec = ftdm_channel_dtmf_codec(ftdmchan);
+					const ftdm_tone_segment_t *segment = ftdm_tone_cache_get_dtmf(*cur, ftdmchan->cold->tone_session.rate,
+										ftdmchan->cold->tone_session.volume, ftdmchan->dtmf_on, ftdmchan->dtmf_off, codec);
+					if (segment) {
+						ftdm_buffer_write(ftdmchan->dtmf_buffer, segment->data, segment->len);
+						wrote = segment->samples;
+						x++;
+					} else if ((wrote = teletone_mux_tones(&ftdmchan->cold->tone_session, &ftdmchan->cold->tone_session.TONES[(int)*cur]))) {
+						/* not in the cache (ie: custom digit), encode the rendered tone ourselves */
+						if (codec == FTDM_CODEC_SLIN) {
+							ftdm_buffer_write(ftdmchan->dtmf_buffer, ftdmchan->cold->tone_session.buffer, wrote * 2);
+						} else {
+							uint8_t *encoded = ftdm_malloc(wrote);
+							ftdm_assert_return(encoded, FTDM_MEMERR, "Failed to allocate memory\n");
+							ftdm_tone_cache_encode(codec, ftdmchan->cold->tone_session.buffer, wrote, encoded);
+							ftdm_buffer_write(ftdmchan->dtmf_buffer, encoded, wrote);
+							ftdm_safe_free(encoded);
+						}
 						x++;
 					} else {
 						ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "Problem adding DTMF sequence [%s]\n", digits);
@@ -4040,10 +4331,12 @@ static ftdm_status_t handle_tone_generation(ftdm_channel_t *ftdmchan)
 		uint8_t auxbuf[1024];
 		ftdm_size_t dlen = ftdmchan->packet_len;
 		ftdm_size_t len, br, max = sizeof(auxbuf);
+		/* FSK is always linear, DTMF is already in the native codec of G.711 channels */
+		int linear = (buffer == ftdmchan->fsk_buffer || ftdm_channel_dtmf_codec(ftdmchan) == FTDM_CODEC_SLIN);
 		
 		/* if the codec is not linear, then data is really twice as much cuz
 		   tone generation is done in linear (we assume anything different than linear is G.711) */
-		if (ftdmchan->native_codec != FTDM_CODEC_SLIN) {
+		if (linear && ftdmchan->native_codec != FTDM_CODEC_SLIN) {
 			dlen *= 2;
 		}
 
@@ -4064,11 +4357,11 @@ static ftdm_status_t handle_tone_generation(ftdm_channel_t *ftdmchan)
 
 		/* if we read less than the chunk size, we must fill in with silence the rest */
 		if (br < dlen) {
-			memset(auxbuf + br, 0, dlen - br);
+			memset(auxbuf + br, linear ? 0 : FTDM_SILENCE_VALUE(ftdmchan), dlen - br);
 		}
 
 		/* finally we convert to the native format for the channel if necessary */
-		if (ftdmchan->native_codec != FTDM_CODEC_SLIN) {
+		if (linear && ftdmchan->native_codec != FTDM_CODEC_SLIN) {
 			if (ftdmchan->native_codec == FTDM_CODEC_ULAW) {
 				fio_slin2ulaw(auxbuf, max, &dlen);
 			} else if (ftdmchan->native_codec == FTDM_CODEC_ALAW) {
@@ -4174,11 +4467,11 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_process_media(ftdm_channel_t *ftdmchan, v
 		}
 
 		if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_CALLERID_DETECT)) {
-			if (ftdm_fsk_demod_feed(&ftdmchan->fsk, sln, slen) != FTDM_SUCCESS) {
+			if (ftdm_fsk_demod_feed(&ftdmchan->cold->fsk, sln, slen) != FTDM_SUCCESS) {
 				ftdm_size_t type, mlen;
 				char str[128], *sp;
 				
-				while(ftdm_fsk_data_parse(&ftdmchan->fsk, &type, &sp, &mlen) == FTDM_SUCCESS) {
+				while(ftdm_fsk_data_parse(&ftdmchan->cold->fsk, &type, &sp, &mlen) == FTDM_SUCCESS) {
 					*(str+mlen) = '\0';
 					ftdm_copy_string(str, sp, ++mlen);
 					ftdm_clean_string(str);
@@ -4249,8 +4542,8 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_process_media(ftdm_channel_t *ftdmchan, v
 			char digit_char;
 			uint32_t dur;
 
-			if ((hit = teletone_dtmf_detect(&ftdmchan->dtmf_detect, sln, (int)slen)) == TT_HIT_END) {
-				teletone_dtmf_get(&ftdmchan->dtmf_detect, &digit_char, &dur);
+			if ((hit = teletone_dtmf_detect(&ftdmchan->cold->dtmf_detect, sln, (int)slen)) == TT_HIT_END) {
+				teletone_dtmf_get(&ftdmchan->cold->dtmf_detect, &digit_char, &dur);
 
 				if (ftdmchan->state == FTDM_CHANNEL_STATE_CALLWAITING && (digit_char == 'D' || digit_char == 'A')) {
 					ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]++;
@@ -4739,6 +5032,12 @@ static void print_core_usage(ftdm_stream_handle_t *stream)
 	"ftdm core flag [!]<flag-int-value|flag-name> [<span_id|span_name>] [<chan_id>] - List all channels with the given flag value set\n"
 	"ftdm core spanflag [!]<flag-int-value|flag-name> [<span_id|span_name>] - List all spans with the given span flag value set\n"
 	"ftdm core calls - List all known calls to the FreeTDM core\n"
+	"ftdm core tonecache - Show the tone cache statistics\n"
+	"ftdm core metrics [json] [<span_id|span_name> [<chan_id>]] - Show the latency metrics\n"
+	"ftdm core metrics reset [<span_id|span_name>] - Reset the latency metrics\n"
+	"ftdm core metrics openmetrics - Export all the metrics in OpenMetrics text format\n"
+	"ftdm core recorder <span_id|span_name> [<chan_id>] - Show the recent events of the channels\n"
+	"ftdm core recorder dump <file> [<span_id|span_name> [<chan_id>]] - Write the recorded events in binary format (see decode_recorder)\n"
 	"--------------------------------------------------------------------------------\n");
 }
 
@@ -4945,15 +5244,14 @@ static char *handle_core_command(const char *cmd)
 	} else if (!strcasecmp(argv[0], "calls")) {
 		uint32_t current_call_id = 0;
 
-		ftdm_mutex_lock(globals.call_id_mutex);
+		/* no lock needed, the caller data lives as long as its channel, the listing is just a snapshot */
 		for (current_call_id = 0; current_call_id <= MAX_CALLIDS; current_call_id++) {
-			ftdm_caller_data_t *calldata = NULL;
+			ftdm_caller_data_t *calldata = ftdm_atomic_get_ptr((void * volatile *)&globals.call_ids[current_call_id]);
 
-			if (!globals.call_ids[current_call_id]) {
+			if (!calldata) {
 				continue;
 			}
 
-			calldata = globals.call_ids[current_call_id];
 			fchan = calldata->fchan;
 			if (fchan) {
 				stream.write_function(&stream, "Call %u on channel %d:%d\n", current_call_id,
@@ -4963,8 +5261,106 @@ static char *handle_core_command(const char *cmd)
 			}
 			count++;
 		}
-		ftdm_mutex_unlock(globals.call_id_mutex);
 		stream.write_function(&stream, "\nTotal calls: %d\n", count);
+	} else if (!strcasecmp(argv[0], "tonecache")) {
+		ftdm_tone_cache_print_stats(&stream);
+	} else if (!strcasecmp(argv[0], "metrics")) {
+		ftdm_metrics_format_t format = FTDM_METRICS_FORMAT_TEXT;
+		int arg = 1;
+
+		if (argc > 1 && !strcasecmp(argv[1], "openmetrics")) {
+			ftdm_metrics_render_stream(&stream);
+			goto done;
+		}
+
+		if (argc > 1 && !strcasecmp(argv[1], "reset")) {
+			if (argc > 2) {
+				ftdm_span_find_by_name(argv[2], &fspan);
+				if (!fspan) {
+					stream.write_function(&stream, "-ERR span:%s not found\n", argv[2]);
+					goto done;
+				}
+			}
+			ftdm_metrics_reset(fspan);
+			stream.write_function(&stream, "+OK metrics reset\n");
+			goto done;
+		}
+
+		if (argc > arg && !strcasecmp(argv[arg], "json")) {
+			format = FTDM_METRICS_FORMAT_JSON;
+			arg++;
+		}
+
+		if (argc > arg) {
+			ftdm_span_find_by_name(argv[arg], &fspan);
+			if (!fspan) {
+				stream.write_function(&stream, "-ERR span:%s not found\n", argv[arg]);
+				goto done;
+			}
+			arg++;
+		}
+
+		if (argc > arg) {
+			uint32_t chan_id = atoi(argv[arg]);
+
+			if (!chan_id || chan_id > fspan->chan_count) {
+				stream.write_function(&stream, "-ERR invalid channel %s\n", argv[arg]);
+				goto done;
+			}
+			fchan = fspan->channels[chan_id];
+		}
+
+		ftdm_metrics_print(&stream, fspan, fchan, format);
+	} else if (!strcasecmp(argv[0], "recorder")) {
+		const char *dumpfile = NULL;
+		int arg = 1;
+
+		if (argc > 1 && !strcasecmp(argv[1], "dump")) {
+			if (argc < 3) {
+				print_core_usage(&stream);
+				goto done;
+			}
+			dumpfile = argv[2];
+			arg = 3;
+		}
+
+		if (argc > arg) {
+			ftdm_span_find_by_name(argv[arg], &fspan);
+			if (!fspan) {
+				stream.write_function(&stream, "-ERR span:%s not found\n", argv[arg]);
+				goto done;
+			}
+			arg++;
+		} else if (!dumpfile) {
+			print_core_usage(&stream);
+			goto done;
+		}
+
+		if (argc > arg) {
+			uint32_t chan_id = atoi(argv[arg]);
+
+			if (!chan_id || chan_id > fspan->chan_count) {
+				stream.write_function(&stream, "-ERR invalid channel %s\n", argv[arg]);
+				goto done;
+			}
+			fchan = fspan->channels[chan_id];
+		}
+
+		if (dumpfile) {
+			if (ftdm_recorder_dump(dumpfile, fspan, fchan) != FTDM_SUCCESS) {
+				stream.write_function(&stream, "-ERR failed to write %s\n", dumpfile);
+			} else {
+				stream.write_function(&stream, "+OK recorded events written to %s\n", dumpfile);
+			}
+		} else if (fchan) {
+			ftdm_recorder_print(&stream, fchan);
+		} else {
+			uint32_t i;
+
+			for (i = 1; i <= fspan->chan_count; i++) {
+				ftdm_recorder_print(&stream, fspan->channels[i]);
+			}
+		}
 	} else {
 		stream.write_function(&stream, "invalid core command %s\n", argv[0]);
 		print_core_usage(&stream);
@@ -5115,7 +5511,7 @@ FT_DECLARE(ftdm_status_t) ftdm_configure_span_channels(ftdm_span_t *span, const
 		}
 
 		if (chan_config->debugdtmf) {
-			span->channels[chan_index]->dtmfdbg.requested = 1;
+			span->channels[chan_index]->cold->dtmfdbg.requested = 1;
 		}
 
 		span->channels[chan_index]->dtmfdetect.duration_ms = chan_config->dtmfdetect_ms;
@@ -5404,6 +5800,18 @@ static ftdm_status_t load_config(void)
 			} else if (!strncasecmp(var, "debugdtmf_directory", sizeof("debugdtmf_directory")-1)) {
 				ftdm_set_string(globals.dtmfdebug_directory, val);
 				ftdm_log(FTDM_LOG_DEBUG, "Debug DTMF directory set to '%s'\n", globals.dtmfdebug_directory);
+			} else if (!strncasecmp(var, "recorder_dump_directory", sizeof("recorder_dump_directory")-1)) {
+				ftdm_recorder_set_dump_directory(val);
+				ftdm_log(FTDM_LOG_DEBUG, "Recorder dump directory set to '%s'\n", val);
+			} else if (!strncasecmp(var, "metrics_file", sizeof("metrics_file")-1)) {
+				ftdm_set_string(globals.metrics_file, val);
+				ftdm_log(FTDM_LOG_DEBUG, "Metrics file set to '%s'\n", globals.metrics_file);
+			} else if (!strncasecmp(var, "metrics_interval", sizeof("metrics_interval")-1)) {
+				if (atoi(val) > 0) {
+					globals.metrics_interval = atoi(val);
+				} else {
+					ftdm_log(FTDM_LOG_ERROR, "Invalid metrics interval %s\n", val);
+				}
 			} else if (!strncasecmp(var, "cpu_monitoring_interval", sizeof("cpu_monitoring_interval")-1)) {
 				if (atoi(val) > 0) {
 					globals.cpu_monitor.interval = atoi(val);
@@ -5723,6 +6131,12 @@ static ftdm_status_t post_configure_span_channels(ftdm_span_t *span)
 	unsigned i = 0;
 	ftdm_status_t status = FTDM_SUCCESS;
 	ftdm_signaling_status_t sigstatus = FTDM_SIG_STATE_DOWN;
+	if (span->state_map) {
+		status = ftdm_state_map_compile(span->state_map, &span->state_matrix);
+		if (status != FTDM_SUCCESS) {
+			return status;
+		}
+	}
 	for (i = 1; i <= span->chan_count; i++) {
 		sigstatus = FTDM_SIG_STATE_DOWN;
 		ftdm_channel_get_sig_status(span->channels[i], &sigstatus);
@@ -5733,6 +6147,9 @@ static ftdm_status_t post_configure_span_channels(ftdm_span_t *span)
 	if (ftdm_test_flag(span, FTDM_SPAN_USE_CHAN_QUEUE)) {
 		status = ftdm_queue_create(&span->pendingchans, SPAN_PENDING_CHANS_QUEUE_SIZE);
 	}
+	if (status == FTDM_SUCCESS && ftdm_test_flag(span, FTDM_SPAN_USE_DIRTY_MAP) && !span->dirty.interrupt) {
+		status = ftdm_interrupt_create(&span->dirty.interrupt, FTDM_INVALID_SOCKET, FTDM_NO_FLAGS);
+	}
 	if (status == FTDM_SUCCESS && ftdm_test_flag(span, FTDM_SPAN_USE_SIGNALS_QUEUE)) {
 		status = ftdm_queue_create(&span->pendingsignals, SPAN_PENDING_SIGNALS_QUEUE_SIZE);
 	}
@@ -5963,7 +6380,7 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_remove_from_group(ftdm_group_t* group, ft
 				group->channels[group->chan_count--] = NULL;
 				if (group->chan_count <=0) {
 					/* Delete group if it is empty */
-					hashtable_remove(globals.group_hash, (void *)group->name);
+					ftdm_name_index_update(&globals.group_names, group->name, NULL);
 				}
 				ftdm_mutex_unlock(globals.group_mutex);
 				return FTDM_SUCCESS;
@@ -5999,21 +6416,13 @@ static ftdm_status_t ftdm_group_add_channels(ftdm_span_t* span, int currindex, c
 
 FT_DECLARE(ftdm_status_t) ftdm_group_find(uint32_t id, ftdm_group_t **group)
 {
-	ftdm_group_t *fgroup = NULL, *grp;
+	ftdm_group_t *fgroup = NULL;
 
 	if (id > FTDM_MAX_GROUPS_INTERFACE) {
 		return FTDM_FAIL;
 	}
 
-	
-	ftdm_mutex_lock(globals.group_mutex);
-	for (grp = globals.groups; grp; grp = grp->next) {
-		if (grp->group_id == id) {
-			fgroup = grp;
-			break;
-		}
-	}
-	ftdm_mutex_unlock(globals.group_mutex);
+	fgroup = ftdm_atomic_get_ptr((void * volatile *)&globals.group_table[id]);
 
 	if (!fgroup) {
 		return FTDM_FAIL;
@@ -6029,13 +6438,11 @@ FT_DECLARE(ftdm_status_t) ftdm_group_find_by_name(const char *name, ftdm_group_t
 {
 	ftdm_status_t status = FTDM_FAIL;
 	*group = NULL;
-	ftdm_mutex_lock(globals.group_mutex);
 	if (!ftdm_strlen_zero(name)) {
-		if ((*group = hashtable_search(globals.group_hash, (void *) name))) {
+		if ((*group = ftdm_name_index_find(&globals.group_names, name))) {
 			status = FTDM_SUCCESS;
 		}
 	}
-	ftdm_mutex_unlock(globals.group_mutex);
 	return status;
 }
 
@@ -6051,7 +6458,8 @@ static void ftdm_group_add(ftdm_group_t *group)
 	} else {
 		globals.groups = group;
 	}
-	hashtable_insert(globals.group_hash, (void *)group->name, group, HASHTABLE_FLAG_NONE);
+	ftdm_name_index_update(&globals.group_names, group->name, group);
+	ftdm_atomic_cas_ptr((void * volatile *)&globals.group_table[group->group_id], NULL, group);
 
 	ftdm_mutex_unlock(globals.group_mutex);
 }
@@ -6094,12 +6502,19 @@ static void ftdm_group_destroy(ftdm_group_t **group)
 	*group = NULL;
 }
 
-static ftdm_status_t ftdm_span_trigger_signal(const ftdm_span_t *span, ftdm_sigmsg_t *sigmsg)
+static ftdm_status_t ftdm_span_trigger_signal(ftdm_span_t *span, ftdm_sigmsg_t *sigmsg)
 {
+	ftdm_status_t status;
+	uint64_t start;
+
 	if (!span->signal_cb) {
 		return FTDM_FAIL;
 	}
-	return span->signal_cb(sigmsg);
+	start = ftdm_metrics_now();
+	status = span->signal_cb(sigmsg);
+	/* signals are delivered from several threads (span, channel and timer threads) without a span lock */
+	ftdm_histogram_record_atomic(&span->metrics.signal, ftdm_metrics_now() - start);
+	return status;
 }
 
 static ftdm_status_t ftdm_span_queue_signal(const ftdm_span_t *span, ftdm_sigmsg_t *sigmsg)
@@ -6116,7 +6531,7 @@ static ftdm_status_t ftdm_span_queue_signal(const ftdm_span_t *span, ftdm_sigmsg
 	return FTDM_SUCCESS;
 }
 
-FT_DECLARE(ftdm_status_t) ftdm_span_trigger_signals(const ftdm_span_t *span)
+FT_DECLARE(ftdm_status_t) ftdm_span_trigger_signals(ftdm_span_t *span)
 {
 	ftdm_sigmsg_t *sigmsg = NULL;
 	while ((sigmsg = ftdm_queue_dequeue(span->pendingsignals))) {
@@ -6131,6 +6546,7 @@ static void execute_safety_hangup(void *data)
 	ftdm_channel_t *fchan = data;
 	ftdm_channel_lock(fchan);
 	fchan->hangup_timer = 0;
+	ftdm_channel_record(fchan, FTDM_RECORDER_TIMER, 0, 0);
 	if (fchan->state == FTDM_CHANNEL_STATE_TERMINATING) {
 		ftdm_log_chan(fchan, FTDM_LOG_WARNING, "Forcing hangup since the user did not confirmed our hangup after %dms\n", FORCE_HANGUP_TIMER);
 		_ftdm_channel_call_hangup_nl(__FILE__, __FTDM_FUNC__, __LINE__, fchan, NULL);
@@ -6147,6 +6563,7 @@ FT_DECLARE(ftdm_status_t) ftdm_span_send_signal(ftdm_span_t *span, ftdm_sigmsg_t
 	if (sigmsg->channel) {
 		fchan = sigmsg->channel;
 		ftdm_channel_lock(fchan);
+		ftdm_channel_record(fchan, FTDM_RECORDER_SIGMSG, sigmsg->event_id, 0);
 	}
 	
 	/* some core things to do on special events */
@@ -6352,13 +6769,15 @@ FT_DECLARE(ftdm_status_t) ftdm_global_init(void)
 	globals.interface_hash = create_hashtable(16, ftdm_hash_hashfromstring, ftdm_hash_equalkeys);
 	globals.module_hash = create_hashtable(16, ftdm_hash_hashfromstring, ftdm_hash_equalkeys);
 	globals.span_hash = create_hashtable(16, ftdm_hash_hashfromstring, ftdm_hash_equalkeys);
-	globals.group_hash = create_hashtable(16, ftdm_hash_hashfromstring, ftdm_hash_equalkeys);
 	ftdm_mutex_create(&globals.mutex);
 	ftdm_mutex_create(&globals.span_mutex);
 	ftdm_mutex_create(&globals.group_mutex);
-	ftdm_mutex_create(&globals.call_id_mutex);
 	
 	ftdm_sched_global_init();
+	ftdm_tone_cache_global_init();
+	ftdm_tone_service_global_init();
+	ftdm_metrics_global_init();
+	ftdm_metric_register(&globals.calls_metric, FTDM_METRIC_COUNTER, "freetdm_calls", NULL, "Calls registered in the core");
 	globals.running = 1;
 	if (ftdm_sched_create(&globals.timingsched, "freetdm-master") != FTDM_SUCCESS) {
 		ftdm_log(FTDM_LOG_CRIT, "Failed to create master timing schedule context\n");
@@ -6376,15 +6795,26 @@ global_init_fail:
 	ftdm_mutex_destroy(&globals.mutex);
 	ftdm_mutex_destroy(&globals.span_mutex);
 	ftdm_mutex_destroy(&globals.group_mutex);
-	ftdm_mutex_destroy(&globals.call_id_mutex);	
+	ftdm_tone_service_global_destroy();
+	ftdm_tone_cache_global_destroy();
+	ftdm_metrics_global_destroy();
 	hashtable_destroy(globals.interface_hash);
 	hashtable_destroy(globals.module_hash);
 	hashtable_destroy(globals.span_hash);
-	hashtable_destroy(globals.group_hash);
 	
 	return FTDM_FAIL;
 }
 
+static void write_metrics_file(void *data)
+{
+	globals.metrics_timer = 0;
+	if (!globals.running) {
+		return;
+	}
+	ftdm_metrics_render_to_file(globals.metrics_file);
+	ftdm_sched_timer(globals.timingsched, "metrics", globals.metrics_interval, write_metrics_file, NULL, &globals.metrics_timer);
+}
+
 FT_DECLARE(ftdm_status_t) ftdm_global_configuration(void)
 {
 	int modcount = 0;
@@ -6403,6 +6833,8 @@ FT_DECLARE(ftdm_status_t) ftdm_global_configuration(void)
 	globals.cpu_monitor.set_alarm_threshold = 92;
 	globals.cpu_monitor.clear_alarm_threshold = 82;
 
+	globals.metrics_interval = 10000;
+
 	if (load_config() != FTDM_SUCCESS) {
 		globals.running = 0;
 		ftdm_log(FTDM_LOG_ERROR, "FreeTDM global configuration failed!\n");
@@ -6420,6 +6852,10 @@ FT_DECLARE(ftdm_status_t) ftdm_global_configuration(void)
 		}
 	}
 
+	if (!ftdm_strlen_zero_buf(globals.metrics_file)) {
+		ftdm_log(FTDM_LOG_INFO, "Writing metrics to %s every %dms\n", globals.metrics_file, globals.metrics_interval);
+		write_metrics_file(NULL);
+	}
 
 	return FTDM_SUCCESS;
 }
@@ -6466,6 +6902,10 @@ FT_DECLARE(ftdm_status_t) ftdm_global_destroy(void)
 	/* many freetdm event loops rely on this variable to decide when to stop, do this first */
 	globals.running = 0;	
 
+	if (globals.metrics_timer) {
+		ftdm_sched_cancel_timer(globals.timingsched, globals.metrics_timer);
+	}
+
 	/* stop the scheduling thread */
 	ftdm_free_sched_stop();
 
@@ -6481,6 +6921,13 @@ FT_DECLARE(ftdm_status_t) ftdm_global_destroy(void)
 	ftdm_mutex_lock(globals.span_mutex);
 
 	span_for_each(force_stop_span);
+
+	/* signaling modules detach their channels on stop, no channel must be attached anymore */
+	ftdm_tone_service_global_destroy();
+	ftdm_tone_cache_global_destroy();
+
+	memset((void *)globals.span_table, 0, sizeof(globals.span_table));
+	ftdm_name_index_destroy(&globals.span_names);
 	span_for_each(destroy_span);
 	globals.spans = NULL;
 
@@ -6491,6 +6938,8 @@ FT_DECLARE(ftdm_status_t) ftdm_global_destroy(void)
 
 	/* Destroy hunting groups */
 	ftdm_mutex_lock(globals.group_mutex);
+	memset((void *)globals.group_table, 0, sizeof(globals.group_table));
+	ftdm_name_index_destroy(&globals.group_names);
 	grp = globals.groups;
 	while (grp) {
 		next_grp = grp->next;
@@ -6507,16 +6956,18 @@ FT_DECLARE(ftdm_status_t) ftdm_global_destroy(void)
 	hashtable_destroy(globals.interface_hash);
 	hashtable_destroy(globals.module_hash);	
 	hashtable_destroy(globals.span_hash);
-	hashtable_destroy(globals.group_hash);
 
 	ftdm_mutex_destroy(&globals.span_mutex);
 	ftdm_mutex_destroy(&globals.group_mutex);
-	ftdm_mutex_destroy(&globals.call_id_mutex);
 
 	ftdm_mutex_unlock(globals.mutex);
 
 	ftdm_mutex_destroy(&globals.mutex);
 
+	ftdm_metrics_global_destroy();
+
+	ftdm_recorder_set_dump_directory(NULL);
+
 	ftdm_sched_global_destroy();
 
 	ftdm_global_set_logger(NULL);
@@ -6837,37 +7288,28 @@ FT_DECLARE(char *) ftdm_strndup(const char *str, ftdm_size_t inlen)
 	return new;
 }
 
+/*
+ * Call ids are allocated without locking (see ftdm_call_ids_claim()) and releasing the id swaps
+ * the slot back to NULL, so span threads never serialise on call setup or teardown
+ */
 static ftdm_status_t ftdm_call_set_call_id(ftdm_channel_t *fchan, ftdm_caller_data_t *caller_data)
 {
 	uint32_t current_call_id;
-	
-	ftdm_assert_return(!caller_data->call_id, FTDM_FAIL, "Overwriting non-cleared call-id\n");
 
-	ftdm_mutex_lock(globals.call_id_mutex);
+	ftdm_assert_return(!caller_data->call_id, FTDM_FAIL, "Overwriting non-cleared call-id\n");
 
-	current_call_id = globals.last_call_id;
+	/* set before publishing the slot, the registry is read without locking */
+	caller_data->fchan = fchan;
 
-	for (current_call_id = globals.last_call_id + 1; 
-	     current_call_id != globals.last_call_id; 
-	     current_call_id++ ) {
-		if (current_call_id > MAX_CALLIDS) {
-			current_call_id = 1;
-		}
-		if (globals.call_ids[current_call_id] == NULL) {
-			break;
-		}
+	current_call_id = ftdm_call_ids_claim(globals.call_ids, &globals.last_call_id, MAX_CALLIDS, caller_data);
+	if (current_call_id) {
+		caller_data->call_id = current_call_id;
+		ftdm_metric_add(&globals.calls_metric, 1);
+		return FTDM_SUCCESS;
 	}
 
-	ftdm_assert_return(globals.call_ids[current_call_id] == NULL, FTDM_FAIL, "We ran out of call ids\n"); 
-
-	globals.last_call_id = current_call_id;
-	caller_data->call_id = current_call_id;
-
-	globals.call_ids[current_call_id] = caller_data;
-	caller_data->fchan = fchan;
-
-	ftdm_mutex_unlock(globals.call_id_mutex);
-	return FTDM_SUCCESS;
+	ftdm_assert(0, "We ran out of call ids\n");
+	return FTDM_FAIL;
 }
 
 static ftdm_status_t ftdm_call_clear_call_id(ftdm_caller_data_t *caller_data)
@@ -6879,15 +7321,12 @@ static ftdm_status_t ftdm_call_clear_call_id(ftdm_caller_data_t *caller_data)
 		return FTDM_SUCCESS;
 	}
 
-	ftdm_mutex_lock(globals.call_id_mutex);
-	if (globals.call_ids[caller_data->call_id]) {
+	if (ftdm_call_ids_release(globals.call_ids, caller_data->call_id, caller_data)) {
 		ftdm_log(FTDM_LOG_DEBUG, "Cleared call with id %u\n", caller_data->call_id);
-		globals.call_ids[caller_data->call_id] = NULL;
 		caller_data->call_id = 0;
 	} else {
 		ftdm_log(FTDM_LOG_CRIT, "call-id did not exist %u\n", caller_data->call_id);
-	} 
-	ftdm_mutex_unlock(globals.call_id_mutex);
+	}
 
 	return FTDM_SUCCESS;
 }
@@ -0,0 +1,442 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "private/ftdm_core.h"
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+/*
+ * Asynchronous logging
+ *
+ * Every thread logging through ftdm_log_async_write() gets its own ring, so writers never contend with each
+ * other nor with the drain thread: the owner only moves the head, the drain thread only moves the tail.
+ * The drain thread merges the rings by timestamp and hands the messages to the real logger.
+ * Rings of exited threads are released once drained, the others live as long as their thread so a writer
+ * racing with ftdm_log_async_stop() never touches released memory, they are used again on the next start.
+ */
+
+/* records are aligned so the space left at the end of the ring always fits at least a padding record header */
+#define LOG_RECORD_ALIGN 32
+#define LOG_RECORD_PAD -1
+#define LOG_NAME_MAX 256
+
+typedef struct {
+	uint64_t time;
+	uint32_t len;		/* whole record length, a multiple of LOG_RECORD_ALIGN */
+	int32_t level;		/* LOG_RECORD_PAD for the filler up to the end of the ring */
+	int32_t line;
+	uint16_t func_offset;	/* from the record start, the file name follows the header */
+	uint16_t msg_offset;
+} log_record_t;
+
+typedef struct ftdm_log_ring ftdm_log_ring_t;
+struct ftdm_log_ring {
+	volatile uint32_t head;		/* bytes written, owner thread */
+	volatile uint32_t dropped;	/* messages that did not fit, owner thread */
+	char pad[56];			/* keep the drain thread fields in another cache line */
+	volatile uint32_t tail;		/* bytes consumed, drain thread */
+	uint32_t reported;		/* drops already reported, drain thread */
+	volatile uint32_t orphaned;	/* the owner thread exited */
+	ftdm_log_ring_t *next;
+	char buffer[FTDM_LOG_RING_SIZE];
+};
+
+/* merge heap entry, the oldest pending record of a ring */
+typedef struct {
+	uint64_t time;
+	ftdm_log_ring_t *ring;
+	log_record_t *rec;
+} log_merge_t;
+
+static struct {
+	ftdm_log_ring_t * volatile rings;
+	ftdm_logger_t volatile sink;
+	ftdm_interrupt_t *interrupt;
+	ftdm_interrupt_t *stopped;	/* signaled by the drain thread right before it exits */
+	log_merge_t *merge;		/* drain thread */
+	uint32_t merge_size;
+	volatile int running;
+	int key_created;
+#ifdef WIN32
+	DWORD fls;
+#else
+	pthread_key_t key;
+#endif
+} async_log;
+
+static FTDM_THREAD_LOCAL ftdm_log_ring_t *thread_ring;
+
+#ifdef WIN32
+static void WINAPI log_ring_release(void *data)
+#else
+static void log_ring_release(void *data)
+#endif
+{
+	ftdm_log_ring_t *ring = data;
+
+	if (ring) {
+		/* a later message from this thread (another thread storage destructor) gets a new ring */
+		thread_ring = NULL;
+		ftdm_atomic_set32(&ring->orphaned, 1);
+	}
+}
+
+static ftdm_log_ring_t *log_thread_ring(void)
+{
+	ftdm_log_ring_t *ring = NULL;
+
+	if (thread_ring) {
+		return thread_ring;
+	}
+
+	ring = ftdm_calloc(1, sizeof(*ring));
+	if (!ring) {
+		return NULL;
+	}
+
+	/* flag the ring on thread exit so the drain thread releases it */
+#ifdef WIN32
+	FlsSetValue(async_log.fls, ring);
+#else
+	pthread_setspecific(async_log.key, ring);
+#endif
+
+	do {
+		ring->next = ftdm_atomic_get_ptr((void * volatile *)&async_log.rings);
+	} while (!ftdm_atomic_cas_ptr((void * volatile *)&async_log.rings, ring->next, ring));
+
+	thread_ring = ring;
+	return ring;
+}
+
+static ftdm_status_t log_ring_write(ftdm_log_ring_t *ring, const char *file, const char *func, int line, int level,
+		const char *msg, uint32_t msg_len)
+{
+	log_record_t *rec = NULL;
+	uint32_t file_len = (uint32_t)strlen(file);
+	uint32_t func_len = (uint32_t)strlen(func);
+	uint32_t head = ring->head;
+	uint32_t pos = head & (FTDM_LOG_RING_SIZE - 1);
+	uint32_t used = head - ftdm_atomic_get32(&ring->tail);
+	uint32_t skip = 0;
+	uint32_t len;
+
+	file_len = ftdm_min(file_len, LOG_NAME_MAX - 1);
+	func_len = ftdm_min(func_len, LOG_NAME_MAX - 1);
+	len = sizeof(*rec) + file_len + 1 + func_len + 1 + msg_len + 1;
+	len = (len + LOG_RECORD_ALIGN - 1) & ~(LOG_RECORD_ALIGN - 1);
+
+	/* records are contiguous, if it does not fit before the end pad up to the end and start over */
+	if ((FTDM_LOG_RING_SIZE - pos) < len) {
+		skip = FTDM_LOG_RING_SIZE - pos;
+	}
+
+	if ((used + skip + len) > FTDM_LOG_RING_SIZE) {
+		ring->dropped++;
+		return FTDM_FAIL;
+	}
+
+	if (skip) {
+		rec = (log_record_t *)(ring->buffer + pos);
+		rec->len = skip;
+		rec->level = LOG_RECORD_PAD;
+		pos = 0;
+	}
+
+	rec = (log_record_t *)(ring->buffer + pos);
+	rec->time = ftdm_metrics_now();
+	rec->len = len;
+	rec->level = level;
+	rec->line = line;
+	rec->func_offset = (uint16_t)(sizeof(*rec) + file_len + 1);
+	rec->msg_offset = (uint16_t)(rec->func_offset + func_len + 1);
+	memcpy((char *)rec + sizeof(*rec), file, file_len);
+	((char *)rec)[sizeof(*rec) + file_len] = '\0';
+	memcpy((char *)rec + rec->func_offset, func, func_len);
+	((char *)rec)[rec->func_offset + func_len] = '\0';
+	memcpy((char *)rec + rec->msg_offset, msg, msg_len);
+	((char *)rec)[rec->msg_offset + msg_len] = '\0';
+
+	/* publish, the drain thread can read the record now */
+	ftdm_atomic_set32(&ring->head, head + skip + len);
+	return FTDM_SUCCESS;
+}
+
+static ftdm_status_t log_ring_vwrite(ftdm_log_ring_t *ring, const char *file, const char *func, int line, int level,
+		const char *fmt, va_list ap)
+{
+	char data[FTDM_LOG_MAX_MSG];
+	int len;
+
+	len = vsnprintf(data, sizeof(data), fmt, ap);
+	if (len < 0) {
+		return FTDM_FAIL;
+	}
+	if (len >= (int)sizeof(data)) {
+		len = sizeof(data) - 1;
+	}
+	return log_ring_write(ring, file, func, line, level, data, (uint32_t)len);
+}
+
+FT_DECLARE_NONSTD(void) ftdm_log_async_write(const char *file, const char *func, int line, int level, const char *fmt, ...)
+{
+	ftdm_log_ring_t *ring = NULL;
+	va_list ap;
+
+	/* ftdm_log may still point here for a moment after ftdm_log_async_stop() */
+	if (!async_log.running || !(ring = log_thread_ring())) {
+		return;
+	}
+
+	va_start(ap, fmt);
+	log_ring_vwrite(ring, file, func, line, level, fmt, ap);
+	va_end(ap);
+}
+
+/* oldest record not yet consumed, skipping the padding */
+static log_record_t *log_ring_peek(ftdm_log_ring_t *ring)
+{
+	uint32_t head = ftdm_atomic_get32(&ring->head);
+	log_record_t *rec = NULL;
+
+	while (ring->tail != head) {
+		rec = (log_record_t *)(ring->buffer + (ring->tail & (FTDM_LOG_RING_SIZE - 1)));
+		if (rec->level != LOG_RECORD_PAD) {
+			return rec;
+		}
+		ftdm_atomic_set32(&ring->tail, ring->tail + rec->len);
+	}
+	return NULL;
+}
+
+
+static void log_merge_sift_down(log_merge_t *heap, uint32_t count, uint32_t i)
+{
+	log_merge_t entry = heap[i];
+	uint32_t child;
+
+	while ((child = (2 * i) + 1) < count) {
+		if ((child + 1) < count && heap[child + 1].time < heap[child].time) {
+			child++;
+		}
+		if (entry.time <= heap[child].time) {
+			break;
+		}
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = entry;
+}
+
+/* release the drained rings of exited threads, only the drain thread (or the stopper once it exited) does it */
+static void log_reclaim(ftdm_log_ring_t *first)
+{
+	ftdm_log_ring_t *prev = NULL;
+	ftdm_log_ring_t *ring = NULL;
+
+	/* writers only push at the front, everything after the first ring belongs to this thread */
+	for (prev = first; prev && (ring = prev->next); ) {
+		if (ftdm_atomic_get32(&ring->orphaned) && ring->tail == ftdm_atomic_get32(&ring->head)) {
+			prev->next = ring->next;
+			ftdm_safe_free(ring);
+		} else {
+			prev = ring;
+		}
+	}
+}
+
+static void log_drain(ftdm_logger_t sink)
+{
+	ftdm_log_ring_t *first = NULL;
+	ftdm_log_ring_t *ring = NULL;
+	log_merge_t *heap = NULL;
+	log_record_t *rec = NULL;
+	uint32_t count = 0;
+	uint32_t rings = 0;
+	uint32_t dropped;
+	uint32_t i;
+
+	first = ftdm_atomic_get_ptr((void * volatile *)&async_log.rings);
+
+	for (ring = first; ring; ring = ring->next) {
+		rings++;
+	}
+	if (rings > async_log.merge_size) {
+		heap = ftdm_realloc(async_log.merge, rings * sizeof(*heap));
+		if (!heap) {
+			return;
+		}
+		async_log.merge = heap;
+		async_log.merge_size = rings;
+	}
+	heap = async_log.merge;
+
+	/* merge the rings by time so the messages of different threads keep their order */
+	for (ring = first; ring; ring = ring->next) {
+		if ((rec = log_ring_peek(ring))) {
+			heap[count].time = rec->time;
+			heap[count].ring = ring;
+			heap[count].rec = rec;
+			count++;
+		}
+	}
+	for (i = count / 2; i-- > 0; ) {
+		log_merge_sift_down(heap, count, i);
+	}
+
+	while (count) {
+		ring = heap[0].ring;
+		rec = heap[0].rec;
+		sink((char *)rec + sizeof(*rec), (char *)rec + rec->func_offset, rec->line, rec->level,
+				"%s", (char *)rec + rec->msg_offset);
+		ftdm_atomic_set32(&ring->tail, ring->tail + rec->len);
+
+		/* the records of a ring are already in time order */
+		if ((rec = log_ring_peek(ring))) {
+			heap[0].time = rec->time;
+			heap[0].rec = rec;
+		} else {
+			heap[0] = heap[--count];
+		}
+		log_merge_sift_down(heap, count, 0);
+	}
+
+	for (ring = first; ring; ring = ring->next) {
+		dropped = ring->dropped;
+		if (dropped != ring->reported) {
+			sink(__FILE__, __func__, __LINE__, FTDM_LOG_LEVEL_WARNING,
+					"Dropped %u log messages, the logger is not keeping up\n", dropped - ring->reported);
+			ring->reported = dropped;
+		}
+	}
+
+	log_reclaim(first);
+}
+
+static void *ftdm_log_drain_run(ftdm_thread_t *me, void *obj)
+{
+	ftdm_unused_arg(me);
+	ftdm_unused_arg(obj);
+
+	while (async_log.running) {
+		log_drain(async_log.sink);
+		ftdm_interrupt_wait(async_log.interrupt, FTDM_LOG_DRAIN_INTERVAL);
+	}
+	log_drain(async_log.sink);
+
+	ftdm_interrupt_signal(async_log.stopped);
+	return NULL;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_log_async_start(ftdm_logger_t sink)
+{
+	async_log.sink = sink;
+
+	if (async_log.running) {
+		return FTDM_SUCCESS;
+	}
+
+	/* the key outlives the drain thread, rings of running threads are kept across restarts */
+	if (!async_log.key_created) {
+#ifdef WIN32
+		async_log.fls = FlsAlloc(log_ring_release);
+		if (async_log.fls == FLS_OUT_OF_INDEXES) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to allocate the async logger thread storage\n");
+			return FTDM_FAIL;
+		}
+#else
+		if (pthread_key_create(&async_log.key, log_ring_release)) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to allocate the async logger thread storage\n");
+			return FTDM_FAIL;
+		}
+#endif
+		async_log.key_created = 1;
+	}
+
+	if (ftdm_interrupt_create(&async_log.interrupt, FTDM_INVALID_SOCKET, FTDM_NO_FLAGS) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to create the async logger interrupt\n");
+		return FTDM_FAIL;
+	}
+	if (ftdm_interrupt_create(&async_log.stopped, FTDM_INVALID_SOCKET, FTDM_NO_FLAGS) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to create the async logger interrupt\n");
+		goto error;
+	}
+
+	async_log.running = 1;
+	if (ftdm_thread_create_detached(ftdm_log_drain_run, NULL) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to create the async logger thread\n");
+		async_log.running = 0;
+		goto error;
+	}
+	return FTDM_SUCCESS;
+
+error:
+	ftdm_interrupt_destroy(&async_log.interrupt);
+	if (async_log.stopped) {
+		ftdm_interrupt_destroy(&async_log.stopped);
+	}
+	return FTDM_FAIL;
+}
+
+FT_DECLARE(void) ftdm_log_async_stop(void)
+{
+	if (!async_log.running) {
+		return;
+	}
+
+	async_log.running = 0;
+	ftdm_interrupt_signal(async_log.interrupt);
+
+	/* join the drain thread, it wrote everything queued so far */
+	ftdm_interrupt_wait(async_log.stopped, -1);
+	ftdm_interrupt_destroy(&async_log.stopped);
+	ftdm_interrupt_destroy(&async_log.interrupt);
+
+	/* rings of running threads are left alone, a writer may still be in ftdm_log_async_write() */
+	log_reclaim(ftdm_atomic_get_ptr((void * volatile *)&async_log.rings));
+	ftdm_safe_free(async_log.merge);
+	async_log.merge_size = 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
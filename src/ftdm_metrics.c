@@ -0,0 +1,814 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "private/ftdm_core.h"
+#include <stddef.h>
+
+typedef struct ftdm_metrics_collector_entry ftdm_metrics_collector_entry_t;
+struct ftdm_metrics_collector_entry {
+	ftdm_metrics_collector_t collector;
+	void *data;
+	ftdm_metrics_collector_entry_t *next;
+};
+
+static struct {
+	ftdm_mutex_t *mutex;
+	ftdm_metric_t *metrics;
+	ftdm_metrics_collector_entry_t *collectors;
+	volatile uint32_t next_shard;
+} metrics_globals;
+
+/* shard of the calling thread plus one, 0 until the thread updates its first counter */
+static FTDM_THREAD_LOCAL uint32_t thread_shard;
+
+FT_DECLARE(uint64_t) ftdm_metrics_now(void)
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (!freq.QuadPart) {
+		QueryPerformanceFrequency(&freq);
+	}
+	QueryPerformanceCounter(&now);
+	return (uint64_t)((now.QuadPart / freq.QuadPart) * 1000000000 + ((now.QuadPart % freq.QuadPart) * 1000000000) / freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
+
+FT_DECLARE(void) ftdm_histogram_merge(ftdm_histogram_t *dst, const ftdm_histogram_t *src)
+{
+	int i;
+
+	if (!src->count) {
+		return;
+	}
+
+	for (i = 0; i < FTDM_HISTOGRAM_BUCKETS; i++) {
+		dst->buckets[i] += src->buckets[i];
+	}
+	if (!dst->count || src->min < dst->min) {
+		dst->min = src->min;
+	}
+	if (src->max > dst->max) {
+		dst->max = src->max;
+	}
+	dst->count += src->count;
+	dst->sum += src->sum;
+}
+
+static __inline__ void histogram_atomic_add(volatile uint64_t *target, uint64_t value)
+{
+#if defined(__ATOMIC_RELAXED)
+	__atomic_fetch_add(target, value, __ATOMIC_RELAXED);
+#elif defined(__GNUC__)
+	__sync_fetch_and_add(target, value);
+#elif defined(WIN32)
+	InterlockedExchangeAdd64((volatile LONGLONG *)target, (LONGLONG)value);
+#else
+	*target += value;
+#endif
+}
+
+static __inline__ int histogram_atomic_cas(volatile uint64_t *target, uint64_t old, uint64_t value)
+{
+#if defined(__ATOMIC_RELAXED)
+	return __atomic_compare_exchange_n(target, &old, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#elif defined(__GNUC__)
+	return __sync_bool_compare_and_swap(target, old, value);
+#elif defined(WIN32)
+	return (uint64_t)InterlockedCompareExchange64((volatile LONGLONG *)target, (LONGLONG)value, (LONGLONG)old) == old;
+#else
+	*target = value;
+	return 1;
+#endif
+}
+
+FT_DECLARE(void) ftdm_histogram_record_atomic(ftdm_histogram_t *histogram, uint64_t value)
+{
+	volatile uint64_t *min = (volatile uint64_t *)&histogram->min;
+	volatile uint64_t *max = (volatile uint64_t *)&histogram->max;
+	uint64_t current;
+
+	ftdm_atomic_inc32((volatile uint32_t *)&histogram->buckets[ftdm_histogram_bucket(value)]);
+
+	/* a min of 0 means nothing was recorded yet, same as the count check of ftdm_histogram_record() */
+	for (current = *min; !current || value < current; current = *min) {
+		if (histogram_atomic_cas(min, current, value)) {
+			break;
+		}
+	}
+	for (current = *max; value > current; current = *max) {
+		if (histogram_atomic_cas(max, current, value)) {
+			break;
+		}
+	}
+
+	histogram_atomic_add((volatile uint64_t *)&histogram->sum, value);
+	histogram_atomic_add((volatile uint64_t *)&histogram->count, 1);
+}
+
+FT_DECLARE(uint64_t) ftdm_histogram_percentile(const ftdm_histogram_t *histogram, double percentile)
+{
+	uint64_t target;
+	uint64_t seen = 0;
+	uint64_t low, width, value;
+	uint32_t group, sub;
+	int i;
+
+	if (!histogram->count) {
+		return 0;
+	}
+
+	target = (uint64_t)((percentile * histogram->count) / 100.0);
+	if (target < 1) {
+		target = 1;
+	}
+
+	for (i = 0; i < FTDM_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= target) {
+			break;
+		}
+	}
+	if (i == FTDM_HISTOGRAM_BUCKETS) {
+		return histogram->max;
+	}
+
+	/* report the middle of the bucket, clamped to the recorded range */
+	group = i >> FTDM_HISTOGRAM_SUB_BITS;
+	sub = i & (FTDM_HISTOGRAM_SUB_BUCKETS - 1);
+	if (!group) {
+		low = sub;
+		width = 1;
+	} else {
+		low = (uint64_t)(FTDM_HISTOGRAM_SUB_BUCKETS + sub) << (group - 1);
+		width = (uint64_t)1 << (group - 1);
+	}
+	value = low + (width / 2);
+	if (value < histogram->min) {
+		value = histogram->min;
+	}
+	if (value > histogram->max) {
+		value = histogram->max;
+	}
+	return value;
+}
+
+FT_DECLARE(void) ftdm_span_metrics_loop_mark(ftdm_span_t *span)
+{
+	uint64_t now = ftdm_metrics_now();
+
+	if (span->metrics.loop_start) {
+		ftdm_histogram_record(&span->metrics.loop, now - span->metrics.loop_start);
+	}
+	span->metrics.loop_start = now;
+}
+
+#define NS2US(ns) ((double)(ns) / 1000.0)
+
+static void print_histogram(ftdm_stream_handle_t *stream, const char *name, const ftdm_histogram_t *histogram,
+		ftdm_metrics_format_t format, int first)
+{
+	double avg = histogram->count ? NS2US(histogram->sum) / histogram->count : 0.0;
+
+	if (format == FTDM_METRICS_FORMAT_JSON) {
+		stream->write_function(stream, "%s\"%s\":{\"count\":%"FTDM_UINT64_FMT",\"min_us\":%.1f,\"avg_us\":%.1f,"
+				"\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}",
+				first ? "" : ",", name, histogram->count, NS2US(histogram->min), avg,
+				NS2US(ftdm_histogram_percentile(histogram, 50)),
+				NS2US(ftdm_histogram_percentile(histogram, 90)),
+				NS2US(ftdm_histogram_percentile(histogram, 99)),
+				NS2US(histogram->max));
+		return;
+	}
+
+	stream->write_function(stream, "  %-8s count=%-10"FTDM_UINT64_FMT" min=%.1f avg=%.1f p50=%.1f p90=%.1f p99=%.1f max=%.1f (us)\n",
+			name, histogram->count, NS2US(histogram->min), avg,
+			NS2US(ftdm_histogram_percentile(histogram, 50)),
+			NS2US(ftdm_histogram_percentile(histogram, 90)),
+			NS2US(ftdm_histogram_percentile(histogram, 99)),
+			NS2US(histogram->max));
+}
+
+static void print_channel_metrics(ftdm_stream_handle_t *stream, const ftdm_channel_metrics_t *metrics, ftdm_metrics_format_t format, int first)
+{
+	print_histogram(stream, "state", &metrics->state, format, first);
+	print_histogram(stream, "read", &metrics->read, format, 0);
+	print_histogram(stream, "write", &metrics->write, format, 0);
+	print_histogram(stream, "jitter", &metrics->jitter, format, 0);
+}
+
+static void print_span_metrics(ftdm_stream_handle_t *stream, ftdm_span_t *span, ftdm_metrics_format_t format)
+{
+	ftdm_channel_metrics_t *total = NULL;
+	uint32_t i;
+
+	total = ftdm_calloc(1, sizeof(*total));
+	if (!total) {
+		return;
+	}
+
+	for (i = 1; i <= span->chan_count; i++) {
+		const ftdm_channel_metrics_t *metrics = &span->channels[i]->cold->metrics;
+		ftdm_histogram_merge(&total->state, &metrics->state);
+		ftdm_histogram_merge(&total->read, &metrics->read);
+		ftdm_histogram_merge(&total->write, &metrics->write);
+		ftdm_histogram_merge(&total->jitter, &metrics->jitter);
+	}
+
+	if (format == FTDM_METRICS_FORMAT_JSON) {
+		stream->write_function(stream, "{\"id\":%u,\"name\":\"%s\",", span->span_id, span->name);
+	} else {
+		stream->write_function(stream, "span %u (%s)\n", span->span_id, span->name);
+	}
+	print_histogram(stream, "signal", &span->metrics.signal, format, 1);
+	print_histogram(stream, "loop", &span->metrics.loop, format, 0);
+	print_channel_metrics(stream, total, format, 0);
+	if (format == FTDM_METRICS_FORMAT_JSON) {
+		stream->write_function(stream, "}");
+	}
+
+	ftdm_safe_free(total);
+}
+
+FT_DECLARE(void) ftdm_metrics_print(ftdm_stream_handle_t *stream, ftdm_span_t *span, ftdm_channel_t *ftdmchan, ftdm_metrics_format_t format)
+{
+	uint32_t id;
+	int first = 1;
+
+	if (ftdmchan) {
+		if (format == FTDM_METRICS_FORMAT_JSON) {
+			stream->write_function(stream, "{\"span\":%u,\"chan\":%u,", ftdmchan->span_id, ftdmchan->chan_id);
+		} else {
+			stream->write_function(stream, "span %u (%s) channel %u\n", ftdmchan->span_id, ftdmchan->span->name, ftdmchan->chan_id);
+		}
+		print_channel_metrics(stream, &ftdmchan->cold->metrics, format, 1);
+		if (format == FTDM_METRICS_FORMAT_JSON) {
+			stream->write_function(stream, "}\n");
+		}
+		return;
+	}
+
+	if (format == FTDM_METRICS_FORMAT_JSON) {
+		stream->write_function(stream, "{\"spans\":[");
+	}
+
+	for (id = 1; id <= FTDM_MAX_SPANS_INTERFACE; id++) {
+		ftdm_span_t *fspan = NULL;
+
+		if (span) {
+			fspan = span;
+		} else if (ftdm_span_find(id, &fspan) != FTDM_SUCCESS) {
+			continue;
+		}
+
+		if (format == FTDM_METRICS_FORMAT_JSON && !first) {
+			stream->write_function(stream, ",");
+		}
+		print_span_metrics(stream, fspan, format);
+		first = 0;
+
+		if (span) {
+			break;
+		}
+	}
+
+	if (format == FTDM_METRICS_FORMAT_JSON) {
+		stream->write_function(stream, "]}\n");
+	}
+}
+
+static void reset_span_metrics(ftdm_span_t *span)
+{
+	uint32_t i;
+
+	memset(&span->metrics.signal, 0, sizeof(span->metrics.signal));
+	memset(&span->metrics.loop, 0, sizeof(span->metrics.loop));
+
+	for (i = 1; i <= span->chan_count; i++) {
+		ftdm_channel_metrics_t *metrics = &span->channels[i]->cold->metrics;
+		memset(&metrics->state, 0, sizeof(metrics->state));
+		memset(&metrics->read, 0, sizeof(metrics->read));
+		memset(&metrics->write, 0, sizeof(metrics->write));
+		memset(&metrics->jitter, 0, sizeof(metrics->jitter));
+	}
+}
+
+FT_DECLARE(void) ftdm_metrics_reset(ftdm_span_t *span)
+{
+	uint32_t id;
+
+	if (span) {
+		reset_span_metrics(span);
+		return;
+	}
+
+	for (id = 1; id <= FTDM_MAX_SPANS_INTERFACE; id++) {
+		if (ftdm_span_find(id, &span) == FTDM_SUCCESS) {
+			reset_span_metrics(span);
+		}
+	}
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_global_init(void)
+{
+	memset(&metrics_globals, 0, sizeof(metrics_globals));
+	return ftdm_mutex_create(&metrics_globals.mutex);
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_global_destroy(void)
+{
+	ftdm_metrics_collector_entry_t *entry = NULL;
+
+	if (!metrics_globals.mutex) {
+		return FTDM_SUCCESS;
+	}
+
+	while (metrics_globals.metrics) {
+		ftdm_metric_unregister(metrics_globals.metrics);
+	}
+
+	while ((entry = metrics_globals.collectors)) {
+		metrics_globals.collectors = entry->next;
+		ftdm_safe_free(entry);
+	}
+
+	ftdm_mutex_destroy(&metrics_globals.mutex);
+	return FTDM_SUCCESS;
+}
+
+static ftdm_status_t metric_register(ftdm_metric_t *metric, ftdm_metric_type_t type, const ftdm_histogram_t *histogram,
+		const char *name, const char *labels, const char *help)
+{
+	ftdm_assert_return(metric && name, FTDM_EINVAL, "Invalid metric\n");
+	ftdm_assert_return(metrics_globals.mutex, FTDM_FAIL, "Metrics registry not initialized\n");
+
+	memset(metric, 0, sizeof(*metric));
+	metric->type = type;
+	metric->histogram = histogram;
+	metric->name = ftdm_strdup(name);
+	metric->labels = labels && *labels ? ftdm_strdup(labels) : NULL;
+	metric->help = help ? ftdm_strdup(help) : NULL;
+
+	ftdm_mutex_lock(metrics_globals.mutex);
+	metric->next = metrics_globals.metrics;
+	metrics_globals.metrics = metric;
+	ftdm_mutex_unlock(metrics_globals.mutex);
+
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metric_register(ftdm_metric_t *metric, ftdm_metric_type_t type,
+		const char *name, const char *labels, const char *help)
+{
+	ftdm_assert_return(type != FTDM_METRIC_HISTOGRAM, FTDM_EINVAL, "Histograms are registered with ftdm_metric_register_histogram\n");
+	return metric_register(metric, type, NULL, name, labels, help);
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metric_register_histogram(ftdm_metric_t *metric, const ftdm_histogram_t *histogram,
+		const char *name, const char *labels, const char *help)
+{
+	ftdm_assert_return(histogram, FTDM_EINVAL, "Invalid histogram\n");
+	return metric_register(metric, FTDM_METRIC_HISTOGRAM, histogram, name, labels, help);
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metric_unregister(ftdm_metric_t *metric)
+{
+	ftdm_metric_t **prev = NULL;
+	ftdm_status_t status = FTDM_FAIL;
+
+	ftdm_mutex_lock(metrics_globals.mutex);
+	for (prev = &metrics_globals.metrics; *prev; prev = &(*prev)->next) {
+		if (*prev == metric) {
+			*prev = metric->next;
+			status = FTDM_SUCCESS;
+			break;
+		}
+	}
+	ftdm_mutex_unlock(metrics_globals.mutex);
+
+	if (status == FTDM_SUCCESS) {
+		ftdm_safe_free(metric->name);
+		ftdm_safe_free(metric->labels);
+		ftdm_safe_free(metric->help);
+		metric->next = NULL;
+	}
+	return status;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_collector_register(ftdm_metrics_collector_t collector, void *data)
+{
+	ftdm_metrics_collector_entry_t *entry = NULL;
+	ftdm_metrics_collector_entry_t **last = NULL;
+
+	ftdm_assert_return(metrics_globals.mutex, FTDM_FAIL, "Metrics registry not initialized\n");
+
+	entry = ftdm_calloc(1, sizeof(*entry));
+	if (!entry) {
+		return FTDM_MEMERR;
+	}
+	entry->collector = collector;
+	entry->data = data;
+
+	/* keep registration order so the output is stable */
+	ftdm_mutex_lock(metrics_globals.mutex);
+	for (last = &metrics_globals.collectors; *last; last = &(*last)->next);
+	*last = entry;
+	ftdm_mutex_unlock(metrics_globals.mutex);
+
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_collector_unregister(ftdm_metrics_collector_t collector, void *data)
+{
+	ftdm_metrics_collector_entry_t **prev = NULL;
+	ftdm_metrics_collector_entry_t *entry = NULL;
+
+	if (!metrics_globals.mutex) {
+		return FTDM_FAIL;
+	}
+
+	ftdm_mutex_lock(metrics_globals.mutex);
+	for (prev = &metrics_globals.collectors; *prev; prev = &(*prev)->next) {
+		if ((*prev)->collector == collector && (*prev)->data == data) {
+			entry = *prev;
+			*prev = entry->next;
+			break;
+		}
+	}
+	ftdm_mutex_unlock(metrics_globals.mutex);
+
+	if (!entry) {
+		return FTDM_FAIL;
+	}
+	ftdm_safe_free(entry);
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(void) ftdm_metric_add(ftdm_metric_t *metric, uint64_t value)
+{
+	volatile uint64_t *shard = NULL;
+
+	if (!thread_shard) {
+		thread_shard = (ftdm_atomic_inc32(&metrics_globals.next_shard) % FTDM_METRIC_SHARDS) + 1;
+	}
+	shard = &metric->shards[thread_shard - 1].value;
+
+	/* only the sum matters, no ordering is needed with other memory accesses */
+#if defined(__ATOMIC_RELAXED)
+	__atomic_fetch_add(shard, value, __ATOMIC_RELAXED);
+#elif defined(__GNUC__)
+	__sync_fetch_and_add(shard, value);
+#elif defined(WIN32)
+	InterlockedExchangeAdd64((volatile LONGLONG *)shard, (LONGLONG)value);
+#else
+	*shard += value;
+#endif
+}
+
+FT_DECLARE(void) ftdm_metric_set(ftdm_metric_t *metric, int64_t value)
+{
+	metric->gauge = value;
+}
+
+FT_DECLARE(uint64_t) ftdm_metric_value(const ftdm_metric_t *metric)
+{
+	uint64_t value = 0;
+	int i;
+
+	for (i = 0; i < FTDM_METRIC_SHARDS; i++) {
+#if defined(__ATOMIC_RELAXED)
+		value += __atomic_load_n(&metric->shards[i].value, __ATOMIC_RELAXED);
+#else
+		value += metric->shards[i].value;
+#endif
+	}
+	return value;
+}
+
+static const char *metric_type_str(ftdm_metric_type_t type)
+{
+	switch (type) {
+	case FTDM_METRIC_COUNTER:
+		return "counter";
+	case FTDM_METRIC_GAUGE:
+		return "gauge";
+	case FTDM_METRIC_HISTOGRAM:
+		return "histogram";
+	}
+	return "unknown";
+}
+
+FT_DECLARE(void) ftdm_metrics_render_family(ftdm_stream_handle_t *stream, const char *name, ftdm_metric_type_t type, const char *help)
+{
+	stream->write_function(stream, "# TYPE %s %s\n", name, metric_type_str(type));
+	if (help) {
+		stream->write_function(stream, "# HELP %s %s\n", name, help);
+	}
+}
+
+/* histogram buckets are exported with an upper bound every power of 4 ns, from ~1us to ~68s */
+#define METRICS_LE_MIN_BIT 10
+#define METRICS_LE_MAX_BIT 36
+#define NS2S(ns) ((double)(ns) / 1000000000.0)
+
+FT_DECLARE(void) ftdm_metrics_render_histogram(ftdm_stream_handle_t *stream, const char *name, const char *labels,
+		const ftdm_histogram_t *histogram)
+{
+	ftdm_histogram_t snapshot;
+	const char *sep = labels && *labels ? "," : "";
+	uint64_t cumulative = 0;
+	uint32_t bucket = 0;
+	uint32_t limit = 0;
+	int bit;
+
+	/* the owner keeps updating it, work on a copy so the buckets are consistent with the total */
+	memcpy(&snapshot, histogram, sizeof(snapshot));
+	labels = labels ? labels : "";
+
+	for (bit = METRICS_LE_MIN_BIT; bit <= METRICS_LE_MAX_BIT; bit += 2) {
+		/* every bucket before the one holding 2^bit only holds smaller values */
+		limit = ftdm_histogram_bucket((uint64_t)1 << bit);
+		for ( ; bucket < limit; bucket++) {
+			cumulative += snapshot.buckets[bucket];
+		}
+		stream->write_function(stream, "%s_bucket{%s%sle=\"%.9g\"} %"FTDM_UINT64_FMT"\n",
+				name, labels, sep, NS2S((uint64_t)1 << bit), cumulative);
+	}
+	for ( ; bucket < FTDM_HISTOGRAM_BUCKETS; bucket++) {
+		cumulative += snapshot.buckets[bucket];
+	}
+	stream->write_function(stream, "%s_bucket{%s%sle=\"+Inf\"} %"FTDM_UINT64_FMT"\n", name, labels, sep, cumulative);
+	if (*labels) {
+		stream->write_function(stream, "%s_count{%s} %"FTDM_UINT64_FMT"\n", name, labels, cumulative);
+		stream->write_function(stream, "%s_sum{%s} %.9f\n", name, labels, NS2S(snapshot.sum));
+	} else {
+		stream->write_function(stream, "%s_count %"FTDM_UINT64_FMT"\n", name, cumulative);
+		stream->write_function(stream, "%s_sum %.9f\n", name, NS2S(snapshot.sum));
+	}
+}
+
+static void render_metric(ftdm_stream_handle_t *stream, const ftdm_metric_t *metric)
+{
+	const char *lb = metric->labels ? "{" : "";
+	const char *rb = metric->labels ? "}" : "";
+	const char *labels = metric->labels ? metric->labels : "";
+
+	switch (metric->type) {
+	case FTDM_METRIC_COUNTER:
+		stream->write_function(stream, "%s_total%s%s%s %"FTDM_UINT64_FMT"\n", metric->name, lb, labels, rb, ftdm_metric_value(metric));
+		break;
+	case FTDM_METRIC_GAUGE:
+		stream->write_function(stream, "%s%s%s%s %"FTDM_INT64_FMT"\n", metric->name, lb, labels, rb, (int64_t)metric->gauge);
+		break;
+	case FTDM_METRIC_HISTOGRAM:
+		if (metric->histogram) {
+			ftdm_metrics_render_histogram(stream, metric->name, metric->labels, metric->histogram);
+		}
+		break;
+	}
+}
+
+typedef uint64_t (*channel_counter_func_t)(const ftdm_channel_t *fchan);
+
+static uint64_t chan_rx_packets(const ftdm_channel_t *fchan) { return fchan->iostats.rx.packets; }
+static uint64_t chan_rx_errors(const ftdm_channel_t *fchan) { return fchan->iostats.rx.errors; }
+static uint64_t chan_rx_drops(const ftdm_channel_t *fchan) { return (uint32_t)fchan->rxdrops; }
+static uint64_t chan_tx_packets(const ftdm_channel_t *fchan) { return fchan->iostats.tx.packets; }
+static uint64_t chan_tx_idle_packets(const ftdm_channel_t *fchan) { return fchan->iostats.tx.idle_packets; }
+static uint64_t chan_tx_errors(const ftdm_channel_t *fchan) { return fchan->iostats.tx.errors; }
+static uint64_t chan_tx_drops(const ftdm_channel_t *fchan) { return (uint32_t)fchan->txdrops; }
+
+static const struct {
+	const char *name;
+	const char *help;
+	channel_counter_func_t get;
+} channel_counters[] = {
+	{ "freetdm_channel_rx_packets", "Packets received by the io module", chan_rx_packets },
+	{ "freetdm_channel_rx_errors", "Receive errors reported by the io module", chan_rx_errors },
+	{ "freetdm_channel_rx_drops", "Media read dropped by the core", chan_rx_drops },
+	{ "freetdm_channel_tx_packets", "Packets transmitted by the io module", chan_tx_packets },
+	{ "freetdm_channel_tx_idle_packets", "Idle packets transmitted by the io module", chan_tx_idle_packets },
+	{ "freetdm_channel_tx_errors", "Transmit errors reported by the io module", chan_tx_errors },
+	{ "freetdm_channel_tx_drops", "Media writes dropped by the core", chan_tx_drops },
+};
+
+static const struct {
+	const char *name;
+	const char *help;
+	size_t offset;
+} channel_histograms[] = {
+	{ "freetdm_channel_state_seconds", "Time from setting a channel state until it is completed", offsetof(ftdm_channel_metrics_t, state) },
+	{ "freetdm_channel_read_seconds", "Media read duration", offsetof(ftdm_channel_metrics_t, read) },
+	{ "freetdm_channel_write_seconds", "Media write duration", offsetof(ftdm_channel_metrics_t, write) },
+	{ "freetdm_channel_jitter_seconds", "Deviation of the media read inter-arrival time from the channel interval", offsetof(ftdm_channel_metrics_t, jitter) },
+};
+
+static void render_core(ftdm_stream_handle_t *stream, ftdm_span_t **spans, uint32_t span_count)
+{
+	ftdm_histogram_t *total = NULL;
+	char labels[256];
+	uint32_t count;
+	uint32_t s, i, c;
+
+	ftdm_metrics_render_family(stream, "freetdm_span_channels", FTDM_METRIC_GAUGE, "Channels in the span");
+	for (s = 0; s < span_count; s++) {
+		stream->write_function(stream, "freetdm_span_channels{span=\"%s\"} %u\n", spans[s]->name, spans[s]->chan_count);
+	}
+
+	ftdm_metrics_render_family(stream, "freetdm_span_channels_in_use", FTDM_METRIC_GAUGE, "Channels in use in the span");
+	for (s = 0; s < span_count; s++) {
+		ftdm_span_channel_use_count(spans[s], &count);
+		stream->write_function(stream, "freetdm_span_channels_in_use{span=\"%s\"} %u\n", spans[s]->name, count);
+	}
+
+	ftdm_metrics_render_family(stream, "freetdm_span_channels_in_alarm", FTDM_METRIC_GAUGE, "Channels in alarm in the span");
+	for (s = 0; s < span_count; s++) {
+		count = 0;
+		for (i = 1; i <= spans[s]->chan_count; i++) {
+			if (ftdm_test_flag(spans[s]->channels[i], FTDM_CHANNEL_IN_ALARM)) {
+				count++;
+			}
+		}
+		stream->write_function(stream, "freetdm_span_channels_in_alarm{span=\"%s\"} %u\n", spans[s]->name, count);
+	}
+
+	for (c = 0; c < ftdm_array_len(channel_counters); c++) {
+		ftdm_metrics_render_family(stream, channel_counters[c].name, FTDM_METRIC_COUNTER, channel_counters[c].help);
+		for (s = 0; s < span_count; s++) {
+			for (i = 1; i <= spans[s]->chan_count; i++) {
+				stream->write_function(stream, "%s_total{span=\"%s\",chan=\"%u\"} %"FTDM_UINT64_FMT"\n",
+						channel_counters[c].name, spans[s]->name, spans[s]->channels[i]->chan_id,
+						channel_counters[c].get(spans[s]->channels[i]));
+			}
+		}
+	}
+
+	ftdm_metrics_render_family(stream, "freetdm_span_signal_seconds", FTDM_METRIC_HISTOGRAM, "User signal callback duration");
+	for (s = 0; s < span_count; s++) {
+		snprintf(labels, sizeof(labels), "span=\"%s\"", spans[s]->name);
+		ftdm_metrics_render_histogram(stream, "freetdm_span_signal_seconds", labels, &spans[s]->metrics.signal);
+	}
+
+	ftdm_metrics_render_family(stream, "freetdm_span_loop_seconds", FTDM_METRIC_HISTOGRAM, "Signaling module loop iteration time");
+	for (s = 0; s < span_count; s++) {
+		snprintf(labels, sizeof(labels), "span=\"%s\"", spans[s]->name);
+		ftdm_metrics_render_histogram(stream, "freetdm_span_loop_seconds", labels, &spans[s]->metrics.loop);
+	}
+
+	/* channel histograms are aggregated per span, per channel buckets would make the output huge */
+	total = ftdm_malloc(sizeof(*total));
+	if (!total) {
+		return;
+	}
+	for (c = 0; c < ftdm_array_len(channel_histograms); c++) {
+		ftdm_metrics_render_family(stream, channel_histograms[c].name, FTDM_METRIC_HISTOGRAM, channel_histograms[c].help);
+		for (s = 0; s < span_count; s++) {
+			memset(total, 0, sizeof(*total));
+			for (i = 1; i <= spans[s]->chan_count; i++) {
+				const char *metrics = (const char *)&spans[s]->channels[i]->cold->metrics;
+				ftdm_histogram_merge(total, (const ftdm_histogram_t *)(metrics + channel_histograms[c].offset));
+			}
+			snprintf(labels, sizeof(labels), "span=\"%s\"", spans[s]->name);
+			ftdm_metrics_render_histogram(stream, channel_histograms[c].name, labels, total);
+		}
+	}
+	ftdm_safe_free(total);
+}
+
+FT_DECLARE(void) ftdm_metrics_render_stream(ftdm_stream_handle_t *stream)
+{
+	ftdm_span_t *spans[FTDM_MAX_SPANS_INTERFACE];
+	ftdm_metrics_collector_entry_t *entry = NULL;
+	ftdm_metric_t *metric = NULL;
+	ftdm_metric_t *family = NULL;
+	uint32_t span_count = 0;
+	uint32_t id;
+
+	for (id = 1; id <= FTDM_MAX_SPANS_INTERFACE; id++) {
+		if (ftdm_span_find(id, &spans[span_count]) == FTDM_SUCCESS) {
+			span_count++;
+		}
+	}
+	render_core(stream, spans, span_count);
+
+	ftdm_mutex_lock(metrics_globals.mutex);
+
+	/* samples of a family must be contiguous, render each name once with all its label sets */
+	for (family = metrics_globals.metrics; family; family = family->next) {
+		for (metric = metrics_globals.metrics; metric != family && strcmp(metric->name, family->name); metric = metric->next);
+		if (metric != family) {
+			continue;
+		}
+		ftdm_metrics_render_family(stream, family->name, family->type, family->help);
+		for (metric = family; metric; metric = metric->next) {
+			if (!strcmp(metric->name, family->name)) {
+				render_metric(stream, metric);
+			}
+		}
+	}
+
+	for (entry = metrics_globals.collectors; entry; entry = entry->next) {
+		entry->collector(stream, entry->data);
+	}
+
+	ftdm_mutex_unlock(metrics_globals.mutex);
+
+	stream->write_function(stream, "# EOF\n");
+}
+
+FT_DECLARE(char *) ftdm_metrics_render(void)
+{
+	ftdm_stream_handle_t stream = { 0 };
+
+	FTDM_STANDARD_STREAM(stream);
+	ftdm_metrics_render_stream(&stream);
+	return stream.data;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_render_to_file(const char *path)
+{
+	ftdm_stream_handle_t stream = { 0 };
+	ftdm_status_t status = FTDM_FAIL;
+	char tmppath[1024];
+	size_t len;
+	FILE *file = NULL;
+
+	snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+
+	FTDM_STANDARD_STREAM(stream);
+	ftdm_metrics_render_stream(&stream);
+	len = strlen(stream.data);
+
+	file = fopen(tmppath, "wb");
+	if (!file) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to open metrics file %s: %s\n", tmppath, strerror(errno));
+		goto done;
+	}
+	if (fwrite(stream.data, 1, len, file) != len) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to write metrics file %s: %s\n", tmppath, strerror(errno));
+		fclose(file);
+		goto done;
+	}
+	fclose(file);
+
+	/* replace the old file in one step, a scraper sees either the old or the new contents */
+#ifdef WIN32
+	if (!MoveFileEx(tmppath, path, MOVEFILE_REPLACE_EXISTING)) {
+#else
+	if (rename(tmppath, path)) {
+#endif
+		ftdm_log(FTDM_LOG_ERROR, "Failed to rename metrics file %s to %s\n", tmppath, path);
+		goto done;
+	}
+	status = FTDM_SUCCESS;
+
+done:
+	ftdm_safe_free(stream.data);
+	return status;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "private/ftdm_core.h"
+
+FTDM_ENUM_NAMES(RECORDER_EVENT_NAMES, RECORDER_EVENT_STRINGS)
+FTDM_STR2ENUM(ftdm_str2ftdm_recorder_event, ftdm_recorder_event2str, ftdm_recorder_event_t, RECORDER_EVENT_NAMES, FTDM_RECORDER_INVALID)
+
+/*! \brief Minimum time (ms) between two automatic dumps, asserts tend to come in bursts */
+#define RECORDER_ASSERT_DUMP_INTERVAL 60000
+
+static struct {
+	char *dump_directory;
+	ftdm_time_t last_assert_dump;
+	uint32_t next_thread_id;
+} recorder_globals;
+
+static FTDM_THREAD_LOCAL uint32_t recorder_thread_id;
+
+FT_DECLARE(void) ftdm_recorder_record(ftdm_recorder_t *recorder, ftdm_recorder_event_t type, uint32_t arg, uint16_t arg2)
+{
+	ftdm_recorder_record_at(recorder, ftdm_metrics_now(), type, arg, arg2);
+}
+
+FT_DECLARE(void) ftdm_recorder_record_at(ftdm_recorder_t *recorder, uint64_t time, ftdm_recorder_event_t type, uint32_t arg, uint16_t arg2)
+{
+	ftdm_recorder_entry_t *entry;
+	uint32_t seq;
+
+	if (!recorder_thread_id) {
+		recorder_thread_id = ftdm_atomic_inc32(&recorder_globals.next_thread_id);
+	}
+
+	/* claim a slot, concurrent writers (the span thread and a user thread) never get the same one */
+	seq = ftdm_atomic_inc32(&recorder->seq);
+	entry = &recorder->entries[(seq - 1) & (FTDM_RECORDER_SIZE - 1)];
+
+	/*
+	 * the slot seq is cleared while the entry is rewritten and published last, see recorder_snapshot()
+	 * the fence keeps the payload stores after the clear, the release store keeps them before the publish
+	 */
+	ftdm_atomic_set32(&entry->seq, 0);
+	ftdm_atomic_fence();
+	entry->time = time;
+	entry->type = (uint16_t)type;
+	entry->arg = arg;
+	entry->arg2 = arg2;
+	entry->thread = recorder_thread_id;
+	ftdm_atomic_set32(&entry->seq, seq);
+}
+
+/*! \brief Copy the valid entries of a recorder from the oldest to the newest, returns how many were copied */
+static uint32_t recorder_snapshot(ftdm_recorder_t *recorder, ftdm_recorder_entry_t *entries)
+{
+	uint32_t last = ftdm_atomic_get32(&recorder->seq);
+	uint32_t seq = last > FTDM_RECORDER_SIZE ? last - FTDM_RECORDER_SIZE + 1 : 1;
+	uint32_t count = 0;
+
+	for ( ; seq && seq <= last; seq++) {
+		ftdm_recorder_entry_t *entry = &recorder->entries[(seq - 1) & (FTDM_RECORDER_SIZE - 1)];
+
+		if (ftdm_atomic_get32(&entry->seq) != seq) {
+			/* not published yet or already overwritten by a newer event */
+			continue;
+		}
+		entries[count] = *entry;
+		/* discard the copy if a writer claimed the slot meanwhile, the fence keeps the copy before the check */
+		ftdm_atomic_fence();
+		if (ftdm_atomic_get32(&entry->seq) != seq) {
+			continue;
+		}
+		count++;
+	}
+	return count;
+}
+
+FT_DECLARE(char *) ftdm_recorder_entry_str(const ftdm_recorder_entry_t *entry, char *buf, ftdm_size_t len)
+{
+	const char *type = ftdm_recorder_event2str(entry->type);
+
+	switch (entry->type) {
+	case FTDM_RECORDER_STATE:
+		snprintf(buf, len, "%s %s -> %s", type,
+				ftdm_channel_state2str(entry->arg2), ftdm_channel_state2str(entry->arg));
+		break;
+	case FTDM_RECORDER_STATE_DONE:
+		snprintf(buf, len, "%s %s", type, ftdm_channel_state2str(entry->arg));
+		break;
+	case FTDM_RECORDER_STATE_CANCEL:
+		snprintf(buf, len, "%s %s (back to %s)", type,
+				ftdm_channel_state2str(entry->arg), ftdm_channel_state2str(entry->arg2));
+		break;
+	case FTDM_RECORDER_OOB:
+		snprintf(buf, len, "%s %s", type, ftdm_oob_event2str(entry->arg));
+		break;
+	case FTDM_RECORDER_SIGMSG:
+		snprintf(buf, len, "%s %s", type, ftdm_signal_event2str(entry->arg));
+		break;
+	case FTDM_RECORDER_INDICATE:
+		snprintf(buf, len, "%s %s", type, ftdm_channel_indication2str(entry->arg));
+		break;
+	case FTDM_RECORDER_INDICATE_DONE:
+		snprintf(buf, len, "%s %s status %u", type, ftdm_channel_indication2str(entry->arg), entry->arg2);
+		break;
+	case FTDM_RECORDER_HANGUP:
+		snprintf(buf, len, "%s cause %u", type, entry->arg);
+		break;
+	case FTDM_RECORDER_DTMF_RX:
+	case FTDM_RECORDER_DTMF_TX:
+		snprintf(buf, len, "%s %c", type, (entry->arg > 0x20 && entry->arg < 0x7f) ? (char)entry->arg : '?');
+		break;
+	case FTDM_RECORDER_READ_ERROR:
+	case FTDM_RECORDER_WRITE_ERROR:
+		snprintf(buf, len, "%s status %u errno %u (%s)", type, entry->arg, entry->arg2, strerror(entry->arg2));
+		break;
+	case FTDM_RECORDER_TIMER:
+		snprintf(buf, len, "%s %u", type, entry->arg);
+		break;
+	default:
+		snprintf(buf, len, "%s %u %u", type, entry->arg, entry->arg2);
+		break;
+	}
+	return buf;
+}
+
+FT_DECLARE(void) ftdm_recorder_print(ftdm_stream_handle_t *stream, ftdm_channel_t *fchan)
+{
+	ftdm_recorder_entry_t entries[FTDM_RECORDER_SIZE];
+	uint64_t now = ftdm_metrics_now();
+	uint32_t count;
+	uint32_t i;
+	char desc[128];
+
+	count = recorder_snapshot(&fchan->cold->recorder, entries);
+
+	stream->write_function(stream, "%d:%d (%d:%d) %u events, %u recorded\n",
+			fchan->span_id, fchan->chan_id, fchan->physical_span_id, fchan->physical_chan_id,
+			count, ftdm_atomic_get32(&fchan->cold->recorder.seq));
+	for (i = 0; i < count; i++) {
+		uint64_t age = now > entries[i].time ? now - entries[i].time : 0;
+		stream->write_function(stream, "%10u -%12.3fms t%-3u %s\n", entries[i].seq, (double)age / 1000000.0,
+				entries[i].thread, ftdm_recorder_entry_str(&entries[i], desc, sizeof(desc)));
+	}
+}
+
+static ftdm_status_t recorder_dump_channel(FILE *file, ftdm_channel_t *fchan, uint64_t now, uint64_t wall)
+{
+	ftdm_recorder_entry_t entries[FTDM_RECORDER_SIZE];
+	ftdm_recorder_dump_header_t header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FTDM_RECORDER_DUMP_MAGIC, sizeof(header.magic));
+	header.entry_size = sizeof(ftdm_recorder_entry_t);
+	header.count = recorder_snapshot(&fchan->cold->recorder, entries);
+	header.span_id = fchan->span_id;
+	header.chan_id = fchan->chan_id;
+	header.physical_span_id = fchan->physical_span_id;
+	header.physical_chan_id = fchan->physical_chan_id;
+	header.dump_time = now;
+	header.dump_wall_time = wall;
+	ftdm_copy_string(header.span_name, fchan->span->name, sizeof(header.span_name));
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1) {
+		return FTDM_FAIL;
+	}
+	if (header.count && fwrite(entries, sizeof(entries[0]), header.count, file) != header.count) {
+		return FTDM_FAIL;
+	}
+	return FTDM_SUCCESS;
+}
+
+static ftdm_status_t recorder_dump_span(FILE *file, ftdm_span_t *span, uint64_t now, uint64_t wall)
+{
+	uint32_t i;
+
+	for (i = 1; i <= span->chan_count; i++) {
+		if (recorder_dump_channel(file, span->channels[i], now, wall) != FTDM_SUCCESS) {
+			return FTDM_FAIL;
+		}
+	}
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_recorder_dump(const char *path, ftdm_span_t *span, ftdm_channel_t *fchan)
+{
+	ftdm_status_t status = FTDM_SUCCESS;
+	uint64_t now = ftdm_metrics_now();
+	uint64_t wall = ftdm_current_time_in_ms();
+	uint32_t id;
+	FILE *file;
+
+	file = fopen(path, "wb");
+	if (!file) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to open recorder dump file %s: %s\n", path, strerror(errno));
+		return FTDM_FAIL;
+	}
+
+	/* no locks are taken, this must work from a thread that failed an assert while holding any of them */
+	if (fchan) {
+		status = recorder_dump_channel(file, fchan, now, wall);
+	} else if (span) {
+		status = recorder_dump_span(file, span, now, wall);
+	} else {
+		for (id = 1; id <= FTDM_MAX_SPANS_INTERFACE && status == FTDM_SUCCESS; id++) {
+			if (ftdm_span_find(id, &span) == FTDM_SUCCESS) {
+				status = recorder_dump_span(file, span, now, wall);
+			}
+		}
+	}
+
+	if (fclose(file) || status != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to write recorder dump file %s\n", path);
+		return FTDM_FAIL;
+	}
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(void) ftdm_recorder_set_dump_directory(const char *directory)
+{
+	ftdm_safe_free(recorder_globals.dump_directory);
+	if (!ftdm_strlen_zero(directory)) {
+		recorder_globals.dump_directory = ftdm_strdup(directory);
+	}
+}
+
+FT_DECLARE(void) ftdm_recorder_assert_dump(void)
+{
+	ftdm_time_t now;
+	char path[1024];
+
+	if (!recorder_globals.dump_directory) {
+		return;
+	}
+
+	now = ftdm_current_time_in_ms();
+	/* always dump before aborting, otherwise only the first of a burst of asserts */
+	if (!(g_ftdm_crash_policy & FTDM_CRASH_ON_ASSERT) && recorder_globals.last_assert_dump &&
+	    (now - recorder_globals.last_assert_dump) < RECORDER_ASSERT_DUMP_INTERVAL) {
+		return;
+	}
+	recorder_globals.last_assert_dump = now;
+
+	snprintf(path, sizeof(path), "%s%sfreetdm-recorder-%"FTDM_TIME_FMT".bin",
+			recorder_globals.dump_directory, FTDM_PATH_SEPARATOR, now);
+	if (ftdm_recorder_dump(path, NULL, NULL) == FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_CRIT, "Channel recorders dumped to %s\n", path);
+	}
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
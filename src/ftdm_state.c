@@ -41,12 +41,58 @@ FTDM_ENUM_NAMES(CHANNEL_STATE_STATUS_NAMES, CHANNEL_STATE_STATUS_STRINGS)
 FTDM_STR2ENUM(ftdm_str2ftdm_state_status, ftdm_state_status2str, ftdm_state_status_t, CHANNEL_STATE_STATUS_NAMES, FTDM_STATE_STATUS_INVALID)
 
 static ftdm_status_t ftdm_core_set_state(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_state_t state, int waitrq);
+static __inline__ void ftdm_span_mark_dirty(ftdm_span_t *span, uint32_t chan_id);
 
-FT_DECLARE(ftdm_status_t) _ftdm_channel_complete_state(const char *file, const char *func, int line, ftdm_channel_t *fchan)
+/* A non-blocking answer (or progress media) indication cannot wait for PROGRESS and PROGRESS_MEDIA to be completed
+ * before moving to the next state, so the next state is set by ftdm_channel_advance_indication() once the previous
+ * one is completed and processed. Returns the next state to move to, or FTDM_CHANNEL_STATE_INVALID if the indication
+ * must be acknowledged with *status */
+static ftdm_channel_state_t ftdm_indication_next_state(ftdm_channel_t *fchan, ftdm_channel_state_t state, ftdm_status_t *status)
+{
+	*status = FTDM_SUCCESS;
+
+	if (ftdm_test_flag(fchan->span, FTDM_SPAN_USE_SKIP_STATES)) {
+		return FTDM_CHANNEL_STATE_INVALID;
+	}
+
+	switch (fchan->indication) {
+	case FTDM_CHANNEL_INDICATE_ANSWER:
+		if (state == FTDM_CHANNEL_STATE_PROGRESS) {
+			return FTDM_CHANNEL_STATE_PROGRESS_MEDIA;
+		}
+		if (state == FTDM_CHANNEL_STATE_PROGRESS_MEDIA) {
+			return FTDM_CHANNEL_STATE_UP;
+		}
+		if (state != FTDM_CHANNEL_STATE_UP) {
+			*status = FTDM_ECANCELED;
+		}
+		break;
+	case FTDM_CHANNEL_INDICATE_PROGRESS_MEDIA:
+		if (state == FTDM_CHANNEL_STATE_PROGRESS) {
+			return FTDM_CHANNEL_STATE_PROGRESS_MEDIA;
+		}
+		if (state != FTDM_CHANNEL_STATE_PROGRESS_MEDIA) {
+			*status = FTDM_ECANCELED;
+		}
+		break;
+	default:
+		break;
+	}
+	return FTDM_CHANNEL_STATE_INVALID;
+}
+
+/* chain is 0 when the signaling module is implicitly completing the state to set a new one (see _ftdm_set_state),
+ * in that case a pending answer indication is acknowledged (or continued) when that new state is completed.
+ * The next state of the indication is never set here, the signaling module may still be processing this state */
+static ftdm_status_t ftdm_channel_complete_state_chain(const char *file, const char *func, int line, ftdm_channel_t *fchan, int chain)
 {
 	uint8_t hindex = 0;
 	ftdm_time_t diff = 0;
 	ftdm_channel_state_t state = fchan->state;
+	ftdm_channel_state_t next_state = FTDM_CHANNEL_STATE_INVALID;
+	ftdm_status_t ack_status = FTDM_SUCCESS;
+	/* NEW while the state processor runs, see ftdm_channel_advance_states() */
+	int processed = (fchan->state_status == FTDM_STATE_STATUS_PROCESSED);
 
 #if 0
 	/*  I could not perform this sanity check without more disruptive changes. Ideally we should check here if the signaling module completing the state
@@ -96,19 +142,34 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_complete_state(const char *file, const c
 
 	/* MAINTENANCE WARNING
 	 * we're assuming an indication performed 
-	 * via state change will involve a single state change */
-	ftdm_ack_indication(fchan, fchan->indication, FTDM_SUCCESS);
+	 * via state change will involve a single state change,
+	 * except for the non-blocking answer and progress media */
+	if (ftdm_test_flag(fchan, FTDM_CHANNEL_IND_ACK_PENDING)) {
+		next_state = ftdm_indication_next_state(fchan, state, &ack_status);
+		if (next_state == FTDM_CHANNEL_STATE_INVALID) {
+			ftdm_ack_indication(fchan, fchan->indication, ack_status);
+		} else if (chain) {
+			ftdm_set_flag(fchan, FTDM_CHANNEL_IND_CHAIN);
+		}
+	}
 
-	hindex = (fchan->hindex == 0) ? (ftdm_array_len(fchan->history) - 1) : (fchan->hindex - 1);
+	hindex = (fchan->cold->hindex == 0) ? (ftdm_array_len(fchan->cold->history) - 1) : (fchan->cold->hindex - 1);
 	
-	ftdm_assert(!fchan->history[hindex].end_time, "End time should be zero!\n");
-
-	fchan->history[hindex].end_time = ftdm_current_time_in_ms();
-	fchan->last_state_change_time = ftdm_current_time_in_ms();
+	ftdm_assert(!fchan->cold->history[hindex].end_time, "End time should be zero!\n");
+
+	fchan->cold->history[hindex].end_time = ftdm_current_time_in_ms();
+	fchan->last_state_change_time = fchan->cold->history[hindex].end_time;
+	if (fchan->cold->metrics.state_start) {
+		uint64_t now = ftdm_histogram_record_since(&fchan->cold->metrics.state, fchan->cold->metrics.state_start);
+		fchan->cold->metrics.state_start = 0;
+		ftdm_channel_record_at(fchan, now, FTDM_RECORDER_STATE_DONE, state, 0);
+	} else {
+		ftdm_channel_record(fchan, FTDM_RECORDER_STATE_DONE, state, 0);
+	}
 
 	fchan->state_status = FTDM_STATE_STATUS_COMPLETED;
 
-	diff = fchan->history[hindex].end_time - fchan->history[hindex].time;
+	diff = fchan->cold->history[hindex].end_time - fchan->cold->history[hindex].time;
 
 	ftdm_log_chan_ex(fchan, file, func, line, FTDM_LOG_LEVEL_DEBUG, "Completed state change from %s to %s in %"FTDM_TIME_FMT" ms\n",
 			ftdm_channel_state2str(fchan->last_state), ftdm_channel_state2str(state), diff);
@@ -119,6 +180,42 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_complete_state(const char *file, const c
 		ftdm_interrupt_signal(fchan->state_completed_interrupt);
 	}
 
+	if (processed && ftdm_test_flag(fchan, FTDM_CHANNEL_IND_CHAIN)) {
+		/* completed after the state processor returned, get the channel advanced again */
+		if (ftdm_test_flag(fchan->span, FTDM_SPAN_USE_DIRTY_MAP)) {
+			ftdm_span_mark_dirty(fchan->span, fchan->chan_id);
+		} else if (fchan->span->pendingchans) {
+			ftdm_queue_enqueue(fchan->span->pendingchans, fchan);
+		}
+	}
+
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) _ftdm_channel_complete_state(const char *file, const char *func, int line, ftdm_channel_t *fchan)
+{
+	return ftdm_channel_complete_state_chain(file, func, line, fchan, 1);
+}
+
+FT_DECLARE(ftdm_status_t) _ftdm_channel_advance_indication(const char *file, const char *func, int line, ftdm_channel_t *fchan)
+{
+	ftdm_channel_state_t next_state;
+	ftdm_status_t ack_status = FTDM_SUCCESS;
+
+	if (!ftdm_test_flag(fchan, FTDM_CHANNEL_IND_CHAIN) || fchan->state_status != FTDM_STATE_STATUS_COMPLETED) {
+		return FTDM_SUCCESS;
+	}
+	ftdm_clear_flag(fchan, FTDM_CHANNEL_IND_CHAIN);
+
+	next_state = ftdm_indication_next_state(fchan, fchan->state, &ack_status);
+	if (next_state == FTDM_CHANNEL_STATE_INVALID) {
+		ftdm_ack_indication(fchan, fchan->indication, ack_status);
+		return FTDM_SUCCESS;
+	}
+	if (ftdm_core_set_state(file, func, line, fchan, next_state, 0) != FTDM_SUCCESS) {
+		ftdm_ack_indication(fchan, fchan->indication, FTDM_ECANCELED);
+		return FTDM_FAIL;
+	}
 	return FTDM_SUCCESS;
 }
 
@@ -129,15 +226,18 @@ FT_DECLARE(ftdm_status_t) _ftdm_set_state(const char *file, const char *func, in
 		/* the current state is not completed, setting a new state from a signaling module
 		   when the current state is not completed is equivalent to implicitly acknowledging 
 		   the current state */
-		_ftdm_channel_complete_state(file, func, line, fchan);
+		ftdm_channel_complete_state_chain(file, func, line, fchan, 0);
 	}
 	return ftdm_core_set_state(file, func, line, fchan, state, 0);
 }
 
-static int ftdm_parse_state_map(ftdm_channel_t *ftdmchan, ftdm_channel_state_t state, ftdm_state_map_t *state_map)
+/* the matrix rows are bit masks of the destination states */
+typedef char ftdm_state_matrix_row_check[(FTDM_CHANNEL_STATE_INVALID <= 32) ? 1 : -1];
+
+static int ftdm_parse_state_map(const ftdm_state_map_t *state_map, ftdm_state_direction_t direction,
+		ftdm_channel_state_t current, ftdm_channel_state_t state)
 {
 	int x = 0, ok = 0;
-	ftdm_state_direction_t direction = ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) ? ZSD_OUTBOUND : ZSD_INBOUND;
 
 	for(x = 0; x < FTDM_MAP_NODE_SIZE; x++) {
 		int i = 0, proceed = 0;
@@ -153,7 +253,7 @@ static int ftdm_parse_state_map(ftdm_channel_t *ftdmchan, ftdm_channel_state_t s
 			proceed = 1;
 		} else {
 			for(i = 0; i < FTDM_MAP_MAX; i++) {
-				if (state_map->nodes[x].check_states[i] == ftdmchan->state) {
+				if (state_map->nodes[x].check_states[i] == current) {
 					proceed = 1;
 					break;
 				}
@@ -180,6 +280,134 @@ static int ftdm_parse_state_map(ftdm_channel_t *ftdmchan, ftdm_channel_state_t s
 	return ok;
 }
 
+FT_DECLARE(ftdm_status_t) ftdm_state_map_compile(const ftdm_state_map_t *map, ftdm_state_matrix_t *matrix)
+{
+	int direction, from, to;
+
+	ftdm_assert_return(map != NULL, FTDM_FAIL, "No state map to compile\n");
+
+	memset(matrix, 0, sizeof(*matrix));
+	/* walk the map for every possible transition, whatever the map walk decides is what the matrix says */
+	for (direction = ZSD_INBOUND; direction <= ZSD_OUTBOUND; direction++) {
+		for (from = 0; from < FTDM_CHANNEL_STATE_INVALID; from++) {
+			for (to = 0; to < FTDM_CHANNEL_STATE_INVALID; to++) {
+				if (ftdm_parse_state_map(map, direction, from, to)) {
+					matrix->allowed[direction][from] |= (1U << to);
+				}
+			}
+		}
+	}
+	matrix->map = map;
+	return FTDM_SUCCESS;
+}
+
+static __inline__ uint32_t ftdm_lowest_bit(uint32_t bits)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return index;
+#else
+	uint32_t index = 0;
+	while (!(bits & 1)) {
+		bits >>= 1;
+		index++;
+	}
+	return index;
+#endif
+}
+
+/* called with the channel locked, from any thread */
+static __inline__ void ftdm_span_mark_dirty(ftdm_span_t *span, uint32_t chan_id)
+{
+	ftdm_dirty_map_t *dirty = &span->dirty;
+	uint32_t word = chan_id / 32;
+
+	ftdm_atomic_or32(&dirty->words[word], 1U << (chan_id % 32));
+	ftdm_atomic_or32(&dirty->summary[word / 32], 1U << (word % 32));
+	/* only the first change since the last pass wakes up the signaling thread */
+	if (!ftdm_atomic_xchg32(&dirty->armed, 1) && dirty->interrupt) {
+		ftdm_interrupt_signal(dirty->interrupt);
+	}
+}
+
+/* take the dirty channels out of the map, advance them (chans is NULL) or store them in chans */
+static uint32_t ftdm_span_take_dirty(ftdm_span_t *span, ftdm_channel_t **chans)
+{
+	ftdm_dirty_map_t *dirty = &span->dirty;
+	uint32_t count = 0;
+	uint32_t s;
+
+	/* re-arm before reading the map, a channel marked from now on signals the interrupt again */
+	ftdm_atomic_xchg32(&dirty->armed, 0);
+
+	for (s = 0; s < ftdm_array_len(dirty->summary); s++) {
+		uint32_t summary;
+
+		if (!dirty->summary[s]) {
+			continue;
+		}
+		summary = ftdm_atomic_xchg32(&dirty->summary[s], 0);
+		while (summary) {
+			uint32_t word = (s * 32) + ftdm_lowest_bit(summary);
+			uint32_t bits = ftdm_atomic_xchg32(&dirty->words[word], 0);
+
+			summary &= summary - 1;
+			while (bits) {
+				uint32_t chan_id = (word * 32) + ftdm_lowest_bit(bits);
+				ftdm_channel_t *fchan;
+
+				bits &= bits - 1;
+				if (chan_id > span->chan_count || !(fchan = span->channels[chan_id])) {
+					continue;
+				}
+				if (chans) {
+					chans[count++] = fchan;
+					continue;
+				}
+				ftdm_channel_lock(fchan);
+				ftdm_channel_advance_states(fchan);
+				ftdm_channel_unlock(fchan);
+				count++;
+			}
+		}
+	}
+	return count;
+}
+
+FT_DECLARE(uint32_t) ftdm_span_advance_all_states(ftdm_span_t *span)
+{
+	return ftdm_span_take_dirty(span, NULL);
+}
+
+FT_DECLARE(uint32_t) ftdm_span_collect_dirty(ftdm_span_t *span, ftdm_channel_t **chans)
+{
+	ftdm_assert_return(chans != NULL, 0, "No channel array to collect the dirty channels\n");
+	return ftdm_span_take_dirty(span, chans);
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_span_get_dirty_interrupt(ftdm_span_t *span, ftdm_interrupt_t **interrupt)
+{
+	ftdm_assert_return(ftdm_test_flag(span, FTDM_SPAN_USE_DIRTY_MAP), FTDM_FAIL, "Span does not use the dirty channel map\n");
+	ftdm_assert_return(span->dirty.interrupt != NULL, FTDM_FAIL, "Span signaling not configured yet\n");
+	*interrupt = span->dirty.interrupt;
+	return FTDM_SUCCESS;
+}
+
+static __inline__ int ftdm_state_transition_ok(ftdm_span_t *span, ftdm_channel_t *ftdmchan, ftdm_channel_state_t state)
+{
+	ftdm_state_direction_t direction = ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) ? ZSD_OUTBOUND : ZSD_INBOUND;
+
+	if (span->state_matrix.map == span->state_map && (unsigned)ftdmchan->state < FTDM_CHANNEL_STATE_INVALID
+	    && (unsigned)state < FTDM_CHANNEL_STATE_INVALID) {
+		return (span->state_matrix.allowed[direction][ftdmchan->state] >> state) & 1;
+	}
+	/* the map was set after the span signaling was configured (or replaced), walk it */
+	return ftdm_parse_state_map(span->state_map, direction, ftdmchan->state, state);
+}
+
 FT_DECLARE(ftdm_status_t) ftdm_channel_cancel_state(const char *file, const char *func, int line, ftdm_channel_t *fchan)
 {
 	ftdm_time_t diff;
@@ -200,8 +428,8 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_cancel_state(const char *file, const char
 	}
 
 	/* compute the last history index */
-	hindex = (fchan->hindex == 0) ? (ftdm_array_len(fchan->history) - 1) : (fchan->hindex - 1);
-	diff = fchan->history[hindex].end_time - fchan->history[hindex].time;
+	hindex = (fchan->cold->hindex == 0) ? (ftdm_array_len(fchan->cold->history) - 1) : (fchan->cold->hindex - 1);
+	diff = fchan->cold->history[hindex].end_time - fchan->cold->history[hindex].time;
 
 	/* go back in time and revert the state to the previous state */
 	state = fchan->state;
@@ -209,8 +437,9 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_cancel_state(const char *file, const char
 
 	fchan->state = fchan->last_state;
 	fchan->state_status = FTDM_STATE_STATUS_COMPLETED;
-	fchan->last_state = fchan->history[hindex].last_state;
-	fchan->hindex = hindex;
+	fchan->last_state = fchan->cold->history[hindex].last_state;
+	fchan->cold->hindex = hindex;
+	ftdm_channel_record(fchan, FTDM_RECORDER_STATE_CANCEL, state, (uint16_t)fchan->state);
 
 	/* clear the state change flag */
 	ftdm_clear_flag(fchan, FTDM_CHANNEL_STATE_CHANGE);
@@ -251,6 +480,7 @@ static ftdm_status_t ftdm_core_set_state(const char *file, const char *func, int
 	ftdm_status_t status;
 	int ok = 1;
 	int waitms = DEFAULT_WAIT_TIME;	
+	ftdm_state_history_entry_t *history = NULL;
 
 	if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_READY)) {
 		ftdm_log_chan_ex(ftdmchan, file, func, line, FTDM_LOG_LEVEL_ERROR, "Ignored state change request from %s to %s, the channel is not ready\n",
@@ -285,7 +515,7 @@ static ftdm_status_t ftdm_core_set_state(const char *file, const char *func, int
 	}
 
 	if (ftdmchan->span->state_map) {
-		ok = ftdm_parse_state_map(ftdmchan, state, ftdmchan->span->state_map);
+		ok = ftdm_state_transition_ok(ftdmchan->span, ftdmchan, state);
 		goto end;
 	}
 
@@ -380,20 +610,26 @@ perform_state_change:
 	ftdmchan->last_state = ftdmchan->state; 
 	ftdmchan->state = state;
 	ftdmchan->state_status = FTDM_STATE_STATUS_NEW;
-	ftdmchan->history[ftdmchan->hindex].file = file;
-	ftdmchan->history[ftdmchan->hindex].func = func;
-	ftdmchan->history[ftdmchan->hindex].line = line;
-	ftdmchan->history[ftdmchan->hindex].state = ftdmchan->state;
-	ftdmchan->history[ftdmchan->hindex].last_state = ftdmchan->last_state;
-	ftdmchan->history[ftdmchan->hindex].time = ftdm_current_time_in_ms();
-	ftdmchan->history[ftdmchan->hindex].end_time = 0;
-	ftdmchan->hindex++;
-	if (ftdmchan->hindex == ftdm_array_len(ftdmchan->history)) {
-		ftdmchan->hindex = 0;
+	history = &ftdmchan->cold->history[ftdmchan->cold->hindex];
+	history->file = file;
+	history->func = func;
+	history->line = line;
+	history->state = ftdmchan->state;
+	history->last_state = ftdmchan->last_state;
+	history->time = ftdm_current_time_in_ms();
+	history->end_time = 0;
+	/* the state latency metric and the recorder share the same clock read */
+	ftdmchan->cold->metrics.state_start = ftdm_metrics_now();
+	ftdm_channel_record_at(ftdmchan, ftdmchan->cold->metrics.state_start, FTDM_RECORDER_STATE, state, (uint16_t)ftdmchan->last_state);
+	ftdmchan->cold->hindex++;
+	if (ftdmchan->cold->hindex == ftdm_array_len(ftdmchan->cold->history)) {
+		ftdmchan->cold->hindex = 0;
 	}
 	ftdm_set_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE);
 
-	if (ftdmchan->span->pendingchans) {
+	if (ftdm_test_flag(ftdmchan->span, FTDM_SPAN_USE_DIRTY_MAP)) {
+		ftdm_span_mark_dirty(ftdmchan->span, ftdmchan->chan_id);
+	} else if (ftdmchan->span->pendingchans) {
 		ftdm_queue_enqueue(ftdmchan->span->pendingchans, ftdmchan);
 	} else {
 		/* there is a potential deadlock here, if a signaling module is processing
@@ -403,12 +639,12 @@ perform_state_change:
 		 * to finish ... The only reason to acquire the span lock is this flag, new
 		 * signaling modules should use the pendingchans queue instead of this flag,
 		 * as of today a few modules need still to be updated before we can get rid of
-		 * this flag (ie, ftmod_libpri, ftmod_isdn, ftmod_analog) */
+		 * this flag (ie, ftmod_isdn, ftmod_analog) */
 		ftdm_set_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
 	}
 
-	if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_NONBLOCK)) {
-		/* the channel should not block waiting for state processing */
+	if (ftdm_test_flag(ftdmchan, (FTDM_CHANNEL_NONBLOCK | FTDM_CHANNEL_ASYNC))) {
+		/* the channel (or the request) should not block waiting for state processing */
 		goto done;
 	}
 
@@ -480,20 +716,20 @@ static void write_history_entry(const ftdm_channel_t *fchan, ftdm_stream_handle_
 	char line[255];
 	char states[255];
 	const char *filename = NULL;
-	snprintf(states, sizeof(states), "%-5.15s => %-5.15s", ftdm_channel_state2str(fchan->history[i].last_state), ftdm_channel_state2str(fchan->history[i].state));
-	snprintf(func, sizeof(func), "[%s]", fchan->history[i].func);
-	filename = strrchr(fchan->history[i].file, *FTDM_PATH_SEPARATOR);
+	snprintf(states, sizeof(states), "%-5.15s => %-5.15s", ftdm_channel_state2str(fchan->cold->history[i].last_state), ftdm_channel_state2str(fchan->cold->history[i].state));
+	snprintf(func, sizeof(func), "[%s]", fchan->cold->history[i].func);
+	filename = strrchr(fchan->cold->history[i].file, *FTDM_PATH_SEPARATOR);
 	if (!filename) {
-		filename = fchan->history[i].file;
+		filename = fchan->cold->history[i].file;
 	} else {
 		filename++;
 	}
 	if (!(*prevtime)) {
-		*prevtime = fchan->history[i].time;
+		*prevtime = fchan->cold->history[i].time;
 	}
-	snprintf(line, sizeof(func), "[%s:%d]", filename, fchan->history[i].line);
-	stream->write_function(stream, "%-30.30s %-30.30s %-30.30s %lums\n", states, func, line, (fchan->history[i].time - *prevtime));
-	*prevtime = fchan->history[i].time;
+	snprintf(line, sizeof(func), "[%s:%d]", filename, fchan->cold->history[i].line);
+	stream->write_function(stream, "%-30.30s %-30.30s %-30.30s %lums\n", states, func, line, (fchan->cold->history[i].time - *prevtime));
+	*prevtime = fchan->cold->history[i].time;
 }
 
 FT_DECLARE(char *) ftdm_channel_get_history_str(const ftdm_channel_t *fchan)
@@ -504,7 +740,7 @@ FT_DECLARE(char *) ftdm_channel_get_history_str(const ftdm_channel_t *fchan)
 
 	ftdm_stream_handle_t stream = { 0 };
 	FTDM_STANDARD_STREAM(stream);
-	if (!fchan->history[0].file) {
+	if (!fchan->cold->history[0].file) {
 		stream.write_function(&stream, "-- No state history --\n");
 		return stream.data;
 	}
@@ -512,14 +748,14 @@ FT_DECLARE(char *) ftdm_channel_get_history_str(const ftdm_channel_t *fchan)
 	stream.write_function(&stream, "%-30.30s %-30.30s %-30.30s %s", 
 			"-- States --", "-- Function --", "-- Location --", "-- Time Offset --\n");
 
-	for (i = fchan->hindex; i < ftdm_array_len(fchan->history); i++) {
-		if (!fchan->history[i].file) {
+	for (i = fchan->cold->hindex; i < ftdm_array_len(fchan->cold->history); i++) {
+		if (!fchan->cold->history[i].file) {
 			break;
 		}
 		write_history_entry(fchan, &stream, i, &prevtime);
 	}
 
-	for (i = 0; i < fchan->hindex; i++) {
+	for (i = 0; i < fchan->cold->hindex; i++) {
 		write_history_entry(fchan, &stream, i, &prevtime);
 	}
 
@@ -535,7 +771,10 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_advance_states(ftdm_channel_t *fchan)
 	ftdm_channel_state_t state;
 
 	ftdm_assert_return(fchan->span->state_processor, FTDM_FAIL, "Cannot process states without a state processor!\n");
-	
+
+	/* a state completed outside of the state processor may have an indication to continue */
+	ftdm_channel_advance_indication(fchan);
+
 	while (fchan->state_status == FTDM_STATE_STATUS_NEW) {
 		state = fchan->state;
 		ftdm_log_chan(fchan, FTDM_LOG_DEBUG, "Executing state processor for %s\n", ftdm_channel_state2str(fchan->state));
@@ -547,6 +786,8 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_advance_states(ftdm_channel_t *fchan)
 			 * call to ftdm_set_state() */
 			fchan->state_status = FTDM_STATE_STATUS_PROCESSED;
 		}		
+		/* only now the processor is done with the state, a non-blocking answer can move on */
+		ftdm_channel_advance_indication(fchan);
 	}
 
 	return FTDM_SUCCESS;
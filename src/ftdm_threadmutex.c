@@ -379,6 +379,24 @@ failed:
 
 #define ONE_BILLION 1000000000
 
+#ifndef WIN32
+/* the device flags are FreeTDM wait flags, poll() wants its own event bits */
+static __inline__ short ftdm_wait_flags2poll(ftdm_wait_flag_t flags)
+{
+	short events = 0;
+	if (flags & FTDM_READ) {
+		events |= POLLIN;
+	}
+	if (flags & FTDM_WRITE) {
+		events |= POLLOUT;
+	}
+	if (flags & FTDM_EVENTS) {
+		events |= POLLPRI;
+	}
+	return events;
+}
+#endif
+
 FT_DECLARE(ftdm_status_t) ftdm_interrupt_wait(ftdm_interrupt_t *interrupt, int ms)
 {
 	int num = 1;
@@ -425,7 +443,7 @@ pollagain:
 	if (interrupt->device != FTDM_INVALID_SOCKET) {
 		num++;
 		ints[1].fd = interrupt->device;
-		ints[1].events = interrupt->device_input_flags;
+		ints[1].events = ftdm_wait_flags2poll(interrupt->device_input_flags);
 		ints[1].revents = 0;
 	}
 
@@ -565,7 +583,7 @@ pollagain:
 		ints[i].fd = interrupts[i]->readfd;
 		interrupts[i]->device_output_flags = FTDM_NO_FLAGS;
 		if (interrupts[i]->device != FTDM_INVALID_SOCKET) {
-			ints[size+numdevices].events = interrupts[i]->device_input_flags;
+			ints[size+numdevices].events = ftdm_wait_flags2poll(interrupts[i]->device_input_flags);
 			ints[size+numdevices].revents = 0;
 			ints[size+numdevices].fd = interrupts[i]->device;
 			numdevices++;
@@ -623,6 +641,106 @@ FT_DECLARE(ftdm_wait_flag_t) ftdm_interrupt_device_ready(ftdm_interrupt_t *inter
 	return interrupt->device_output_flags;
 }
 
+FT_DECLARE(uint32_t) ftdm_atomic_inc32(volatile uint32_t *value)
+{
+#ifdef WIN32
+	return (uint32_t)InterlockedIncrement((volatile LONG *)value);
+#else
+	return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+FT_DECLARE(uint32_t) ftdm_atomic_dec32(volatile uint32_t *value)
+{
+#ifdef WIN32
+	return (uint32_t)InterlockedDecrement((volatile LONG *)value);
+#else
+	return __sync_sub_and_fetch(value, 1);
+#endif
+}
+
+FT_DECLARE(ftdm_bool_t) ftdm_atomic_cas_ptr(void * volatile *ptr, void *oldval, void *newval)
+{
+#ifdef WIN32
+	return InterlockedCompareExchangePointer(ptr, newval, oldval) == oldval ? FTDM_TRUE : FTDM_FALSE;
+#else
+	return __sync_bool_compare_and_swap(ptr, oldval, newval) ? FTDM_TRUE : FTDM_FALSE;
+#endif
+}
+
+FT_DECLARE(void *) ftdm_atomic_get_ptr(void * volatile *ptr)
+{
+	void *val = *ptr;
+#ifdef WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+	return val;
+}
+
+FT_DECLARE(uint32_t) ftdm_atomic_get32(volatile uint32_t *value)
+{
+#if defined(__ATOMIC_ACQUIRE)
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+	uint32_t val = *value;
+#ifdef WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+	return val;
+#endif
+}
+
+FT_DECLARE(void) ftdm_atomic_set32(volatile uint32_t *value, uint32_t newval)
+{
+#if defined(__ATOMIC_RELEASE)
+	__atomic_store_n(value, newval, __ATOMIC_RELEASE);
+#else
+#ifdef WIN32
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+	*value = newval;
+#endif
+}
+
+FT_DECLARE(uint32_t) ftdm_atomic_or32(volatile uint32_t *value, uint32_t bits)
+{
+#ifdef WIN32
+	return (uint32_t)InterlockedOr((volatile LONG *)value, (LONG)bits);
+#else
+	return __sync_fetch_and_or(value, bits);
+#endif
+}
+
+FT_DECLARE(uint32_t) ftdm_atomic_xchg32(volatile uint32_t *value, uint32_t newval)
+{
+#ifdef WIN32
+	return (uint32_t)InterlockedExchange((volatile LONG *)value, (LONG)newval);
+#elif defined(__ATOMIC_SEQ_CST)
+	return __atomic_exchange_n(value, newval, __ATOMIC_SEQ_CST);
+#else
+	/* __sync_lock_test_and_set is only an acquire barrier */
+	__sync_synchronize();
+	return __sync_lock_test_and_set(value, newval);
+#endif
+}
+
+FT_DECLARE(void) ftdm_atomic_fence(void)
+{
+#ifdef WIN32
+	MemoryBarrier();
+#elif defined(__ATOMIC_SEQ_CST)
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+	__sync_synchronize();
+#endif
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "private/ftdm_core.h"
+
+/* number of hash buckets, the cache holds a few entries per configured tone map / dtmf setting */
+#define FTDM_TONE_CACHE_BUCKETS 64
+
+typedef enum {
+	FTDM_TONE_CACHE_DTMF,
+	FTDM_TONE_CACHE_TONE
+} ftdm_tone_cache_type_t;
+
+typedef struct ftdm_tone_cache_entry {
+	/* key */
+	ftdm_tone_cache_type_t type;
+	char digit;
+	char *tone;
+	uint32_t rate;
+	int volume;
+	uint32_t on_ms;
+	uint32_t off_ms;
+	ftdm_codec_t codec;
+	/* value */
+	ftdm_tone_segment_t segment;
+	struct ftdm_tone_cache_entry *next;
+} ftdm_tone_cache_entry_t;
+
+/*
+ * Entries are immutable once published. Readers walk the buckets without locking,
+ * the mutex only serializes writers rendering and publishing new entries at the
+ * head of a bucket. Entries are released on global destroy only.
+ */
+static struct {
+	ftdm_mutex_t *mutex;
+	ftdm_tone_cache_entry_t * volatile buckets[FTDM_TONE_CACHE_BUCKETS];
+	uint32_t entries;
+	uint64_t bytes;
+	ftdm_metric_t hits;		/*!< sharded counter, updated by lock-free readers */
+	uint64_t misses;
+} tone_cache;
+
+static __inline__ uint32_t tone_cache_bytes_per_sample(ftdm_codec_t codec)
+{
+	return codec == FTDM_CODEC_SLIN ? 2 : 1;
+}
+
+static __inline__ ftdm_bool_t tone_cache_valid_codec(ftdm_codec_t codec)
+{
+	return (codec == FTDM_CODEC_SLIN || codec == FTDM_CODEC_ULAW || codec == FTDM_CODEC_ALAW) ? FTDM_TRUE : FTDM_FALSE;
+}
+
+static uint32_t tone_cache_hash(ftdm_tone_cache_type_t type, char digit, const char *tone, uint32_t rate, ftdm_codec_t codec)
+{
+	uint32_t hash = 5381;
+
+	if (type == FTDM_TONE_CACHE_DTMF) {
+		hash = ((hash << 5) + hash) + (uint8_t)digit;
+	} else {
+		for (; *tone; tone++) {
+			hash = ((hash << 5) + hash) + (uint8_t)*tone;
+		}
+	}
+	hash = ((hash << 5) + hash) + rate;
+	hash = ((hash << 5) + hash) + codec;
+	return hash % FTDM_TONE_CACHE_BUCKETS;
+}
+
+FT_DECLARE(ftdm_size_t) ftdm_tone_cache_encode(ftdm_codec_t codec, const int16_t *in, uint32_t samples, uint8_t *out)
+{
+	uint32_t i;
+
+	switch (codec) {
+	case FTDM_CODEC_ULAW:
+		for (i = 0; i < samples; i++) {
+			out[i] = linear_to_ulaw(in[i]);
+		}
+		return samples;
+	case FTDM_CODEC_ALAW:
+		for (i = 0; i < samples; i++) {
+			out[i] = linear_to_alaw(in[i]);
+		}
+		return samples;
+	default:
+		memcpy(out, in, samples * sizeof(int16_t));
+		return samples * sizeof(int16_t);
+	}
+}
+
+static int tone_cache_handler(teletone_generation_session_t *ts, teletone_tone_map_t *map)
+{
+	ftdm_buffer_t *buffer = ts->user_data;
+	int wrote;
+
+	if (!buffer) {
+		return -1;
+	}
+
+	wrote = teletone_mux_tones(ts, map);
+	ftdm_buffer_write(buffer, ts->buffer, wrote * 2);
+	return 0;
+}
+
+/* set the segment data from linear samples */
+static ftdm_status_t tone_cache_set_segment(ftdm_tone_cache_entry_t *entry, const int16_t *sln, uint32_t samples)
+{
+	uint8_t *data = NULL;
+
+	if (!samples) {
+		return FTDM_FAIL;
+	}
+
+	data = ftdm_malloc(samples * tone_cache_bytes_per_sample(entry->codec));
+	if (!data) {
+		return FTDM_MEMERR;
+	}
+
+	entry->segment.len = ftdm_tone_cache_encode(entry->codec, sln, samples, data);
+	entry->segment.samples = samples;
+	entry->segment.codec = entry->codec;
+	entry->segment.data = data;
+	return FTDM_SUCCESS;
+}
+
+static ftdm_status_t tone_cache_render(ftdm_tone_cache_entry_t *entry)
+{
+	teletone_generation_session_t ts;
+	ftdm_status_t status = FTDM_FAIL;
+
+	memset(&ts, 0, sizeof(ts));
+
+	if (entry->type == FTDM_TONE_CACHE_DTMF) {
+		int wrote;
+
+		teletone_init_session(&ts, 0, NULL, NULL);
+		ts.rate = entry->rate;
+		ts.duration = entry->on_ms * (ts.rate / 1000);
+		ts.wait = entry->off_ms * (ts.rate / 1000);
+		ts.volume = entry->volume;
+
+		if ((wrote = teletone_mux_tones(&ts, &ts.TONES[(int)entry->digit])) > 0) {
+			status = tone_cache_set_segment(entry, ts.buffer, wrote);
+		}
+	} else {
+		ftdm_buffer_t *buffer = NULL;
+		ftdm_size_t len;
+		int16_t *sln = NULL;
+
+		if (ftdm_buffer_create(&buffer, 1024, 1024, 0) != FTDM_SUCCESS) {
+			return FTDM_MEMERR;
+		}
+
+		teletone_init_session(&ts, 0, tone_cache_handler, buffer);
+		ts.rate = entry->rate;
+		ts.duration = ts.rate;
+
+		teletone_run(&ts, entry->tone);
+
+		if ((len = ftdm_buffer_inuse(buffer)) && (sln = ftdm_malloc(len))) {
+			ftdm_buffer_read(buffer, sln, len);
+			status = tone_cache_set_segment(entry, sln, (uint32_t)(len / 2));
+			ftdm_safe_free(sln);
+		}
+		ftdm_buffer_destroy(&buffer);
+	}
+
+	if (ts.buffer) {
+		teletone_destroy_session(&ts);
+	}
+	return status;
+}
+
+static ftdm_tone_cache_entry_t *tone_cache_find(ftdm_tone_cache_entry_t *head, const ftdm_tone_cache_entry_t *key)
+{
+	ftdm_tone_cache_entry_t *entry = NULL;
+
+	for (entry = head; entry; entry = entry->next) {
+		if (entry->type != key->type || entry->rate != key->rate || entry->codec != key->codec) {
+			continue;
+		}
+		if (entry->type == FTDM_TONE_CACHE_DTMF) {
+			if (entry->digit == key->digit && entry->volume == key->volume &&
+			    entry->on_ms == key->on_ms && entry->off_ms == key->off_ms) {
+				return entry;
+			}
+		} else if (!strcmp(entry->tone, key->tone)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static const ftdm_tone_segment_t *tone_cache_get(ftdm_tone_cache_entry_t *key)
+{
+	ftdm_tone_cache_entry_t *entry = NULL;
+	ftdm_tone_cache_entry_t *head = NULL;
+	uint32_t hash = tone_cache_hash(key->type, key->digit, key->tone, key->rate, key->codec);
+
+	ftdm_assert_return(tone_cache.mutex != NULL, NULL, "tone cache not initialized\n");
+
+	/* fast path, no lock: published entries and their next pointers never change */
+	head = ftdm_atomic_get_ptr((void * volatile *)&tone_cache.buckets[hash]);
+	if ((entry = tone_cache_find(head, key))) {
+		ftdm_metric_add(&tone_cache.hits, 1);
+		return &entry->segment;
+	}
+
+	ftdm_mutex_lock(tone_cache.mutex);
+
+	/* another writer may have published it meanwhile */
+	head = tone_cache.buckets[hash];
+	if ((entry = tone_cache_find(head, key))) {
+		ftdm_metric_add(&tone_cache.hits, 1);
+		goto done;
+	}
+
+	tone_cache.misses++;
+
+	entry = ftdm_calloc(1, sizeof(*entry));
+	if (!entry) {
+		goto done;
+	}
+	*entry = *key;
+	entry->tone = NULL;
+	if (key->tone && !(entry->tone = ftdm_strdup(key->tone))) {
+		ftdm_safe_free(entry);
+		goto done;
+	}
+
+	if (tone_cache_render(entry) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to render tone %s%c\n", entry->tone ? entry->tone : "dtmf ", entry->tone ? ' ' : entry->digit);
+		ftdm_safe_free(entry->tone);
+		ftdm_safe_free(entry);
+		goto done;
+	}
+
+	/* publish, the entry is complete before readers can reach it (writers are serialized, this cannot fail) */
+	entry->next = head;
+	ftdm_atomic_cas_ptr((void * volatile *)&tone_cache.buckets[hash], head, entry);
+	tone_cache.entries++;
+	tone_cache.bytes += entry->segment.len;
+
+done:
+	ftdm_mutex_unlock(tone_cache.mutex);
+
+	return entry ? &entry->segment : NULL;
+}
+
+FT_DECLARE(const ftdm_tone_segment_t *) ftdm_tone_cache_get_dtmf(char digit, uint32_t rate, int volume, uint32_t on_ms, uint32_t off_ms, ftdm_codec_t codec)
+{
+	ftdm_tone_cache_entry_t key;
+
+	if (!rate || !on_ms || !tone_cache_valid_codec(codec) || !digit || !strchr("0123456789*#ABCD", digit)) {
+		return NULL;
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.type = FTDM_TONE_CACHE_DTMF;
+	key.digit = digit;
+	key.rate = rate;
+	key.volume = volume;
+	key.on_ms = on_ms;
+	key.off_ms = off_ms;
+	key.codec = codec;
+	return tone_cache_get(&key);
+}
+
+FT_DECLARE(const ftdm_tone_segment_t *) ftdm_tone_cache_get_tone(const char *tone, uint32_t rate, ftdm_codec_t codec)
+{
+	ftdm_tone_cache_entry_t key;
+
+	if (ftdm_strlen_zero(tone) || !rate || !tone_cache_valid_codec(codec)) {
+		return NULL;
+	}
+
+	memset(&key, 0, sizeof(key));
+	key.type = FTDM_TONE_CACHE_TONE;
+	key.tone = (char *)tone;
+	key.rate = rate;
+	key.codec = codec;
+	return tone_cache_get(&key);
+}
+
+FT_DECLARE(void) ftdm_tone_cache_print_stats(ftdm_stream_handle_t *stream)
+{
+	ftdm_mutex_lock(tone_cache.mutex);
+	stream->write_function(stream, "Tone cache entries: %u\n", tone_cache.entries);
+	stream->write_function(stream, "Tone cache memory: %"FTDM_UINT64_FMT" bytes\n", tone_cache.bytes);
+	stream->write_function(stream, "Tone cache hits: %"FTDM_UINT64_FMT"\n", ftdm_metric_value(&tone_cache.hits));
+	stream->write_function(stream, "Tone cache misses: %"FTDM_UINT64_FMT"\n", tone_cache.misses);
+	ftdm_mutex_unlock(tone_cache.mutex);
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_cache_global_init(void)
+{
+	memset(&tone_cache, 0, sizeof(tone_cache));
+
+	if (ftdm_mutex_create(&tone_cache.mutex) != FTDM_SUCCESS) {
+		return FTDM_FAIL;
+	}
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_cache_global_destroy(void)
+{
+	uint32_t i;
+
+	if (!tone_cache.mutex) {
+		return FTDM_SUCCESS;
+	}
+
+	for (i = 0; i < FTDM_TONE_CACHE_BUCKETS; i++) {
+		while (tone_cache.buckets[i]) {
+			ftdm_tone_cache_entry_t *entry = tone_cache.buckets[i];
+			tone_cache.buckets[i] = entry->next;
+			ftdm_free((void *)entry->segment.data);
+			ftdm_safe_free(entry->tone);
+			ftdm_safe_free(entry);
+		}
+	}
+
+	ftdm_mutex_destroy(&tone_cache.mutex);
+	memset(&tone_cache, 0, sizeof(tone_cache));
+	return FTDM_SUCCESS;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "private/ftdm_core.h"
+
+#ifndef __WINDOWS__
+#include <unistd.h>
+#endif
+
+/* max. number of frames processed per channel on each tick (catch up after scheduling delays) */
+#define FTDM_TONE_SERVICE_MAX_FRAMES 4
+
+/* sampling rate of the generated tones */
+#define FTDM_TONE_SERVICE_RATE 8000
+
+struct ftdm_tone_service_entry {
+	ftdm_channel_t *ftdmchan;
+	ftdm_tone_service_cb_t callback;
+	void *data;
+	ftdm_tonemap_t tone;		/*!< tone currently played */
+	const ftdm_tone_segment_t *segment;	/*!< pre-rendered tone (shared, owned by the tone cache) */
+	ftdm_size_t offset;		/*!< play offset in the segment (bytes) */
+	uint8_t detached;		/*!< detached, to be released by the worker */
+	struct ftdm_tone_service_entry *next;
+};
+
+/*
+ * The entry list is only touched by the worker thread itself, attach / detach
+ * requests go through the pending list and the detached flag. The worker mutex
+ * is never held while calling callbacks or doing channel I/O, this way attach and
+ * detach never block and can be called with the channel lock held.
+ */
+typedef struct ftdm_tone_worker {
+	uint32_t id;
+	ftdm_mutex_t *mutex;
+	ftdm_tone_service_entry_t *entries;	/*!< entries served by the worker */
+	ftdm_tone_service_entry_t *pending;	/*!< newly attached entries */
+	uint32_t count;
+	uint8_t running;
+} ftdm_tone_worker_t;
+
+static struct {
+	ftdm_mutex_t *mutex;
+	ftdm_tone_worker_t workers[FTDM_TONE_SERVICE_MAX_WORKERS];
+	uint32_t num_workers;
+	uint8_t running;
+} tone_globals;
+
+static uint32_t tone_service_cpu_count(void)
+{
+	long count = 1;
+#ifdef __WINDOWS__
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1) {
+		count = 1;
+	}
+	return (uint32_t)ftdm_min(count, FTDM_TONE_SERVICE_MAX_WORKERS);
+}
+
+static void tone_service_free_entry(ftdm_tone_service_entry_t **entry)
+{
+	ftdm_safe_free(*entry);
+	*entry = NULL;
+}
+
+/* move new entries to the worker list and release detached ones */
+static void tone_worker_update(ftdm_tone_worker_t *worker)
+{
+	ftdm_tone_service_entry_t **cur;
+
+	ftdm_mutex_lock(worker->mutex);
+
+	while (worker->pending) {
+		ftdm_tone_service_entry_t *entry = worker->pending;
+		worker->pending = entry->next;
+		entry->next = worker->entries;
+		worker->entries = entry;
+	}
+
+	for (cur = &worker->entries; *cur; ) {
+		ftdm_tone_service_entry_t *entry = *cur;
+
+		if (entry->detached) {
+			*cur = entry->next;
+			worker->count--;
+			tone_service_free_entry(&entry);
+		} else {
+			cur = &entry->next;
+		}
+	}
+
+	ftdm_mutex_unlock(worker->mutex);
+}
+
+/* mark the entry detached, must be called with the worker lock held */
+static void tone_worker_detach_entry(ftdm_tone_service_entry_t *entry)
+{
+	entry->detached = 1;
+	if (entry->ftdmchan->tone_entry == entry) {
+		entry->ftdmchan->tone_entry = NULL;
+	}
+}
+
+/* select the tone to play, tones are pre-rendered by the tone cache in the codec of the channel */
+static void tone_service_set_tone(ftdm_tone_service_entry_t *entry, ftdm_tonemap_t tone)
+{
+	ftdm_channel_t *ftdmchan = entry->ftdmchan;
+
+	entry->tone = tone;
+	entry->segment = NULL;
+	entry->offset = 0;
+
+	if (tone == FTDM_TONEMAP_NONE) {
+		return;
+	}
+
+	entry->segment = ftdm_tone_cache_get_tone(ftdmchan->span->tone_map[tone], FTDM_TONE_SERVICE_RATE, ftdmchan->effective_codec);
+	if (!entry->segment) {
+		ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "Failed to get tone %d for codec %d\n", tone, ftdmchan->effective_codec);
+	}
+}
+
+/* read the media available on the channel and write the same amount of tone */
+static void tone_service_process_media(ftdm_tone_service_entry_t *entry)
+{
+	ftdm_channel_t *ftdmchan = entry->ftdmchan;
+	const ftdm_tone_segment_t *segment = entry->segment;
+	unsigned char frame[1024];
+	int i;
+
+	for (i = 0; i < FTDM_TONE_SERVICE_MAX_FRAMES; i++) {
+		ftdm_wait_flag_t flags = FTDM_READ;
+		ftdm_size_t len = sizeof(frame);
+		ftdm_size_t wlen = 0;
+
+		if (ftdm_channel_wait(ftdmchan, &flags, 0) != FTDM_SUCCESS || !(flags & FTDM_READ)) {
+			break;
+		}
+
+		if (ftdm_channel_read(ftdmchan, frame, &len) != FTDM_SUCCESS || len <= 0) {
+			break;
+		}
+
+		if (!segment) {
+			continue;
+		}
+
+		/* the segment is in the effective codec of the channel, write as much as we read */
+		len = ftdm_min(len, sizeof(frame));
+		while (wlen < len) {
+			ftdm_size_t chunk = ftdm_min(len - wlen, segment->len - entry->offset);
+
+			memcpy(frame + wlen, segment->data + entry->offset, chunk);
+			wlen += chunk;
+			entry->offset = (entry->offset + chunk) % segment->len;
+		}
+
+		if (ftdm_channel_write(ftdmchan, frame, sizeof(frame), &wlen) != FTDM_SUCCESS) {
+			break;
+		}
+	}
+}
+
+static void *tone_worker_run(ftdm_thread_t *me, void *obj)
+{
+	ftdm_tone_worker_t *worker = obj;
+	ftdm_time_t next;
+
+	ftdm_log(FTDM_LOG_DEBUG, "Tone service worker %d started\n", worker->id);
+
+	next = ftdm_current_time_in_ms() + FTDM_TONE_SERVICE_INTERVAL;
+
+	while (ftdm_running() && tone_globals.running) {
+		ftdm_tone_service_entry_t *entry = NULL;
+		ftdm_time_t now;
+
+		tone_worker_update(worker);
+
+		for (entry = worker->entries; entry; entry = entry->next) {
+			ftdm_channel_t *ftdmchan = entry->ftdmchan;
+			ftdm_tonemap_t tone = entry->tone;
+			uint8_t detached;
+
+			/*
+			 * Owners detach and close the channel with the channel lock held, checking the
+			 * detached flag and doing the I/O under the same lock keeps us away from a channel
+			 * being closed. Lock order is always channel then worker.
+			 */
+			ftdm_channel_lock(ftdmchan);
+
+			ftdm_mutex_lock(worker->mutex);
+			detached = entry->detached;
+			ftdm_mutex_unlock(worker->mutex);
+
+			if (detached) {
+				ftdm_channel_unlock(ftdmchan);
+				continue;
+			}
+
+			if (entry->callback(ftdmchan, &tone, entry->data) == FTDM_BREAK) {
+				ftdm_mutex_lock(worker->mutex);
+				tone_worker_detach_entry(entry);
+				ftdm_mutex_unlock(worker->mutex);
+				ftdm_channel_unlock(ftdmchan);
+				continue;
+			}
+
+			if (tone != entry->tone || (entry->segment && entry->segment->codec != ftdmchan->effective_codec)) {
+				tone_service_set_tone(entry, tone);
+			}
+
+			if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OPEN)) {
+				tone_service_process_media(entry);
+			}
+
+			ftdm_channel_unlock(ftdmchan);
+		}
+
+		/* all workers run on the same media clock */
+		now = ftdm_current_time_in_ms();
+		if (next > now) {
+			ftdm_sleep((uint32_t)(next - now));
+		} else if (now - next > FTDM_TONE_SERVICE_INTERVAL * FTDM_TONE_SERVICE_MAX_FRAMES) {
+			/* we are too late, resync the clock */
+			next = now;
+		}
+		next += FTDM_TONE_SERVICE_INTERVAL;
+	}
+
+	ftdm_log(FTDM_LOG_DEBUG, "Tone service worker %d stopped\n", worker->id);
+	worker->running = 0;
+	return NULL;
+}
+
+/* must be called with the global lock held */
+static ftdm_status_t tone_service_start(void)
+{
+	uint32_t i;
+
+	tone_globals.num_workers = tone_service_cpu_count();
+	tone_globals.running = 1;
+
+	ftdm_log(FTDM_LOG_NOTICE, "Starting tone service with %d workers\n", tone_globals.num_workers);
+
+	for (i = 0; i < tone_globals.num_workers; i++) {
+		ftdm_tone_worker_t *worker = &tone_globals.workers[i];
+
+		worker->id = i;
+		worker->running = 1;
+		if (ftdm_thread_create_detached(tone_worker_run, worker) != FTDM_SUCCESS) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to launch tone service worker %d\n", i);
+			worker->running = 0;
+			break;
+		}
+	}
+
+	if (!i) {
+		tone_globals.running = 0;
+		return FTDM_FAIL;
+	}
+	tone_globals.num_workers = i;
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_global_init(void)
+{
+	uint32_t i;
+
+	memset(&tone_globals, 0, sizeof(tone_globals));
+
+	if (ftdm_mutex_create(&tone_globals.mutex) != FTDM_SUCCESS) {
+		return FTDM_FAIL;
+	}
+	for (i = 0; i < FTDM_TONE_SERVICE_MAX_WORKERS; i++) {
+		if (ftdm_mutex_create(&tone_globals.workers[i].mutex) != FTDM_SUCCESS) {
+			return FTDM_FAIL;
+		}
+	}
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_global_destroy(void)
+{
+	uint32_t i;
+
+	if (!tone_globals.mutex) {
+		return FTDM_SUCCESS;
+	}
+
+	ftdm_mutex_lock(tone_globals.mutex);
+
+	tone_globals.running = 0;
+	for (i = 0; i < tone_globals.num_workers; i++) {
+		ftdm_tone_worker_t *worker = &tone_globals.workers[i];
+
+		while (worker->running) {
+			ftdm_sleep(10);
+		}
+
+		/* detach channels whose owners did not do it themselves */
+		ftdm_mutex_lock(worker->mutex);
+		while (worker->pending) {
+			ftdm_tone_service_entry_t *entry = worker->pending;
+			worker->pending = entry->next;
+			entry->next = worker->entries;
+			worker->entries = entry;
+		}
+		while (worker->entries) {
+			ftdm_tone_service_entry_t *entry = worker->entries;
+			worker->entries = entry->next;
+			tone_worker_detach_entry(entry);
+			tone_service_free_entry(&entry);
+		}
+		worker->count = 0;
+		ftdm_mutex_unlock(worker->mutex);
+	}
+
+	ftdm_mutex_unlock(tone_globals.mutex);
+
+	for (i = 0; i < FTDM_TONE_SERVICE_MAX_WORKERS; i++) {
+		ftdm_mutex_destroy(&tone_globals.workers[i].mutex);
+	}
+	ftdm_mutex_destroy(&tone_globals.mutex);
+
+	memset(&tone_globals, 0, sizeof(tone_globals));
+	return FTDM_SUCCESS;
+}
+
+/* channels are spread over the workers, a channel always uses the same worker */
+static __inline__ ftdm_tone_worker_t *tone_service_get_worker(const ftdm_channel_t *ftdmchan)
+{
+	uint32_t index = (ftdmchan->span_id * FTDM_MAX_CHANNELS_SPAN) + ftdmchan->chan_id;
+	return &tone_globals.workers[index % tone_globals.num_workers];
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_attach(ftdm_channel_t *ftdmchan, ftdm_tone_service_cb_t callback, void *data)
+{
+	ftdm_tone_service_entry_t *entry = NULL;
+	ftdm_tone_worker_t *worker = NULL;
+
+	ftdm_assert_return(ftdmchan != NULL, FTDM_EINVAL, "invalid channel\n");
+	ftdm_assert_return(callback != NULL, FTDM_EINVAL, "invalid callback\n");
+
+	ftdm_mutex_lock(tone_globals.mutex);
+	if (!tone_globals.running && tone_service_start() != FTDM_SUCCESS) {
+		ftdm_mutex_unlock(tone_globals.mutex);
+		return FTDM_FAIL;
+	}
+	ftdm_mutex_unlock(tone_globals.mutex);
+
+	worker = tone_service_get_worker(ftdmchan);
+
+	ftdm_mutex_lock(worker->mutex);
+
+	if (ftdmchan->tone_entry) {
+		ftdm_mutex_unlock(worker->mutex);
+		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "Channel is already attached to the tone service\n");
+		return FTDM_FAIL;
+	}
+
+	entry = ftdm_calloc(1, sizeof(*entry));
+	if (!entry) {
+		ftdm_mutex_unlock(worker->mutex);
+		return FTDM_MEMERR;
+	}
+	entry->ftdmchan = ftdmchan;
+	entry->callback = callback;
+	entry->data = data;
+	entry->tone = FTDM_TONEMAP_NONE;
+	entry->next = worker->pending;
+	worker->pending = entry;
+	worker->count++;
+	ftdmchan->tone_entry = entry;
+
+	ftdm_mutex_unlock(worker->mutex);
+
+	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Attached to tone service worker %d\n", worker->id);
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_detach(ftdm_channel_t *ftdmchan)
+{
+	ftdm_tone_worker_t *worker = NULL;
+
+	ftdm_assert_return(ftdmchan != NULL, FTDM_EINVAL, "invalid channel\n");
+
+	if (!tone_globals.num_workers) {
+		return FTDM_SUCCESS;
+	}
+
+	worker = tone_service_get_worker(ftdmchan);
+
+	ftdm_mutex_lock(worker->mutex);
+	if (ftdmchan->tone_entry) {
+		tone_worker_detach_entry(ftdmchan->tone_entry);
+	}
+	ftdm_mutex_unlock(worker->mutex);
+
+	return FTDM_SUCCESS;
+}
+
+FT_DECLARE(ftdm_bool_t) ftdm_tone_service_attached(const ftdm_channel_t *ftdmchan)
+{
+	return ftdmchan->tone_entry ? FTDM_TRUE : FTDM_FALSE;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
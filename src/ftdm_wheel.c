@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "private/ftdm_core.h"
+
+FT_DECLARE(void) ftdm_wheel_init(ftdm_wheel_t *wheel, ftdm_time_t now)
+{
+	memset(wheel, 0, sizeof(*wheel));
+	wheel->current = now - (now % FTDM_WHEEL_MS);
+}
+
+FT_DECLARE(void) ftdm_wheel_add(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer, ftdm_time_t due)
+{
+	ftdm_wheel_timer_t **slot;
+
+	/* round up to the slot resolution, timers already due expire with the next slot */
+	due = ((due + FTDM_WHEEL_MS - 1) / FTDM_WHEEL_MS) * FTDM_WHEEL_MS;
+	if (due < wheel->current) {
+		due = wheel->current;
+	}
+
+	slot = &wheel->slots[(due / FTDM_WHEEL_MS) % FTDM_WHEEL_SLOTS];
+	timer->due = due;
+	timer->scheduled = 1;
+	timer->next = *slot;
+	*slot = timer;
+}
+
+FT_DECLARE(ftdm_bool_t) ftdm_wheel_cancel(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer)
+{
+	ftdm_wheel_timer_t **cur;
+
+	if (!timer->scheduled) {
+		return FTDM_FALSE;
+	}
+
+	for (cur = &wheel->slots[(timer->due / FTDM_WHEEL_MS) % FTDM_WHEEL_SLOTS]; *cur; cur = &(*cur)->next) {
+		if (*cur == timer) {
+			*cur = timer->next;
+			timer->scheduled = 0;
+			timer->next = NULL;
+			return FTDM_TRUE;
+		}
+	}
+	return FTDM_FALSE;
+}
+
+FT_DECLARE(ftdm_wheel_timer_t *) ftdm_wheel_expire(ftdm_wheel_t *wheel, ftdm_time_t now)
+{
+	ftdm_wheel_timer_t *expired = NULL;
+	uint32_t turns = 0;
+
+	while (wheel->current <= now) {
+		ftdm_wheel_timer_t **cur = &wheel->slots[(wheel->current / FTDM_WHEEL_MS) % FTDM_WHEEL_SLOTS];
+
+		while (*cur) {
+			ftdm_wheel_timer_t *timer = *cur;
+
+			/* timers due on a later turn of the wheel stay in the slot */
+			if (timer->due <= now) {
+				*cur = timer->next;
+				timer->scheduled = 0;
+				timer->next = expired;
+				expired = timer;
+			} else {
+				cur = &timer->next;
+			}
+		}
+
+		wheel->current += FTDM_WHEEL_MS;
+		if (++turns == FTDM_WHEEL_SLOTS) {
+			/* we slept more than a whole turn, every slot has been visited */
+			wheel->current = now - (now % FTDM_WHEEL_MS) + FTDM_WHEEL_MS;
+			break;
+		}
+	}
+	return expired;
+}
+
+FT_DECLARE(ftdm_wheel_timer_t *) ftdm_wheel_flush(ftdm_wheel_t *wheel)
+{
+	ftdm_wheel_timer_t *flushed = NULL;
+	ftdm_wheel_timer_t *timer, *next;
+	uint32_t i;
+
+	for (i = 0; i < FTDM_WHEEL_SLOTS; i++) {
+		for (timer = wheel->slots[i]; timer; timer = next) {
+			next = timer->next;
+			timer->scheduled = 0;
+			timer->next = flushed;
+			flushed = timer;
+		}
+		wheel->slots[i] = NULL;
+	}
+	return flushed;
+}
+
+FT_DECLARE(ftdm_wheel_action_t) ftdm_wheel_service(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer, ftdm_channel_t *ftdmchan,
+		uint32_t interval, const ftdm_wheel_ops_t *ops, ftdm_time_t now)
+{
+	ftdm_wheel_action_t action = FTDM_WHEEL_AGAIN;
+	uint32_t elapsed = (uint32_t)(now - timer->last);
+	uint32_t frames = 0;
+	ftdm_time_t due;
+	int i;
+
+	timer->last = now;
+
+	for (i = 0; i < FTDM_WHEEL_MAX_STEPS; i++) {
+		ftdm_wait_flag_t flags = FTDM_READ;
+
+		if (!ftdm_running() || !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_INTHREAD)) {
+			action = FTDM_WHEEL_DONE;
+			break;
+		}
+
+		/* timeouts use the real time elapsed since the last tick, not a frame count */
+		action = ops->tick(timer->obj, elapsed);
+		elapsed = 0;
+
+		if (action == FTDM_WHEEL_AGAIN) {
+			continue;
+		}
+		if (action != FTDM_WHEEL_IO) {
+			break;
+		}
+
+		/* never block the thread serving the wheel, the object runs again when the next frame is due */
+		if (ftdm_channel_wait(ftdmchan, &flags, 0) != FTDM_SUCCESS || !(flags & FTDM_READ)) {
+			break;
+		}
+
+		frames++;
+		if ((action = ops->io(timer->obj)) == FTDM_WHEEL_DONE) {
+			break;
+		}
+	}
+
+	switch (action) {
+	case FTDM_WHEEL_DONE:
+		return FTDM_WHEEL_DONE;
+	case FTDM_WHEEL_SLEEP:
+		due = now + interval;
+		break;
+	case FTDM_WHEEL_IO:
+		/* nothing to read yet, poll again on the next slot */
+		due = frames ? now + interval : now + FTDM_WHEEL_MS;
+		break;
+	default:
+		due = now;
+		break;
+	}
+	ftdm_wheel_add(wheel, timer, due);
+	return action;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -43,8 +43,17 @@ typedef enum {
 	FTDM_ANALOG_POLARITY_CALLERID = (1 << 4)
 } ftdm_analog_flag_t;
 
+typedef enum {
+	FTDM_ANALOG_ENGINE_THREAD,	/* one thread per call */
+	FTDM_ANALOG_ENGINE_EVENT	/* span workers multiplexing the calls */
+} ftdm_analog_engine_type_t;
+
 #define FTDM_MAX_HOTLINE_STR		32
 #define MAX_DTMF 256
+#define FTDM_ANALOG_ENGINE_MAX_WORKERS 16
+
+typedef struct ftdm_analog_call ftdm_analog_call_t;
+typedef struct ftdm_analog_worker ftdm_analog_worker_t;
 
 struct ftdm_analog_data {
 	uint32_t flags;
@@ -53,6 +62,11 @@ struct ftdm_analog_data {
 	uint32_t polarity_delay;
 	uint32_t digit_timeout;
 	char hotline[FTDM_MAX_HOTLINE_STR];
+	ftdm_analog_engine_type_t engine;
+	uint32_t engine_workers;	/* 0: one per CPU */
+	uint32_t num_workers;
+	ftdm_analog_worker_t *workers;	/* NULL when running a thread per call, released with the span */
+	ftdm_analog_call_t *calls;	/* call state of each channel, indexed by chan_id */
 };
 
 /* Analog flags to be set in the sflags (signaling flags) channel memeber */
@@ -34,11 +34,120 @@
 #include "private/ftdm_core.h"
 #include "ftdm_analog.h"
 
+#ifndef __WINDOWS__
+#include <unistd.h>
+#endif
+
 #ifndef localtime_r
 struct tm * localtime_r(const time_t *clock, struct tm *result);
 #endif
 
+/* per channel call state, owned by the channel thread or by the engine worker serving the channel */
+struct ftdm_analog_call {
+	ftdm_channel_t *ftdmchan;
+	ftdm_buffer_t *dt_buffer;
+	teletone_generation_session_t ts;
+	char dtmf[MAX_DTMF+1];
+	ftdm_size_t dtmf_offset;
+	uint32_t state_counter;
+	uint32_t elapsed;
+	uint32_t collecting;
+	uint32_t interval;
+	uint32_t last_digit;
+	uint32_t indicate;
+	uint32_t dial_timeout;
+	uint32_t answer_on_polarity_counter;
+	ftdm_sigmsg_t sig;
+	/* engine only */
+	ftdm_wheel_timer_t timer;	/*!< next tick of the call in the worker wheel */
+	uint8_t attached;		/*!< attached to a worker, protected by the worker mutex */
+	struct ftdm_analog_call *next;	/*!< pending list or calls just started */
+};
+
+/*
+ * The timer wheel is only touched by the worker thread itself, the span monitor and
+ * outgoing_call hand channels over through the pending list.
+ */
+struct ftdm_analog_worker {
+	uint32_t id;
+	ftdm_span_t *span;
+	ftdm_mutex_t *mutex;
+	ftdm_interrupt_t *interrupt;
+	ftdm_analog_call_t *pending;
+	ftdm_wheel_t wheel;
+	uint32_t count;			/*!< calls in the wheel */
+	uint8_t accept;			/*!< calls can be attached, protected by the mutex */
+	uint8_t running;
+};
+
 static void *ftdm_analog_channel_run(ftdm_thread_t *me, void *obj);
+static void *ftdm_analog_worker_run(ftdm_thread_t *me, void *obj);
+
+static ftdm_analog_worker_t *analog_engine_worker(ftdm_analog_data_t *analog_data, const ftdm_channel_t *ftdmchan)
+{
+	return &analog_data->workers[(ftdmchan->chan_id - 1) % analog_data->num_workers];
+}
+
+/**
+ * \brief Hands a channel over to the worker of the span engine serving it
+ * \param ftdmchan Channel to run
+ * \return Success or failure
+ */
+static ftdm_status_t ftdm_analog_engine_attach(ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_analog_worker_t *worker = analog_engine_worker(analog_data, ftdmchan);
+	ftdm_analog_call_t *call = &analog_data->calls[ftdmchan->chan_id];
+
+	ftdm_mutex_lock(worker->mutex);
+	if (!worker->accept || call->attached) {
+		ftdm_mutex_unlock(worker->mutex);
+		ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "Cannot attach channel to analog worker %d\n", worker->id);
+		return FTDM_FAIL;
+	}
+	call->attached = 1;
+	call->ftdmchan = ftdmchan;
+	call->next = worker->pending;
+	worker->pending = call;
+	ftdm_mutex_unlock(worker->mutex);
+
+	ftdm_interrupt_signal(worker->interrupt);
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief Runs a channel in its own thread or in the span engine
+ * \param ftdmchan Channel to run
+ * \return Success or failure
+ *
+ * The workers are only released with the span, once the engine is stopped
+ * ftdm_analog_engine_attach() refuses the channel under the worker mutex.
+ */
+static ftdm_status_t ftdm_analog_run_channel(ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_data_t *analog_data = ftdmchan->span->signal_data;
+
+	if (analog_data->workers) {
+		return ftdm_analog_engine_attach(ftdmchan);
+	}
+	return ftdm_thread_create_detached(ftdm_analog_channel_run, ftdmchan);
+}
+
+static uint32_t analog_engine_cpu_count(void)
+{
+	long count = 1;
+#ifdef __WINDOWS__
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1) {
+		count = 1;
+	}
+	return (uint32_t)count;
+}
 
 /**
  * \brief Starts an FXO channel thread (outgoing call)
@@ -60,7 +169,7 @@ static FIO_CHANNEL_OUTGOING_CALL_FUNCTION(analog_fxo_outgoing_call)
 			ftdmchan->needed_tones[FTDM_TONEMAP_DIAL] = 1;
 		}
 		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DIALING);
-		ftdm_thread_create_detached(ftdm_analog_channel_run, ftdmchan);
+		ftdm_analog_run_channel(ftdmchan);
 		return FTDM_SUCCESS;
 	}
 
@@ -81,7 +190,7 @@ static FIO_CHANNEL_OUTGOING_CALL_FUNCTION(analog_fxs_outgoing_call)
 		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_CALLWAITING);
 	} else {
 		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_GENRING);
-		ftdm_thread_create_detached(ftdm_analog_channel_run, ftdmchan);
+		ftdm_analog_run_channel(ftdmchan);
 	}
 
 	return FTDM_SUCCESS;
@@ -135,6 +244,147 @@ static FIO_SPAN_GET_SIG_STATUS_FUNCTION(analog_get_span_sig_status)
 	return FTDM_SUCCESS;
 }
 
+/**
+ * \brief Stops the workers of the span engine, the calls they still serve are hung up
+ * \param analog_data Span signaling data
+ * \return Success or failure (workers still running)
+ */
+static ftdm_status_t analog_engine_stop(ftdm_analog_data_t *analog_data)
+{
+	uint32_t i;
+
+	if (!analog_data->workers) {
+		return FTDM_SUCCESS;
+	}
+
+	/* no channel can be attached once this is done */
+	for (i = 0; i < analog_data->num_workers; i++) {
+		ftdm_analog_worker_t *worker = &analog_data->workers[i];
+
+		ftdm_mutex_lock(worker->mutex);
+		worker->accept = 0;
+		ftdm_mutex_unlock(worker->mutex);
+		ftdm_interrupt_signal(worker->interrupt);
+	}
+
+	for (i = 0; i < analog_data->num_workers; i++) {
+		ftdm_analog_worker_t *worker = &analog_data->workers[i];
+		int32_t sanity = 100;
+
+		while (worker->running && sanity--) {
+			ftdm_sleep(100);
+			ftdm_log(FTDM_LOG_DEBUG, "Waiting for analog worker %d for span %s to stop\n", worker->id, worker->span->name);
+		}
+		if (worker->running) {
+			ftdm_log(FTDM_LOG_ERROR, "The analog worker %d for span %s is probably still running, we may crash :(\n", worker->id, worker->span->name);
+			return FTDM_FAIL;
+		}
+	}
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief Releases the workers of the span engine, they must be stopped
+ * \param analog_data Span signaling data
+ */
+static void analog_engine_destroy(ftdm_analog_data_t *analog_data)
+{
+	uint32_t i;
+
+	for (i = 0; analog_data->workers && i < analog_data->num_workers; i++) {
+		ftdm_analog_worker_t *worker = &analog_data->workers[i];
+
+		if (worker->interrupt) {
+			ftdm_interrupt_destroy(&worker->interrupt);
+		}
+		if (worker->mutex) {
+			ftdm_mutex_destroy(&worker->mutex);
+		}
+	}
+	ftdm_safe_free(analog_data->workers);
+	ftdm_safe_free(analog_data->calls);
+	analog_data->num_workers = 0;
+}
+
+/**
+ * \brief Creates the workers multiplexing the calls of an analog span, they live as long as the span
+ * \param span Span to serve
+ * \return Success or failure
+ */
+static ftdm_status_t analog_engine_create(ftdm_span_t *span)
+{
+	ftdm_analog_data_t *analog_data = span->signal_data;
+	uint32_t num_workers = analog_data->engine_workers ? analog_data->engine_workers : analog_engine_cpu_count();
+	ftdm_analog_worker_t *workers;
+	uint32_t i;
+
+	num_workers = ftdm_min(num_workers, FTDM_ANALOG_ENGINE_MAX_WORKERS);
+	num_workers = ftdm_min(num_workers, span->chan_count);
+	num_workers = ftdm_max(num_workers, 1);
+
+	analog_data->calls = ftdm_calloc(span->chan_count + 1, sizeof(*analog_data->calls));
+	workers = ftdm_calloc(num_workers, sizeof(*workers));
+	if (!analog_data->calls || !workers) {
+		ftdm_safe_free(workers);
+		ftdm_safe_free(analog_data->calls);
+		return FTDM_FAIL;
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		ftdm_analog_worker_t *worker = &workers[i];
+
+		worker->id = i;
+		worker->span = span;
+		if (ftdm_mutex_create(&worker->mutex) != FTDM_SUCCESS ||
+		    ftdm_interrupt_create(&worker->interrupt, FTDM_INVALID_SOCKET, FTDM_NO_FLAGS) != FTDM_SUCCESS) {
+			analog_data->workers = workers;
+			analog_data->num_workers = num_workers;
+			analog_engine_destroy(analog_data);
+			return FTDM_FAIL;
+		}
+	}
+
+	/* ftdm_analog_run_channel() picks the engine as soon as the workers are set */
+	analog_data->num_workers = num_workers;
+	analog_data->workers = workers;
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief Starts the worker threads multiplexing the calls of an analog span
+ * \param span Span to serve
+ * \return Success or failure
+ */
+static ftdm_status_t analog_engine_start(ftdm_span_t *span)
+{
+	ftdm_analog_data_t *analog_data = span->signal_data;
+	uint32_t i;
+
+	/* the workers of a restarted span are reused, calls may still look them up */
+	if (!analog_data->workers && analog_engine_create(span) != FTDM_SUCCESS) {
+		return FTDM_FAIL;
+	}
+
+	for (i = 0; i < analog_data->num_workers; i++) {
+		ftdm_analog_worker_t *worker = &analog_data->workers[i];
+
+		ftdm_mutex_lock(worker->mutex);
+		worker->accept = 1;
+		ftdm_mutex_unlock(worker->mutex);
+
+		worker->running = 1;
+		if (ftdm_thread_create_detached(ftdm_analog_worker_run, worker) != FTDM_SUCCESS) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to launch analog worker %d for span %s\n", i, span->name);
+			worker->running = 0;
+			analog_engine_stop(analog_data);
+			return FTDM_FAIL;
+		}
+	}
+
+	ftdm_log(FTDM_LOG_NOTICE, "Analog span %s running %d channels on %d workers\n", span->name, span->chan_count, analog_data->num_workers);
+	return FTDM_SUCCESS;
+}
+
 /**
  * \brief Starts an analog span thread (monitor)
  * \param span Span to monitor
@@ -143,6 +393,16 @@ static FIO_SPAN_GET_SIG_STATUS_FUNCTION(analog_get_span_sig_status)
 static ftdm_status_t ftdm_analog_start(ftdm_span_t *span)
 {
 	ftdm_analog_data_t *analog_data = span->signal_data;
+
+	if (analog_data->engine == FTDM_ANALOG_ENGINE_EVENT && analog_engine_start(span) != FTDM_SUCCESS) {
+		if (analog_data->workers) {
+			/* the workers exist, calls would be attached to them rather than run in a thread */
+			ftdm_log(FTDM_LOG_ERROR, "Failed to start the analog engine for span %s\n", span->name);
+			return FTDM_FAIL;
+		}
+		ftdm_log(FTDM_LOG_ERROR, "Failed to start the analog engine for span %s, running a thread per call\n", span->name);
+	}
+
 	ftdm_set_flag(analog_data, FTDM_ANALOG_RUNNING);
 	return ftdm_thread_create_detached(ftdm_analog_run, span);
 }
@@ -165,6 +425,22 @@ static ftdm_status_t ftdm_analog_stop(ftdm_span_t *span)
 		ftdm_log(FTDM_LOG_ERROR, "The analog thread for span %s is probably still running, we may crash :(\n", span->name);
 		return FTDM_FAIL;
 	}
+	return analog_engine_stop(analog_data);
+}
+
+/**
+ * \brief Releases the signaling data of an analog span
+ * \param span Span to destroy
+ * \return Success or failure
+ */
+static ftdm_status_t ftdm_analog_destroy(ftdm_span_t *span)
+{
+	ftdm_analog_data_t *analog_data = span->signal_data;
+
+	if (analog_data) {
+		analog_engine_destroy(analog_data);
+		ftdm_free(analog_data);
+	}
 	return FTDM_SUCCESS;
 }
 
@@ -185,6 +461,8 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_configure_span)
 	uint32_t wait_dialtone_timeout = 5000;
 	uint32_t max_dialstr = MAX_DTMF;
 	uint32_t polarity_delay = 600;
+	ftdm_analog_engine_type_t engine = FTDM_ANALOG_ENGINE_THREAD;
+	uint32_t engine_workers = 0;
 	const char *var, *val;
 	int *intval;
 	uint32_t flags = FTDM_ANALOG_CALLERID;
@@ -281,6 +559,22 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_configure_span)
 			} else {
 				flags &= ~FTDM_ANALOG_POLARITY_CALLERID;
 			}
+		} else if (!strcasecmp(var, "engine")) {
+			if (!(val = va_arg(ap, char *))) {
+				break;
+			}
+			if (!strcasecmp(val, "event")) {
+				engine = FTDM_ANALOG_ENGINE_EVENT;
+			} else if (!strcasecmp(val, "thread")) {
+				engine = FTDM_ANALOG_ENGINE_THREAD;
+			} else {
+				ftdm_log(FTDM_LOG_ERROR, "Invalid engine %s in span %s, using a thread per call\n", val, span->name);
+			}
+		} else if (!strcasecmp(var, "engine_workers")) {
+			if (!(intval = va_arg(ap, int *))) {
+				break;
+			}
+			engine_workers = ftdm_max(0, *intval);
 		} else {
 			ftdm_log(FTDM_LOG_ERROR, "Unknown parameter %s in span %s\n", var, span->name);
 		}			
@@ -303,11 +597,14 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_configure_span)
 	
 	span->start = ftdm_analog_start;
 	span->stop = ftdm_analog_stop;
+	span->destroy = ftdm_analog_destroy;
 	analog_data->flags = flags;
 	analog_data->digit_timeout = digit_timeout;
 	analog_data->wait_dialtone_timeout = wait_dialtone_timeout;
 	analog_data->polarity_delay = polarity_delay;
 	analog_data->max_dialstr = max_dialstr;
+	analog_data->engine = engine;
+	analog_data->engine_workers = engine_workers;
 	span->signal_cb = sig_cb;
 	strncpy(analog_data->hotline, hotline, sizeof(analog_data->hotline));
 	span->signal_type = FTDM_SIGTYPE_ANALOG;
@@ -413,532 +710,564 @@ static void analog_dial(ftdm_channel_t *ftdmchan, uint32_t *state_counter, uint3
 }
 
 /**
- * \brief Main thread function for analog channel (outgoing call)
- * \param me Current thread
- * \param obj Channel to run in this thread
+ * \brief Prepares a channel to run a call (opens it, creates the tone generator and dtmf detector)
+ * \param call Call state to initialise
+ * \param ftdmchan Channel to run
+ * \return Success or failure, analog_call_end() must be called in both cases
  */
-static void *ftdm_analog_channel_run(ftdm_thread_t *me, void *obj)
+static ftdm_status_t analog_call_start(ftdm_analog_call_t *call, ftdm_channel_t *ftdmchan)
 {
-	ftdm_channel_t *ftdmchan = (ftdm_channel_t *) obj;
-	ftdm_buffer_t *dt_buffer = NULL;
-	teletone_generation_session_t ts;
-	uint8_t frame[1024];
-	ftdm_size_t len, rlen;
-	ftdm_tone_type_t tt = FTDM_TONE_DTMF;
-	char dtmf[MAX_DTMF+1] = "";
-	ftdm_size_t dtmf_offset = 0;
 	ftdm_analog_data_t *analog_data = ftdmchan->span->signal_data;
-	ftdm_channel_t *closed_chan;
-	uint32_t state_counter = 0, elapsed = 0, collecting = 0, interval = 0, last_digit = 0, indicate = 0, dial_timeout = analog_data->wait_dialtone_timeout;
-	uint32_t answer_on_polarity_counter = 0;
-	ftdm_sigmsg_t sig;
+	ftdm_tone_type_t tt = FTDM_TONE_DTMF;
 
-	ftdm_unused_arg(me);
-	ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "ANALOG CHANNEL thread starting.\n");
+	call->ftdmchan = ftdmchan;
+	call->dt_buffer = NULL;
+	call->ts.buffer = NULL;
+	call->dtmf[0] = '\0';
+	call->dtmf_offset = 0;
+	call->state_counter = 0;
+	call->elapsed = 0;
+	call->collecting = 0;
+	call->interval = 0;
+	call->last_digit = 0;
+	call->indicate = 0;
+	call->dial_timeout = analog_data->wait_dialtone_timeout;
+	call->answer_on_polarity_counter = 0;
 
-	ts.buffer = NULL;
+	ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "ANALOG CHANNEL thread starting.\n");
 
 	if (ftdm_channel_open_chan(ftdmchan) != FTDM_SUCCESS) {
 		ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "OPEN ERROR [%s]\n", ftdmchan->last_error);
-		goto done;
+		return FTDM_FAIL;
 	}
 
-	if (ftdm_buffer_create(&dt_buffer, 1024, 3192, 0) != FTDM_SUCCESS) {
+	if (ftdm_buffer_create(&call->dt_buffer, 1024, 3192, 0) != FTDM_SUCCESS) {
 		snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "memory error!");
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "MEM ERROR\n");
-		goto done;
+		return FTDM_FAIL;
 	}
 
 	if (ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_DTMF_DETECT, &tt) != FTDM_SUCCESS) {
 		snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "error initilizing tone detector!");
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "failed to initialize DTMF detector\n");
-		goto done;
+		return FTDM_FAIL;
 	}
 	ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Initialized DTMF detection\n");
 
 	ftdm_set_flag_locked(ftdmchan, FTDM_CHANNEL_INTHREAD);
-	teletone_init_session(&ts, 0, teletone_handler, dt_buffer);
-	ts.rate = 8000;
+	teletone_init_session(&call->ts, 0, teletone_handler, call->dt_buffer);
+	call->ts.rate = 8000;
 #if 0
-	ts.debug = 1;
-	ts.debug_stream = stdout;
+	call->ts.debug = 1;
+	call->ts.debug_stream = stdout;
 #endif
-	ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_INTERVAL, &interval);
-	ftdm_buffer_set_loops(dt_buffer, -1);
-	
-	memset(&sig, 0, sizeof(sig));
-	sig.chan_id = ftdmchan->chan_id;
-	sig.span_id = ftdmchan->span_id;
-	sig.channel = ftdmchan;
-	
-	ftdm_assert(interval != 0, "Invalid interval");
+	ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_INTERVAL, &call->interval);
+	ftdm_buffer_set_loops(call->dt_buffer, -1);
+
+	memset(&call->sig, 0, sizeof(call->sig));
+	call->sig.chan_id = ftdmchan->chan_id;
+	call->sig.span_id = ftdmchan->span_id;
+	call->sig.channel = ftdmchan;
+
+	ftdm_assert(call->interval != 0, "Invalid interval");
 
-	if (!dial_timeout) {
+	if (!call->dial_timeout) {
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Not waiting for dial tone to dial number %s\n", ftdmchan->caller_data.dnis.digits);
 	}
+	return FTDM_SUCCESS;
+}
 
-	while (ftdm_running() && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_INTHREAD)) {
-		ftdm_wait_flag_t flags = FTDM_READ;
-		ftdm_size_t dlen = 0;
-		
-		len = sizeof(frame);
-		
-		elapsed += interval;
-		state_counter += interval;
-		
-		if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
-			switch(ftdmchan->state) {
-			case FTDM_CHANNEL_STATE_GET_CALLERID:
-				{
-					if (state_counter > 5000 || !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_CALLERID_DETECT)) {
-						ftdm_channel_command(ftdmchan, FTDM_COMMAND_DISABLE_CALLERID_DETECT, NULL);
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
-					}
+/**
+ * \brief Runs the state machine, timeouts and digit collection of a call
+ * \param call Call to run
+ * \param elapsed Milliseconds elapsed since the previous tick
+ * \return What the caller must do next with the call
+ */
+static ftdm_wheel_action_t analog_call_tick(ftdm_analog_call_t *call, uint32_t elapsed)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	ftdm_analog_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_size_t dlen = 0;
+
+	call->elapsed += elapsed;
+	call->state_counter += elapsed;
+
+	/* the previous tick is done with the state, a non-blocking answer can move to its next state */
+	if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_IND_CHAIN)) {
+		ftdm_channel_lock(ftdmchan);
+		ftdm_channel_advance_indication(ftdmchan);
+		ftdm_channel_unlock(ftdmchan);
+	}
+
+	if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
+		switch(ftdmchan->state) {
+		case FTDM_CHANNEL_STATE_GET_CALLERID:
+			{
+				if (call->state_counter > 5000 || !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_CALLERID_DETECT)) {
+					ftdm_channel_command(ftdmchan, FTDM_COMMAND_DISABLE_CALLERID_DETECT, NULL);
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALING:
-				{
-					if (state_counter > dial_timeout) {
-						if (ftdmchan->needed_tones[FTDM_TONEMAP_DIAL]) {
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALING:
+			{
+				if (call->state_counter > call->dial_timeout) {
+					if (ftdmchan->needed_tones[FTDM_TONEMAP_DIAL]) {
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+					} else {
+						/* do not go up if we're waiting for polarity reversal */
+						if (ftdm_test_flag(analog_data, FTDM_ANALOG_ANSWER_POLARITY_REVERSE)) {
+							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_PROGRESS_MEDIA);
 						} else {
-							/* do not go up if we're waiting for polarity reversal */
-							if (ftdm_test_flag(analog_data, FTDM_ANALOG_ANSWER_POLARITY_REVERSE)) {
-								ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_PROGRESS_MEDIA);
-							} else {
-								ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
-							}
+							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
 						}
 					}
 				}
-				break;
-			case FTDM_CHANNEL_STATE_GENRING:
-				{
-					if (state_counter > 60000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-					} else if (!ftdmchan->fsk_buffer || !ftdm_buffer_inuse(ftdmchan->fsk_buffer)) {
-						ftdm_sleep(interval);
-						continue;
-					}
-				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALTONE:
-				{
-					if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_HOLD) && state_counter > 10000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_GENRING:
+			{
+				if (call->state_counter > 60000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+				} else if (!ftdmchan->fsk_buffer || !ftdm_buffer_inuse(ftdmchan->fsk_buffer)) {
+					return FTDM_WHEEL_SLEEP;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_BUSY:
-				{
-					if (state_counter > 20000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_ATTN);
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALTONE:
+			{
+				if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_HOLD) && call->state_counter > 10000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_ATTN:
-				{
-					if (state_counter > 20000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_BUSY:
+			{
+				if (call->state_counter > 20000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_ATTN);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_HANGUP:
-				{
-					if (state_counter > 500) {
-						if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RINGING)) {
-							ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_OFF, NULL);
-						}
-						
-						if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
-							   ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && 
-							(ftdmchan->last_state == FTDM_CHANNEL_STATE_RINGING 
-							 || ftdmchan->last_state == FTDM_CHANNEL_STATE_DIALTONE 
-							 || ftdmchan->last_state == FTDM_CHANNEL_STATE_RING
-							 || ftdmchan->last_state == FTDM_CHANNEL_STATE_UP)) {
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-						} else {
-							ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-						}
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_ATTN:
+			{
+				if (call->state_counter > 20000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_CALLWAITING:
-				{
-					int done = 0;
-					
-					if (ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] == 1) {
-						send_caller_id(ftdmchan);
-						ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]++;
-					} else if (state_counter > 600 && !ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]) {
-						send_caller_id(ftdmchan);
-						ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]++;
-					} else if (state_counter > 1000 && !ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]) {
-						done = 1;
-					} else if (state_counter > 10000) {
-						if (ftdmchan->fsk_buffer) {
-							ftdm_buffer_zero(ftdmchan->fsk_buffer);
-						} else {
-							ftdm_buffer_create(&ftdmchan->fsk_buffer, 128, 128, 0);
-						}
-						
-						ts.user_data = ftdmchan->fsk_buffer;
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_SAS]);
-						ts.user_data = dt_buffer;
-						done = 1;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_HANGUP:
+			{
+				if (call->state_counter > 500) {
+					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RINGING)) {
+						ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_OFF, NULL);
 					}
 
-					if (done) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
-						ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
-						ftdm_channel_complete_state(ftdmchan);
-						ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] = 0;
-					}
-				}
-			case FTDM_CHANNEL_STATE_UP:
-			case FTDM_CHANNEL_STATE_RING:
-			case FTDM_CHANNEL_STATE_PROGRESS_MEDIA:
-				{
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) &&
-					    ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS_MEDIA && 
-					    ftdm_test_sflag(ftdmchan, AF_POLARITY_REVERSE)) {
-						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_NOTICE, "Answering on polarity reverse\n");
-						ftdm_clear_sflag(ftdmchan, AF_POLARITY_REVERSE);
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
-						answer_on_polarity_counter = state_counter;
-					} else if (ftdmchan->state == FTDM_CHANNEL_STATE_UP
-						   && ftdm_test_sflag(ftdmchan, AF_POLARITY_REVERSE)){
-						/* if this polarity reverse is close to the answer polarity reverse, ignore it */
-						if (answer_on_polarity_counter 
-						&& (state_counter - answer_on_polarity_counter) > analog_data->polarity_delay) {
-							ftdm_log_chan_msg(ftdmchan, FTDM_LOG_NOTICE, "Hanging up on polarity reverse\n");
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_HANGUP);
-						} else {
-							ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, 
-							"Not hanging up on polarity reverse, too close to Answer reverse\n");
-						}
-						ftdm_clear_sflag(ftdmchan, AF_POLARITY_REVERSE);
+					if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
+						   ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) &&
+						(ftdmchan->last_state == FTDM_CHANNEL_STATE_RINGING
+						 || ftdmchan->last_state == FTDM_CHANNEL_STATE_DIALTONE
+						 || ftdmchan->last_state == FTDM_CHANNEL_STATE_RING
+						 || ftdmchan->last_state == FTDM_CHANNEL_STATE_UP)) {
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
 					} else {
-						ftdm_sleep(interval);
+						ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 					}
-					continue;
-				}
-				break;
-			case FTDM_CHANNEL_STATE_DOWN:
-				{
-					goto done;
 				}
-				break;
-			default:
-				break;
 			}
-		} else {
-			ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
-			ftdm_channel_complete_state(ftdmchan);
-			indicate = 0;
-			state_counter = 0;
-
-			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Executing state handler on %d:%d for %s\n", 
-					ftdmchan->span_id, ftdmchan->chan_id,
-					ftdm_channel_state2str(ftdmchan->state));
-			switch(ftdmchan->state) {
-			case FTDM_CHANNEL_STATE_UP:
-				{
-					ftdm_channel_use(ftdmchan);
-					ftdm_channel_clear_needed_tones(ftdmchan);
-					ftdm_channel_flush_dtmf(ftdmchan);
-						
-					if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
-						ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
-					}
+			break;
+		case FTDM_CHANNEL_STATE_CALLWAITING:
+			{
+				int done = 0;
 
-					if (ftdmchan->fsk_buffer && ftdm_buffer_inuse(ftdmchan->fsk_buffer)) {
-						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Cancel FSK transmit due to early answer.\n");
+				if (ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] == 1) {
+					send_caller_id(ftdmchan);
+					ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]++;
+				} else if (call->state_counter > 600 && !ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]) {
+					send_caller_id(ftdmchan);
+					ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]++;
+				} else if (call->state_counter > 1000 && !ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK]) {
+					done = 1;
+				} else if (call->state_counter > 10000) {
+					if (ftdmchan->fsk_buffer) {
 						ftdm_buffer_zero(ftdmchan->fsk_buffer);
-					}
-
-					if (ftdmchan->type == FTDM_CHAN_TYPE_FXS && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RINGING)) {
-						ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_OFF, NULL);
-					}
-
-					if (ftdmchan->token_count == 1) {
-						ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_HOLD);
-					}
-
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_HOLD)) {
-						ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_HOLD);
-						sig.event_id = FTDM_SIGEVENT_ADD_CALL;
 					} else {
-						sig.event_id = FTDM_SIGEVENT_UP;
-					}
-
-					if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
-					    !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) &&
-					    ftdm_test_flag(analog_data, FTDM_ANALOG_ANSWER_POLARITY_REVERSE)) {
-						ftdm_polarity_t polarity = FTDM_POLARITY_REVERSE;
-						if (ftdmchan->polarity == FTDM_POLARITY_FORWARD) {
-							ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Reversing polarity on answer\n");
-							ftdm_channel_command(ftdmchan, FTDM_COMMAND_SET_POLARITY, &polarity);
-						} else {
-							/* the polarity may be already reversed if this is the second time we 
-							 * answer (ie, due to 2 calls being on the same line) */
-						}
+						ftdm_buffer_create(&ftdmchan->fsk_buffer, 128, 128, 0);
 					}
 
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					continue;
+					call->ts.user_data = ftdmchan->fsk_buffer;
+					teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_SAS]);
+					call->ts.user_data = call->dt_buffer;
+					done = 1;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALING:
-				{
-					ftdm_channel_use(ftdmchan);
-				}
-				break;
-			case FTDM_CHANNEL_STATE_RING:
-				{
-					ftdm_channel_use(ftdmchan);
-					sig.event_id = FTDM_SIGEVENT_START;
 
-					if (ftdmchan->type == FTDM_CHAN_TYPE_FXO) {
-						ftdm_set_string(ftdmchan->caller_data.dnis.digits, ftdmchan->chan_number);
+				if (done) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
+					ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
+					ftdm_channel_complete_state(ftdmchan);
+					ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] = 0;
+				}
+			}
+		case FTDM_CHANNEL_STATE_UP:
+		case FTDM_CHANNEL_STATE_RING:
+		case FTDM_CHANNEL_STATE_PROGRESS_MEDIA:
+			{
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) &&
+				    ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS_MEDIA &&
+				    ftdm_test_sflag(ftdmchan, AF_POLARITY_REVERSE)) {
+					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_NOTICE, "Answering on polarity reverse\n");
+					ftdm_clear_sflag(ftdmchan, AF_POLARITY_REVERSE);
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
+					call->answer_on_polarity_counter = call->state_counter;
+				} else if (ftdmchan->state == FTDM_CHANNEL_STATE_UP
+					   && ftdm_test_sflag(ftdmchan, AF_POLARITY_REVERSE)){
+					/* if this polarity reverse is close to the answer polarity reverse, ignore it */
+					if (call->answer_on_polarity_counter
+					&& (call->state_counter - call->answer_on_polarity_counter) > analog_data->polarity_delay) {
+						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_NOTICE, "Hanging up on polarity reverse\n");
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_HANGUP);
 					} else {
-						ftdm_set_string(ftdmchan->caller_data.dnis.digits, dtmf);
+						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING,
+						"Not hanging up on polarity reverse, too close to Answer reverse\n");
 					}
-
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					continue;
+					ftdm_clear_sflag(ftdmchan, AF_POLARITY_REVERSE);
+				} else {
+					return FTDM_WHEEL_SLEEP;
 				}
-				break;
+				return FTDM_WHEEL_AGAIN;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DOWN:
+			{
+				return FTDM_WHEEL_DONE;
+			}
+			break;
+		default:
+			break;
+		}
+	} else {
+		ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
+		ftdm_channel_complete_state(ftdmchan);
+		call->indicate = 0;
+		call->state_counter = 0;
+
+		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Executing state handler on %d:%d for %s\n",
+				ftdmchan->span_id, ftdmchan->chan_id,
+				ftdm_channel_state2str(ftdmchan->state));
+		switch(ftdmchan->state) {
+		case FTDM_CHANNEL_STATE_UP:
+			{
+				ftdm_channel_use(ftdmchan);
+				ftdm_channel_clear_needed_tones(ftdmchan);
+				ftdm_channel_flush_dtmf(ftdmchan);
 
-			case FTDM_CHANNEL_STATE_HANGUP:
-				/* this state is only used when the user hangup, if the device hang up (onhook) we currently
-				 * go straight to DOWN. If we ever change this (as other signaling modules do) by using this
-				 * state for both user and device hangup, we should check here for the type of hangup since
-				 * some actions (polarity reverse) do not make sense if the device hung up */
-				if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
-				    ftdmchan->last_state == FTDM_CHANNEL_STATE_UP &&
-				    ftdm_test_flag(analog_data, FTDM_ANALOG_HANGUP_POLARITY_REVERSE)) {
-					ftdm_polarity_t polarity = ftdmchan->polarity == FTDM_POLARITY_REVERSE 
-						                 ? FTDM_POLARITY_FORWARD : FTDM_POLARITY_REVERSE;
-					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Reversing polarity on hangup\n");
-					ftdm_channel_command(ftdmchan, FTDM_COMMAND_SET_POLARITY, &polarity);
+				if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
+					ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
 				}
-				break;
 
-			case FTDM_CHANNEL_STATE_DOWN:
-				{
-					sig.event_id = FTDM_SIGEVENT_STOP;
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					goto done;
-				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALTONE:
-				{
-					memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
-					*dtmf = '\0';
-					dtmf_offset = 0;
-					ftdm_buffer_zero(dt_buffer);
-					teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_DIAL]);
-					indicate = 1;
+				if (ftdmchan->fsk_buffer && ftdm_buffer_inuse(ftdmchan->fsk_buffer)) {
+					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Cancel FSK transmit due to early answer.\n");
+					ftdm_buffer_zero(ftdmchan->fsk_buffer);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_CALLWAITING:
-				{
-					ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] = 0;
-					if (ftdmchan->fsk_buffer) {
-						ftdm_buffer_zero(ftdmchan->fsk_buffer);
-					} else {
-						ftdm_buffer_create(&ftdmchan->fsk_buffer, 128, 128, 0);
-					}
-					
-					ts.user_data = ftdmchan->fsk_buffer;
-					teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_SAS]);
-					teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_CAS]);
-					ts.user_data = dt_buffer;
-				}
-				break;
-			case FTDM_CHANNEL_STATE_GENRING:
-				{
-					ftdm_sigmsg_t sig;
 
-					send_caller_id(ftdmchan);
-					ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_ON, NULL);
-
-					memset(&sig, 0, sizeof(sig));
-					sig.chan_id = ftdmchan->chan_id;
-					sig.span_id = ftdmchan->span_id;
-					sig.channel = ftdmchan;
-					sig.event_id = FTDM_SIGEVENT_PROGRESS;
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					
-				}
-				break;
-			case FTDM_CHANNEL_STATE_GET_CALLERID:
-				{
-					memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
-					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Initializing cid data!\n");
-					ftdm_set_string(ftdmchan->caller_data.ani.digits, "unknown");
-					ftdm_set_string(ftdmchan->caller_data.cid_name, ftdmchan->caller_data.ani.digits);
-					ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_CALLERID_DETECT, NULL);
-					continue;
+				if (ftdmchan->type == FTDM_CHAN_TYPE_FXS && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RINGING)) {
+					ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_OFF, NULL);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_RINGING:
-				{
-					ftdm_buffer_zero(dt_buffer);
-					teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_RING]);
-					indicate = 1;
-					
+
+				if (ftdmchan->token_count == 1) {
+					ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_HOLD);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_BUSY:
-				{
-					ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CIRCUIT_CONGESTION;
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_BUSY]);
-						indicate = 1;
-					} else {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-					}
+
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_HOLD)) {
+					ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_HOLD);
+					call->sig.event_id = FTDM_SIGEVENT_ADD_CALL;
+				} else {
+					call->sig.event_id = FTDM_SIGEVENT_UP;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_ATTN:
-				{
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_ATTN]);
-						indicate = 1;
+
+				if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
+				    !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND) &&
+				    ftdm_test_flag(analog_data, FTDM_ANALOG_ANSWER_POLARITY_REVERSE)) {
+					ftdm_polarity_t polarity = FTDM_POLARITY_REVERSE;
+					if (ftdmchan->polarity == FTDM_POLARITY_FORWARD) {
+						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Reversing polarity on answer\n");
+						ftdm_channel_command(ftdmchan, FTDM_COMMAND_SET_POLARITY, &polarity);
 					} else {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+						/* the polarity may be already reversed if this is the second time we
+						 * answer (ie, due to 2 calls being on the same line) */
 					}
 				}
-				break;
-			default:
-				break;
+
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_AGAIN;
 			}
-		}
+			break;
+		case FTDM_CHANNEL_STATE_DIALING:
+			{
+				ftdm_channel_use(ftdmchan);
+			}
+			break;
+		case FTDM_CHANNEL_STATE_RING:
+			{
+				ftdm_channel_use(ftdmchan);
+				call->sig.event_id = FTDM_SIGEVENT_START;
 
+				if (ftdmchan->type == FTDM_CHAN_TYPE_FXO) {
+					ftdm_set_string(ftdmchan->caller_data.dnis.digits, ftdmchan->chan_number);
+				} else {
+					ftdm_set_string(ftdmchan->caller_data.dnis.digits, call->dtmf);
+				}
 
-		if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE || ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT) {
-			if ((dlen = ftdm_channel_dequeue_dtmf(ftdmchan, dtmf + dtmf_offset, sizeof(dtmf) - strlen(dtmf)))) {
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_AGAIN;
+			}
+			break;
 
-				if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE) {
-					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_COLLECT);
-					collecting = 1;
+		case FTDM_CHANNEL_STATE_HANGUP:
+			/* this state is only used when the user hangup, if the device hang up (onhook) we currently
+			 * go straight to DOWN. If we ever change this (as other signaling modules do) by using this
+			 * state for both user and device hangup, we should check here for the type of hangup since
+			 * some actions (polarity reverse) do not make sense if the device hung up */
+			if (ftdmchan->type == FTDM_CHAN_TYPE_FXS &&
+			    ftdmchan->last_state == FTDM_CHANNEL_STATE_UP &&
+			    ftdm_test_flag(analog_data, FTDM_ANALOG_HANGUP_POLARITY_REVERSE)) {
+				ftdm_polarity_t polarity = ftdmchan->polarity == FTDM_POLARITY_REVERSE
+					                 ? FTDM_POLARITY_FORWARD : FTDM_POLARITY_REVERSE;
+				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Reversing polarity on hangup\n");
+				ftdm_channel_command(ftdmchan, FTDM_COMMAND_SET_POLARITY, &polarity);
+			}
+			break;
+
+		case FTDM_CHANNEL_STATE_DOWN:
+			{
+				call->sig.event_id = FTDM_SIGEVENT_STOP;
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_DONE;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALTONE:
+			{
+				memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
+				*call->dtmf = '\0';
+				call->dtmf_offset = 0;
+				ftdm_buffer_zero(call->dt_buffer);
+				teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_DIAL]);
+				call->indicate = 1;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_CALLWAITING:
+			{
+				ftdmchan->detected_tones[FTDM_TONEMAP_CALLWAITING_ACK] = 0;
+				if (ftdmchan->fsk_buffer) {
+					ftdm_buffer_zero(ftdmchan->fsk_buffer);
+				} else {
+					ftdm_buffer_create(&ftdmchan->fsk_buffer, 128, 128, 0);
 				}
-				dtmf_offset = strlen(dtmf);
-				last_digit = elapsed;
-				sig.event_id = FTDM_SIGEVENT_COLLECTED_DIGIT;
-				ftdm_set_string(sig.ev_data.collected.digits, dtmf);
-				if (ftdm_span_send_signal(ftdmchan->span, &sig) == FTDM_BREAK) {
-					collecting = 0;
+
+				call->ts.user_data = ftdmchan->fsk_buffer;
+				teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_SAS]);
+				teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_CALLWAITING_CAS]);
+				call->ts.user_data = call->dt_buffer;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_GENRING:
+			{
+				ftdm_sigmsg_t sig;
+
+				send_caller_id(ftdmchan);
+				ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_ON, NULL);
+
+				memset(&sig, 0, sizeof(sig));
+				sig.chan_id = ftdmchan->chan_id;
+				sig.span_id = ftdmchan->span_id;
+				sig.channel = ftdmchan;
+				sig.event_id = FTDM_SIGEVENT_PROGRESS;
+				ftdm_span_send_signal(ftdmchan->span, &sig);
+
+			}
+			break;
+		case FTDM_CHANNEL_STATE_GET_CALLERID:
+			{
+				memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
+				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Initializing cid data!\n");
+				ftdm_set_string(ftdmchan->caller_data.ani.digits, "unknown");
+				ftdm_set_string(ftdmchan->caller_data.cid_name, ftdmchan->caller_data.ani.digits);
+				ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_CALLERID_DETECT, NULL);
+				return FTDM_WHEEL_AGAIN;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_RINGING:
+			{
+				ftdm_buffer_zero(call->dt_buffer);
+				teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_RING]);
+				call->indicate = 1;
+
+			}
+			break;
+		case FTDM_CHANNEL_STATE_BUSY:
+			{
+				ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CIRCUIT_CONGESTION;
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
+					ftdm_buffer_zero(call->dt_buffer);
+					teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_BUSY]);
+					call->indicate = 1;
+				} else {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 				}
 			}
-			else if(!analog_data->max_dialstr)
+			break;
+		case FTDM_CHANNEL_STATE_ATTN:
 			{
-				last_digit = elapsed;
-				collecting = 0;
-				strcpy(dtmf, analog_data->hotline);
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
+					ftdm_buffer_zero(call->dt_buffer);
+					teletone_run(&call->ts, ftdmchan->span->tone_map[FTDM_TONEMAP_ATTN]);
+					call->indicate = 1;
+				} else {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+				}
 			}
+			break;
+		default:
+			break;
 		}
+	}
+
 
+	if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE || ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT) {
+		if ((dlen = ftdm_channel_dequeue_dtmf(ftdmchan, call->dtmf + call->dtmf_offset, sizeof(call->dtmf) - strlen(call->dtmf)))) {
 
-		if (last_digit && (!collecting || ((elapsed - last_digit > analog_data->digit_timeout) || strlen(dtmf) >= analog_data->max_dialstr))) {
-			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Number obtained [%s]\n", dtmf);
-			if (ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT && ftdmchan->state_status != FTDM_STATE_STATUS_COMPLETED) {
-				ftdm_channel_complete_state(ftdmchan);
+			if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE) {
+				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_COLLECT);
+				call->collecting = 1;
+			}
+			call->dtmf_offset = strlen(call->dtmf);
+			call->last_digit = call->elapsed;
+			call->sig.event_id = FTDM_SIGEVENT_COLLECTED_DIGIT;
+			ftdm_set_string(call->sig.ev_data.collected.digits, call->dtmf);
+			if (ftdm_span_send_signal(ftdmchan->span, &call->sig) == FTDM_BREAK) {
+				call->collecting = 0;
 			}
-			ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
-			last_digit = 0;
-			collecting = 0;
 		}
-
-		if (ftdm_channel_wait(ftdmchan, &flags, interval * 2) != FTDM_SUCCESS) {
-			continue;
+		else if(!analog_data->max_dialstr)
+		{
+			call->last_digit = call->elapsed;
+			call->collecting = 0;
+			strcpy(call->dtmf, analog_data->hotline);
 		}
+	}
 
-		if (!(flags & FTDM_READ)) {
-			continue;
-		}
 
-		if (ftdm_channel_read(ftdmchan, frame, &len) != FTDM_SUCCESS) {
-			ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "read error [%s]\n", ftdmchan->last_error);
-			continue;
+	if (call->last_digit && (!call->collecting || ((call->elapsed - call->last_digit > analog_data->digit_timeout) || strlen(call->dtmf) >= analog_data->max_dialstr))) {
+		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Number obtained [%s]\n", call->dtmf);
+		if (ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT && ftdmchan->state_status != FTDM_STATE_STATUS_COMPLETED) {
+			ftdm_channel_complete_state(ftdmchan);
 		}
+		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
+		call->last_digit = 0;
+		call->collecting = 0;
+	}
 
-		if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && ftdmchan->detected_tones[0]) {
-			int i;
-			
-			for (i = 1; i < FTDM_TONEMAP_INVALID; i++) {
-				if (ftdmchan->detected_tones[i]) {
-					ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Detected tone %s on %d:%d\n", ftdm_tonemap2str(i), ftdmchan->span_id, ftdmchan->chan_id);
-				}
-			}
-			
-			if (ftdmchan->detected_tones[FTDM_TONEMAP_BUSY] || 
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL1] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL2] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL3] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_ATTN]
-				) {
-				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Failure indication detected!\n");
-				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-			} else if (ftdmchan->detected_tones[FTDM_TONEMAP_DIAL]) {
-				analog_dial(ftdmchan, &state_counter, &dial_timeout);
-			} else if (ftdmchan->detected_tones[FTDM_TONEMAP_RING]) {
-				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
+	return FTDM_WHEEL_IO;
+}
+
+/**
+ * \brief Reads one frame of a readable channel, runs the progress detection and writes the indicated tone
+ * \param call Call to run
+ * \return FTDM_WHEEL_AGAIN or FTDM_WHEEL_DONE on fatal errors
+ */
+static ftdm_wheel_action_t analog_call_io(ftdm_analog_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	uint8_t frame[1024];
+	ftdm_size_t len = sizeof(frame), rlen;
+
+	if (ftdm_channel_read(ftdmchan, frame, &len) != FTDM_SUCCESS) {
+		ftdm_log_chan(ftdmchan, FTDM_LOG_WARNING, "read error [%s]\n", ftdmchan->last_error);
+		return FTDM_WHEEL_AGAIN;
+	}
+
+	if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && ftdmchan->detected_tones[0]) {
+		int i;
+
+		for (i = 1; i < FTDM_TONEMAP_INVALID; i++) {
+			if (ftdmchan->detected_tones[i]) {
+				ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Detected tone %s on %d:%d\n", ftdm_tonemap2str(i), ftdmchan->span_id, ftdmchan->chan_id);
 			}
-			
-			ftdm_channel_clear_detected_tones(ftdmchan);
-		} else if (!dial_timeout) {
-			/* we were requested not to wait for dial tone, we can dial immediately */
-			analog_dial(ftdmchan, &state_counter, &dial_timeout);
 		}
 
-		if ((ftdmchan->dtmf_buffer && ftdm_buffer_inuse(ftdmchan->dtmf_buffer)) || (ftdmchan->fsk_buffer && ftdm_buffer_inuse(ftdmchan->fsk_buffer))) {
-			//rlen = len;
-			//memset(frame, 0, len);
-			//ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
-			continue;
-		}
-		
-		if (!indicate) {
-			continue;
+		if (ftdmchan->detected_tones[FTDM_TONEMAP_BUSY] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL1] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL2] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL3] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_ATTN]
+			) {
+			ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Failure indication detected!\n");
+			ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+		} else if (ftdmchan->detected_tones[FTDM_TONEMAP_DIAL]) {
+			analog_dial(ftdmchan, &call->state_counter, &call->dial_timeout);
+		} else if (ftdmchan->detected_tones[FTDM_TONEMAP_RING]) {
+			ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
 		}
 
-		if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
-			ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
-		}
+		ftdm_channel_clear_detected_tones(ftdmchan);
+	} else if (!call->dial_timeout) {
+		/* we were requested not to wait for dial tone, we can dial immediately */
+		analog_dial(ftdmchan, &call->state_counter, &call->dial_timeout);
+	}
 
-		if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
-			len *= 2;
-		}
+	if ((ftdmchan->dtmf_buffer && ftdm_buffer_inuse(ftdmchan->dtmf_buffer)) || (ftdmchan->fsk_buffer && ftdm_buffer_inuse(ftdmchan->fsk_buffer))) {
+		//rlen = len;
+		//memset(frame, 0, len);
+		//ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
+		return FTDM_WHEEL_AGAIN;
+	}
 
-		rlen = ftdm_buffer_read_loop(dt_buffer, frame, len);					
-		
-		if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
-			fio_codec_t codec_func = NULL;
+	if (!call->indicate) {
+		return FTDM_WHEEL_AGAIN;
+	}
 
-			if (ftdmchan->native_codec == FTDM_CODEC_ULAW) {
-				codec_func = fio_slin2ulaw;
-			} else if (ftdmchan->native_codec == FTDM_CODEC_ALAW) {
-				codec_func = fio_slin2alaw;
-			}
+	if (ftdmchan->type == FTDM_CHAN_TYPE_FXO && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
+		ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
+	}
 
-			if (codec_func) {
-				codec_func(frame, sizeof(frame), &rlen);
-			} else {
-				snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "codec error!");
-				goto done;
-			}
+	if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
+		len *= 2;
+	}
+
+	rlen = ftdm_buffer_read_loop(call->dt_buffer, frame, len);
+
+	if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
+		fio_codec_t codec_func = NULL;
+
+		if (ftdmchan->native_codec == FTDM_CODEC_ULAW) {
+			codec_func = fio_slin2ulaw;
+		} else if (ftdmchan->native_codec == FTDM_CODEC_ALAW) {
+			codec_func = fio_slin2alaw;
 		}
 
-		ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
+		if (codec_func) {
+			codec_func(frame, sizeof(frame), &rlen);
+		} else {
+			snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "codec error!");
+			return FTDM_WHEEL_DONE;
+		}
 	}
 
- done:
+	ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
+	return FTDM_WHEEL_AGAIN;
+}
+
+/**
+ * \brief Releases the channel and the resources of a call
+ * \param call Call to end
+ *
+ * The call object is free to be reused as soon as FTDM_CHANNEL_INTHREAD is cleared.
+ */
+static void analog_call_end(ftdm_analog_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	ftdm_analog_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_channel_t *closed_chan;
 
 	closed_chan = ftdmchan;
 
@@ -953,19 +1282,19 @@ static void *ftdm_analog_channel_run(ftdm_thread_t *me, void *obj)
 		ftdm_channel_command(ftdmchan, FTDM_COMMAND_GENERATE_RING_OFF, NULL);
 	}
 
-	
+
 	ftdm_clear_sflag(ftdmchan, AF_POLARITY_REVERSE);
 
 	ftdm_channel_close(&ftdmchan);
 
 	ftdm_channel_command(closed_chan, FTDM_COMMAND_SET_NATIVE_CODEC, NULL);
 
-	if (ts.buffer) {
-		teletone_destroy_session(&ts);
+	if (call->ts.buffer) {
+		teletone_destroy_session(&call->ts);
 	}
 
-	if (dt_buffer) {
-		ftdm_buffer_destroy(&dt_buffer);
+	if (call->dt_buffer) {
+		ftdm_buffer_destroy(&call->dt_buffer);
 	}
 
 	if (closed_chan->state != FTDM_CHANNEL_STATE_DOWN) {
@@ -974,10 +1303,207 @@ static void *ftdm_analog_channel_run(ftdm_thread_t *me, void *obj)
 
 	ftdm_log_chan(closed_chan, FTDM_LOG_DEBUG, "ANALOG CHANNEL %d:%d thread ended.\n", closed_chan->span_id, closed_chan->chan_id);
 
+	if (analog_data->workers) {
+		/* the channel can be attached again once it is out of the thread */
+		ftdm_analog_worker_t *worker = analog_engine_worker(analog_data, closed_chan);
+
+		ftdm_mutex_lock(worker->mutex);
+		call->attached = 0;
+		ftdm_mutex_unlock(worker->mutex);
+	}
+
 	ftdm_clear_flag(closed_chan, FTDM_CHANNEL_INTHREAD);
 
 	ftdm_channel_unlock(closed_chan);
+}
+
+/**
+ * \brief Main thread function for analog channel (outgoing call)
+ * \param me Current thread
+ * \param obj Channel to run in this thread
+ */
+static void *ftdm_analog_channel_run(ftdm_thread_t *me, void *obj)
+{
+	ftdm_analog_call_t call;
+
+	ftdm_unused_arg(me);
+
+	memset(&call, 0, sizeof(call));
+
+	if (analog_call_start(&call, obj) != FTDM_SUCCESS) {
+		goto done;
+	}
+
+	while (ftdm_running() && ftdm_test_flag(call.ftdmchan, FTDM_CHANNEL_INTHREAD)) {
+		ftdm_wait_flag_t flags = FTDM_READ;
+
+		switch (analog_call_tick(&call, call.interval)) {
+		case FTDM_WHEEL_DONE:
+			goto done;
+		case FTDM_WHEEL_SLEEP:
+			ftdm_sleep(call.interval);
+			continue;
+		case FTDM_WHEEL_AGAIN:
+			continue;
+		case FTDM_WHEEL_IO:
+			break;
+		}
+
+		if (ftdm_channel_wait(call.ftdmchan, &flags, call.interval * 2) != FTDM_SUCCESS) {
+			continue;
+		}
+
+		if (!(flags & FTDM_READ)) {
+			continue;
+		}
+
+		if (analog_call_io(&call) == FTDM_WHEEL_DONE) {
+			goto done;
+		}
+	}
+
+ done:
+
+	analog_call_end(&call);
+
+	return NULL;
+}
+
+static ftdm_wheel_action_t analog_wheel_tick(void *obj, uint32_t elapsed)
+{
+	return analog_call_tick(obj, elapsed);
+}
+
+static ftdm_wheel_action_t analog_wheel_io(void *obj)
+{
+	return analog_call_io(obj);
+}
+
+static const ftdm_wheel_ops_t analog_wheel_ops = {
+	analog_wheel_tick,
+	analog_wheel_io
+};
+
+/**
+ * \brief Hangs up a call still served by a worker when the engine stops
+ * \param call Call to hang up
+ *
+ * The call goes to DOWN through the state machine so the user gets FTDM_SIGEVENT_STOP.
+ */
+static void analog_call_release(ftdm_analog_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	int i;
+
+	for (i = 0; i < FTDM_WHEEL_MAX_STEPS; i++) {
+		ftdm_channel_lock(ftdmchan);
+		if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE) && ftdmchan->state != FTDM_CHANNEL_STATE_DOWN) {
+			ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
+			ftdm_set_state(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+		}
+		ftdm_channel_unlock(ftdmchan);
+
+		if (analog_call_tick(call, 0) == FTDM_WHEEL_DONE) {
+			break;
+		}
+	}
+	analog_call_end(call);
+}
+
+/**
+ * \brief Starts the calls attached to a worker since its last run
+ * \param worker Worker to update
+ * \param now Current time (ms)
+ * \return List of the calls started, linked through next
+ */
+static ftdm_analog_call_t *analog_worker_update(ftdm_analog_worker_t *worker, ftdm_time_t now)
+{
+	ftdm_analog_call_t *call, *next;
+	ftdm_analog_call_t *started = NULL;
+
+	ftdm_mutex_lock(worker->mutex);
+	call = worker->pending;
+	worker->pending = NULL;
+	ftdm_mutex_unlock(worker->mutex);
+
+	for (; call; call = next) {
+		next = call->next;
+
+		if (analog_call_start(call, call->ftdmchan) != FTDM_SUCCESS) {
+			analog_call_end(call);
+			continue;
+		}
+		worker->count++;
+		call->timer.obj = call;
+		call->timer.last = now;
+		call->next = started;
+		started = call;
+	}
+	return started;
+}
+
+/**
+ * \brief Main thread function for an analog engine worker
+ * \param me Current thread
+ * \param obj Worker to run in this thread
+ */
+static void *ftdm_analog_worker_run(ftdm_thread_t *me, void *obj)
+{
+	ftdm_analog_worker_t *worker = obj;
+	ftdm_analog_call_t *call, *next;
+	ftdm_wheel_timer_t *timer, *next_timer;
+	ftdm_time_t now;
+
+	ftdm_unused_arg(me);
+	ftdm_log(FTDM_LOG_DEBUG, "ANALOG worker %d for span %s starting.\n", worker->id, worker->span->name);
+
+	ftdm_wheel_init(&worker->wheel, ftdm_current_time_in_ms());
+
+	while (ftdm_running() && worker->accept) {
+		int waitms = 1000;
+
+		now = ftdm_current_time_in_ms();
+
+		for (call = analog_worker_update(worker, now); call; call = next) {
+			next = call->next;
+			ftdm_wheel_add(&worker->wheel, &call->timer, now);
+		}
+
+		for (timer = ftdm_wheel_expire(&worker->wheel, now); timer; timer = next_timer) {
+			next_timer = timer->next;
+			call = timer->obj;
+			if (ftdm_wheel_service(&worker->wheel, timer, call->ftdmchan, call->interval, &analog_wheel_ops, now) == FTDM_WHEEL_DONE) {
+				worker->count--;
+				analog_call_end(call);
+			}
+		}
+
+		if (worker->count) {
+			now = ftdm_current_time_in_ms();
+			if (worker->wheel.current <= now) {
+				continue;
+			}
+			waitms = (int)(worker->wheel.current - now);
+		}
+
+		/* the interrupt is signaled when a call is attached */
+		ftdm_interrupt_wait(worker->interrupt, waitms);
+	}
+
+	/* the engine is stopping, hang up the calls still running (and the ones attached meanwhile) */
+	for (call = analog_worker_update(worker, ftdm_current_time_in_ms()); call; call = next) {
+		next = call->next;
+		analog_call_release(call);
+	}
+	for (timer = ftdm_wheel_flush(&worker->wheel); timer; timer = next_timer) {
+		next_timer = timer->next;
+		analog_call_release(timer->obj);
+	}
+	worker->count = 0;
+
+	ftdm_log(FTDM_LOG_DEBUG, "ANALOG worker %d for span %s ending.\n", worker->id, worker->span->name);
 
+	worker->running = 0;
 	return NULL;
 }
 
@@ -1034,7 +1560,7 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 				event->channel->ring_count = 1;
 				ftdm_mutex_unlock(event->channel->mutex);
 				locked = 0;
-				ftdm_thread_create_detached(ftdm_analog_channel_run, event->channel);
+				ftdm_analog_run_channel(event->channel);
 			} else {
 				event->channel->ring_count++;
 			}
@@ -1096,7 +1622,7 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 					}						
 					ftdm_mutex_unlock(event->channel->mutex);
 					locked = 0;
-					ftdm_thread_create_detached(ftdm_analog_channel_run, event->channel);
+					ftdm_analog_run_channel(event->channel);
 				}
 			} else {
 				if (!ftdm_test_flag(event->channel, FTDM_CHANNEL_INTHREAD)) {
@@ -1150,7 +1676,7 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 					event->channel->ring_count = 1;
 					ftdm_mutex_unlock(event->channel->mutex);
 					locked = 0;
-					ftdm_thread_create_detached(ftdm_analog_channel_run, event->channel);
+					ftdm_analog_run_channel(event->channel);
 				} else {
 					ftdm_log_chan_msg(event->channel, FTDM_LOG_DEBUG, 
 						"Ignoring polarity reversal because this channel is down\n");
@@ -1194,6 +1720,7 @@ static void *ftdm_analog_run(ftdm_thread_t *me, void *obj)
 		int waitms = 1000;
 		ftdm_status_t status;
 
+		ftdm_span_metrics_loop_mark(span);
 		if ((status = ftdm_span_poll_event(span, waitms, NULL)) != FTDM_FAIL) {
 			errs = 0;
 		}
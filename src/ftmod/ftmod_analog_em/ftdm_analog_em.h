@@ -50,6 +50,14 @@ typedef enum {
 	FTDM_ANALOG_EM_REMOTE_SUSPEND = (1 << 4),
 } ftdm_analog_em_flag_t;
 
+typedef enum {
+	FTDM_ANALOG_EM_ENGINE_THREAD,	/* one thread per call */
+	FTDM_ANALOG_EM_ENGINE_EVENT	/* calls multiplexed in the span thread */
+} ftdm_analog_em_engine_type_t;
+
+typedef struct ftdm_analog_em_call ftdm_analog_em_call_t;
+typedef struct ftdm_analog_em_engine ftdm_analog_em_engine_t;
+
 struct ftdm_analog_data {
 	uint32_t flags;
 	uint32_t max_dialstr;
@@ -58,6 +66,8 @@ struct ftdm_analog_data {
 	ftdm_bool_t answer_supervision;
 	ftdm_bool_t immediate_ringback;
 	char ringback_file[512];
+	ftdm_analog_em_engine_type_t engine_type;
+	ftdm_analog_em_engine_t *engine;	/* NULL when running a thread per call, released with the span */
 };
 
 static void *ftdm_analog_em_run(ftdm_thread_t *me, void *obj);
@@ -146,8 +146,165 @@ error:
 	return -1;
 }
 
+/* tones are rendered at the rate of the channel */
+#define ANALOG_EM_TONE_RATE 8000
+
+/* time the CAS bits must persist to be taken as an answer or a hangup (ms) */
+#define ANALOG_EM_CAS_ANSWER_MS 500
+#define ANALOG_EM_CAS_HANGUP_MS 500
+
+/* per channel call state, owned by the channel thread or by the span engine */
+struct ftdm_analog_em_call {
+	ftdm_channel_t *ftdmchan;
+	ftdm_buffer_t *dt_buffer;	/*!< thread engine: tone rendered by teletone */
+	teletone_generation_session_t ts;
+	const ftdm_tone_segment_t *segment;	/*!< event engine: tone being played (shared, owned by the tone cache) */
+	ftdm_tonemap_t tone;
+	ftdm_size_t offset;		/*!< play offset in the segment (bytes) */
+	FILE *ringback_f;
+	char dtmf[128];
+	ftdm_size_t dtmf_offset;
+	uint32_t state_counter;
+	uint32_t elapsed;
+	uint32_t collecting;
+	uint32_t interval;
+	uint32_t last_digit;
+	uint32_t indicate;
+	uint32_t dial_timeout;
+	uint32_t cas_answer;
+	uint32_t cas_hangup;
+	ftdm_bool_t busy_timeout;
+	ftdm_bool_t digits_sent;
+	ftdm_sigmsg_t sig;
+	/* engine only */
+	uint64_t attach_time;		/*!< seizure time (ftdm_metrics_now()), 0 once the wink is sent */
+	ftdm_wheel_timer_t timer;	/*!< next tick of the call in the engine wheel */
+	uint8_t attached;		/*!< handed over to the engine, protected by the engine mutex */
+	struct ftdm_analog_em_call *next;	/*!< pending list or ready list */
+};
+
+/*
+ * The engine runs in the span monitor thread, only the pending list is shared with
+ * outgoing_call, everything else is touched by the span thread alone.
+ */
+struct ftdm_analog_em_engine {
+	ftdm_mutex_t *mutex;
+	ftdm_analog_em_call_t *calls;	/*!< call state of each channel, indexed by chan_id */
+	ftdm_analog_em_call_t *pending;
+	ftdm_analog_em_call_t *ready;
+	ftdm_wheel_t wheel;
+	uint32_t count;			/*!< calls being served */
+	uint8_t accept;			/*!< calls can be attached, protected by the mutex */
+	uint8_t running;		/*!< the span thread is running the engine */
+	ftdm_histogram_t lateness;
+	ftdm_histogram_t wink;
+	ftdm_metric_t lateness_metric;
+	ftdm_metric_t wink_metric;
+};
+
 static void *ftdm_analog_em_channel_run(ftdm_thread_t *me, void *obj);
 
+/**
+ * \brief Hands a channel over to the span engine
+ * \param ftdmchan Channel to run
+ * \return Success or failure
+ */
+static ftdm_status_t analog_em_engine_attach(ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_analog_em_engine_t *engine = analog_data->engine;
+	ftdm_analog_em_call_t *call = &engine->calls[ftdmchan->chan_id];
+
+	ftdm_mutex_lock(engine->mutex);
+	if (!engine->accept || call->attached) {
+		ftdm_mutex_unlock(engine->mutex);
+		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "Cannot attach channel to the analog em engine\n");
+		return FTDM_FAIL;
+	}
+	call->attached = 1;
+	call->ftdmchan = ftdmchan;
+	call->attach_time = ftdm_metrics_now();
+	call->next = engine->pending;
+	engine->pending = call;
+	ftdm_mutex_unlock(engine->mutex);
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief Runs a channel in its own thread or in the span engine
+ * \param ftdmchan Channel to run
+ * \return Success or failure
+ *
+ * The engine is only released with the span, once it is stopped
+ * analog_em_engine_attach() refuses the channel under the engine mutex.
+ */
+static ftdm_status_t analog_em_run_channel(ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+
+	if (analog_data->engine) {
+		return analog_em_engine_attach(ftdmchan);
+	}
+	return ftdm_thread_create_detached(ftdm_analog_em_channel_run, ftdmchan);
+}
+
+/**
+ * \brief Releases the span engine, the span must be stopped
+ * \param span Span of the engine
+ */
+static void analog_em_engine_destroy(ftdm_span_t *span)
+{
+	ftdm_analog_em_data_t *analog_data = span->signal_data;
+	ftdm_analog_em_engine_t *engine = analog_data->engine;
+
+	if (!engine) {
+		return;
+	}
+
+	ftdm_metric_unregister(&engine->lateness_metric);
+	ftdm_metric_unregister(&engine->wink_metric);
+	if (engine->mutex) {
+		ftdm_mutex_destroy(&engine->mutex);
+	}
+	ftdm_safe_free(engine->calls);
+	ftdm_safe_free(analog_data->engine);
+}
+
+/**
+ * \brief Creates the engine multiplexing the calls of a span in the span thread
+ * \param span Span to serve
+ * \return Success or failure
+ */
+static ftdm_status_t analog_em_engine_create(ftdm_span_t *span)
+{
+	ftdm_analog_em_data_t *analog_data = span->signal_data;
+	ftdm_analog_em_engine_t *engine = NULL;
+	char labels[128];
+
+	if (!(engine = ftdm_calloc(1, sizeof(*engine)))) {
+		return FTDM_FAIL;
+	}
+
+	engine->calls = ftdm_calloc(span->chan_count + 1, sizeof(*engine->calls));
+	if (!engine->calls || ftdm_mutex_create(&engine->mutex) != FTDM_SUCCESS) {
+		ftdm_safe_free(engine->calls);
+		ftdm_safe_free(engine);
+		return FTDM_FAIL;
+	}
+
+	snprintf(labels, sizeof(labels), "span=\"%s\"", span->name);
+	ftdm_metric_register_histogram(&engine->lateness_metric, &engine->lateness, "freetdm_analog_em_timer_lateness_seconds",
+			labels, "Delay between the time an E&M call tick is due and the time it runs");
+	ftdm_metric_register_histogram(&engine->wink_metric, &engine->wink, "freetdm_analog_em_wink_seconds",
+			labels, "Delay between an E&M seizure and the wink sent back");
+
+	/* analog_em_run_channel() picks the engine as soon as it is set */
+	analog_data->engine = engine;
+
+	ftdm_log(FTDM_LOG_NOTICE, "Analog EM span %s running %d channels in the span thread\n", span->name, span->chan_count);
+	return FTDM_SUCCESS;
+}
+
 /**
  * \brief Starts an EM channel thread (outgoing call)
  * \param ftdmchan Channel to initiate call on
@@ -166,8 +323,7 @@ static FIO_CHANNEL_OUTGOING_CALL_FUNCTION(analog_em_outgoing_call)
 		ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
 		ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_PROGRESS_DETECT, NULL);
 		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DIALING);
-		ftdm_thread_create_detached(ftdm_analog_em_channel_run, ftdmchan);
-		return FTDM_SUCCESS;
+		return analog_em_run_channel(ftdmchan);
 	}
 
 	return FTDM_FAIL;
@@ -193,8 +349,33 @@ static ftdm_status_t ftdm_analog_em_sig_write(ftdm_channel_t *ftdmchan, void *da
 static ftdm_status_t ftdm_analog_em_start(ftdm_span_t *span)
 {
 	ftdm_analog_em_data_t *analog_data = span->signal_data;
+	ftdm_analog_em_engine_t *engine;
+
+	/* the engine of a restarted span is reused, calls may still look it up */
+	if (analog_data->engine_type == FTDM_ANALOG_EM_ENGINE_EVENT && !analog_data->engine && analog_em_engine_create(span) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_ERROR, "Failed to create the analog em engine for span %s, running a thread per call\n", span->name);
+	}
+
+	if ((engine = analog_data->engine)) {
+		ftdm_wheel_init(&engine->wheel, ftdm_current_time_in_ms());
+		ftdm_mutex_lock(engine->mutex);
+		engine->accept = 1;
+		ftdm_mutex_unlock(engine->mutex);
+		engine->running = 1;
+	}
+
 	ftdm_set_flag(analog_data, FTDM_ANALOG_EM_RUNNING);
-	return ftdm_thread_create_detached(ftdm_analog_em_run, span);
+	if (ftdm_thread_create_detached(ftdm_analog_em_run, span) != FTDM_SUCCESS) {
+		ftdm_clear_flag(analog_data, FTDM_ANALOG_EM_RUNNING);
+		if (engine) {
+			ftdm_mutex_lock(engine->mutex);
+			engine->accept = 0;
+			ftdm_mutex_unlock(engine->mutex);
+			engine->running = 0;
+		}
+		return FTDM_FAIL;
+	}
+	return FTDM_SUCCESS;
 }
 
 static void ftdm_analog_set_chan_sig_status(ftdm_channel_t *ftdmchan, ftdm_signaling_status_t status)
@@ -222,12 +403,49 @@ static void ftdm_analog_set_chan_sig_status(ftdm_channel_t *ftdmchan, ftdm_signa
 static ftdm_status_t ftdm_analog_em_stop(ftdm_span_t *span)
 {
 	ftdm_analog_em_data_t *analog_data = span->signal_data;
+	ftdm_analog_em_engine_t *engine = analog_data->engine;
+
+	if (engine) {
+		/* no channel can be attached once this is done */
+		ftdm_mutex_lock(engine->mutex);
+		engine->accept = 0;
+		ftdm_mutex_unlock(engine->mutex);
+	}
 	ftdm_clear_flag(analog_data, FTDM_ANALOG_EM_RUNNING);
-	ftdm_sleep(100);
+	if (engine) {
+		int32_t sanity = 100;
+
+		/* the span thread hangs up the calls it is still serving before leaving */
+		while (engine->running && sanity--) {
+			ftdm_sleep(100);
+			ftdm_log(FTDM_LOG_DEBUG, "Waiting for the analog em engine of span %s to stop\n", span->name);
+		}
+		if (engine->running) {
+			ftdm_log(FTDM_LOG_ERROR, "The analog em engine of span %s is probably still running, we may crash :(\n", span->name);
+			return FTDM_FAIL;
+		}
+	} else {
+		ftdm_sleep(100);
+	}
 	analog_em_set_span_sig_status(span, FTDM_SIG_STATE_SUSPENDED);
 	return FTDM_SUCCESS;
 }
 
+/**
+ * \brief Releases the signaling data of an EM span
+ * \param span Span to destroy
+ * \return Success or failure
+ */
+static ftdm_status_t ftdm_analog_em_destroy(ftdm_span_t *span)
+{
+	if (span->signal_data) {
+		analog_em_engine_destroy(span);
+		ftdm_free(span->signal_data);
+		span->signal_data = NULL;
+	}
+	return FTDM_SUCCESS;
+}
+
 /**
  * \brief Returns the signalling status on a channel
  * \param ftdmchan Channel to get status on
@@ -380,6 +598,7 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_em_configure_span)
 	uint32_t dial_timeout = 0;
 	uint32_t release_guard_time_ms = 500;
 	ftdm_bool_t answer_supervision = FTDM_FALSE;
+	ftdm_analog_em_engine_type_t engine_type = FTDM_ANALOG_EM_ENGINE_THREAD;
 	const char *var, *val;
 	int *intval;
 
@@ -435,6 +654,17 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_em_configure_span)
 				break;
 			}
 			release_guard_time_ms = *intval;
+		} else if (!strcasecmp(var, "engine")) {
+			if (!(val = va_arg(ap, char *))) {
+				break;
+			}
+			if (!strcasecmp(val, "event")) {
+				engine_type = FTDM_ANALOG_EM_ENGINE_EVENT;
+			} else if (!strcasecmp(val, "thread")) {
+				engine_type = FTDM_ANALOG_EM_ENGINE_THREAD;
+			} else {
+				ftdm_log(FTDM_LOG_ERROR, "Invalid analog em engine '%s', using 'thread'\n", val);
+			}
 		} else {
 			ftdm_log(FTDM_LOG_ERROR, "Invalid parameter for analog em span: '%s'\n", var);
 			return FTDM_FAIL;
@@ -453,11 +683,13 @@ static FIO_SIG_CONFIGURE_FUNCTION(ftdm_analog_em_configure_span)
 
 	span->start = ftdm_analog_em_start;
 	span->stop = ftdm_analog_em_stop;
+	span->destroy = ftdm_analog_em_destroy;
 	span->sig_write = ftdm_analog_em_sig_write;
 	analog_data->digit_timeout = digit_timeout;
 	analog_data->max_dialstr = max_dialstr;
 	analog_data->dial_timeout = dial_timeout;
 	analog_data->answer_supervision = answer_supervision;
+	analog_data->engine_type = engine_type;
 	span->signal_cb = sig_cb;
 	span->signal_type = FTDM_SIGTYPE_ANALOG;
 	span->signal_data = analog_data;
@@ -497,441 +729,490 @@ static int teletone_handler(teletone_generation_session_t *ts, teletone_tone_map
 }
 
 /**
- * \brief Main thread function for EM channel (outgoing call)
- * \param me Current thread
- * \param obj Channel to run in this thread
+ * \brief Selects the tone played on a call
+ * \param call Call to play the tone on
+ * \param tone Tone to play
+ *
+ * A call running in its own thread renders the tone with its teletone session, the event
+ * engine plays the segments pre-rendered and shared by the tone cache.
  */
-static void *ftdm_analog_em_channel_run(ftdm_thread_t *me, void *obj)
+static void analog_em_call_set_tone(ftdm_analog_em_call_t *call, ftdm_tonemap_t tone)
 {
-	ftdm_channel_t *ftdmchan = (ftdm_channel_t *) obj;
-	ftdm_buffer_t *dt_buffer = NULL;
-	teletone_generation_session_t ts;
-	uint8_t frame[1024];
-	ftdm_size_t len, rlen;
-	ftdm_tone_type_t tt = FTDM_TONE_DTMF;
-	char dtmf[128] = "";
-	ftdm_size_t dtmf_offset = 0;
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
 	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
-	ftdm_channel_t *closed_chan;
-	uint32_t state_counter = 0, elapsed = 0, collecting = 0, interval = 0, last_digit = 0, indicate = 0, dial_timeout = 30000;
-	ftdm_sigmsg_t sig;
-	int cas_bits = 0;
-	uint32_t cas_answer = 0;
-	uint32_t cas_hangup = 0;
-	int cas_answer_ms = 500;
-	int cas_hangup_ms = 500;
-	ftdm_bool_t busy_timeout = FTDM_FALSE;
-	FILE *ringback_f = NULL;
-	ftdm_bool_t digits_sent = FTDM_FALSE;
 
-	ftdm_unused_arg(me);
-	ftdm_log(FTDM_LOG_DEBUG, "ANALOG EM CHANNEL thread starting.\n");
+	call->tone = tone;
+	call->indicate = 1;
+	if (!analog_data->engine) {
+		ftdm_buffer_zero(call->dt_buffer);
+		teletone_run(&call->ts, ftdmchan->span->tone_map[tone]);
+		return;
+	}
+	call->offset = 0;
+	call->segment = ftdm_tone_cache_get_tone(ftdmchan->span->tone_map[tone], ANALOG_EM_TONE_RATE, ftdmchan->effective_codec);
+}
+
+/**
+ * \brief Prepares a channel to run a call (opens it, enables dtmf detection and opens the ringback file)
+ * \param call Call state to initialise
+ * \param ftdmchan Channel to run
+ * \return Success or failure, analog_em_call_end() must be called in both cases
+ */
+static ftdm_status_t analog_em_call_start(ftdm_analog_em_call_t *call, ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_tone_type_t tt = FTDM_TONE_DTMF;
 
-	ts.buffer = NULL;
+	call->ftdmchan = ftdmchan;
+	call->dt_buffer = NULL;
+	call->ts.buffer = NULL;
+	call->segment = NULL;
+	call->tone = FTDM_TONEMAP_NONE;
+	call->offset = 0;
+	call->ringback_f = NULL;
+	call->dtmf[0] = '\0';
+	call->dtmf_offset = 0;
+	call->state_counter = 0;
+	call->elapsed = 0;
+	call->collecting = 0;
+	call->interval = 0;
+	call->last_digit = 0;
+	call->indicate = 0;
+	call->dial_timeout = 30000;
+	call->cas_answer = 0;
+	call->cas_hangup = 0;
+	call->busy_timeout = FTDM_FALSE;
+	call->digits_sent = FTDM_FALSE;
+
+	ftdm_log(FTDM_LOG_DEBUG, "ANALOG EM CHANNEL thread starting.\n");
 
 	if (ftdm_channel_open_chan(ftdmchan) != FTDM_SUCCESS) {
 		ftdm_log(FTDM_LOG_ERROR, "OPEN ERROR [%s]\n", ftdmchan->last_error);
-		goto done;
+		return FTDM_FAIL;
 	}
 
-	if (ftdm_buffer_create(&dt_buffer, 1024, 3192, 0) != FTDM_SUCCESS) {
+	if (!analog_data->engine && ftdm_buffer_create(&call->dt_buffer, 1024, 3192, 0) != FTDM_SUCCESS) {
 		snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "memory error!");
 		ftdm_log(FTDM_LOG_ERROR, "MEM ERROR\n");
-		goto done;
+		return FTDM_FAIL;
 	}
 
 	if (ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_DTMF_DETECT, &tt) != FTDM_SUCCESS) {
 		snprintf(ftdmchan->last_error, sizeof(ftdmchan->last_error), "error initilizing tone detector!");
 		ftdm_log(FTDM_LOG_ERROR, "TONE ERROR\n");
-		goto done;
+		return FTDM_FAIL;
 	}
 
 	ftdm_set_flag_locked(ftdmchan, FTDM_CHANNEL_INTHREAD);
-	teletone_init_session(&ts, 0, teletone_handler, dt_buffer);
-	ts.rate = 8000;
+	if (call->dt_buffer) {
+		teletone_init_session(&call->ts, 0, teletone_handler, call->dt_buffer);
+		call->ts.rate = 8000;
 #if 0
-	ts.debug = 1;
-	ts.debug_stream = stdout;
+		call->ts.debug = 1;
+		call->ts.debug_stream = stdout;
 #endif
-	ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_INTERVAL, &interval);
-	ftdm_buffer_set_loops(dt_buffer, -1);
-	
-	memset(&sig, 0, sizeof(sig));
-	sig.chan_id = ftdmchan->chan_id;
-	sig.span_id = ftdmchan->span_id;
-	sig.channel = ftdmchan;
-	
-	assert(interval != 0);
-	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "IO Interval: %u\n", interval);
+		ftdm_buffer_set_loops(call->dt_buffer, -1);
+	}
+	ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_INTERVAL, &call->interval);
+
+	memset(&call->sig, 0, sizeof(call->sig));
+	call->sig.chan_id = ftdmchan->chan_id;
+	call->sig.span_id = ftdmchan->span_id;
+	call->sig.channel = ftdmchan;
+
+	assert(call->interval != 0);
+	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "IO Interval: %u\n", call->interval);
 
 	if (analog_data->immediate_ringback && !ftdm_strlen_zero(analog_data->ringback_file)) {
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Using ringback file '%s'\n", analog_data->ringback_file);
-		ringback_f = fopen(analog_data->ringback_file, "rb");
-		if (!ringback_f) {
+		call->ringback_f = fopen(analog_data->ringback_file, "rb");
+		if (!call->ringback_f) {
 			ftdm_log_chan(ftdmchan, FTDM_LOG_ERROR, "Failed to open ringback file '%s'\n", analog_data->ringback_file);
 		} else {
-			if (skip_wave_header(analog_data->ringback_file, ringback_f)) {
-				ringback_f = NULL;
+			if (skip_wave_header(analog_data->ringback_file, call->ringback_f)) {
+				call->ringback_f = NULL;
 			}
 		}
 	}
+	return FTDM_SUCCESS;
+}
 
-	while (ftdm_running() && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_INTHREAD)) {
-		ftdm_wait_flag_t flags = FTDM_READ;
-		ftdm_size_t dlen = 0;
-		
-		elapsed += interval;
-		state_counter += interval;
-
-		if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
-			switch(ftdmchan->state) {
-			case FTDM_CHANNEL_STATE_DIALING:
-				{
-					if (! ftdmchan->needed_tones[FTDM_TONEMAP_RING]
-						&& ftdm_test_flag(ftdmchan, FTDM_CHANNEL_WINK)
-						&& !digits_sent) {
-						if (ftdm_strlen_zero(ftdmchan->caller_data.dnis.digits)) {
-							ftdm_log(FTDM_LOG_ERROR, "No Digits to send!\n");
+/**
+ * \brief Runs the state machine, CAS signal persistence and digit collection of a call
+ * \param call Call to run
+ * \param elapsed Milliseconds elapsed since the previous tick
+ * \return What the caller must do next with the call
+ */
+static ftdm_wheel_action_t analog_em_call_tick(ftdm_analog_em_call_t *call, uint32_t elapsed)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_size_t dlen = 0;
+	int cas_bits = 0;
+
+	call->elapsed += elapsed;
+	call->state_counter += elapsed;
+
+	/* the previous tick is done with the state, a non-blocking answer can move to its next state */
+	if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_IND_CHAIN)) {
+		ftdm_channel_lock(ftdmchan);
+		ftdm_channel_advance_indication(ftdmchan);
+		ftdm_channel_unlock(ftdmchan);
+	}
+
+	if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
+		switch(ftdmchan->state) {
+		case FTDM_CHANNEL_STATE_DIALING:
+			{
+				if (! ftdmchan->needed_tones[FTDM_TONEMAP_RING]
+					&& ftdm_test_flag(ftdmchan, FTDM_CHANNEL_WINK)
+					&& !call->digits_sent) {
+					if (ftdm_strlen_zero(ftdmchan->caller_data.dnis.digits)) {
+						ftdm_log(FTDM_LOG_ERROR, "No Digits to send!\n");
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+					} else {
+						if (ftdm_channel_command(ftdmchan, FTDM_COMMAND_SEND_DTMF, ftdmchan->caller_data.dnis.digits) != FTDM_SUCCESS) {
+							ftdm_log(FTDM_LOG_ERROR, "Send Digits Failed [%s]\n", ftdmchan->last_error);
 							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
 						} else {
-							if (ftdm_channel_command(ftdmchan, FTDM_COMMAND_SEND_DTMF, ftdmchan->caller_data.dnis.digits) != FTDM_SUCCESS) {
-								ftdm_log(FTDM_LOG_ERROR, "Send Digits Failed [%s]\n", ftdmchan->last_error);
-								ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-							} else {
-								state_counter = 0;
-								digits_sent = FTDM_TRUE;
-								ftdmchan->needed_tones[FTDM_TONEMAP_RING] = 1;
-								ftdmchan->needed_tones[FTDM_TONEMAP_BUSY] = 1;
-								ftdmchan->needed_tones[FTDM_TONEMAP_FAIL1] = 1;
-								ftdmchan->needed_tones[FTDM_TONEMAP_FAIL2] = 1;
-								ftdmchan->needed_tones[FTDM_TONEMAP_FAIL3] = 1;
-								dial_timeout = ((ftdmchan->dtmf_on + ftdmchan->dtmf_off) * strlen(ftdmchan->caller_data.dnis.digits)) + 2000;
-								if (analog_data->dial_timeout) {
-									dial_timeout += analog_data->dial_timeout;
-								}
-								ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Outbound dialing timeout: %dms\n", dial_timeout);
-								ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Outbound CAS answer timeout: %dms\n", cas_answer_ms);
+							call->state_counter = 0;
+							call->digits_sent = FTDM_TRUE;
+							ftdmchan->needed_tones[FTDM_TONEMAP_RING] = 1;
+							ftdmchan->needed_tones[FTDM_TONEMAP_BUSY] = 1;
+							ftdmchan->needed_tones[FTDM_TONEMAP_FAIL1] = 1;
+							ftdmchan->needed_tones[FTDM_TONEMAP_FAIL2] = 1;
+							ftdmchan->needed_tones[FTDM_TONEMAP_FAIL3] = 1;
+							call->dial_timeout = ((ftdmchan->dtmf_on + ftdmchan->dtmf_off) * strlen(ftdmchan->caller_data.dnis.digits)) + 2000;
+							if (analog_data->dial_timeout) {
+								call->dial_timeout += analog_data->dial_timeout;
 							}
-						}
-						break;
-					}
-					if (state_counter > dial_timeout) {
-						if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_WINK)) {
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-						} else if (!analog_data->answer_supervision) {
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
+							ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Outbound dialing timeout: %dms\n", call->dial_timeout);
+							ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Outbound CAS answer timeout: %dms\n", ANALOG_EM_CAS_ANSWER_MS);
 						}
 					}
-					cas_bits = 0;
-					ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_CAS_BITS, &cas_bits);
-					if (!(state_counter % 1000)) {
-						ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "CAS bits: 0x%X\n", cas_bits);
-					}
-					if (cas_bits == 0xF) {
-						cas_answer += interval;
-						if (cas_answer >= cas_answer_ms) {
-							ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Answering on CAS answer signal persistence!\n");
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
-						}
-					} else if (cas_answer) {
-						ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Resetting cas answer to 0: 0x%X!\n", cas_bits);
-						cas_answer = 0;
-					}
+					break;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALTONE:
-				{
-					if (state_counter > 10000) {
+				if (call->state_counter > call->dial_timeout) {
+					if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_WINK)) {
 						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+					} else if (!analog_data->answer_supervision) {
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
 					}
 				}
-				break;
-			case FTDM_CHANNEL_STATE_BUSY:
-				{
-					if (state_counter > 20000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_ATTN);
-					}
+				cas_bits = 0;
+				ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_CAS_BITS, &cas_bits);
+				if (!(call->state_counter % 1000)) {
+					ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "CAS bits: 0x%X\n", cas_bits);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_ATTN:
-				{
-					if (state_counter > 20000) {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+				if (cas_bits == 0xF) {
+					call->cas_answer += elapsed;
+					if (call->cas_answer >= ANALOG_EM_CAS_ANSWER_MS) {
+						ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Answering on CAS answer signal persistence!\n");
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
 					}
+				} else if (call->cas_answer) {
+					ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Resetting cas answer to 0: 0x%X!\n", cas_bits);
+					call->cas_answer = 0;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_HANGUP:
-				{
-					if (state_counter > 500) {
-						if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && 
-							(ftdmchan->last_state == FTDM_CHANNEL_STATE_RINGING || ftdmchan->last_state == FTDM_CHANNEL_STATE_DIALTONE 
-							 || ftdmchan->last_state == FTDM_CHANNEL_STATE_RING)) {
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-						} else {
-							ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
-							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-						}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALTONE:
+			{
+				if (call->state_counter > 10000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+				}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_BUSY:
+			{
+				if (call->state_counter > 20000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_ATTN);
+				}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_ATTN:
+			{
+				if (call->state_counter > 20000) {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+				}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_HANGUP:
+			{
+				if (call->state_counter > 500) {
+					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) &&
+						(ftdmchan->last_state == FTDM_CHANNEL_STATE_RINGING || ftdmchan->last_state == FTDM_CHANNEL_STATE_DIALTONE
+						 || ftdmchan->last_state == FTDM_CHANNEL_STATE_RING)) {
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+					} else {
+						ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
+						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 					}
 				}
-				break;
-			case FTDM_CHANNEL_STATE_UP:
-			case FTDM_CHANNEL_STATE_RING:
-				{
-					ftdm_sleep(interval);
-					if (ftdmchan->state == FTDM_CHANNEL_STATE_UP) {
-						cas_bits = 0;
-						ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_CAS_BITS, &cas_bits);
-						if (cas_bits == 0x0) {
-							cas_hangup += interval;
-							if (cas_hangup >= cas_hangup_ms) {
-								ftdm_log_chan_msg(ftdmchan, FTDM_LOG_INFO, "Hanging up on CAS hangup signal persistence\n");
-								ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_HANGUP);
-							}
-						} else if (cas_hangup) {
-							ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Resetting cas hangup to 0: 0x%X!\n", cas_bits);
-							cas_hangup = 0;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_UP:
+		case FTDM_CHANNEL_STATE_RING:
+			{
+				if (ftdmchan->state == FTDM_CHANNEL_STATE_UP) {
+					cas_bits = 0;
+					ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_CAS_BITS, &cas_bits);
+					if (cas_bits == 0x0) {
+						call->cas_hangup += elapsed;
+						if (call->cas_hangup >= ANALOG_EM_CAS_HANGUP_MS) {
+							ftdm_log_chan_msg(ftdmchan, FTDM_LOG_INFO, "Hanging up on CAS hangup signal persistence\n");
+							ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_HANGUP);
 						}
+					} else if (call->cas_hangup) {
+						ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Resetting cas hangup to 0: 0x%X!\n", cas_bits);
+						call->cas_hangup = 0;
 					}
-					continue;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_DOWN:
-				{
-					goto done;
-				}
-				break;
-			default:
-				break;
+				return FTDM_WHEEL_SLEEP;
 			}
-		} else {
-			ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
-			ftdm_channel_complete_state(ftdmchan);
-			indicate = 0;
-			state_counter = 0;
-
-			ftdm_log(FTDM_LOG_DEBUG, "Executing state handler on %d:%d for %s\n", 
-					ftdmchan->span_id, ftdmchan->chan_id,
-					ftdm_channel_state2str(ftdmchan->state));
-			switch(ftdmchan->state) {
-			case FTDM_CHANNEL_STATE_UP:
-				{
-					ftdm_channel_use(ftdmchan);
-					ftdm_channel_clear_needed_tones(ftdmchan);
-					ftdm_channel_flush_dtmf(ftdmchan);
-
-					if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
-						ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
-					}
-
-					sig.event_id = FTDM_SIGEVENT_UP;
+			break;
+		case FTDM_CHANNEL_STATE_DOWN:
+			{
+				return FTDM_WHEEL_DONE;
+			}
+			break;
+		default:
+			break;
+		}
+	} else {
+		ftdm_clear_flag_locked(ftdmchan->span, FTDM_SPAN_STATE_CHANGE);
+		ftdm_channel_complete_state(ftdmchan);
+		call->indicate = 0;
+		call->state_counter = 0;
+
+		ftdm_log(FTDM_LOG_DEBUG, "Executing state handler on %d:%d for %s\n",
+				ftdmchan->span_id, ftdmchan->chan_id,
+				ftdm_channel_state2str(ftdmchan->state));
+		switch(ftdmchan->state) {
+		case FTDM_CHANNEL_STATE_UP:
+			{
+				ftdm_channel_use(ftdmchan);
+				ftdm_channel_clear_needed_tones(ftdmchan);
+				ftdm_channel_flush_dtmf(ftdmchan);
 
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					continue;
-				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALING:
-				{
-					ftdm_channel_use(ftdmchan);
+				if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK)) {
+					ftdm_channel_command(ftdmchan, FTDM_COMMAND_OFFHOOK, NULL);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_RING:
-				{
-					ftdm_channel_use(ftdmchan);
 
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
-						ftdm_set_string(ftdmchan->caller_data.dnis.digits, ftdmchan->chan_number);
-					} else {
-						ftdm_set_string(ftdmchan->caller_data.dnis.digits, dtmf);
-					}
+				call->sig.event_id = FTDM_SIGEVENT_UP;
 
-					sig.event_id = FTDM_SIGEVENT_START;
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_AGAIN;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALING:
+			{
+				ftdm_channel_use(ftdmchan);
+			}
+			break;
+		case FTDM_CHANNEL_STATE_RING:
+			{
+				ftdm_channel_use(ftdmchan);
 
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					continue;
-				}
-				break;
-			case FTDM_CHANNEL_STATE_DOWN:
-				{
-					sig.event_id = FTDM_SIGEVENT_STOP;
-					ftdm_span_send_signal(ftdmchan->span, &sig);
-					goto done;
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
+					ftdm_set_string(ftdmchan->caller_data.dnis.digits, ftdmchan->chan_number);
+				} else {
+					ftdm_set_string(ftdmchan->caller_data.dnis.digits, call->dtmf);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_DIALTONE:
-				{
-					memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
-					*dtmf = '\0';
-					dtmf_offset = 0;
-					ftdm_buffer_zero(dt_buffer);
-					teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_DIAL]);
-					indicate = 1;
-
-					ftdm_channel_command(ftdmchan, FTDM_COMMAND_WINK, NULL);
+
+				call->sig.event_id = FTDM_SIGEVENT_START;
+
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_AGAIN;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DOWN:
+			{
+				call->sig.event_id = FTDM_SIGEVENT_STOP;
+				ftdm_span_send_signal(ftdmchan->span, &call->sig);
+				return FTDM_WHEEL_DONE;
+			}
+			break;
+		case FTDM_CHANNEL_STATE_DIALTONE:
+			{
+				memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
+				*call->dtmf = '\0';
+				call->dtmf_offset = 0;
+				analog_em_call_set_tone(call, FTDM_TONEMAP_DIAL);
+
+				ftdm_channel_command(ftdmchan, FTDM_COMMAND_WINK, NULL);
+				if (analog_data->engine && call->attach_time) {
+					/* the engine runs in a single thread, it owns the span histograms */
+					ftdm_histogram_record_since(&analog_data->engine->wink, call->attach_time);
+					call->attach_time = 0;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_RINGING:
-				{
-					if (!analog_data->immediate_ringback) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_RING]);
-						indicate = 1;
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_RINGING:
+			{
+				if (!analog_data->immediate_ringback) {
+					analog_em_call_set_tone(call, FTDM_TONEMAP_RING);
 				}
-				break;
-			case FTDM_CHANNEL_STATE_BUSY:
-				{
-					ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CIRCUIT_CONGESTION;
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_BUSY]);
-						indicate = 1;
-					} else {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-						busy_timeout = FTDM_TRUE;
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_BUSY:
+			{
+				ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CIRCUIT_CONGESTION;
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
+					analog_em_call_set_tone(call, FTDM_TONEMAP_BUSY);
+				} else {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+					call->busy_timeout = FTDM_TRUE;
 				}
-				break;
-			case FTDM_CHANNEL_STATE_ATTN:
-				{
-					if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_ATTN]);
-						indicate = 1;
-					} else {
-						ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
-					}
+			}
+			break;
+		case FTDM_CHANNEL_STATE_ATTN:
+			{
+				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OFFHOOK) && !ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
+					analog_em_call_set_tone(call, FTDM_TONEMAP_ATTN);
+				} else {
+					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 				}
-				break;
-			default:
-				break;
 			}
+			break;
+		default:
+			break;
 		}
+	}
 
 
-		if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE || ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT) {
-			if ((dlen = ftdm_channel_dequeue_dtmf(ftdmchan, dtmf + dtmf_offset, sizeof(dtmf) - strlen(dtmf)))) {
+	if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE || ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT) {
+		if ((dlen = ftdm_channel_dequeue_dtmf(ftdmchan, call->dtmf + call->dtmf_offset, sizeof(call->dtmf) - strlen(call->dtmf)))) {
 
-				if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE) {
-					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_COLLECT);
-					collecting = 1;
-				}
-				dtmf_offset = strlen(dtmf);
-				last_digit = elapsed;
-				sig.event_id = FTDM_SIGEVENT_COLLECTED_DIGIT;
-				ftdm_set_string(sig.ev_data.collected.digits, dtmf);
-				if (ftdm_span_send_signal(ftdmchan->span, &sig) == FTDM_BREAK) {
-					collecting = 0;
-				}
+			if (ftdmchan->state == FTDM_CHANNEL_STATE_DIALTONE) {
+				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_COLLECT);
+				call->collecting = 1;
+			}
+			call->dtmf_offset = strlen(call->dtmf);
+			call->last_digit = call->elapsed;
+			call->sig.event_id = FTDM_SIGEVENT_COLLECTED_DIGIT;
+			ftdm_set_string(call->sig.ev_data.collected.digits, call->dtmf);
+			if (ftdm_span_send_signal(ftdmchan->span, &call->sig) == FTDM_BREAK) {
+				call->collecting = 0;
 			}
 		}
+	}
 
-		if (last_digit && (!collecting || ((elapsed - last_digit > analog_data->digit_timeout) || strlen(dtmf) > analog_data->max_dialstr))) {
-			ftdm_log(FTDM_LOG_DEBUG, "Number obtained [%s]\n", dtmf);
-			ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
-			last_digit = 0;
-			collecting = 0;
-		}
+	if (call->last_digit && (!call->collecting || ((call->elapsed - call->last_digit > analog_data->digit_timeout) || strlen(call->dtmf) > analog_data->max_dialstr))) {
+		ftdm_log(FTDM_LOG_DEBUG, "Number obtained [%s]\n", call->dtmf);
+		ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_RING);
+		call->last_digit = 0;
+		call->collecting = 0;
+	}
 
-		if (ftdm_channel_wait(ftdmchan, &flags, interval * 2) != FTDM_SUCCESS) {
-			continue;
-		}
+	return FTDM_WHEEL_IO;
+}
 
-		if (!(flags & FTDM_READ)) {
-			continue;
-		}
+/**
+ * \brief Reads one frame of a readable channel, runs the progress detection and writes the indicated tone
+ * \param call Call to run
+ * \return FTDM_WHEEL_AGAIN or FTDM_WHEEL_DONE on fatal errors
+ */
+static ftdm_wheel_action_t analog_em_call_io(ftdm_analog_em_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+	uint8_t frame[1024];
+	ftdm_size_t len, rlen;
 
-		/* Do not try to read more than the proper interval size */
-		len = ftdmchan->packet_len * 2;
-		if (ftdm_channel_read(ftdmchan, frame, &len) != FTDM_SUCCESS) {
-			ftdm_log(FTDM_LOG_ERROR, "READ ERROR [%s]\n", ftdmchan->last_error);
-			goto done;
-		}
+	/* Do not try to read more than the proper interval size */
+	len = ftdmchan->packet_len * 2;
+	if (ftdm_channel_read(ftdmchan, frame, &len) != FTDM_SUCCESS) {
+		ftdm_log(FTDM_LOG_ERROR, "READ ERROR [%s]\n", ftdmchan->last_error);
+		return FTDM_WHEEL_DONE;
+	}
 
-		if (0 == len) {
-			ftdm_log(FTDM_LOG_DEBUG, "Nothing read\n");
-			continue;
-		}
+	if (0 == len) {
+		ftdm_log(FTDM_LOG_DEBUG, "Nothing read\n");
+		return FTDM_WHEEL_AGAIN;
+	}
 
-		if (len >= (sizeof(frame)/2)) {
-			ftdm_log(FTDM_LOG_CRIT, "Ignoring big read of %zd bytes!\n", len);
-			continue;
-		}
+	if (len >= (sizeof(frame)/2)) {
+		ftdm_log(FTDM_LOG_CRIT, "Ignoring big read of %zd bytes!\n", len);
+		return FTDM_WHEEL_AGAIN;
+	}
 
-		if (ftdmchan->detected_tones[0]) {
-			int i;
-			
-			for (i = 1; i < FTDM_TONEMAP_INVALID; i++) {
-				if (ftdmchan->detected_tones[i]) {
-					ftdm_log(FTDM_LOG_DEBUG, "Detected tone %s on %d:%d\n", ftdm_tonemap2str(i), ftdmchan->span_id, ftdmchan->chan_id);
-				}
-			}
-			
-			if (ftdmchan->detected_tones[FTDM_TONEMAP_BUSY] || 
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL1] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL2] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_FAIL3] ||
-				ftdmchan->detected_tones[FTDM_TONEMAP_ATTN]
-				) {
-				ftdm_log(FTDM_LOG_ERROR, "Failure indication detected!\n");
-				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
-			} else if (ftdmchan->detected_tones[FTDM_TONEMAP_RING]) {
-				if (!analog_data->answer_supervision) {
-					ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
-				} else {
-					ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Ringing, but not answering since answer supervision is enabled\n");
-				}
-			}
-			
-			ftdm_channel_clear_detected_tones(ftdmchan);
-		}
+	if (ftdmchan->detected_tones[0]) {
+		int i;
 
-		if ((ftdmchan->dtmf_buffer && ftdm_buffer_inuse(ftdmchan->dtmf_buffer))) {
-			rlen = len;
-			memset(frame, 0, len);
-			ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
-			continue;
+		for (i = 1; i < FTDM_TONEMAP_INVALID; i++) {
+			if (ftdmchan->detected_tones[i]) {
+				ftdm_log(FTDM_LOG_DEBUG, "Detected tone %s on %d:%d\n", ftdm_tonemap2str(i), ftdmchan->span_id, ftdmchan->chan_id);
+			}
 		}
 
-		if (analog_data->immediate_ringback &&
-		    (ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT ||
-		     ftdmchan->state == FTDM_CHANNEL_STATE_RING ||
-		     ftdmchan->state == FTDM_CHANNEL_STATE_RINGING ||
-		     ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS ||
-		     ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS_MEDIA
-		     )) {
-			indicate = 1;
-			if (!ringback_f) {
-				ftdm_buffer_zero(dt_buffer);
-				teletone_run(&ts, ftdmchan->span->tone_map[FTDM_TONEMAP_RING]);
+		if (ftdmchan->detected_tones[FTDM_TONEMAP_BUSY] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL1] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL2] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_FAIL3] ||
+			ftdmchan->detected_tones[FTDM_TONEMAP_ATTN]
+			) {
+			ftdm_log(FTDM_LOG_ERROR, "Failure indication detected!\n");
+			ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_BUSY);
+		} else if (ftdmchan->detected_tones[FTDM_TONEMAP_RING]) {
+			if (!analog_data->answer_supervision) {
+				ftdm_set_state_locked(ftdmchan, FTDM_CHANNEL_STATE_UP);
+			} else {
+				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "Ringing, but not answering since answer supervision is enabled\n");
 			}
 		}
-		
-		if (!indicate) {
-			continue;
+
+		ftdm_channel_clear_detected_tones(ftdmchan);
+	}
+
+	if ((ftdmchan->dtmf_buffer && ftdm_buffer_inuse(ftdmchan->dtmf_buffer))) {
+		rlen = len;
+		memset(frame, 0, len);
+		ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
+		return FTDM_WHEEL_AGAIN;
+	}
+
+	if (analog_data->immediate_ringback &&
+	    (ftdmchan->state == FTDM_CHANNEL_STATE_COLLECT ||
+	     ftdmchan->state == FTDM_CHANNEL_STATE_RING ||
+	     ftdmchan->state == FTDM_CHANNEL_STATE_RINGING ||
+	     ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS ||
+	     ftdmchan->state == FTDM_CHANNEL_STATE_PROGRESS_MEDIA
+	     )) {
+		call->indicate = 1;
+		if (!call->ringback_f && (!analog_data->engine || call->tone != FTDM_TONEMAP_RING)) {
+			analog_em_call_set_tone(call, FTDM_TONEMAP_RING);
 		}
+	}
 
+	if (!call->indicate) {
+		return FTDM_WHEEL_AGAIN;
+	}
+
+	if (call->ringback_f || call->dt_buffer) {
+		/* the ringback file and the tones rendered by teletone are linear, encode them in the codec of the channel */
 		if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
 			len *= 2;
 		}
 
-		if (ringback_f) {
+		if (call->ringback_f) {
 			uint8_t failed_read = 0;
 read_try:
-			rlen = fread(frame, 1, len, ringback_f);
+			rlen = fread(frame, 1, len, call->ringback_f);
 			if (rlen != len) {
-				if (!feof(ringback_f)) {
+				if (!feof(call->ringback_f)) {
 					ftdm_log(FTDM_LOG_ERROR, "Error reading from ringback file: %zd != %zd\n", rlen, len);
 				}
 				if (failed_read) {
-					continue;
+					return FTDM_WHEEL_AGAIN;
 				}
 				/* return cursor to start of wav file */
-				fseek(ringback_f, WAVE_HEADER_LEN, SEEK_SET);
+				fseek(call->ringback_f, WAVE_HEADER_LEN, SEEK_SET);
 				failed_read++;
 				goto read_try;
 			}
 		} else {
-			rlen = ftdm_buffer_read_loop(dt_buffer, frame, len);
+			rlen = ftdm_buffer_read_loop(call->dt_buffer, frame, len);
 		}
 
 		if (ftdmchan->effective_codec != FTDM_CODEC_SLIN) {
@@ -947,22 +1228,54 @@ read_try:
 				codec_func(frame, sizeof(frame), &rlen);
 			} else {
 				ftdm_log(FTDM_LOG_ERROR, "codec error, no codec function for native codec %d!", ftdmchan->native_codec);
-				goto done;
+				return FTDM_WHEEL_DONE;
 			}
 		}
+	} else {
+		const ftdm_tone_segment_t *segment;
 
-		/* we must lock the channel and make sure we let our own generated audio thru (FTDM_ANALOG_EM_LOCAL_WRITE is tested in the ftdm_analog_em_sig_write handler)*/
-		ftdm_channel_lock(ftdmchan);
-		ftdm_set_sflag(ftdmchan, FTDM_ANALOG_EM_LOCAL_WRITE);
-		ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
-		ftdm_clear_sflag(ftdmchan, FTDM_ANALOG_EM_LOCAL_WRITE);
-		ftdm_channel_unlock(ftdmchan);
+		if (call->segment && call->segment->codec != ftdmchan->effective_codec) {
+			analog_em_call_set_tone(call, call->tone);
+		}
+		if (!(segment = call->segment)) {
+			return FTDM_WHEEL_AGAIN;
+		}
+
+		/* the segment is in the effective codec of the channel, write as much as we read */
+		rlen = 0;
+		while (rlen < len) {
+			ftdm_size_t chunk = ftdm_min(len - rlen, segment->len - call->offset);
+
+			memcpy(frame + rlen, segment->data + call->offset, chunk);
+			rlen += chunk;
+			call->offset = (call->offset + chunk) % segment->len;
+		}
 	}
 
- done:
+	/* we must lock the channel and make sure we let our own generated audio thru (FTDM_ANALOG_EM_LOCAL_WRITE is tested in the ftdm_analog_em_sig_write handler)*/
+	ftdm_channel_lock(ftdmchan);
+	ftdm_set_sflag(ftdmchan, FTDM_ANALOG_EM_LOCAL_WRITE);
+	ftdm_channel_write(ftdmchan, frame, sizeof(frame), &rlen);
+	ftdm_clear_sflag(ftdmchan, FTDM_ANALOG_EM_LOCAL_WRITE);
+	ftdm_channel_unlock(ftdmchan);
+	return FTDM_WHEEL_AGAIN;
+}
+
+/**
+ * \brief Releases the channel and the resources of a call
+ * \param call Call to end
+ *
+ * The call object is free to be reused as soon as FTDM_CHANNEL_INTHREAD is cleared.
+ */
+static void analog_em_call_end(ftdm_analog_em_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	ftdm_analog_em_data_t *analog_data = ftdmchan->span->signal_data;
+	ftdm_channel_t *closed_chan;
+	int cas_bits = 0;
 
 	ftdm_channel_command(ftdmchan, FTDM_COMMAND_ONHOOK, NULL);
-	if (busy_timeout) {
+	if (call->busy_timeout) {
 		ftdm_channel_command(ftdmchan, FTDM_COMMAND_GET_CAS_BITS, &cas_bits);
 		if (cas_bits == 0XF) {
 			/* the remote end never sent any digits, neither moved to onhook, let's stay suspended */
@@ -970,31 +1283,232 @@ read_try:
 			analog_em_set_channel_sig_status_ex(ftdmchan, FTDM_SIG_STATE_SUSPENDED, FTDM_TRUE);
 		}
 	}
-	
+
 	closed_chan = ftdmchan;
 	ftdm_channel_close(&ftdmchan);
 
 	ftdm_channel_command(closed_chan, FTDM_COMMAND_SET_NATIVE_CODEC, NULL);
 
-	if (ts.buffer) {
-		teletone_destroy_session(&ts);
+	call->segment = NULL;
+
+	if (call->ts.buffer) {
+		teletone_destroy_session(&call->ts);
 	}
 
-	if (dt_buffer) {
-		ftdm_buffer_destroy(&dt_buffer);
+	if (call->dt_buffer) {
+		ftdm_buffer_destroy(&call->dt_buffer);
 	}
 
-	if (ringback_f) {
-		fclose(ringback_f);
+	if (call->ringback_f) {
+		fclose(call->ringback_f);
+		call->ringback_f = NULL;
+	}
+
+	if (analog_data->engine) {
+		/* the channel can be attached again once it is out of the thread */
+		ftdm_mutex_lock(analog_data->engine->mutex);
+		call->attached = 0;
+		ftdm_mutex_unlock(analog_data->engine->mutex);
 	}
 
 	ftdm_clear_flag(closed_chan, FTDM_CHANNEL_INTHREAD);
 
 	ftdm_log(FTDM_LOG_DEBUG, "ANALOG EM CHANNEL thread ended.\n");
+}
+
+/**
+ * \brief Main thread function for EM channel (outgoing call)
+ * \param me Current thread
+ * \param obj Channel to run in this thread
+ */
+static void *ftdm_analog_em_channel_run(ftdm_thread_t *me, void *obj)
+{
+	ftdm_analog_em_call_t call;
+
+	ftdm_unused_arg(me);
+
+	memset(&call, 0, sizeof(call));
+
+	if (analog_em_call_start(&call, obj) != FTDM_SUCCESS) {
+		goto done;
+	}
+
+	while (ftdm_running() && ftdm_test_flag(call.ftdmchan, FTDM_CHANNEL_INTHREAD)) {
+		ftdm_wait_flag_t flags = FTDM_READ;
+
+		switch (analog_em_call_tick(&call, call.interval)) {
+		case FTDM_WHEEL_DONE:
+			goto done;
+		case FTDM_WHEEL_SLEEP:
+			ftdm_sleep(call.interval);
+			continue;
+		case FTDM_WHEEL_AGAIN:
+			continue;
+		case FTDM_WHEEL_IO:
+			break;
+		}
+
+		if (ftdm_channel_wait(call.ftdmchan, &flags, call.interval * 2) != FTDM_SUCCESS) {
+			continue;
+		}
+
+		if (!(flags & FTDM_READ)) {
+			continue;
+		}
+
+		if (analog_em_call_io(&call) == FTDM_WHEEL_DONE) {
+			goto done;
+		}
+	}
+
+ done:
+
+	analog_em_call_end(&call);
 
 	return NULL;
 }
 
+static ftdm_wheel_action_t analog_em_wheel_tick(void *obj, uint32_t elapsed)
+{
+	return analog_em_call_tick(obj, elapsed);
+}
+
+static ftdm_wheel_action_t analog_em_wheel_io(void *obj)
+{
+	return analog_em_call_io(obj);
+}
+
+static const ftdm_wheel_ops_t analog_em_wheel_ops = {
+	analog_em_wheel_tick,
+	analog_em_wheel_io
+};
+
+/**
+ * \brief Moves a scheduled call to the list of calls to run on this loop (ie, a wink was received)
+ * \param engine Span engine
+ * \param ftdmchan Channel of the call
+ */
+static void analog_em_engine_kick(ftdm_analog_em_engine_t *engine, ftdm_channel_t *ftdmchan)
+{
+	ftdm_analog_em_call_t *call = &engine->calls[ftdmchan->chan_id];
+
+	if (ftdm_wheel_cancel(&engine->wheel, &call->timer)) {
+		call->next = engine->ready;
+		engine->ready = call;
+	}
+}
+
+/**
+ * \brief Starts the attached calls and runs the calls that are due, called by the span thread
+ * \param engine Span engine
+ */
+static void analog_em_engine_run(ftdm_analog_em_engine_t *engine)
+{
+	ftdm_analog_em_call_t *call, *next;
+	ftdm_wheel_timer_t *timer, *next_timer;
+	ftdm_time_t now = ftdm_current_time_in_ms();
+
+	ftdm_mutex_lock(engine->mutex);
+	call = engine->pending;
+	engine->pending = NULL;
+	ftdm_mutex_unlock(engine->mutex);
+
+	for (; call; call = next) {
+		next = call->next;
+
+		if (analog_em_call_start(call, call->ftdmchan) != FTDM_SUCCESS) {
+			analog_em_call_end(call);
+			continue;
+		}
+		engine->count++;
+		call->timer.obj = call;
+		call->timer.last = now;
+		call->next = engine->ready;
+		engine->ready = call;
+	}
+
+	for (timer = ftdm_wheel_expire(&engine->wheel, now); timer; timer = next_timer) {
+		next_timer = timer->next;
+		call = timer->obj;
+		/* how late the timer fires, this is the jitter of the call ticks: wink, CAS persistence and dial timeouts.
+		 * The release guard is checked by the core when hunting channels, it does not run on the wheel */
+		ftdm_histogram_record(&engine->lateness, (now - timer->due) * 1000000);
+		call->next = engine->ready;
+		engine->ready = call;
+	}
+
+	while ((call = engine->ready)) {
+		engine->ready = call->next;
+		if (ftdm_wheel_service(&engine->wheel, &call->timer, call->ftdmchan, call->interval, &analog_em_wheel_ops, now) == FTDM_WHEEL_DONE) {
+			engine->count--;
+			analog_em_call_end(call);
+		}
+	}
+}
+
+/**
+ * \brief Hangs up a call still served by the span engine when it stops
+ * \param call Call to hang up
+ *
+ * The call goes to DOWN through the state machine so the user gets FTDM_SIGEVENT_STOP.
+ */
+static void analog_em_call_release(ftdm_analog_em_call_t *call)
+{
+	ftdm_channel_t *ftdmchan = call->ftdmchan;
+	int i;
+
+	for (i = 0; i < FTDM_WHEEL_MAX_STEPS; i++) {
+		ftdm_channel_lock(ftdmchan);
+		if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE) && ftdmchan->state != FTDM_CHANNEL_STATE_DOWN) {
+			ftdmchan->caller_data.hangup_cause = FTDM_CAUSE_NORMAL_CLEARING;
+			ftdm_set_state(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+		}
+		ftdm_channel_unlock(ftdmchan);
+
+		if (analog_em_call_tick(call, 0) == FTDM_WHEEL_DONE) {
+			break;
+		}
+	}
+	analog_em_call_end(call);
+}
+
+/**
+ * \brief Hangs up the calls still served by the span engine, called by the span thread when it stops
+ * \param engine Span engine
+ */
+static void analog_em_engine_release(ftdm_analog_em_engine_t *engine)
+{
+	ftdm_analog_em_call_t *call, *next;
+	ftdm_wheel_timer_t *timer, *next_timer;
+
+	ftdm_mutex_lock(engine->mutex);
+	call = engine->pending;
+	engine->pending = NULL;
+	ftdm_mutex_unlock(engine->mutex);
+
+	/* calls attached meanwhile were never started */
+	for (; call; call = next) {
+		next = call->next;
+		if (analog_em_call_start(call, call->ftdmchan) != FTDM_SUCCESS) {
+			analog_em_call_end(call);
+			continue;
+		}
+		analog_em_call_release(call);
+	}
+
+	for (call = engine->ready; call; call = next) {
+		next = call->next;
+		analog_em_call_release(call);
+	}
+	engine->ready = NULL;
+
+	for (timer = ftdm_wheel_flush(&engine->wheel); timer; timer = next_timer) {
+		next_timer = timer->next;
+		analog_em_call_release(timer->obj);
+	}
+	engine->count = 0;
+}
+
 /**
  * \brief Processes EM events coming from ftdmtel/dahdi
  * \param span Span on which the event was fired
@@ -1003,6 +1517,7 @@ read_try:
  */
 static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *event)
 {
+	ftdm_analog_em_data_t *analog_data = span->signal_data;
 	ftdm_sigmsg_t sig;
 	int locked = 0;
 	
@@ -1011,7 +1526,6 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 	sig.span_id = event->channel->span_id;
 	sig.channel = event->channel;
 
-	ftdm_unused_arg(span);
 	ftdm_log(FTDM_LOG_DEBUG, "EVENT [%s][%d:%d] STATE [%s]\n", 
 			ftdm_oob_event2str(event->enum_id), event->channel->span_id, event->channel->chan_id, ftdm_channel_state2str(event->channel->state));
 
@@ -1048,7 +1562,7 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 				ftdm_set_state_locked(event->channel, FTDM_CHANNEL_STATE_DIALTONE);
 				ftdm_mutex_unlock(event->channel->mutex);
 				locked = 0;
-				ftdm_thread_create_detached(ftdm_analog_em_channel_run, event->channel);
+				analog_em_run_channel(event->channel);
 			}
 		break;
 		}
@@ -1064,6 +1578,11 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 		break;
 	}
 
+	if (analog_data->engine) {
+		/* run the call on this loop rather than on its next tick, ie: send the digits as soon as the wink comes */
+		analog_em_engine_kick(analog_data->engine, event->channel);
+	}
+
 done:
 
 	if (locked) {
@@ -1081,6 +1600,7 @@ static void *ftdm_analog_em_run(ftdm_thread_t *me, void *obj)
 {
 	ftdm_span_t *span = (ftdm_span_t *) obj;
 	ftdm_analog_em_data_t *analog_data = span->signal_data;
+	ftdm_analog_em_engine_t *engine = analog_data->engine;
 
 	ftdm_unused_arg(me);
 	ftdm_log(FTDM_LOG_DEBUG, "ANALOG EM thread starting.\n");
@@ -1090,6 +1610,13 @@ static void *ftdm_analog_em_run(ftdm_thread_t *me, void *obj)
 		int waitms = 10;
 		ftdm_status_t status;
 
+		if (engine && engine->count) {
+			/* wake up for the next slot of the timer wheel */
+			ftdm_time_t now = ftdm_current_time_in_ms();
+			waitms = engine->wheel.current > now ? (int)ftdm_min(engine->wheel.current - now, 10) : 0;
+		}
+
+		ftdm_span_metrics_loop_mark(span);
 		status = ftdm_span_poll_event(span, waitms, NULL);
 		
 		switch(status) {
@@ -1115,14 +1642,29 @@ static void *ftdm_analog_em_run(ftdm_thread_t *me, void *obj)
 			break;
 		}
 
+		if (engine) {
+			analog_em_engine_run(engine);
+		}
 	}
 
  end:
 
+	if (engine) {
+		ftdm_mutex_lock(engine->mutex);
+		engine->accept = 0;
+		ftdm_mutex_unlock(engine->mutex);
+		analog_em_engine_release(engine);
+	}
+
 	ftdm_clear_flag(analog_data, FTDM_ANALOG_EM_RUNNING);
 	
 	ftdm_log(FTDM_LOG_DEBUG, "ANALOG EM thread ending.\n");
 
+	if (engine) {
+		/* last access to the engine, ftdm_analog_em_stop() is waiting for this */
+		engine->running = 0;
+	}
+
 	return NULL;
 }
 
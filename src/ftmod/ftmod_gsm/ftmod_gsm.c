@@ -1243,6 +1243,7 @@ static void *ftdm_gsm_run(ftdm_thread_t *me, void *obj)
 	}
 
 	while (ftdm_running() && ftdm_test_flag(gsm_data, FTDM_GSM_SPAN_STARTED)) {
+		ftdm_span_metrics_loop_mark(span);
 		wat_span_run(span->span_id);
 		ftdm_sched_run(gsm_data->sched);
 
@@ -53,6 +53,166 @@
 #define DEFAULT_NATIONAL_PREFIX 	"0"
 #define DEFAULT_INTERNATIONAL_PREFIX	"00"
 
+/* NFAS groups, shared by all isdn spans */
+static ftdm_isdn_nfas_group_t nfas_groups[FTDM_ISDN_NFAS_MAX_GROUPS];
+static int num_nfas_groups = 0;
+
+/*****************************************************************************************
+ * NFAS
+ *          One D-channel (on the "dchan span") controls the B-channels of all
+ *          spans in the group, spans are addressed by the interface identifier
+ *          in the Channel ID IE.
+ *****************************************************************************************/
+
+/**
+ * \brief	Check whether the span carries the D-channel for its (NFAS) signalling
+ */
+static __inline__ int ftdm_isdn_has_dchan(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+	return (!isdn_data->nfas || isdn_data->nfas->dchan_span == span) ? 1 : 0;
+}
+
+/**
+ * \brief	Get the signalling data (Q.921/Q.931 instance) controlling a span
+ * \param	span	Span to get the signalling data for
+ * \return	Signalling data of the NFAS D-channel span, or the span's own data
+ */
+static __inline__ ftdm_isdn_data_t *ftdm_isdn_get_dchan_data(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+
+	if (isdn_data->nfas && isdn_data->nfas->dchan_span) {
+		return isdn_data->nfas->dchan_span->signal_data;
+	}
+	return isdn_data;
+}
+
+/**
+ * \brief	Get the NFAS group member addressed by a Channel ID IE
+ * \param	span	Span the message has been received on (D-channel span)
+ * \param	chanid	Channel ID IE of the message
+ * \return	Member span, NULL if the interface identifier is unknown
+ */
+static ftdm_span_t *ftdm_isdn_nfas_get_span(ftdm_span_t *span, const Q931ie_ChanID *chanid)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+
+	if (!isdn_data->nfas || !chanid->IntIDPresent) {
+		return span;
+	}
+	if (chanid->InterfaceID >= FTDM_ISDN_NFAS_MAX_SPANS) {
+		return NULL;
+	}
+	return isdn_data->nfas->spans[chanid->InterfaceID];
+}
+
+/**
+ * \brief	Add the NFAS interface identifier of a span to a Channel ID IE
+ * \param	span	Span the B-channel belongs to
+ * \param	chanid	Channel ID IE to update
+ */
+static __inline__ void ftdm_isdn_nfas_set_chanid(ftdm_span_t *span, Q931ie_ChanID *chanid)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+
+	if (isdn_data->nfas && chanid->IntType) {
+		chanid->IntIDPresent = 1;
+		chanid->InterfaceID  = (L3UCHAR)isdn_data->nfas_iface;
+	}
+}
+
+/**
+ * \brief	Add a span to a NFAS group (the group is created on first use)
+ * \param	span		Span to add
+ * \param	isdn_data	Signalling data of the span
+ * \param	name		NFAS group name
+ * \param	iface		Interface identifier of the span
+ * \param	has_dchan	Span carries the D-channel of the group
+ * \return	Success or failure
+ */
+static ftdm_status_t ftdm_isdn_nfas_add_span(ftdm_span_t *span, ftdm_isdn_data_t *isdn_data, const char *name, int iface, int has_dchan)
+{
+	ftdm_isdn_nfas_group_t *group = NULL;
+	int i;
+
+	for (i = 0; i < num_nfas_groups; i++) {
+		if (!strcasecmp(nfas_groups[i].name, name)) {
+			group = &nfas_groups[i];
+			break;
+		}
+	}
+
+	if (!group) {
+		if (num_nfas_groups >= FTDM_ISDN_NFAS_MAX_GROUPS) {
+			snprintf(span->last_error, sizeof(span->last_error), "Too many NFAS groups (max. %d)", FTDM_ISDN_NFAS_MAX_GROUPS);
+			return FTDM_FAIL;
+		}
+		group = &nfas_groups[num_nfas_groups++];
+		memset(group, 0, sizeof(*group));
+		ftdm_copy_string(group->name, name, sizeof(group->name));
+	}
+
+	if (group->spans[iface]) {
+		snprintf(span->last_error, sizeof(span->last_error), "NFAS group '%s' already has span '%s' with interface id %d",
+			group->name, ftdm_span_get_name(group->spans[iface]), iface);
+		return FTDM_FAIL;
+	}
+
+	if (has_dchan) {
+		if (group->dchan_span) {
+			snprintf(span->last_error, sizeof(span->last_error), "NFAS group '%s' already has a D-Channel on span '%s'",
+				group->name, ftdm_span_get_name(group->dchan_span));
+			return FTDM_FAIL;
+		}
+		group->dchan_span = span;
+	}
+
+	group->spans[iface] = span;
+	group->num_spans++;
+
+	isdn_data->nfas = group;
+	isdn_data->nfas_iface = iface;
+
+	ftdm_log(FTDM_LOG_INFO, "Span '%s' [s%d] added to NFAS group '%s' with interface id %d%s\n",
+		ftdm_span_get_name(span), ftdm_span_get_id(span), group->name, iface, has_dchan ? " (D-Channel)" : "");
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief	Check the NFAS group of a span is complete (and its D-Channel span running) before starting it
+ */
+static ftdm_status_t ftdm_isdn_nfas_check(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+	ftdm_isdn_data_t *dchan_data = NULL;
+
+	if (!isdn_data->nfas->dchan_span) {
+		ftdm_log(FTDM_LOG_ERROR, "NFAS group '%s' of span '%s' has no D-Channel span\n",
+			isdn_data->nfas->name, ftdm_span_get_name(span));
+		snprintf(span->last_error, sizeof(span->last_error), "NFAS group '%s' has no D-Channel span", isdn_data->nfas->name);
+		return FTDM_FAIL;
+	}
+
+	dchan_data = isdn_data->nfas->dchan_span->signal_data;
+	if (dchan_data->mode != isdn_data->mode) {
+		ftdm_log(FTDM_LOG_ERROR, "Span '%s' mode does not match the mode of NFAS D-Channel span '%s'\n",
+			ftdm_span_get_name(span), ftdm_span_get_name(isdn_data->nfas->dchan_span));
+		snprintf(span->last_error, sizeof(span->last_error), "NFAS group '%s' mode mismatch", isdn_data->nfas->name);
+		return FTDM_FAIL;
+	}
+
+	/* the signalling of a member is run by the D-Channel span thread */
+	if (isdn_data->nfas->dchan_span != span && !ftdm_test_flag(dchan_data, FTDM_ISDN_RUNNING)) {
+		ftdm_log(FTDM_LOG_ERROR, "Span '%s' cannot start, NFAS D-Channel span '%s' is not running\n",
+			ftdm_span_get_name(span), ftdm_span_get_name(isdn_data->nfas->dchan_span));
+		snprintf(span->last_error, sizeof(span->last_error), "NFAS D-Channel span '%s' is not running",
+			ftdm_span_get_name(isdn_data->nfas->dchan_span));
+		return FTDM_FAIL;
+	}
+	return FTDM_SUCCESS;
+}
+
 /*****************************************************************************************
  * PCAP
  *          Based on Helmut Kuper's (<helmut.kuper@ewetel.de>) implementation,
@@ -254,7 +414,7 @@ static FIO_CHANNEL_GET_SIG_STATUS_FUNCTION(isdn_get_channel_sig_status)
 {
 	*status = FTDM_SIG_STATE_DOWN;
 
-	ftdm_isdn_data_t *isdn_data = ftdmchan->span->signal_data;
+	ftdm_isdn_data_t *isdn_data = ftdm_isdn_get_dchan_data(ftdmchan->span);
 	if (ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
 		*status = FTDM_SIG_STATE_UP;
 	}
@@ -271,7 +431,7 @@ static FIO_SPAN_GET_SIG_STATUS_FUNCTION(isdn_get_span_sig_status)
 {
 	*status = FTDM_SIG_STATE_DOWN;
 
-	ftdm_isdn_data_t *isdn_data = span->signal_data;
+	ftdm_isdn_data_t *isdn_data = ftdm_isdn_get_dchan_data(span);
 	if (ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
 		*status = FTDM_SIG_STATE_UP;
 	}
@@ -733,6 +893,78 @@ static void __isdn_get_number(const char *digits, const int ton, char *buf, int
 	__isdn_get_number((const char *)(num)->Digit, (num)->TypNum, (char *)buf, sizeof(buf))
 
 
+/**
+ * \brief	(Re)start the overlap dial timeout of a B-channel
+ * \param	isdn_data	Signalling data of the D-channel span
+ * \param	ftdmchan	B-channel waiting for digits
+ */
+static void ftdm_isdn_start_digit_timeout(ftdm_isdn_data_t *isdn_data, ftdm_channel_t *ftdmchan)
+{
+	ftdm_isdn_bchan_data_t *data = ftdmchan->call_data;
+
+	if (!data) {
+		return;
+	}
+
+	data->digit_timeout = ftdm_time_now() + isdn_data->digit_timeout;
+	if (!data->digit_timer_linked) {
+		data->digit_timer_linked = 1;
+		data->next_digit_timer = isdn_data->digit_timers;
+		isdn_data->digit_timers = data;
+	}
+}
+
+/**
+ * \brief	Check the overlap dial timeout of the B-channels in DIALTONE state
+ * \param	span	D-channel span, its timer list holds the B-channels of all the NFAS members
+ */
+static void check_digit_timeouts(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+	ftdm_isdn_bchan_data_t **cur = &isdn_data->digit_timers;
+	ftdm_time_t now;
+
+	if (!*cur) {
+		return;
+	}
+
+	now = ftdm_time_now();
+
+	while (*cur) {
+		ftdm_isdn_bchan_data_t *data = *cur;
+		ftdm_channel_t *chan = data->ftdmchan;
+		ftdm_caller_data_t *caller_data = NULL;
+		int waiting = data->digit_timeout && ftdm_channel_get_state(chan) == FTDM_CHANNEL_STATE_DIALTONE;
+
+		if (waiting && data->digit_timeout > now) {
+			cur = &data->next_digit_timer;
+			continue;
+		}
+
+		/* expired, or the channel left DIALTONE: unlink it */
+		*cur = data->next_digit_timer;
+		data->next_digit_timer = NULL;
+		data->digit_timer_linked = 0;
+		data->digit_timeout = 0;
+
+		if (!waiting) {
+			continue;
+		}
+
+		caller_data = ftdm_channel_get_caller_data(chan);
+
+		if (strlen(caller_data->dnis.digits) > 0) {
+			ftdm_log(FTDM_LOG_DEBUG, "Overlap dial timeout, advancing to RING state\n");
+			ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_RING);
+		} else {
+			/* no digits received, hangup */
+			ftdm_log(FTDM_LOG_DEBUG, "Overlap dial timeout, no digits received, going to HANGUP state\n");
+			caller_data->hangup_cause = FTDM_CAUSE_RECOVERY_ON_TIMER_EXPIRE;	/* TODO: probably wrong cause value */
+			ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_HANGUP);
+		}
+	}
+}
+
 /**
  * \brief	The old call event handler (err, call message handler)
  * \todo	This one must die!
@@ -758,6 +990,20 @@ static L3INT ftdm_isdn_931_34(void *pvt, struct Q931_Call *call, Q931mes_Generic
 		if (chanid->InfoChanSel == 3) {
 			chan_hunt++;
 		}
+
+		/* NFAS: B-channel is on the group member selected by the interface id */
+		if (isdn_data->nfas) {
+			ftdm_span_t *nfas_span = ftdm_isdn_nfas_get_span(span, chanid);
+
+			if (nfas_span) {
+				span = nfas_span;
+			} else {
+				ftdm_log(FTDM_LOG_WARNING, "[s%d] Unknown NFAS interface id %d in Channel ID IE\n",
+					ftdm_span_get_id(span), (int)chanid->InterfaceID);
+				chan_id = 0;
+				chan_hunt = 0;
+			}
+		}
 	} else if (FTDM_SPAN_IS_NT(span)) {
 		/* no channel ie */
 		chan_hunt++;
@@ -1078,7 +1324,8 @@ static L3INT ftdm_isdn_931_34(void *pvt, struct Q931_Call *call, Q931mes_Generic
 						memset(&ftdmchan->caller_data, 0, sizeof(ftdmchan->caller_data));
 
 						if (ftdmchan->call_data) {
-							memset(ftdmchan->call_data, 0, sizeof(ftdm_isdn_bchan_data_t));
+							/* the channel may still be linked in the digit timer list, keep the linkage */
+							((ftdm_isdn_bchan_data_t *)ftdmchan->call_data)->digit_timeout = 0;
 						}
 
 						/* copy number readd prefix as needed */
@@ -1142,6 +1389,7 @@ static L3INT ftdm_isdn_931_34(void *pvt, struct Q931_Call *call, Q931mes_Generic
 					} else {
 						ChanID.InfoChanSel = (unsigned char)ftdm_channel_get_id(ftdmchan) & 0x03;	/* None = 0, B1 = 1, B2 = 2, Any = 3 */
 					}
+					ftdm_isdn_nfas_set_chanid(ftdm_channel_get_span(ftdmchan), &ChanID);
 					gen->ChanID = Q931AppendIE(gen, (L3UCHAR *) &ChanID);
 
 					if (overlap_dial) {
@@ -1221,7 +1469,7 @@ static L3INT ftdm_isdn_931_34(void *pvt, struct Q931_Call *call, Q931mes_Generic
 							strcat(&ftdmchan->caller_data.dnis.digits[pos], (char *)callednum->Digit);
 
 							/* update timer */
-							data->digit_timeout = ftdm_time_now() + isdn_data->digit_timeout;
+							ftdm_isdn_start_digit_timeout(isdn_data, ftdmchan);
 
 							ftdm_log(FTDM_LOG_DEBUG, "Received new overlap digit (%s), destination number: %s\n", callednum->Digit, ftdmchan->caller_data.dnis.digits);
 						}
@@ -1290,6 +1538,53 @@ static int ftdm_isdn_921_21(void *pvt, L2UCHAR *msg, L2INT mlen)
 	return ftdm_channel_write(isdn_data->dchan, msg, len, &len) == FTDM_SUCCESS ? 0 : -1;
 }
 
+/**
+ * \brief	Tone service callback, selects the tone to play for the B-channel state
+ * \note	Called by a core tone worker with the channel lock held,
+ *		the channel is detached as soon as it leaves the tone generating states.
+ */
+static ftdm_status_t ftdm_isdn_tone_cb(ftdm_channel_t *ftdmchan, ftdm_tonemap_t *tone, void *data)
+{
+	switch (ftdm_channel_get_state(ftdmchan)) {
+	case FTDM_CHANNEL_STATE_DIALTONE:
+		*tone = FTDM_TONEMAP_DIAL;
+		break;
+	case FTDM_CHANNEL_STATE_RING:
+		*tone = FTDM_TONEMAP_RING;
+		break;
+	default:
+		return FTDM_BREAK;
+	}
+	return FTDM_SUCCESS;
+}
+
+/**
+ * \brief	Start generating dial / ring tone on a B-channel (NT-mode)
+ * \param	ftdmchan	B-channel entering a tone generating state
+ */
+static void ftdm_isdn_tones_attach(ftdm_channel_t *ftdmchan)
+{
+	ftdm_isdn_data_t *isdn_data = ftdm_channel_get_span(ftdmchan)->signal_data;
+
+	if (!ftdm_test_flag(isdn_data, FTDM_ISDN_TONES_RUNNING) || ftdm_tone_service_attached(ftdmchan)) {
+		return;
+	}
+
+	if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OPEN)) {
+		if (ftdm_channel_open_chan(ftdmchan) != FTDM_SUCCESS) {
+			ftdm_set_state(ftdmchan, FTDM_CHANNEL_STATE_HANGUP);
+			return;
+		}
+		ftdm_log(FTDM_LOG_NOTICE, "Successfully opened channel %d:%d\n",
+				ftdm_channel_get_span_id(ftdmchan),
+				ftdm_channel_get_id(ftdmchan));
+	}
+
+	if (ftdm_tone_service_attach(ftdmchan, ftdm_isdn_tone_cb, NULL) != FTDM_SUCCESS) {
+		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_ERROR, "Failed to attach to tone service\n");
+	}
+}
+
 static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 {
 	ftdm_span_t *span = ftdm_channel_get_span(ftdmchan);
@@ -1303,7 +1598,7 @@ static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 
 	Q931InitMesGeneric(gen);
 
-	isdn_data = span->signal_data;
+	isdn_data = ftdm_isdn_get_dchan_data(span);
 	assert(isdn_data);
 
 	call = Q931GetCallByCRV(&isdn_data->q931, ftdmchan->caller_data.call_reference);
@@ -1333,6 +1628,7 @@ static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 				Q931ReleaseCRV(&isdn_data->q931, gen->CRV);
 			}
 			ftdmchan->caller_data.call_reference = 0;
+			ftdm_tone_service_detach(ftdmchan);
 			ftdm_channel_close(&ftdmchan);
 		}
 		break;
@@ -1363,6 +1659,7 @@ static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 					} else {
 						ChanID.InfoChanSel = (unsigned char)ftdm_channel_get_id(ftdmchan) & 0x03;	/* None = 0, B1 = 1, B2 = 2, Any = 3 */
 					}
+					ftdm_isdn_nfas_set_chanid(ftdm_channel_get_span(ftdmchan), &ChanID);
 					gen->ChanID = Q931AppendIE(gen, (L3UCHAR *) &ChanID);
 				}
 
@@ -1372,15 +1669,14 @@ static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 		break;
 	case FTDM_CHANNEL_STATE_DIALTONE:
 		{
-			ftdm_isdn_bchan_data_t *data = (ftdm_isdn_bchan_data_t *)ftdmchan->call_data;
-
-			if (data) {
-				data->digit_timeout = ftdm_time_now() + isdn_data->digit_timeout;
-			}
+			ftdm_isdn_start_digit_timeout(isdn_data, ftdmchan);
+			ftdm_isdn_tones_attach(ftdmchan);
 		}
 		break;
 	case FTDM_CHANNEL_STATE_RING:
 		{
+			ftdm_isdn_tones_attach(ftdmchan);
+
 			if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_OUTBOUND)) {
 				sig.event_id = FTDM_SIGEVENT_START;
 				if ((status = ftdm_span_send_signal(span, &sig) != FTDM_SUCCESS)) {
@@ -1488,6 +1784,7 @@ static __inline__ void state_advance(ftdm_channel_t *ftdmchan)
 			} else {
 				ChanID.InfoChanSel = (unsigned char)ftdm_channel_get_id(ftdmchan) & 0x03;	/* None = 0, B1 = 1, B2 = 2, Any = 3 */
 			}
+			ftdm_isdn_nfas_set_chanid(ftdm_channel_get_span(ftdmchan), &ChanID);
 			gen->ChanID = Q931AppendIE(gen, (L3UCHAR *) &ChanID);
 
 			/*
@@ -1670,6 +1967,8 @@ static __inline__ void check_state(ftdm_span_t *span)
 				ftdm_channel_lock(chan);
 				ftdm_clear_flag(chan, FTDM_CHANNEL_STATE_CHANGE);
 				state_advance(chan);
+				/* picked up by the next check_state() pass */
+				ftdm_channel_advance_indication(chan);
 				ftdm_channel_unlock(chan);
 			}
 		}
@@ -1754,9 +2053,9 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 }
 
 
-static __inline__ void check_events(ftdm_span_t *span)
+static __inline__ void check_events(ftdm_span_t *span, uint32_t ms)
 {
-	ftdm_status_t status = ftdm_span_poll_event(span, 5, NULL);
+	ftdm_status_t status = ftdm_span_poll_event(span, ms, NULL);
 
 	switch (status) {
 	case FTDM_SUCCESS:
@@ -1784,238 +2083,57 @@ static __inline__ void check_events(ftdm_span_t *span)
 }
 
 
-static int teletone_handler(teletone_generation_session_t *ts, teletone_tone_map_t *map)
-{
-	ftdm_buffer_t *dt_buffer = ts->user_data;
-	int wrote;
-
-	if (!dt_buffer) {
-		return -1;
-	}
-
-	wrote = teletone_mux_tones(ts, map);
-	ftdm_buffer_write(dt_buffer, ts->buffer, wrote * 2);
-	return 0;
-}
-
-static void *ftdm_isdn_tones_run(ftdm_thread_t *me, void *obj)
+/**
+ * \brief	Process state changes and events of the other NFAS group members
+ * \param	span	NFAS D-channel span
+ */
+static __inline__ void check_nfas_spans(ftdm_span_t *span)
 {
-	ftdm_span_t *span = (ftdm_span_t *) obj;
 	ftdm_isdn_data_t *isdn_data = span->signal_data;
-	ftdm_buffer_t *dt_buffer = NULL;
-	teletone_generation_session_t ts = {{{{0}}}};;
-	unsigned char frame[1024];
-	int x, interval;
+	int i;
 
-	ftdm_log(FTDM_LOG_DEBUG, "ISDN tones thread starting.\n");
-	ftdm_set_flag(isdn_data, FTDM_ISDN_TONES_RUNNING);
+	for (i = 0; i < FTDM_ISDN_NFAS_MAX_SPANS; i++) {
+		ftdm_span_t *member = isdn_data->nfas->spans[i];
 
-	if (ftdm_buffer_create(&dt_buffer, 1024, 1024, 0) != FTDM_SUCCESS) {
-		snprintf(isdn_data->dchan->last_error, sizeof(isdn_data->dchan->last_error), "memory error!");
-		ftdm_log(FTDM_LOG_ERROR, "MEM ERROR\n");
-		goto done;
-	}
-	ftdm_buffer_set_loops(dt_buffer, -1);
-
-	/* get a tone generation friendly interval to avoid distortions */
-	for (x = 1; x <= ftdm_span_get_chan_count(span); x++) {
-		ftdm_channel_t *chan = ftdm_span_get_channel(span, x);
-
-		if (ftdm_channel_get_type(chan) != FTDM_CHAN_TYPE_DQ921) {
-			ftdm_channel_command(chan, FTDM_COMMAND_GET_INTERVAL, &interval);
-			break;
+		if (!member || member == span) {
+			continue;
 		}
+		if (!ftdm_test_flag((ftdm_isdn_data_t *)member->signal_data, FTDM_ISDN_RUNNING)) {
+			continue;
+		}
+		check_state(member);
+		check_events(member, 0);
 	}
-	if (!interval) {
-		interval = 20;
-	}
-	ftdm_log(FTDM_LOG_NOTICE, "Tone generating interval %d\n", interval);
-
-	/* init teletone */
-	teletone_init_session(&ts, 0, teletone_handler, dt_buffer);
-	ts.rate     = 8000;
-	ts.duration = ts.rate;
-
-	/* main loop */
-	while (ftdm_running() && ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
-		ftdm_wait_flag_t flags;
-		ftdm_status_t status;
-		int last_chan_state = 0;
-		int gated = 0;
-		L2ULONG now = ftdm_time_now();
-
-		/*
-		 * check b-channel states and generate & send tones if neccessary
-		 */
-		for (x = 1; x <= ftdm_span_get_chan_count(span); x++) {
-			ftdm_channel_t *chan = ftdm_span_get_channel(span, x);
-			ftdm_size_t len = sizeof(frame), rlen;
-			ftdm_isdn_bchan_data_t *data = chan->call_data;
-
-			if (ftdm_channel_get_type(chan) == FTDM_CHAN_TYPE_DQ921) {
-				continue;
-			}
-
-			/*
-			 * Generate tones based on current bchan state
-			 * (Recycle buffer content if succeeding channels share the
-			 *  same state, this saves some cpu cycles)
-			 */
-			switch (ftdm_channel_get_state(chan)) {
-			case FTDM_CHANNEL_STATE_DIALTONE:
-				{
-					ftdm_caller_data_t *caller_data = ftdm_channel_get_caller_data(chan);
-
-					/* check overlap dial timeout first before generating tone */
-					if (data && data->digit_timeout && data->digit_timeout <= now) {
-						if (strlen(caller_data->dnis.digits) > 0) {
-							ftdm_log(FTDM_LOG_DEBUG, "Overlap dial timeout, advancing to RING state\n");
-							ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_RING);
-						} else {
-							/* no digits received, hangup */
-							ftdm_log(FTDM_LOG_DEBUG, "Overlap dial timeout, no digits received, going to HANGUP state\n");
-							caller_data->hangup_cause = FTDM_CAUSE_RECOVERY_ON_TIMER_EXPIRE;	/* TODO: probably wrong cause value */
-							ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_HANGUP);
-						}
-						data->digit_timeout = 0;
-						continue;
-					}
-
-					if (last_chan_state != ftdm_channel_get_state(chan)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, span->tone_map[FTDM_TONEMAP_DIAL]);
-						last_chan_state = ftdm_channel_get_state(chan);
-					}
-				}
-				break;
-
-			case FTDM_CHANNEL_STATE_RING:
-				{
-					if (last_chan_state != ftdm_channel_get_state(chan)) {
-						ftdm_buffer_zero(dt_buffer);
-						teletone_run(&ts, span->tone_map[FTDM_TONEMAP_RING]);
-						last_chan_state = ftdm_channel_get_state(chan);
-					}
-				}
-				break;
-
-			default:	/* Not in a tone generating state, go to next round */
-				continue;
-			}
-
-			if (!ftdm_test_flag(chan, FTDM_CHANNEL_OPEN)) {
-				if (ftdm_channel_open_chan(chan) != FTDM_SUCCESS) {
-					ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_HANGUP);
-					continue;
-				}
-				ftdm_log(FTDM_LOG_NOTICE, "Successfully opened channel %d:%d\n",
-						ftdm_channel_get_span_id(chan),
-						ftdm_channel_get_id(chan));
-			}
-
-			flags = FTDM_READ;
-
-			status = ftdm_channel_wait(chan, &flags, (gated) ? 0 : interval);
-			switch (status) {
-			case FTDM_FAIL:
-				continue;
-
-			case FTDM_TIMEOUT:
-				gated = 1;
-				continue;
-
-			default:
-				if (!(flags & FTDM_READ)) {
-					continue;
-				}
-			}
-			gated = 1;
-
-			status = ftdm_channel_read(chan, frame, &len);
-			if (status != FTDM_SUCCESS || len <= 0) {
-				continue;
-			}
-
-			/*
-			 * Teletone operates on SLIN data (2 bytes per sample).
-			 * Convert the length of non-SLIN codecs, so we read
-			 * the right amount of samples from the buffer.
-			 */
-			if (chan->effective_codec != FTDM_CODEC_SLIN) {
-				len *= 2;
-			}
-
-			/* seek to current offset */
-			ftdm_buffer_seek(dt_buffer, data->offset);
-
-			/*
-			 * ftdm_channel_read() can read up to sizeof(frame) bytes
-			 * (in certain situations). Avoid overflowing the stack (and smashing dt_buffer)
-			 * if the codec is not slin and we had to double the length.
-			 */
-			len  = ftdm_min(len, sizeof(frame));
-			rlen = ftdm_buffer_read_loop(dt_buffer, frame, len);
-
-			if (chan->effective_codec != FTDM_CODEC_SLIN) {
-				fio_codec_t codec_func = NULL;
-
-				if (chan->native_codec == FTDM_CODEC_ULAW) {
-					codec_func = fio_slin2ulaw;
-				} else if (chan->native_codec == FTDM_CODEC_ALAW) {
-					codec_func = fio_slin2alaw;
-				}
-
-				/*
-				 * Convert SLIN to native format (a-law/u-law),
-				 * input size is 2 bytes per sample, output size
-				 * (after conversion) is one byte per sample
-				 * (= max. half the input size).
-				 */
-				if (codec_func) {
-					status = codec_func(frame, sizeof(frame), &rlen);
-				} else {
-					snprintf(chan->last_error, sizeof(chan->last_error), "codec error!");
-					goto done;
-				}
-			}
+}
 
-			if (ftdm_channel_write(chan, frame, sizeof(frame), &rlen) == FTDM_SUCCESS) {
-				/*
-				 * Advance offset in teletone buffer by amount
-				 * of data actually written to channel.
-				 */
-				if (chan->effective_codec != FTDM_CODEC_SLIN) {
-					data->offset += rlen << 1;	/* Teletone buffer is in SLIN (= rlen * 2) */
-				} else {
-					data->offset += rlen;
-				}
 
-				/* Limit offset to [0..Rate(Samples/s)-1] in SLIN (2 bytes per sample) units. */
-				data->offset %= (ts.rate << 1);
-			}
-		}
+/**
+ * \brief	Enable tone generation on a NT-mode span
+ */
+static ftdm_status_t ftdm_isdn_tones_start(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
 
-		/*
-		 * sleep a bit if there was nothing to do
-		 */
-		if (!gated) {
-			ftdm_sleep(interval);
-		}
-	}
+	ftdm_set_flag(isdn_data, FTDM_ISDN_TONES_RUNNING);
+	return FTDM_SUCCESS;
+}
 
-done:
-	if (ts.buffer) {
-		teletone_destroy_session(&ts);
-	}
+/**
+ * \brief	Disable tone generation on a span and detach its B-channels from the tone service
+ */
+static void ftdm_isdn_tones_stop(ftdm_span_t *span)
+{
+	ftdm_isdn_data_t *isdn_data = span->signal_data;
+	uint32_t x;
 
-	if (dt_buffer) {
-		ftdm_buffer_destroy(&dt_buffer);
+	if (!ftdm_test_flag(isdn_data, FTDM_ISDN_TONES_RUNNING)) {
+		return;
 	}
-
-	ftdm_log(FTDM_LOG_DEBUG, "ISDN tone thread ended.\n");
 	ftdm_clear_flag(isdn_data, FTDM_ISDN_TONES_RUNNING);
 
-	return NULL;
+	for (x = 1; x <= ftdm_span_get_chan_count(span); x++) {
+		ftdm_tone_service_detach(ftdm_span_get_channel(span, x));
+	}
 }
 
 static void *ftdm_isdn_run(ftdm_thread_t *me, void *obj)
@@ -2036,14 +2154,20 @@ static void *ftdm_isdn_run(ftdm_thread_t *me, void *obj)
 	Q921Start(&isdn_data->q921);
 	Q931Start(&isdn_data->q931);
 
-	while (ftdm_running() && ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
+	while (ftdm_running() && ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING) && !ftdm_test_flag(isdn_data, FTDM_ISDN_STOP)) {
 		ftdm_wait_flag_t flags = FTDM_READ;
 		ftdm_status_t status = ftdm_channel_wait(isdn_data->dchan, &flags, 100);
 
+		ftdm_span_metrics_loop_mark(span);
 		Q921TimerTick(&isdn_data->q921);
 		Q931TimerTick(&isdn_data->q931);
 		check_state(span);
-		check_events(span);
+		check_events(span, 5);
+		check_digit_timeouts(span);
+
+		if (isdn_data->nfas) {
+			check_nfas_spans(span);
+		}
 
 		/*
 		 *
@@ -2270,19 +2394,41 @@ static ftdm_status_t ftdm_isdn_stop(ftdm_span_t *span)
 	ftdm_isdn_data_t *isdn_data = span->signal_data;
 
 	if (!ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
+		ftdm_isdn_tones_stop(span);
 		return FTDM_FAIL;
 	}
 
-	ftdm_set_flag(isdn_data, FTDM_ISDN_STOP);
+	if (isdn_data->nfas && ftdm_isdn_has_dchan(span)) {
+		int i;
 
-	while (ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
-		ftdm_sleep(100);
+		/* the members are run by our thread, they cannot outlive it */
+		for (i = 0; i < FTDM_ISDN_NFAS_MAX_SPANS; i++) {
+			ftdm_span_t *member = isdn_data->nfas->spans[i];
+
+			if (!member || member == span) {
+				continue;
+			}
+			if (ftdm_test_flag((ftdm_isdn_data_t *)member->signal_data, FTDM_ISDN_RUNNING)) {
+				ftdm_log(FTDM_LOG_NOTICE, "Stopping NFAS member span '%s' [s%d] of D-Channel span '%s'\n",
+					ftdm_span_get_name(member), ftdm_span_get_id(member), ftdm_span_get_name(span));
+				ftdm_span_stop(member);
+			}
+		}
 	}
 
-	while (ftdm_test_flag(isdn_data, FTDM_ISDN_TONES_RUNNING)) {
-		ftdm_sleep(100);
+	ftdm_set_flag(isdn_data, FTDM_ISDN_STOP);
+
+	if (ftdm_isdn_has_dchan(span)) {
+		while (ftdm_test_flag(isdn_data, FTDM_ISDN_RUNNING)) {
+			ftdm_sleep(100);
+		}
+	} else {
+		/* NFAS member, signalling is handled by the D-Channel span */
+		ftdm_clear_flag(isdn_data, FTDM_ISDN_RUNNING);
 	}
 
+	ftdm_isdn_tones_stop(span);
+
 	return FTDM_SUCCESS;
 }
 
@@ -2298,15 +2444,32 @@ static ftdm_status_t ftdm_isdn_start(ftdm_span_t *span)
 		return FTDM_FAIL;
 	}
 
+	if (isdn_data->nfas && ftdm_isdn_nfas_check(span) != FTDM_SUCCESS) {
+		return FTDM_FAIL;
+	}
+
 	ftdm_clear_flag(isdn_data, FTDM_ISDN_STOP);
-	ret = ftdm_thread_create_detached(ftdm_isdn_run, span);
 
-	if (ret != FTDM_SUCCESS) {
-		return ret;
+	if (ftdm_isdn_has_dchan(span)) {
+		/* set before the thread runs, NFAS members can be started right after us */
+		ftdm_set_flag(isdn_data, FTDM_ISDN_RUNNING);
+
+		ret = ftdm_thread_create_detached(ftdm_isdn_run, span);
+
+		if (ret != FTDM_SUCCESS) {
+			ftdm_clear_flag(isdn_data, FTDM_ISDN_RUNNING);
+			return ret;
+		}
+	} else {
+		/* NFAS member, signalling is handled by the D-Channel span */
+		ftdm_log(FTDM_LOG_INFO, "Span '%s' [s%d] signalling is controlled by NFAS D-Channel span '%s'\n",
+			ftdm_span_get_name(span), ftdm_span_get_id(span), ftdm_span_get_name(isdn_data->nfas->dchan_span));
+		ftdm_set_flag(isdn_data, FTDM_ISDN_RUNNING);
+		ret = FTDM_SUCCESS;
 	}
 
 	if (FTDM_SPAN_IS_NT(span) && !(isdn_data->opts & FTDM_ISDN_OPT_DISABLE_TONES)) {
-		ret = ftdm_thread_create_detached(ftdm_isdn_tones_run, span);
+		ret = ftdm_isdn_tones_start(span);
 	}
 	return ret;
 }
@@ -2438,7 +2601,7 @@ static FIO_API_FUNCTION(isdn_api)
 		span_id = atoi(argv[1]);
 
 		if (ftdm_span_find_by_name(argv[1], &span) == FTDM_SUCCESS || ftdm_span_find(span_id, &span) == FTDM_SUCCESS) {
-			isdn_data = span->signal_data;
+			isdn_data = ftdm_isdn_get_dchan_data(span);
 		} else {
 			stream->write_function(stream, "-ERR invalid span.\n");
 			goto done;
@@ -2468,7 +2631,7 @@ static FIO_API_FUNCTION(isdn_api)
 		span_id = atoi(argv[1]);
 
 		if (ftdm_span_find_by_name(argv[1], &span) == FTDM_SUCCESS || ftdm_span_find(span_id, &span) == FTDM_SUCCESS) {
-			isdn_data = span->signal_data;
+			isdn_data = ftdm_isdn_get_dchan_data(span);
 		} else {
 			stream->write_function(stream, "-ERR invalid span.\n");
 			goto done;
@@ -2530,7 +2693,7 @@ static FIO_API_FUNCTION(isdn_api)
 		span_id = atoi(argv[1]);
 
 		if (ftdm_span_find_by_name(argv[1], &span) == FTDM_SUCCESS || ftdm_span_find(span_id, &span) == FTDM_SUCCESS) {
-			isdn_data = span->signal_data;
+			isdn_data = ftdm_isdn_get_dchan_data(span);
 		} else {
 			stream->write_function(stream, "-ERR invalid span.\n");
 			goto done;
@@ -2639,6 +2802,8 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 	int dchan_count = 0, bchan_count = 0;
 	int q921loglevel = -1;
 	int q931loglevel = -1;
+	const char *nfas_group = NULL;
+	int nfas_iface = -1;
 	uint32_t i;
 
 	if (span->signal_type) {
@@ -2680,11 +2845,6 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 			break;
 		}
 	}
-	if (!dchan_count) {
-		ftdm_log(FTDM_LOG_ERROR, "Span has no D-Channel!\n");
-		snprintf(span->last_error, sizeof(span->last_error), "Span has no D-Channel!");
-		return FTDM_FAIL;
-	}
 	if (!bchan_count) {
 		ftdm_log(FTDM_LOG_ERROR, "Span has no B-Channels!\n");
 		snprintf(span->last_error, sizeof(span->last_error), "Span has no B-Channels!");
@@ -2763,6 +2923,15 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 				snprintf(span->last_error, sizeof(span->last_error), "Invalid/unknown loglevel [%s]!", val);
 				return FTDM_FAIL;
 			}
+		} else if (!strcasecmp(var, "nfas-group")) {
+			nfas_group = val;
+		} else if (!strcasecmp(var, "nfas-interface-id")) {
+			nfas_iface = atoi(val);
+			if (nfas_iface < 0 || nfas_iface >= FTDM_ISDN_NFAS_MAX_SPANS) {
+				ftdm_log(FTDM_LOG_ERROR, "Invalid NFAS interface id '%s' (0 - %d)\n", val, FTDM_ISDN_NFAS_MAX_SPANS - 1);
+				snprintf(span->last_error, sizeof(span->last_error), "Invalid NFAS interface id [%s]!", val);
+				return FTDM_FAIL;
+			}
 		} else {
 			ftdm_log(FTDM_LOG_ERROR, "Unknown parameter '%s'\n", var);
 			snprintf(span->last_error, sizeof(span->last_error), "Unknown parameter [%s]", var);
@@ -2774,6 +2943,29 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 		digit_timeout = DEFAULT_DIGIT_TIMEOUT;
 	}
 
+	if (!dchan_count && !nfas_group) {
+		ftdm_log(FTDM_LOG_ERROR, "Span has no D-Channel!\n");
+		snprintf(span->last_error, sizeof(span->last_error), "Span has no D-Channel!");
+		return FTDM_FAIL;
+	}
+
+	if (nfas_group) {
+		if (FTDM_SPAN_IS_BRI(span)) {
+			ftdm_log(FTDM_LOG_ERROR, "NFAS is not supported on BRI spans\n");
+			snprintf(span->last_error, sizeof(span->last_error), "NFAS is not supported on BRI spans!");
+			return FTDM_FAIL;
+		}
+		if (nfas_iface < 0) {
+			ftdm_log(FTDM_LOG_ERROR, "NFAS group '%s' requires a 'nfas-interface-id'\n", nfas_group);
+			snprintf(span->last_error, sizeof(span->last_error), "Missing NFAS interface id!");
+			return FTDM_FAIL;
+		}
+		if (ftdm_isdn_nfas_add_span(span, isdn_data, nfas_group, nfas_iface, dchan_count > 0) != FTDM_SUCCESS) {
+			ftdm_log(FTDM_LOG_ERROR, "%s\n", span->last_error);
+			return FTDM_FAIL;
+		}
+	}
+
 	/* Check if modes match and log a message if they do not. Just to be on the safe side. */
 	if (isdn_data->mode == Q931_TE && ftdm_span_get_trunk_mode(span) == FTDM_TRUNK_MODE_NET) {
 		ftdm_log(FTDM_LOG_WARNING, "Span '%s' signalling set up for TE/CPE/USER mode, while port is running in NT/NET mode. You may want to check your 'trunk_mode' settings.\n",
@@ -2799,6 +2991,7 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 			if (ftdm_channel_get_type(chan) == FTDM_CHAN_TYPE_B) {
 				chan->call_data = data;
 				memset(data, 0, sizeof(ftdm_isdn_bchan_data_t));
+				data->ftdmchan = chan;
 			}
 		}
 	}
@@ -2806,41 +2999,44 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(isdn_configure_span)
 	isdn_data->dchan = dchan;
 	isdn_data->digit_timeout = digit_timeout;
 
-	Q921_InitTrunk(&isdn_data->q921,
-				   0,
-				   0,
-				   isdn_data->mode,
-				   (ftdm_span_get_trunk_type(span) == FTDM_TRUNK_BRI_PTMP) ? Q921_PTMP : Q921_PTP,
-				   0,
-				   ftdm_isdn_921_21,
-				   (Q921Tx23CB_t)ftdm_isdn_921_23,
-				   span,
-				   span);
-
-	Q921SetLogCB(&isdn_data->q921, &ftdm_isdn_q921_log, span);
-	Q921SetLogLevel(&isdn_data->q921, (Q921LogLevel_t)q921loglevel);
-
-	Q931InitTrunk(&isdn_data->q931,
-					  dialect,
-					  isdn_data->mode,
-					  span->trunk_type,
-					  ftdm_isdn_931_34,
-					  (Q931Tx32CB_t)q931_rx_32,
-					  ftdm_isdn_931_err,
-					  span,
-					  span);
-
-	Q931SetLogCB(&isdn_data->q931, &ftdm_isdn_q931_log, span);
-	Q931SetLogLevel(&isdn_data->q931, (Q931LogLevel_t)q931loglevel);
-
-	/* Register new event hander CB */
-	Q931SetCallEventCB(&isdn_data->q931, ftdm_isdn_call_event, span);
-
-	/* TODO: hmm, maybe drop the "Trunk" prefix */
-	Q931TrunkSetAutoRestartAck(&isdn_data->q931, 1);
-	Q931TrunkSetAutoConnectAck(&isdn_data->q931, 1);
-	Q931TrunkSetAutoServiceAck(&isdn_data->q931, 1);
-	Q931TrunkSetStatusEnquiry(&isdn_data->q931, 0);
+	/* NFAS members without D-Channel use the Q.921/Q.931 instance of the D-Channel span */
+	if (dchan) {
+		Q921_InitTrunk(&isdn_data->q921,
+					   0,
+					   0,
+					   isdn_data->mode,
+					   (ftdm_span_get_trunk_type(span) == FTDM_TRUNK_BRI_PTMP) ? Q921_PTMP : Q921_PTP,
+					   0,
+					   ftdm_isdn_921_21,
+					   (Q921Tx23CB_t)ftdm_isdn_921_23,
+					   span,
+					   span);
+
+		Q921SetLogCB(&isdn_data->q921, &ftdm_isdn_q921_log, span);
+		Q921SetLogLevel(&isdn_data->q921, (Q921LogLevel_t)q921loglevel);
+
+		Q931InitTrunk(&isdn_data->q931,
+						  dialect,
+						  isdn_data->mode,
+						  span->trunk_type,
+						  ftdm_isdn_931_34,
+						  (Q931Tx32CB_t)q931_rx_32,
+						  ftdm_isdn_931_err,
+						  span,
+						  span);
+
+		Q931SetLogCB(&isdn_data->q931, &ftdm_isdn_q931_log, span);
+		Q931SetLogLevel(&isdn_data->q931, (Q931LogLevel_t)q931loglevel);
+
+		/* Register new event hander CB */
+		Q931SetCallEventCB(&isdn_data->q931, ftdm_isdn_call_event, span);
+
+		/* TODO: hmm, maybe drop the "Trunk" prefix */
+		Q931TrunkSetAutoRestartAck(&isdn_data->q931, 1);
+		Q931TrunkSetAutoConnectAck(&isdn_data->q931, 1);
+		Q931TrunkSetAutoServiceAck(&isdn_data->q931, 1);
+		Q931TrunkSetStatusEnquiry(&isdn_data->q931, 0);
+	}
 
 	span->state_map     = &isdn_state_map;
 	span->signal_data   = isdn_data;
@@ -2895,6 +3091,9 @@ static FIO_SIG_LOAD_FUNCTION(isdn_load)
 	Q921SetGetTimeCB(ftdm_time_now);
 	Q931SetGetTimeCB(ftdm_time_now);
 
+	memset(nfas_groups, 0, sizeof(nfas_groups));
+	num_nfas_groups = 0;
+
 	return FTDM_SUCCESS;
 }
 
@@ -2903,6 +3102,9 @@ static FIO_SIG_LOAD_FUNCTION(isdn_load)
  */
 static FIO_SIG_UNLOAD_FUNCTION(isdn_unload)
 {
+	memset(nfas_groups, 0, sizeof(nfas_groups));
+	num_nfas_groups = 0;
+
 	return FTDM_SUCCESS;
 };
 
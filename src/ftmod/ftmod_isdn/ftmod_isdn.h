@@ -36,12 +36,15 @@
 
 #define DEFAULT_DIGIT_TIMEOUT	10000		/* default overlap timeout: 10 seconds */
 
+#define FTDM_ISDN_NFAS_MAX_GROUPS	16	/* max. number of NFAS groups */
+#define FTDM_ISDN_NFAS_MAX_SPANS	32	/* max. number of spans (interface ids 0..31) in a NFAS group */
+
 
 typedef enum {
 	FTDM_ISDN_OPT_NONE = 0,
 	FTDM_ISDN_OPT_SUGGEST_CHANNEL = (1 << 0),
 	FTDM_ISDN_OPT_OMIT_DISPLAY_IE = (1 << 1),	/*!< Do not send Caller name in outgoing SETUP message (= Display IE) */
-	FTDM_ISDN_OPT_DISABLE_TONES   = (1 << 2),	/*!< Disable tone generating thread (NT mode) */
+	FTDM_ISDN_OPT_DISABLE_TONES   = (1 << 2),	/*!< Disable tone generation (NT mode) */
 
 	FTDM_ISDN_OPT_MAX = (2 << 0)
 } ftdm_isdn_opts_t;
@@ -59,6 +62,9 @@ typedef enum {
 struct pcap_context;
 #endif
 
+struct ftdm_isdn_nfas_group;
+struct ftdm_isdn_bchan_data;
+
 struct ftdm_isdn_data {
 	Q921Data_t q921;
 	Q931_TrunkInfo_t q931;
@@ -67,6 +73,9 @@ struct ftdm_isdn_data {
 	int32_t mode;
 	int32_t digit_timeout;
 	ftdm_isdn_opts_t opts;
+	struct ftdm_isdn_nfas_group *nfas;	/*!< NFAS group this span is a member of (NULL: no NFAS) */
+	int32_t nfas_iface;			/*!< Interface identifier of this span in the NFAS group */
+	struct ftdm_isdn_bchan_data *digit_timers;	/*!< B-channels with a running overlap dial timeout (D-channel span only) */
 #ifdef HAVE_PCAP
 	struct pcap_context *pcap;
 #endif
@@ -75,11 +84,27 @@ struct ftdm_isdn_data {
 typedef struct ftdm_isdn_data ftdm_isdn_data_t;
 
 
+/*
+ * NFAS group: one D-channel (and Q.921/Q.931 instance)
+ * controls the B-channels of all member spans.
+ */
+struct ftdm_isdn_nfas_group {
+	char name[FTDM_MAX_NAME_STR_SZ];
+	ftdm_span_t *dchan_span;			/*!< Member span carrying the D-channel */
+	ftdm_span_t *spans[FTDM_ISDN_NFAS_MAX_SPANS];	/*!< Member spans, indexed by interface identifier */
+	int num_spans;
+};
+
+typedef struct ftdm_isdn_nfas_group ftdm_isdn_nfas_group_t;
+
+
 /* b-channel private data */
 struct ftdm_isdn_bchan_data
 {
 	ftdm_time_t digit_timeout;
-	int offset;	/* offset in teletone buffer */
+	ftdm_channel_t *ftdmchan;
+	uint8_t digit_timer_linked;			/*!< in the digit_timers list of the D-channel span */
+	struct ftdm_isdn_bchan_data *next_digit_timer;
 };
 
 typedef struct ftdm_isdn_bchan_data ftdm_isdn_bchan_data_t;
@@ -456,6 +456,7 @@ static const char *ftdm_libpri_usage =
 #endif
 	"libpri debug <span> [all|none|flag,...flagN]\n"
 	"libpri msn <span>\n"
+	"libpri stats <span> [reset]\n"
 	"\n"
 	"Possible debug flags:\n"
 	"\tq921_raw     - Q.921 Raw messages\n"
@@ -502,6 +503,56 @@ static int msn_list_cb(const char *msn, void *priv)
 }
 
 
+/**
+ * "ftdm libpri stats <span> [reset]" API command
+ * Prints event loop wakeups and SETUP-to-ALERTING latency
+ */
+static void print_stats(ftdm_stream_handle_t *stream, const char *name, const int reset)
+{
+	ftdm_span_t *span = NULL;
+	ftdm_libpri_data_t *isdn_data = NULL;
+	struct ftdm_libpri_stats *stats = NULL;
+	ftdm_time_t elapsed = 0;
+	uint64_t wakeups = 0;
+
+	if (ftdm_span_find_by_name(name, &span) != FTDM_SUCCESS) {
+		stream->write_function(stream, "%s: -ERR span '%s' not found.\n",
+			__FILE__, name);
+		return;
+	}
+	if (span->start != ftdm_libpri_start) {
+		stream->write_function(stream, "%s: -ERR '%s' is not a libpri span.\n",
+			__FILE__, ftdm_span_get_name(span));
+		return;
+	}
+	isdn_data = span->signal_data;
+	stats = &isdn_data->stats;
+
+	if (reset) {
+		memset(stats, 0, sizeof(*stats));
+		stats->wakeups = isdn_data->spri.wakeups;
+		stats->since = ftdm_current_time_in_ms();
+		stream->write_function(stream, "%s: +OK stats reset.\n", __FILE__);
+		return;
+	}
+
+	elapsed = ftdm_current_time_in_ms() - stats->since;
+	wakeups = isdn_data->spri.wakeups - stats->wakeups;
+
+	stream->write_function(stream, "Span: %s\n", ftdm_span_get_name(span));
+	stream->write_function(stream, "Sample time: %"FTDM_TIME_FMT" ms\n", elapsed);
+	stream->write_function(stream, "Loop wakeups: %"FTDM_UINT64_FMT" (%.2f/s)\n",
+		wakeups, elapsed ? (wakeups * 1000.0) / elapsed : 0.0);
+	if (stats->setup_count) {
+		stream->write_function(stream, "SETUP-to-ALERTING: %u calls, min %"FTDM_TIME_FMT" ms, avg %"FTDM_TIME_FMT" ms, max %"FTDM_TIME_FMT" ms\n",
+			stats->setup_count, stats->setup_alert_min,
+			stats->setup_alert_total / stats->setup_count, stats->setup_alert_max);
+	} else {
+		stream->write_function(stream, "SETUP-to-ALERTING: no calls\n");
+	}
+	stream->write_function(stream, "+OK");
+}
+
 /**
  * \brief API function to kill or debug a libpri span
  * \param stream API stream handler
@@ -546,6 +597,10 @@ static FIO_API_FUNCTION(ftdm_libpri_api)
 				goto done;
 			}
 		}
+		if (!strcasecmp(argv[0], "stats")) {
+			print_stats(stream, argv[1], 0);
+			goto done;
+		}
 		if (!strcasecmp(argv[0], "msn")) {
 			ftdm_span_t *span = NULL;
 			struct msn_list_cb_private data;
@@ -581,6 +636,10 @@ static FIO_API_FUNCTION(ftdm_libpri_api)
 			goto done;
 		}
 	} else if (argc >= 2) {
+		if (!strcasecmp(argv[0], "stats") && argc == 3 && !strcasecmp(argv[2], "reset")) {
+			print_stats(stream, argv[1], 1);
+			goto done;
+		}
 		if (!strcasecmp(argv[0], "debug")) {
 			ftdm_span_t *span = NULL;
 
@@ -1014,6 +1073,19 @@ static ftdm_status_t state_advance(ftdm_channel_t *chan)
 			} else if (call) {
 //				pri_progress(isdn_data->spri.pri, call, ftdm_channel_get_id(chan), 1);
 				pri_acknowledge(isdn_data->spri.pri, call, ftdm_channel_get_id(chan), 0);
+
+				if (chan_priv->setup_time) {
+					struct ftdm_libpri_stats *stats = &isdn_data->stats;
+					ftdm_time_t diff = ftdm_current_time_in_ms() - chan_priv->setup_time;
+
+					if (!stats->setup_count || diff < stats->setup_alert_min)
+						stats->setup_alert_min = diff;
+					if (diff > stats->setup_alert_max)
+						stats->setup_alert_max = diff;
+					stats->setup_alert_total += diff;
+					stats->setup_count++;
+					chan_priv->setup_time = 0;
+				}
 			} else {
 				ftdm_set_state_locked(chan, FTDM_CHANNEL_STATE_RESTART);
 			}
@@ -1271,23 +1343,14 @@ static ftdm_status_t state_advance(ftdm_channel_t *chan)
 }
 
 /**
- * \brief Checks current state on a span
+ * \brief Processes pending state changes on a span
  * \param span Span to check status on
+ *
+ * Only the channels marked in the span dirty channel map are visited
  */
 static __inline__ void check_state(ftdm_span_t *span)
 {
-	if (ftdm_test_flag(span, FTDM_SPAN_STATE_CHANGE)) {
-		uint32_t j;
-
-		ftdm_clear_flag_locked(span, FTDM_SPAN_STATE_CHANGE);
-
-		for (j = 1; j <= ftdm_span_get_chan_count(span); j++) {
-			ftdm_channel_t *chan = ftdm_span_get_channel(span, j);
-			ftdm_channel_lock(chan);
-			ftdm_channel_advance_states(chan);
-			ftdm_channel_unlock(chan);
-		}
-	}
+	ftdm_span_advance_all_states(span);
 }
 
 
@@ -1966,6 +2029,7 @@ static int on_ring(lpwrap_pri_t *spri, lpwrap_pri_event_t event_type, pri_event
 	// scary to trust this pointer, you'd think they would give you a copy of the call data so you own it......
 	/* hurr, this is valid as along as nobody releases the call */
 	chan_priv->call = pevent->ring.call;
+	chan_priv->setup_time = ftdm_current_time_in_ms();
 
 	/* Open Channel if inband information is available */
 	if ((pevent->ring.progressmask & PRI_PROG_INBAND_AVAILABLE)) {
@@ -2125,12 +2189,14 @@ static __inline__ ftdm_status_t process_event(ftdm_span_t *span, ftdm_event_t *e
 /**
  * \brief Checks for events on a span
  * \param span Span to check for events
+ *
+ * Does not block, the D-Channel wait in lpwrap_run_pri_once() provides the sleep
  */
 static __inline__ void check_events(ftdm_span_t *span)
 {
 	ftdm_status_t status;
 
-	status = ftdm_span_poll_event(span, 5, NULL);
+	status = ftdm_span_poll_event(span, 0, NULL);
 
 	switch (status) {
 	case FTDM_SUCCESS:
@@ -2166,8 +2232,23 @@ static __inline__ void check_events(ftdm_span_t *span)
 static int check_flags(lpwrap_pri_t *spri)
 {
 	ftdm_span_t *span = spri->span;
+	ftdm_libpri_data_t *isdn_data = span->signal_data;
+	ftdm_time_t now = ftdm_current_time_in_ms();
+
+	/* one lpwrap_run_pri() event loop iteration per call */
+	ftdm_span_metrics_loop_mark(span);
+
 	check_state(span);
-	check_events(span);
+
+	/*
+	 * Poll the B-channels when the D-Channel reported OOB events
+	 * or the poll interval (the max. loop timeout) expired
+	 */
+	if ((spri->flags & LPWRAP_PRI_EVENTS) || now >= isdn_data->event_poll_ms) {
+		spri->flags &= ~LPWRAP_PRI_EVENTS;
+		isdn_data->event_poll_ms = now + EVENT_POLL_INTERVAL_MS;
+		check_events(span);
+	}
 	return 0;
 }
 
@@ -2599,6 +2680,7 @@ static void *ftdm_libpri_run(ftdm_thread_t *me, void *obj)
 {
 	ftdm_span_t *span = (ftdm_span_t *) obj;
 	ftdm_libpri_data_t *isdn_data = span->signal_data;
+	ftdm_interrupt_t *pending_int = NULL;
 	int down = 0;
 	int res = 0;
 	int i;
@@ -2637,6 +2719,18 @@ static void *ftdm_libpri_run(ftdm_thread_t *me, void *obj)
 		goto out;
 	}
 
+	/* Wake up the event loop as soon as a state change is queued */
+	if (ftdm_span_get_dirty_interrupt(span, &pending_int) != FTDM_SUCCESS ||
+	    lpwrap_add_interrupt(&isdn_data->spri, pending_int)) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to get a state change interrupt for span %d\n",
+			ftdm_span_get_id(span));
+		goto out;
+	}
+
+	memset(&isdn_data->stats, 0, sizeof(isdn_data->stats));
+	isdn_data->stats.since = ftdm_current_time_in_ms();
+	isdn_data->event_poll_ms = 0;
+
 #ifdef HAVE_LIBPRI_AOC
 	/*
 	 * Only enable facility on trunk if really required,
@@ -3191,6 +3285,9 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_libpri_configure_span)
 	/* move calls to PROCEED state when they hit dialplan (ROUTING state in FreeSWITCH) */
 	ftdm_set_flag(span, FTDM_SPAN_USE_PROCEED_STATE);
 
+	/* mark channels with pending state changes in the dirty map instead of scanning the whole span */
+	ftdm_set_flag(span, FTDM_SPAN_USE_DIRTY_MAP);
+
 	if ((isdn_data->opts & FTMOD_LIBPRI_OPT_SUGGEST_CHANNEL)) {
 		span->channel_request = isdn_channel_request;
 		ftdm_set_flag(span, FTDM_SPAN_SUGGEST_CHAN_ID);
@@ -50,6 +50,13 @@
 #define T316_TIMEOUT_MS_MIN		10000	/* 10 sec */
 #define T316_TIMEOUT_MS_MAX		300000	/* 5 min  */
 
+/*
+ * B-channel OOB event poll interval, when the D-channel did not report any.
+ * B-channel events (alarms) do not wake up the D-channel wait, poll them at least
+ * once per event loop timeout like the loop always did.
+ */
+#define EVENT_POLL_INTERVAL_MS		LPWRAP_MAX_TIMEOUT_MS
+
 /* T316 restart attempts until channel is suspended */
 #define T316_ATTEMPT_LIMIT_DEFAULT	3
 #define T316_ATTEMPT_LIMIT_MIN		1
@@ -83,6 +90,18 @@ typedef enum {
 #define FTMOD_LIBPRI_OVERLAP_BOTH	(FTMOD_LIBPRI_OVERLAP_RECEIVE | FTMOD_LIBPRI_OVERLAP_SEND)
 } ftdm_isdn_overlap_t;
 
+/**
+ * Event loop statistics ("libpri stats <span>")
+ */
+struct ftdm_libpri_stats {
+	ftdm_time_t since;		/*!< time of the last reset */
+	uint64_t wakeups;		/*!< event loop wakeup count at the last reset */
+	uint32_t setup_count;		/*!< inbound SETUPs answered with ALERTING */
+	ftdm_time_t setup_alert_min;	/*!< SETUP-to-ALERTING latency (ms) */
+	ftdm_time_t setup_alert_max;
+	ftdm_time_t setup_alert_total;
+};
+
 struct ftdm_libpri_data {
 	ftdm_channel_t *dchan;
 	ftdm_isdn_opts_t opts;
@@ -108,6 +127,11 @@ struct ftdm_libpri_data {
 
 	/* NT-mode idle restart timer */
 	struct lpwrap_timer t3xx;
+
+	/* next scheduled B-channel OOB event poll */
+	ftdm_time_t event_poll_ms;
+
+	struct ftdm_libpri_stats stats;
 };
 
 typedef struct ftdm_libpri_data ftdm_libpri_data_t;
@@ -132,6 +156,7 @@ struct ftdm_libpri_b_chan {
 	uint32_t flags;			/*!< channel flags */
 	uint32_t t316_timeout_cnt;	/*!< T316 timeout counter */
 	int peerhangup;			/*!< hangup requested from libpri (RELEASE/RELEASE_ACK/DL_RELEASE/TIMERS EXPIRY) */
+	ftdm_time_t setup_time;		/*!< time the inbound SETUP was received */
 };
 
 typedef struct ftdm_libpri_b_chan ftdm_libpri_b_chan_t;
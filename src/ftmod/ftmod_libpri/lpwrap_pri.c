@@ -180,10 +180,46 @@ int lpwrap_init_pri(struct lpwrap_pri *spri, ftdm_span_t *span, ftdm_channel_t *
 	} else {
 		ftdm_log(FTDM_LOG_CRIT, "Unable to create BRI/PRI\n");
 		ftdm_mutex_destroy(&spri->timer_mutex);
+		return ret;
+	}
+
+#ifndef __WINDOWS__
+	/*
+	 * Persistent D-Channel interrupt, lpwrap_run_pri_once() waits on it
+	 * together with any interrupt added via lpwrap_add_interrupt()
+	 * so state changes wake up the loop right away.
+	 * (Windows has no device support in ftdm_interrupt_multiple_wait(),
+	 *  use ftdm_channel_wait() there)
+	 */
+	if (ftdm_interrupt_create(&spri->ints[0], spri->dchan->sockfd, FTDM_READ | FTDM_EVENTS) == FTDM_SUCCESS) {
+		spri->num_ints = 1;
+	} else {
+		ftdm_log(FTDM_LOG_WARNING, "Failed to create D-Channel interrupt, falling back to polling\n");
 	}
+#endif
 	return ret;
 }
 
+/*
+ * Add an interrupt to be waited on in the event loop (D-Channel interrupt mode only)
+ */
+int lpwrap_add_interrupt(struct lpwrap_pri *spri, ftdm_interrupt_t *interrupt)
+{
+	if (!spri || !interrupt)
+		return -1;
+
+	if (!spri->num_ints) {
+		/* polling mode, the interrupt will be serviced on the next timeout */
+		return 0;
+	}
+	if (spri->num_ints >= LPWRAP_MAX_INTERRUPTS) {
+		ftdm_log(FTDM_LOG_ERROR, "Too many interrupts on span %d\n", spri->span->span_id);
+		return -1;
+	}
+	spri->ints[spri->num_ints++] = interrupt;
+	return 0;
+}
+
 
 #define timeval_to_ms(x) \
 	(ftdm_time_t)(((x)->tv_sec * 1000) + ((x)->tv_usec / 1000))
@@ -298,7 +334,6 @@ static int lpwrap_run_expired(struct lpwrap_pri *spri, ftdm_time_t now_ms)
 }
 
 
-#define LPWRAP_MAX_TIMEOUT_MS	100
 #define LPWRAP_MAX_ERRORS	2
 
 int lpwrap_run_pri_once(struct lpwrap_pri *spri)
@@ -352,12 +387,23 @@ int lpwrap_run_pri_once(struct lpwrap_pri *spri)
 
 	/* */
 	if (timeout_ms > 0) {
-		flags = FTDM_READ | FTDM_EVENTS;
-		ret = ftdm_channel_wait(spri->dchan, &flags, timeout_ms);
+		if (spri->num_ints) {
+			ret = ftdm_interrupt_multiple_wait(spri->ints, spri->num_ints, timeout_ms);
+			flags = ftdm_interrupt_device_ready(spri->ints[0]);
+		} else {
+			flags = FTDM_READ | FTDM_EVENTS;
+			ret = ftdm_channel_wait(spri->dchan, &flags, timeout_ms);
+		}
+		spri->wakeups++;
 
 		if (spri->flags & LPWRAP_PRI_ABORT)
 			return FTDM_SUCCESS;
 
+		if (flags & FTDM_EVENTS) {
+			/* let the on_loop handler pick up the OOB events */
+			spri->flags |= LPWRAP_PRI_EVENTS;
+		}
+
 		if (ret == FTDM_TIMEOUT) {
 			now_ms = ftdm_current_time_in_ms();
 
@@ -449,6 +495,10 @@ int lpwrap_destroy_pri(struct lpwrap_pri *spri)
 {
 	if (spri->timer_mutex)
 		ftdm_mutex_destroy(&spri->timer_mutex);
+	/* only the D-Channel interrupt is ours */
+	if (spri->ints[0])
+		ftdm_interrupt_destroy(&spri->ints[0]);
+	spri->num_ints = 0;
 	return FTDM_SUCCESS;
 }
 
@@ -93,9 +93,16 @@ typedef enum {
 
 typedef enum {
 	LPWRAP_PRI_READY = (1 << 0),
-	LPWRAP_PRI_ABORT = (1 << 1)
+	LPWRAP_PRI_ABORT = (1 << 1),
+	LPWRAP_PRI_EVENTS = (1 << 2)	/*!< D-Channel reported pending OOB events */
 } lpwrap_pri_flag_t;
 
+/* D-Channel interrupt + user interrupts (e.g. span pending state queue) */
+#define LPWRAP_MAX_INTERRUPTS	4
+
+/* Max. time lpwrap_run_pri_once() waits for the D-Channel */
+#define LPWRAP_MAX_TIMEOUT_MS	100
+
 struct lpwrap_pri;
 struct lpwrap_timer;
 
@@ -114,6 +121,9 @@ struct lpwrap_pri {
 	int errs;
 	struct lpwrap_timer *timer_list;
 	ftdm_mutex_t *timer_mutex;
+	ftdm_interrupt_t *ints[LPWRAP_MAX_INTERRUPTS];	/*!< ints[0] is the D-Channel, waited on together with the rest */
+	int num_ints;
+	uint64_t wakeups;	/*!< number of times the event loop woke up */
 };
 
 typedef struct lpwrap_pri lpwrap_pri_t;
@@ -137,6 +147,7 @@ int lpwrap_stop_timer(struct lpwrap_pri *spri, struct lpwrap_timer *timer);
 const char *lpwrap_pri_event_str(lpwrap_pri_event_t event_id);
 
 int lpwrap_init_pri(struct lpwrap_pri *spri, ftdm_span_t *span, ftdm_channel_t *dchan, int swtype, int node, int debug);
+int lpwrap_add_interrupt(struct lpwrap_pri *spri, ftdm_interrupt_t *interrupt);
 int lpwrap_destroy_pri(struct lpwrap_pri *spri);
 int lpwrap_run_pri_once(struct lpwrap_pri *spri);
 int lpwrap_run_pri(struct lpwrap_pri *spri);
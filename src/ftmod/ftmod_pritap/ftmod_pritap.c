@@ -399,15 +399,7 @@ static ftdm_status_t state_advance(ftdm_channel_t *ftdmchan)
 
 static __inline__ void pritap_check_state(ftdm_span_t *span)
 {
-	if (ftdm_test_flag(span, FTDM_SPAN_STATE_CHANGE)) {
-		uint32_t j;
-		ftdm_clear_flag_locked(span, FTDM_SPAN_STATE_CHANGE);
-		for(j = 1; j <= span->chan_count; j++) {
-			ftdm_channel_lock(span->channels[j]);
-			ftdm_channel_advance_states(span->channels[j]);
-			ftdm_channel_unlock(span->channels[j]);
-		}
-	}
+	ftdm_span_advance_all_states(span);
 }
 
 static int pri_io_read(struct pri *pri, void *buf, int buflen)
@@ -849,8 +841,10 @@ static void *ftdm_pritap_run(ftdm_thread_t *me, void *obj)
 	pritap_t *pritap = span->signal_data;
 	pritap_t *p_pritap = NULL;
 	pri_event *event = NULL;
-	struct pollfd dpoll[2];
-	int rc = 0;
+	/* both D-channels and both span dirty channel maps wake up the master thread */
+	ftdm_interrupt_t *ints[4] = { NULL, NULL, NULL, NULL };
+	ftdm_wait_flag_t flags[2];
+	ftdm_status_t status;
 
 	ftdm_log(FTDM_LOG_DEBUG, "Tapping PRI thread started on span %s\n", span->name);
 	
@@ -881,34 +875,33 @@ static void *ftdm_pritap_run(ftdm_thread_t *me, void *obj)
 			poll(NULL, 0, 100);
 		}
 	} else {
-		memset(&dpoll, 0, sizeof(dpoll));
-		dpoll[0].fd = pritap->dchan->sockfd;
-		dpoll[1].fd = p_pritap->dchan->sockfd;
+		if (ftdm_interrupt_create(&ints[0], pritap->dchan->sockfd, FTDM_READ) != FTDM_SUCCESS ||
+		    ftdm_interrupt_create(&ints[1], p_pritap->dchan->sockfd, FTDM_READ) != FTDM_SUCCESS) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to create the D-channel interrupts for span %s\n", span->name);
+			goto done;
+		}
+		if (ftdm_span_get_dirty_interrupt(span, &ints[2]) != FTDM_SUCCESS ||
+		    ftdm_span_get_dirty_interrupt(peer, &ints[3]) != FTDM_SUCCESS) {
+			ftdm_log(FTDM_LOG_CRIT, "Failed to get the state change interrupts for span %s\n", span->name);
+			goto done;
+		}
 
 		ftdm_log(FTDM_LOG_DEBUG, "Master tapping thread on span %s (fd1=%d, fd2=%d)\n", span->name,
 				pritap->dchan->sockfd, p_pritap->dchan->sockfd);
 
 		while (ftdm_running() && !ftdm_test_flag(span, FTDM_SPAN_STOP_THREAD)) {
+			ftdm_span_metrics_loop_mark(span);
 
 			pritap_check_state(span);
 			pritap_check_state(peer);
 
-			dpoll[0].revents = 0;
-			dpoll[0].events = POLLIN;
-
-			dpoll[1].revents = 0;
-			dpoll[1].events = POLLIN;
-
-			rc = poll(&dpoll[0], 2, 10);
-
-			if (rc < 0) {
-				if (errno == EINTR) {
-					ftdm_log(FTDM_LOG_DEBUG, "D-channel waiting interrupted, continuing ...\n");
-					continue;
-				}
-				ftdm_log(FTDM_LOG_ERROR, "poll failed: %s\n", strerror(errno));
+			status = ftdm_interrupt_multiple_wait(ints, ftdm_array_len(ints), 10);
+			if (status == FTDM_FAIL) {
+				ftdm_log(FTDM_LOG_ERROR, "D-channel wait failed on span %s\n", span->name);
 				continue;
 			}
+			flags[0] = ftdm_interrupt_device_ready(ints[0]);
+			flags[1] = ftdm_interrupt_device_ready(ints[1]);
 
 			pri_schedule_run(pritap->pri);
 			pri_schedule_run(p_pritap->pri);
@@ -916,8 +909,8 @@ static void *ftdm_pritap_run(ftdm_thread_t *me, void *obj)
 			pritap_check_state(span);
 			pritap_check_state(peer);
 
-			if (rc) {
-				if (dpoll[0].revents & POLLIN) {
+			if (status == FTDM_SUCCESS) {
+				if (flags[0] & FTDM_READ) {
 					event = pri_read_event(pritap->pri);
 					if (event) {
 						handle_pri_passive_event(pritap, event);
@@ -925,7 +918,7 @@ static void *ftdm_pritap_run(ftdm_thread_t *me, void *obj)
 					}
 				}
 
-				if (dpoll[1].revents & POLLIN) {
+				if (flags[1] & FTDM_READ) {
 					event = pri_read_event(p_pritap->pri);
 					if (event) {
 						handle_pri_passive_event(p_pritap, event);
@@ -941,6 +934,14 @@ static void *ftdm_pritap_run(ftdm_thread_t *me, void *obj)
 done:
 	ftdm_log(FTDM_LOG_DEBUG, "Tapping PRI thread ended on span %s\n", span->name);
 
+	/* the dirty map interrupts belong to the spans */
+	if (ints[0]) {
+		ftdm_interrupt_destroy(&ints[0]);
+	}
+	if (ints[1]) {
+		ftdm_interrupt_destroy(&ints[1]);
+	}
+
 	ftdm_clear_flag(span, FTDM_SPAN_IN_THREAD);
 	ftdm_clear_flag(pritap, PRITAP_RUNNING);
 	ftdm_clear_flag(pritap, PRITAP_MASTER);
@@ -1160,6 +1161,9 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_pritap_configure_span)
 	span->state_map = &pritap_state_map;
 	span->state_processor = state_advance;
 
+	/* the span thread only visits the channels with a state change pending */
+	ftdm_set_flag(span, FTDM_SPAN_USE_DIRTY_MAP);
+
 	return FTDM_SUCCESS;
 }
 
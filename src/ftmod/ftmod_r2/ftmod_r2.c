@@ -54,6 +54,7 @@
 #include <private/ftdm_core.h>
 
 #include "ftmod_r2_io_mf_lib.h" // ftdm_r2_get_native_channel_mf_generation_iface
+#include "ftmod_r2_mf.h"
 
 /* when the user stops a span, we clear FTDM_R2_SPAN_STARTED, so that the signaling thread
  * knows it must stop, and we wait for FTDM_R2_RUNNING to be clear, which tells us the
@@ -81,8 +82,28 @@ typedef struct ftdm_r2_call_t {
 	char logname[255];
 	char name[10];
 	ftdm_timer_id_t protocol_error_recovery_timer;
+	/* MF engine handles (mf_engine = freetdm), not call data either */
+	ftdm_r2_mf_rx_t mf_rx;
+	ftdm_r2_mf_tx_t mf_tx;
+	/* event driven span loop, not call data: ft_r2_clean_call() leaves them alone */
+	int32_t active_index; /* position in the span active set, -1 when not in it */
+	ftdm_time_t timer_due; /* time the next openr2 timer of the channel is due, 0 if none */
+	uint64_t serviced; /* span loop the channel was last serviced in */
 } ftdm_r2_call_t;
 
+/* span loop phases, the processing time of each one is kept in ftdm_r2_data_t.phases */
+typedef enum {
+	FTDM_R2_PHASE_SIGNALS, /* delivery of the queued signals to the user */
+	FTDM_R2_PHASE_TIMERS, /* span scheduler */
+	FTDM_R2_PHASE_SCAN, /* every channel of the span (event_driven disabled) */
+	FTDM_R2_PHASE_STATES, /* channels with a state change pending */
+	FTDM_R2_PHASE_CAS, /* channels with CAS or alarm events */
+	FTDM_R2_PHASE_MF, /* channels in the active set, in MF signaling or with an openr2 timer pending */
+	FTDM_R2_PHASE_COUNT
+} ftdm_r2_phase_t;
+
+static const char *ftdm_r2_phase_names[FTDM_R2_PHASE_COUNT] = { "signals", "timers", "scan", "states", "cas", "mf" };
+
 /* this is just used as place holder in the stack when configuring the span to avoid using bunch of locals */
 typedef struct ft_r2_conf_s {
 	/* openr2 types */
@@ -111,6 +132,8 @@ typedef struct ft_r2_conf_s {
 	int forced_release;
 	int allow_collect_calls;
 	int use_channel_native_mf_generation;
+	int use_ftdm_mf_engine;
+	int event_driven;
 } ft_r2_conf_t;
 
 /* r2 configuration stored in span->signal_data */
@@ -129,6 +152,8 @@ typedef struct ftdm_r2_data_s {
 	int forced_release:1;
 	/* whether accept the call when offered, or wait until the user decides to accept */
 	int accept_on_offer:1;
+	/* whether the span loop services only the channels with activity instead of all of them */
+	int event_driven:1;
 	/* Size of multi-frequency (or any media) dumps used during protocol errors */
 	ftdm_size_t mf_dump_size;
 	/* max time spent in ms doing real work in a single loop */
@@ -137,12 +162,18 @@ typedef struct ftdm_r2_data_s {
 	uint64_t total_loops;
 	/* number of loops per 10ms increment from 0-9ms, 10-19ms .. 100ms and above */
 	uint64_t loops[11];
+	/* sum in ms of the loop times counted in loops */
+	uint64_t loops_ms;
 	/* Total number of sleeps performed so far */
 	uint64_t total_sleeps;
-	/* number of sleeps per 10ms increment from 0-9ms, 10-19ms .. 100ms and above */
+	/* number of sleeps per 15ms increment from 0-14ms, 15-29ms .. 150ms and above */
 	uint64_t sleeps[11];
+	/* sum in ms of the sleep times counted in sleeps */
+	uint64_t sleeps_ms;
 	/* max time spent in ms sleeping in a single loop */
 	int32_t sleepmax;
+	/* processing time of each loop phase */
+	ftdm_histogram_t phases[FTDM_R2_PHASE_COUNT];
 	/* LWP */
 	uint32_t monitor_thread_id;
 	/* Logging directory */
@@ -1480,7 +1511,9 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 		/* .charge_calls */ -1,
 		/* .forced_release */ -1,
 		/* .allow_collect_calls */ -1,
-		/* .use_channel_native_mf_generation */ 0
+		/* .use_channel_native_mf_generation */ 0,
+		/* .use_ftdm_mf_engine */ 0,
+		/* .event_driven */ 0
 	};
 
 	ftdm_assert_return(sig_cb != NULL, FTDM_FAIL, "No signaling cb provided\n");
@@ -1599,6 +1632,23 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 		} else if (!strcasecmp(var, "max_dnis")) {
 			r2conf.max_dnis = atoi(val);
 			ftdm_log(FTDM_LOG_DEBUG, "Configuring R2 span %s with max dnis = %d\n", span->name, r2conf.max_dnis);
+		} else if (!strcasecmp(var, "mf_engine")) {
+			if (!val) {
+				break;
+			}
+			if (!strcasecmp(val, "freetdm")) {
+				r2conf.use_ftdm_mf_engine = 1;
+			} else if (!strcasecmp(val, "openr2")) {
+				r2conf.use_ftdm_mf_engine = 0;
+			} else {
+				ftdm_log(FTDM_LOG_ERROR, "Unknown R2 MF engine %s\n", val);
+				conf_failure = 1;
+				break;
+			}
+			ftdm_log(FTDM_LOG_DEBUG, "Configuring R2 span %s with MF engine %s\n", span->name, val);
+		} else if (!strcasecmp(var, "event_driven")) {
+			r2conf.event_driven = ftdm_true(val);
+			ftdm_log(FTDM_LOG_DEBUG, "Configuring R2 span %s with event driven loop = %d\n", span->name, r2conf.event_driven);
 		} else if (!strcasecmp(var, "use_channel_native_mf_generation")) {
 			r2conf.use_channel_native_mf_generation = ftdm_true(val);
 			ftdm_log(FTDM_LOG_DEBUG, "Configuring R2 span %s with \"use native channel MF generation\" = %d\n", span->name, r2conf.use_channel_native_mf_generation);
@@ -1653,7 +1703,9 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 		openr2_context_configure_from_advanced_file(r2data->r2context, r2conf.advanced_protocol_file);
 	}
 
-	if(r2conf.use_channel_native_mf_generation) {
+	if (r2conf.use_ftdm_mf_engine) {
+		openr2_context_set_mflib_interface(r2data->r2context, ftdm_r2_get_mf_engine_iface(r2conf.use_channel_native_mf_generation));
+	} else if(r2conf.use_channel_native_mf_generation) {
 		openr2_context_set_mflib_interface(r2data->r2context, ftdm_r2_get_native_channel_mf_generation_iface());
 	}
 
@@ -1700,6 +1752,11 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 		openr2_chan_set_logging_func(r2chan, ftdm_r2_on_chan_log);
 		openr2_chan_set_client_data(r2chan, span->channels[i]);
 		r2call->r2chan = r2chan;
+		r2call->active_index = -1;
+		if (r2conf.use_ftdm_mf_engine) {
+			/* with native generation the write handle set above stays in place */
+			openr2_chan_set_mflib_handles(r2chan, r2conf.use_channel_native_mf_generation ? NULL : &r2call->mf_tx, &r2call->mf_rx);
+		}
 		span->channels[i]->call_data = r2call;
 		/* value and key are the same so just free one of them */
 		snprintf(r2call->name, sizeof(r2call->name), "chancall%d", i);
@@ -1711,6 +1768,7 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 	r2data->flags = 0;
 	r2data->charge_calls = r2conf.charge_calls;
 	r2data->forced_release = r2conf.forced_release;
+	r2data->event_driven = r2conf.event_driven ? 1 : 0;
 	spanpvt->r2context = r2data->r2context;
 
 	/* just the value must be freed by the hash */
@@ -1739,6 +1797,11 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_r2_configure_span_signaling)
 	/* we can skip states (going straight from RING to UP) */
 	ftdm_set_flag(span, FTDM_SPAN_USE_SKIP_STATES);
 
+	/* the event driven loop only services the channels marked in the dirty map for state changes */
+	if (r2data->event_driven) {
+		ftdm_set_flag(span, FTDM_SPAN_USE_DIRTY_MAP);
+	}
+
 	/* setup the scheduler */
 	snprintf(schedname, sizeof(schedname), "ftmod_r2_%s", span->name);
 	ftdm_assert(ftdm_sched_create(&r2data->sched, schedname) == FTDM_SUCCESS, "Failed to create schedule!\n");
@@ -1946,23 +2009,182 @@ static ftdm_status_t ftdm_r2_state_advance(ftdm_channel_t *ftdmchan)
 	return ret;
 }
 
+/* this takes care of MF and CAS signaling during call setup and tear down for a single channel,
+ * the channel must be locked, do not perform blocking operations here! */
+static void ftdm_r2_service_channel(ftdm_channel_t *ftdmchan)
+{
+	ftdm_r2_call_t *call = R2CALL(ftdmchan);
+
+	/* This let knows the core and io signaling hooks know that 
+	 * read/writes come from us and should be allowed */
+	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_TX_DISABLED);
+
+	ftdm_channel_advance_states(ftdmchan);
+
+	openr2_chan_process_signaling(call->r2chan);
+
+	ftdm_channel_advance_states(ftdmchan);
+
+	if (!call->accepted) {
+		/* if the call is not accepted we do not want users reading */
+		ftdm_set_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+		ftdm_set_flag(ftdmchan, FTDM_CHANNEL_TX_DISABLED);
+	}
+}
+
+/* state of the event driven span loop, owned by the span thread */
+typedef struct {
+	/* channels reading MF tones or with an openr2 timer pending */
+	ftdm_channel_t **active;
+	uint32_t num_active;
+	/* channels to service in the current phase */
+	ftdm_channel_t **ready;
+	/* events polled for each channel, FTDM_READ is only set while openr2 wants to read */
+	short *poll_events;
+	/* current loop, a channel is serviced at most once per loop */
+	uint64_t loop;
+} ftdm_r2_engine_t;
+
+/* a full scan of the span every this many loops catches openr2 changes done outside the span thread */
+#define FTDM_R2_ENGINE_RESCAN_LOOPS 100
+
+/* update the poll events and the active set membership of a channel after servicing it, the channel must be locked */
+static void ftdm_r2_engine_update(ftdm_r2_engine_t *engine, ftdm_channel_t *ftdmchan, ftdm_time_t now)
+{
+	ftdm_r2_call_t *call = R2CALL(ftdmchan);
+	short *events = &engine->poll_events[ftdmchan->chan_id - 1];
+	int read_enabled = openr2_chan_get_read_enabled(call->r2chan);
+	int next = openr2_chan_get_time_to_next_event(call->r2chan);
+
+	if (read_enabled) {
+		*events |= FTDM_READ;
+	} else {
+		*events &= ~FTDM_READ;
+	}
+	call->timer_due = next >= 0 ? now + next : 0;
+
+	if (read_enabled || call->timer_due) {
+		if (call->active_index < 0) {
+			call->active_index = engine->num_active;
+			engine->active[engine->num_active++] = ftdmchan;
+		}
+	} else if (call->active_index >= 0) {
+		ftdm_channel_t *last = engine->active[--engine->num_active];
+		engine->active[call->active_index] = last;
+		R2CALL(last)->active_index = call->active_index;
+		call->active_index = -1;
+	}
+}
+
+static void ftdm_r2_engine_service(ftdm_r2_engine_t *engine, ftdm_channel_t *ftdmchan)
+{
+	ftdm_r2_call_t *call = R2CALL(ftdmchan);
+
+	if (call->serviced == engine->loop) {
+		return;
+	}
+	call->serviced = engine->loop;
+
+	ftdm_channel_lock(ftdmchan);
+	ftdm_r2_service_channel(ftdmchan);
+	ftdm_r2_engine_update(engine, ftdmchan, ftdm_current_time_in_ms());
+	ftdm_channel_unlock(ftdmchan);
+}
+
+/* time to wait for I/O, bounded by the nearest openr2 timer of the active set */
+static int ftdm_r2_engine_waitms(ftdm_r2_engine_t *engine, int waitms)
+{
+	ftdm_time_t now = ftdm_current_time_in_ms();
+	uint32_t i;
+
+	for (i = 0; i < engine->num_active; i++) {
+		ftdm_time_t due = R2CALL(engine->active[i])->timer_due;
+		if (!due) {
+			continue;
+		}
+		if (due <= now) {
+			return 0;
+		}
+		if ((due - now) < (ftdm_time_t)waitms) {
+			waitms = (int)(due - now);
+		}
+	}
+	return waitms;
+}
+
+/* service only the channels with activity: pending state changes, CAS events, MF tones to read or openr2 timers due */
+static void ftdm_r2_engine_run(ftdm_r2_engine_t *engine, ftdm_span_t *span, ftdm_r2_data_t *r2data, ftdm_status_t status)
+{
+	uint64_t phase_start = ftdm_metrics_now();
+	ftdm_time_t now;
+	uint32_t count, i;
+
+	engine->loop++;
+
+	if (!(engine->loop % FTDM_R2_ENGINE_RESCAN_LOOPS)) {
+		for (i = 1; i <= span->chan_count; i++) {
+			ftdm_r2_engine_service(engine, span->channels[i]);
+		}
+		ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_SCAN], phase_start);
+		return;
+	}
+
+	count = ftdm_span_collect_dirty(span, engine->ready);
+	for (i = 0; i < count; i++) {
+		ftdm_r2_engine_service(engine, engine->ready[i]);
+	}
+	phase_start = ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_STATES], phase_start);
+
+	if (FTDM_SUCCESS == status) {
+		for (count = 0, i = 1; i <= span->chan_count; i++) {
+			if (ftdm_test_io_flag(span->channels[i], FTDM_CHANNEL_IO_EVENT)) {
+				engine->ready[count++] = span->channels[i];
+			}
+		}
+		for (i = 0; i < count; i++) {
+			ftdm_r2_engine_service(engine, engine->ready[i]);
+		}
+		phase_start = ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_CAS], phase_start);
+	}
+
+	/* walk backwards, a channel leaving the set is replaced by the last one, which was already visited */
+	now = ftdm_current_time_in_ms();
+	for (i = engine->num_active; i-- > 0; ) {
+		ftdm_channel_t *ftdmchan = engine->active[i];
+		ftdm_time_t due = R2CALL(ftdmchan)->timer_due;
+		if (ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ) || (due && due <= now)) {
+			ftdm_r2_engine_service(engine, ftdmchan);
+		}
+	}
+	ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_MF], phase_start);
+}
+
 static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 {
 	openr2_chan_t *r2chan = NULL;
 	ftdm_channel_t *ftdmchan = NULL;
-	ftdm_r2_call_t *call = NULL;
 	ftdm_status_t status;
 	ftdm_span_t *span = (ftdm_span_t *) obj;
 	ftdm_r2_data_t *r2data = span->signal_data;
+	ftdm_r2_engine_t engine;
 	int waitms = 20;
 	unsigned int i;
 	int res, ms;
 	int index = 0;
 	struct timeval start, end;
+	uint64_t phase_start;
 	ftdm_iterator_t *chaniter = NULL;
 	ftdm_iterator_t *citer = NULL;
 	uint32_t txqueue_size = 4;
-	short *poll_events = ftdm_malloc(sizeof(short) * span->chan_count);
+	short *poll_events = ftdm_calloc(span->chan_count, sizeof(short));
+
+	memset(&engine, 0, sizeof(engine));
+	engine.poll_events = poll_events;
+	if (r2data->event_driven) {
+		engine.active = ftdm_calloc(span->chan_count, sizeof(*engine.active));
+		engine.ready = ftdm_calloc(span->chan_count, sizeof(*engine.ready));
+	}
 
 	/* as long as this thread is running, this flag is set */
 	ftdm_set_flag(r2data, FTDM_R2_RUNNING);
@@ -1972,6 +2194,10 @@ static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 #endif
 	
 	ftdm_log(FTDM_LOG_DEBUG, "OpenR2 monitor thread %u started.\n", r2data->monitor_thread_id);
+	if (!poll_events || (r2data->event_driven && (!engine.active || !engine.ready))) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to allocate the poll data for span %s!\n", span->name);
+		goto done;
+	}
 	r2chan = NULL;
 	chaniter = ftdm_span_get_chan_iterator(span, NULL);
 	if (!chaniter) {
@@ -1985,6 +2211,12 @@ static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 		openr2_chan_set_span_id(r2chan, span->span_id);
 		openr2_chan_set_idle(r2chan);
 		openr2_chan_process_cas_signaling(r2chan);
+		if (r2data->event_driven) {
+			R2CALL(ftdmchan)->active_index = -1;
+			R2CALL(ftdmchan)->serviced = 0;
+			poll_events[ftdmchan->chan_id - 1] = FTDM_EVENTS;
+			ftdm_r2_engine_update(&engine, ftdmchan, ftdm_current_time_in_ms());
+		}
 		ftdm_channel_unlock(ftdmchan);
 		ftdm_channel_command(ftdmchan, FTDM_COMMAND_SET_TX_QUEUE_SIZE, &txqueue_size);
 	}
@@ -1992,6 +2224,7 @@ static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 	memset(&start, 0, sizeof(start));
 	memset(&end, 0, sizeof(end));
 	while (ftdm_running() && ftdm_test_flag(r2data, FTDM_R2_SPAN_STARTED)) {
+		ftdm_span_metrics_loop_mark(span);
 		res = gettimeofday(&end, NULL);
 		if (res) {
 			ftdm_log(FTDM_LOG_CRIT, "Failure gettimeofday [%s]\n", strerror(errno));
@@ -2008,41 +2241,48 @@ static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 			index = (ms / 10);
 			index = (index > 10) ? 10 : index;
 			r2data->loops[index]++;
+			r2data->loops_ms += ms;
 			r2data->total_loops++;
 		}
 
-		/* run any span timers */
-		ftdm_sched_run(r2data->sched);
-
 		/* deliver the actual channel events to the user now without any channel locking */
+		phase_start = ftdm_metrics_now();
 		ftdm_span_trigger_signals(span);
+		ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_SIGNALS], phase_start);
 
-		 /* figure out what event to poll each channel for. POLLPRI when the channel is down,
-		  * POLLPRI|POLLIN|POLLOUT otherwise */
-		memset(poll_events, 0, sizeof(short)*span->chan_count);
-		citer = ftdm_span_get_chan_iterator(span, chaniter);
-		if (!citer) {
-			ftdm_log(FTDM_LOG_CRIT, "Failed to allocate channel iterator for span %s!\n", span->name);
-			goto done;
-		}
-		for (i = 0; citer; citer = ftdm_iterator_next(citer), i++) {
-			ftdmchan = ftdm_iterator_current(citer);
-			r2chan = R2CALL(ftdmchan)->r2chan;
-			poll_events[i] = FTDM_EVENTS;
-			if (openr2_chan_get_read_enabled(r2chan)) {
-				poll_events[i] |= FTDM_READ;
+		if (r2data->event_driven) {
+			/* the poll events are kept up to date as channels are serviced */
+			status = ftdm_span_poll_event(span, ftdm_r2_engine_waitms(&engine, waitms), poll_events);
+		} else {
+			/* figure out what event to poll each channel for. POLLPRI when the channel is down,
+			 * POLLPRI|POLLIN|POLLOUT otherwise */
+			memset(poll_events, 0, sizeof(short)*span->chan_count);
+			citer = ftdm_span_get_chan_iterator(span, chaniter);
+			if (!citer) {
+				ftdm_log(FTDM_LOG_CRIT, "Failed to allocate channel iterator for span %s!\n", span->name);
+				goto done;
+			}
+			for (i = 0; citer; citer = ftdm_iterator_next(citer), i++) {
+				ftdmchan = ftdm_iterator_current(citer);
+				r2chan = R2CALL(ftdmchan)->r2chan;
+				poll_events[i] = FTDM_EVENTS;
+				if (openr2_chan_get_read_enabled(r2chan)) {
+					poll_events[i] |= FTDM_READ;
+				}
 			}
+			status = ftdm_span_poll_event(span, waitms, poll_events);
 		}
-		status = ftdm_span_poll_event(span, waitms, poll_events);
-
-		/* run any span timers */
-		ftdm_sched_run(r2data->sched);
 
 		res = gettimeofday(&start, NULL);
 		if (res) {
 			ftdm_log(FTDM_LOG_CRIT, "Failure gettimeofday [%s]\n", strerror(errno));
 		}
 
+		/* run any span timers */
+		phase_start = ftdm_metrics_now();
+		ftdm_sched_run(r2data->sched);
+		ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_TIMERS], phase_start);
+
 		if (FTDM_FAIL == status) {
 			ftdm_log(FTDM_LOG_CRIT, "Failure waiting I/O! [%s]\n", span->channels[1]->last_error);
 			continue;
@@ -2059,38 +2299,25 @@ static void *ftdm_r2_run(ftdm_thread_t *me, void *obj)
 		index = (ms / 15);
 		index = (index > 10) ? 10 : index;
 		r2data->sleeps[index]++;
+		r2data->sleeps_ms += ms;
 		r2data->total_sleeps++;
 
+		if (r2data->event_driven) {
+			ftdm_r2_engine_run(&engine, span, r2data, status);
+			continue;
+		}
+
 		/* this main loop takes care of MF and CAS signaling during call setup and tear down
 		 * for every single channel in the span, do not perform blocking operations here! */
+		phase_start = ftdm_metrics_now();
 		citer = ftdm_span_get_chan_iterator(span, chaniter);
 		for ( ; citer; citer = ftdm_iterator_next(citer)) {
 			ftdmchan = ftdm_iterator_current(citer);
-
 			ftdm_channel_lock(ftdmchan);
-
-			call = R2CALL(ftdmchan);
-
-			/* This let knows the core and io signaling hooks know that 
-			 * read/writes come from us and should be allowed */
-			ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
-			ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_TX_DISABLED);
-
-			ftdm_channel_advance_states(ftdmchan);
-
-			r2chan = call->r2chan;
-			openr2_chan_process_signaling(r2chan);
-
-			ftdm_channel_advance_states(ftdmchan);
-
-			if (!call->accepted) {
-				/* if the call is not accepted we do not want users reading */
-				ftdm_set_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
-				ftdm_set_flag(ftdmchan, FTDM_CHANNEL_TX_DISABLED);
-			}
-
+			ftdm_r2_service_channel(ftdmchan);
 			ftdm_channel_unlock(ftdmchan);
 		}
+		ftdm_histogram_record_since(&r2data->phases[FTDM_R2_PHASE_SCAN], phase_start);
 	}
 
 done:	
@@ -2105,6 +2332,8 @@ done:
 
 	ftdm_iterator_free(chaniter);
 	ftdm_safe_free(poll_events);
+	ftdm_safe_free(engine.active);
+	ftdm_safe_free(engine.ready);
 
 	ftdm_clear_flag(r2data, FTDM_R2_RUNNING);
 	ftdm_log(FTDM_LOG_DEBUG, "R2 thread ending.\n");
@@ -2326,6 +2555,18 @@ static FIO_API_FUNCTION(ftdm_r2_api)
 					range += 15;
 				}
 				stream->write_function(stream, "\n");
+
+				stream->write_function(stream, "-- Phases (%s loop) --\n", r2data->event_driven ? "event driven" : "scan");
+				for (i = 0; i < FTDM_R2_PHASE_COUNT; i++) {
+					const ftdm_histogram_t *phase = &r2data->phases[i];
+					if (!phase->count) {
+						continue;
+					}
+					stream->write_function(stream, "%-8s count %"FTDM_UINT64_FMT" p50 %"FTDM_UINT64_FMT"us p99 %"FTDM_UINT64_FMT"us max %"FTDM_UINT64_FMT"us\n",
+							ftdm_r2_phase_names[i], phase->count, ftdm_histogram_percentile(phase, 50.0) / 1000,
+							ftdm_histogram_percentile(phase, 99.0) / 1000, phase->max / 1000);
+				}
+				stream->write_function(stream, "\n");
 				
 				stream->write_function(stream, "+OK.\n");
 				goto done;
@@ -2386,12 +2627,78 @@ static FIO_IO_LOAD_FUNCTION(ftdm_r2_io_init)
 	return FTDM_SUCCESS;
 }
 
+/* export the loop statistics as histograms, bucket i holds the loops that took [i*width, (i+1)*width) ms */
+static void r2_render_loop_histogram(ftdm_stream_handle_t *stream, const char *name, const char *span_name,
+		const uint64_t *buckets, int bucket_count, int width, uint64_t total, uint64_t sum_ms)
+{
+	uint64_t cumulative = 0;
+	int i;
+
+	for (i = 0; i < (bucket_count - 1); i++) {
+		cumulative += buckets[i];
+		stream->write_function(stream, "%s_bucket{span=\"%s\",le=\"%.3f\"} %"FTDM_UINT64_FMT"\n",
+				name, span_name, (double)((i + 1) * width) / 1000.0, cumulative);
+	}
+	stream->write_function(stream, "%s_bucket{span=\"%s\",le=\"+Inf\"} %"FTDM_UINT64_FMT"\n", name, span_name, total);
+	stream->write_function(stream, "%s_sum{span=\"%s\"} %.3f\n", name, span_name, (double)sum_ms / 1000.0);
+	stream->write_function(stream, "%s_count{span=\"%s\"} %"FTDM_UINT64_FMT"\n", name, span_name, total);
+}
+
+static void ftdm_r2_metrics_collector(ftdm_stream_handle_t *stream, void *data)
+{
+	ftdm_hash_iterator_t *i = NULL;
+	ftdm_r2_data_t *r2data = NULL;
+	ftdm_span_t *span = NULL;
+	const void *key = NULL;
+	char labels[128];
+	int loops;
+	int phase;
+
+	for (loops = 1; loops >= 0; loops--) {
+		const char *name = loops ? "freetdm_r2_loop_seconds" : "freetdm_r2_sleep_seconds";
+		ftdm_metrics_render_family(stream, name, FTDM_METRIC_HISTOGRAM,
+				loops ? "R2 span loop processing time" : "R2 span loop time waiting for events");
+		for (i = hashtable_first(g_mod_data_hash); i; i = hashtable_next(i)) {
+			hashtable_this(i, &key, NULL, NULL);
+			if (!key || ftdm_span_find_by_name(key, &span) != FTDM_SUCCESS || span->start != ftdm_r2_start) {
+				continue;
+			}
+			if (!(r2data = span->signal_data)) {
+				continue;
+			}
+			if (loops) {
+				r2_render_loop_histogram(stream, name, span->name, r2data->loops,
+						ftdm_array_len(r2data->loops), 10, r2data->total_loops, r2data->loops_ms);
+			} else {
+				r2_render_loop_histogram(stream, name, span->name, r2data->sleeps,
+						ftdm_array_len(r2data->sleeps), 15, r2data->total_sleeps, r2data->sleeps_ms);
+			}
+		}
+	}
+
+	ftdm_metrics_render_family(stream, "freetdm_r2_phase_seconds", FTDM_METRIC_HISTOGRAM, "R2 span loop processing time per phase");
+	for (i = hashtable_first(g_mod_data_hash); i; i = hashtable_next(i)) {
+		hashtable_this(i, &key, NULL, NULL);
+		if (!key || ftdm_span_find_by_name(key, &span) != FTDM_SUCCESS || span->start != ftdm_r2_start) {
+			continue;
+		}
+		if (!(r2data = span->signal_data)) {
+			continue;
+		}
+		for (phase = 0; phase < FTDM_R2_PHASE_COUNT; phase++) {
+			snprintf(labels, sizeof(labels), "span=\"%s\",phase=\"%s\"", span->name, ftdm_r2_phase_names[phase]);
+			ftdm_metrics_render_histogram(stream, "freetdm_r2_phase_seconds", labels, &r2data->phases[phase]);
+		}
+	}
+}
+
 static FIO_SIG_LOAD_FUNCTION(ftdm_r2_init)
 {
 	g_mod_data_hash = create_hashtable(10, ftdm_hash_hashfromstring, ftdm_hash_equalkeys);
 	if (!g_mod_data_hash) {
 		return FTDM_FAIL;
 	}
+	ftdm_metrics_collector_register(ftdm_r2_metrics_collector, NULL);
 	return FTDM_SUCCESS;
 }
 
@@ -2401,6 +2708,7 @@ static FIO_SIG_UNLOAD_FUNCTION(ftdm_r2_destroy)
 	ftdm_r2_span_pvt_t *spanpvt = NULL;
 	const void *key = NULL;
 	void *val = NULL;
+	ftdm_metrics_collector_unregister(ftdm_r2_metrics_collector, NULL);
 	for (i = hashtable_first(g_mod_data_hash); i; i = hashtable_next(i)) {
 		hashtable_this(i, &key, NULL, &val);
 		if (key && val) {
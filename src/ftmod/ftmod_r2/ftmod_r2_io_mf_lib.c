@@ -38,20 +38,24 @@
 #include <openr2.h>
 
 #include "ftmod_r2_io_mf_lib.h"
+#include "ftmod_r2_mf.h"
+
+/* openr2 MF tone enum value of each MF tone number (1-15, 0 no tone) */
+static const openr2_mf_tone_t g_openr2_mf_tones[16] = {
+	0,
+	OR2_MF_TONE_1, OR2_MF_TONE_2, OR2_MF_TONE_3, OR2_MF_TONE_4, OR2_MF_TONE_5,
+	OR2_MF_TONE_6, OR2_MF_TONE_7, OR2_MF_TONE_8, OR2_MF_TONE_9, OR2_MF_TONE_10,
+	OR2_MF_TONE_11, OR2_MF_TONE_12, OR2_MF_TONE_13, OR2_MF_TONE_14, OR2_MF_TONE_15
+};
 
-/* Convert openr2 MF tone enum value to FreeTDM MF tone value 
-    1-15 bitwise OR FTDM_MF_DIRECTION_FORWARD/BACKWARD
-    0 (stop playing)
+/* Convert openr2 MF tone enum value to MF tone number 1-15, 0 (stop playing) or -1 if invalid
    openr2_mf_tone_t defined in r2proto.h
 */
-static int ftdm_r2_openr2_mf_tone_to_ftdm_mf_tone(openr2_mf_tone_t 
-    openr2_tone_value, int forward_signals) 
+static int ftdm_r2_openr2_mf_tone_to_number(openr2_mf_tone_t openr2_tone_value)
 {
-	int tone;
-
 	switch (openr2_tone_value) {
 	case 0: return 0;
-#define TONE_FROM_NAME(name) case OR2_MF_TONE_##name: tone = name; break;
+#define TONE_FROM_NAME(name) case OR2_MF_TONE_##name: return name;
 	TONE_FROM_NAME(1)
 	TONE_FROM_NAME(2)
 	TONE_FROM_NAME(3)
@@ -72,6 +76,20 @@ static int ftdm_r2_openr2_mf_tone_to_ftdm_mf_tone(openr2_mf_tone_t
 		ftdm_assert(0, "Invalid openr2_tone_value\n");
 		return -1;
 	}
+}
+
+/* Convert openr2 MF tone enum value to FreeTDM MF tone value 
+    1-15 bitwise OR FTDM_MF_DIRECTION_FORWARD/BACKWARD
+    0 (stop playing)
+*/
+static int ftdm_r2_openr2_mf_tone_to_ftdm_mf_tone(openr2_mf_tone_t 
+    openr2_tone_value, int forward_signals) 
+{
+	int tone = ftdm_r2_openr2_mf_tone_to_number(openr2_tone_value);
+
+	if (tone <= 0) {
+		return tone;
+	}
 
 	/* Add flag corresponding to direction */
 	if (forward_signals) {
@@ -151,6 +169,72 @@ openr2_mflib_interface_t *ftdm_r2_get_native_channel_mf_generation_iface()
 	return &g_mf_ftdm_io_iface;
 }
 
+/* MF detection and generation routines using the FreeTDM MF engine (ftmod_r2_mf.c) */
+static void *ftdm_r2_mf_read_init(ftdm_r2_mf_rx_t *rx, int forward_signals)
+{
+	return ftdm_r2_mf_rx_init(rx, forward_signals);
+}
+
+static int ftdm_r2_mf_detect_tone(ftdm_r2_mf_rx_t *rx, const int16_t amp[], int samples)
+{
+	return g_openr2_mf_tones[ftdm_r2_mf_rx(rx, amp, samples)];
+}
+
+static void *ftdm_r2_mf_write_init(ftdm_r2_mf_tx_t *tx, int forward_signals)
+{
+	return ftdm_r2_mf_tx_init(tx, forward_signals);
+}
+
+static int ftdm_r2_mf_generate_tone(ftdm_r2_mf_tx_t *tx, int16_t amp[], int samples)
+{
+	return ftdm_r2_mf_tx(tx, amp, samples);
+}
+
+static int ftdm_r2_mf_select_tone(ftdm_r2_mf_tx_t *tx, char signal)
+{
+	int tone = ftdm_r2_openr2_mf_tone_to_number(signal);
+
+	if (tone < 0) {
+		return -1;
+	}
+	return ftdm_r2_mf_tx_select(tx, tone);
+}
+
+static int ftdm_r2_mf_want_generate(ftdm_r2_mf_tx_t *tx, int signal)
+{
+	return signal != 0;
+}
+
+/* MF lib interface that detects and generates MF tones with the FreeTDM MF engine */
+static openr2_mflib_interface_t g_mf_ftdm_iface = {
+	/* .mf_read_init */ (openr2_mf_read_init_func)ftdm_r2_mf_read_init,
+	/* .mf_write_init */ (openr2_mf_write_init_func)ftdm_r2_mf_write_init,
+	/* .mf_detect_tone */ (openr2_mf_detect_tone_func)ftdm_r2_mf_detect_tone,
+	/* .mf_generate_tone */ (openr2_mf_generate_tone_func)ftdm_r2_mf_generate_tone,
+	/* .mf_select_tone */ (openr2_mf_select_tone_func)ftdm_r2_mf_select_tone,
+	/* .mf_want_generate */ (openr2_mf_want_generate_func)ftdm_r2_mf_want_generate,
+	/* .mf_read_dispose */ NULL,
+	/* .mf_write_dispose */ NULL
+};
+
+/* MF lib interface that generates MF tones via FreeTDM channel IO commands
+   and detects them with the FreeTDM MF engine */
+static openr2_mflib_interface_t g_mf_ftdm_io_engine_iface = {
+	/* .mf_read_init */ (openr2_mf_read_init_func)ftdm_r2_mf_read_init,
+	/* .mf_write_init */ (openr2_mf_write_init_func)ftdm_r2_io_mf_write_init,
+	/* .mf_detect_tone */ (openr2_mf_detect_tone_func)ftdm_r2_mf_detect_tone,
+	/* .mf_generate_tone */ (openr2_mf_generate_tone_func)ftdm_r2_io_mf_generate_tone,
+	/* .mf_select_tone */ (openr2_mf_select_tone_func)ftdm_r2_io_mf_select_tone,
+	/* .mf_want_generate */ (openr2_mf_want_generate_func)ftdm_r2_io_mf_want_generate,
+	/* .mf_read_dispose */ NULL,
+	/* .mf_write_dispose */ NULL
+};
+
+openr2_mflib_interface_t *ftdm_r2_get_mf_engine_iface(int native_generation)
+{
+	return native_generation ? &g_mf_ftdm_io_engine_iface : &g_mf_ftdm_iface;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -55,6 +55,11 @@ typedef struct {
    MF detection using the default openr2 provider (r2engine) */   
 openr2_mflib_interface_t *ftdm_r2_get_native_channel_mf_generation_iface(void);
 
+/* MF lib interface that detects MF tones with the FreeTDM MF engine (ftdm_r2_mf_rx_t read handles)
+   and generates them with it too (ftdm_r2_mf_tx_t write handles) or via FreeTDM channel IO commands
+   when native_generation is set (ftdm_r2_mf_write_handle_t write handles) */
+openr2_mflib_interface_t *ftdm_r2_get_mf_engine_iface(int native_generation);
+
 #if defined(__cplusplus)
 } /* endif extern "C" */
 #endif
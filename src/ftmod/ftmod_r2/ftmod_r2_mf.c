@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2009, Moises Silva <moy@sangoma.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <math.h>
+
+#include "ftmod_r2_mf.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FTDM_R2_MF_HAVE_SSE
+#endif
+
+#ifndef M_PI
+#define M_PI        3.14159265358979323846
+#endif
+
+/* minimum energy of each frequency of a tone, a -38dBm0 sine over a block */
+#define FTDM_R2_MF_THRESHOLD 3.65e8f
+/* maximum level difference between the two frequencies of a tone, 7dB */
+#define FTDM_R2_MF_TWIST 5.012f
+/* the other frequencies must be at least 12dB below the weakest frequency of the tone */
+#define FTDM_R2_MF_RELATIVE_PEAK 15.85f
+
+static const float mf_fwd_frequencies[FTDM_R2_MF_FREQS] = { 1380.0f, 1500.0f, 1620.0f, 1740.0f, 1860.0f, 1980.0f };
+static const float mf_bwd_frequencies[FTDM_R2_MF_FREQS] = { 1140.0f, 1020.0f, 900.0f, 780.0f, 660.0f, 540.0f };
+
+/* frequencies (index in the tables above) of each tone */
+static const int mf_tone_frequencies[16][2] = {
+	{ -1, -1 },
+	{ 0, 1 }, { 0, 2 }, { 1, 2 }, { 0, 3 }, { 1, 3 },
+	{ 2, 3 }, { 0, 4 }, { 1, 4 }, { 2, 4 }, { 3, 4 },
+	{ 0, 5 }, { 1, 5 }, { 2, 5 }, { 3, 5 }, { 4, 5 }
+};
+
+/* tone made of each pair of frequencies */
+static const int mf_pair_tone[FTDM_R2_MF_FREQS][FTDM_R2_MF_FREQS] = {
+	{ 0, 1, 2, 4, 7, 11 },
+	{ 1, 0, 3, 5, 8, 12 },
+	{ 2, 3, 0, 6, 9, 13 },
+	{ 4, 5, 6, 0, 10, 14 },
+	{ 7, 8, 9, 10, 0, 15 },
+	{ 11, 12, 13, 14, 15, 0 }
+};
+
+static const char *mf_impl_names[FTDM_R2_MF_IMPL_COUNT] = { "scalar", "sse" };
+
+const char *ftdm_r2_mf_impl_name(ftdm_r2_mf_impl_t impl)
+{
+	return impl < FTDM_R2_MF_IMPL_COUNT ? mf_impl_names[impl] : "invalid";
+}
+
+/* run the goertzel filters over samples of the current block, one lane after the other */
+static void mf_rx_filter_scalar(ftdm_r2_mf_rx_t *rx, const int16_t amp[], int samples)
+{
+	int lane, i;
+
+	for (lane = 0; lane < FTDM_R2_MF_FREQS; lane++) {
+		float fac = rx->fac[lane];
+		float v1;
+		float v2 = rx->v2[lane];
+		float v3 = rx->v3[lane];
+
+		for (i = 0; i < samples; i++) {
+			v1 = v2;
+			v2 = v3;
+			v3 = fac * v2 - v1 + (float)amp[i];
+		}
+		rx->v2[lane] = v2;
+		rx->v3[lane] = v3;
+	}
+}
+
+#ifdef FTDM_R2_MF_HAVE_SSE
+/* same as mf_rx_filter_scalar with all the lanes updated at once, each lane goes through the same
+ * single precision operations in the same order so the results are identical, as long as the compiler
+ * does not reassociate or contract them: this file is built without -ffast-math and FP contraction */
+static void mf_rx_filter_sse(ftdm_r2_mf_rx_t *rx, const int16_t amp[], int samples)
+{
+	const __m128 fac_lo = _mm_loadu_ps(rx->fac);
+	const __m128 fac_hi = _mm_loadu_ps(rx->fac + 4);
+	__m128 v2_lo = _mm_loadu_ps(rx->v2);
+	__m128 v2_hi = _mm_loadu_ps(rx->v2 + 4);
+	__m128 v3_lo = _mm_loadu_ps(rx->v3);
+	__m128 v3_hi = _mm_loadu_ps(rx->v3 + 4);
+	__m128 v1_lo, v1_hi, sample;
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		sample = _mm_set1_ps((float)amp[i]);
+		v1_lo = v2_lo;
+		v1_hi = v2_hi;
+		v2_lo = v3_lo;
+		v2_hi = v3_hi;
+		v3_lo = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac_lo, v2_lo), v1_lo), sample);
+		v3_hi = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac_hi, v2_hi), v1_hi), sample);
+	}
+	_mm_storeu_ps(rx->v2, v2_lo);
+	_mm_storeu_ps(rx->v2 + 4, v2_hi);
+	_mm_storeu_ps(rx->v3, v3_lo);
+	_mm_storeu_ps(rx->v3 + 4, v3_hi);
+}
+#endif
+
+/* end of a block: find the two strongest frequencies and check they make a valid tone */
+static void mf_rx_block_end(ftdm_r2_mf_rx_t *rx)
+{
+	float energy[FTDM_R2_MF_FREQS];
+	int best = -1, second = -1;
+	int hit = 0;
+	int lane;
+
+	for (lane = 0; lane < FTDM_R2_MF_FREQS; lane++) {
+		energy[lane] = rx->v3[lane] * rx->v3[lane] + rx->v2[lane] * rx->v2[lane] - rx->v2[lane] * rx->v3[lane] * rx->fac[lane];
+		if (best < 0 || energy[lane] > energy[best]) {
+			second = best;
+			best = lane;
+		} else if (second < 0 || energy[lane] > energy[second]) {
+			second = lane;
+		}
+	}
+
+	if (energy[second] >= FTDM_R2_MF_THRESHOLD && energy[best] <= energy[second] * FTDM_R2_MF_TWIST) {
+		hit = mf_pair_tone[best][second];
+		for (lane = 0; lane < FTDM_R2_MF_FREQS; lane++) {
+			if (lane != best && lane != second && energy[lane] * FTDM_R2_MF_RELATIVE_PEAK >= energy[second]) {
+				hit = 0;
+				break;
+			}
+		}
+	}
+
+	/* tones (and silence) must last two blocks to be reported, glitches are ignored */
+	if (hit == rx->hit) {
+		rx->tone = hit;
+	}
+	rx->hit = hit;
+
+	memset(rx->v2, 0, sizeof(rx->v2));
+	memset(rx->v3, 0, sizeof(rx->v3));
+	rx->samples = 0;
+}
+
+ftdm_r2_mf_rx_t *ftdm_r2_mf_rx_init(ftdm_r2_mf_rx_t *rx, int fwd)
+{
+	const float *frequencies = fwd ? mf_fwd_frequencies : mf_bwd_frequencies;
+	int lane;
+
+	memset(rx, 0, sizeof(*rx));
+	rx->fwd = fwd;
+	for (lane = 0; lane < FTDM_R2_MF_FREQS; lane++) {
+		rx->fac[lane] = (float)(2.0 * cos(2.0 * M_PI * frequencies[lane] / FTDM_R2_MF_RATE));
+	}
+#ifdef FTDM_R2_MF_HAVE_SSE
+	rx->impl = FTDM_R2_MF_SSE;
+#else
+	rx->impl = FTDM_R2_MF_SCALAR;
+#endif
+	return rx;
+}
+
+ftdm_status_t ftdm_r2_mf_rx_set_impl(ftdm_r2_mf_rx_t *rx, ftdm_r2_mf_impl_t impl)
+{
+	switch (impl) {
+	case FTDM_R2_MF_SCALAR:
+		break;
+#ifdef FTDM_R2_MF_HAVE_SSE
+	case FTDM_R2_MF_SSE:
+		break;
+#endif
+	default:
+		return FTDM_FAIL;
+	}
+	rx->impl = impl;
+	return FTDM_SUCCESS;
+}
+
+int ftdm_r2_mf_rx(ftdm_r2_mf_rx_t *rx, const int16_t amp[], int samples)
+{
+	int chunk;
+
+	while (samples > 0) {
+		chunk = FTDM_R2_MF_BLOCK - rx->samples;
+		if (chunk > samples) {
+			chunk = samples;
+		}
+#ifdef FTDM_R2_MF_HAVE_SSE
+		if (rx->impl == FTDM_R2_MF_SSE) {
+			mf_rx_filter_sse(rx, amp, chunk);
+		} else
+#endif
+		{
+			mf_rx_filter_scalar(rx, amp, chunk);
+		}
+		rx->samples += chunk;
+		amp += chunk;
+		samples -= chunk;
+		if (rx->samples == FTDM_R2_MF_BLOCK) {
+			mf_rx_block_end(rx);
+		}
+	}
+	return rx->tone;
+}
+
+ftdm_r2_mf_tx_t *ftdm_r2_mf_tx_init(ftdm_r2_mf_tx_t *tx, int fwd)
+{
+	memset(tx, 0, sizeof(*tx));
+	tx->fwd = fwd;
+	teletone_dds_state_set_tx_level(&tx->dds[0], FTDM_R2_MF_TX_LEVEL);
+	teletone_dds_state_set_tx_level(&tx->dds[1], FTDM_R2_MF_TX_LEVEL);
+	return tx;
+}
+
+int ftdm_r2_mf_tx_select(ftdm_r2_mf_tx_t *tx, int tone)
+{
+	const float *frequencies = tx->fwd ? mf_fwd_frequencies : mf_bwd_frequencies;
+	int i;
+
+	if (tone < 0 || tone > 15) {
+		return -1;
+	}
+	if (tone == tx->tone) {
+		return 0;
+	}
+	tx->tone = tone;
+	if (!tone) {
+		return 0;
+	}
+	for (i = 0; i < 2; i++) {
+		teletone_dds_state_set_tone(&tx->dds[i], frequencies[mf_tone_frequencies[tone][i]], FTDM_R2_MF_RATE, 0);
+		teletone_dds_state_reset_accum(&tx->dds[i]);
+	}
+	return 0;
+}
+
+int ftdm_r2_mf_tx(ftdm_r2_mf_tx_t *tx, int16_t amp[], int samples)
+{
+	int i;
+
+	if (!tx->tone) {
+		memset(amp, 0, samples * sizeof(amp[0]));
+		return samples;
+	}
+	for (i = 0; i < samples; i++) {
+		amp[i] = teletone_dds_state_modulate_sample(&tx->dds[0], 0) + teletone_dds_state_modulate_sample(&tx->dds[1], 0);
+	}
+	return samples;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
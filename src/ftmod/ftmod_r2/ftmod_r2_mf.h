@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2009, Moises Silva <moy@sangoma.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _FTMOD_R2_MF_H_
+#define _FTMOD_R2_MF_H_
+
+#include <private/ftdm_core.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* R2 MF tone detector and generator (ITU-T Q.441), the detector runs a bank of goertzel filters,
+ * one per MF frequency, in SIMD lanes when SSE is available. Tones are numbered 1-15, 0 is no tone */
+
+/* sampling rate of the audio fed to the detector and produced by the generator */
+#define FTDM_R2_MF_RATE 8000
+/* MF frequencies per direction */
+#define FTDM_R2_MF_FREQS 6
+/* goertzel filters per detector, the MF frequencies padded to a multiple of the SIMD width */
+#define FTDM_R2_MF_LANES 8
+/* samples per detection block at 8kHz, 60Hz bins for frequencies 120Hz apart */
+#define FTDM_R2_MF_BLOCK 133
+/* level of each frequency of a generated tone (Q.454) */
+#define FTDM_R2_MF_TX_LEVEL -8.0f
+
+typedef enum {
+	FTDM_R2_MF_SCALAR,
+	FTDM_R2_MF_SSE,
+	FTDM_R2_MF_IMPL_COUNT
+} ftdm_r2_mf_impl_t;
+
+/*! \brief MF detector of a channel */
+typedef struct {
+	/*! goertzel coefficient and state of each lane, the padding lanes have no coefficient */
+	float fac[FTDM_R2_MF_LANES];
+	float v2[FTDM_R2_MF_LANES];
+	float v3[FTDM_R2_MF_LANES];
+	/*! 1 if detecting forward tones, otherwise backward tones */
+	int fwd;
+	/*! samples of the current block already filtered */
+	int samples;
+	/*! tone found in the last block, a tone is reported (or cleared) once found in two blocks in a row */
+	int hit;
+	/*! tone reported */
+	int tone;
+	ftdm_r2_mf_impl_t impl;
+} ftdm_r2_mf_rx_t;
+
+/*! \brief MF generator of a channel */
+typedef struct {
+	/*! one oscillator per frequency of the tone */
+	teletone_dds_state_t dds[2];
+	/*! 1 if generating forward tones, otherwise backward tones */
+	int fwd;
+	/*! tone being generated */
+	int tone;
+} ftdm_r2_mf_tx_t;
+
+/*! \brief Name of a detector implementation */
+const char *ftdm_r2_mf_impl_name(ftdm_r2_mf_impl_t impl);
+
+/*! \brief Initialize a detector with the fastest implementation available */
+ftdm_r2_mf_rx_t *ftdm_r2_mf_rx_init(ftdm_r2_mf_rx_t *rx, int fwd);
+
+/*! \brief Select the detector implementation, fails if not built in. All of them give the same results */
+ftdm_status_t ftdm_r2_mf_rx_set_impl(ftdm_r2_mf_rx_t *rx, ftdm_r2_mf_impl_t impl);
+
+/*! \brief Feed samples to a detector
+ * \return The tone being received, 0 for none */
+int ftdm_r2_mf_rx(ftdm_r2_mf_rx_t *rx, const int16_t amp[], int samples);
+
+/*! \brief Initialize a generator, silent until a tone is selected */
+ftdm_r2_mf_tx_t *ftdm_r2_mf_tx_init(ftdm_r2_mf_tx_t *tx, int fwd);
+
+/*! \brief Select the tone to generate, 0 for silence
+ * \return 0 on success, -1 if the tone is invalid */
+int ftdm_r2_mf_tx_select(ftdm_r2_mf_tx_t *tx, int tone);
+
+/*! \brief Generate samples of the selected tone
+ * \return The number of samples written in amp */
+int ftdm_r2_mf_tx(ftdm_r2_mf_tx_t *tx, int16_t amp[], int samples);
+
+#if defined(__cplusplus)
+} /* endif extern "C" */
+#endif
+
+#endif /* endif defined _FTMOD_R2_MF_H_ */
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -339,48 +339,97 @@ static void ftdm_sangoma_isdn_wakeup_phy(ftdm_channel_t *dchan)
 	return;
 }
 
+/* Channels the I/O thread reads, the registration survives across polls and only changes when
+ * a voice channel enters or leaves RX_DISABLED (see sngisdn_set_chan_rx_disabled) */
+typedef struct sngisdn_io {
+	short			*poll_events;	/* indexed by chan_id - 1, every channel is polled for events */
+	ftdm_channel_t	**readers;		/* the d-channel and the RX-disabled voice channels */
+	uint32_t		num_readers;
+	uint32_t		num_voice_readers;
+} sngisdn_io_t;
+
+static void sngisdn_io_register(sngisdn_io_t *io, ftdm_channel_t *ftdmchan)
+{
+	uint32_t i;
+
+	for (i = 0; i < io->num_readers; i++) {
+		if (io->readers[i] == ftdmchan) {
+			return;
+		}
+	}
+
+	io->readers[io->num_readers++] = ftdmchan;
+	io->poll_events[ftdmchan->chan_id - 1] |= FTDM_READ;
+	if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
+		io->num_voice_readers++;
+	}
+}
+
+static void sngisdn_io_unregister(sngisdn_io_t *io, ftdm_channel_t *ftdmchan)
+{
+	uint32_t i;
+
+	for (i = 0; i < io->num_readers; i++) {
+		if (io->readers[i] == ftdmchan) {
+			io->readers[i] = io->readers[--io->num_readers];
+			io->poll_events[ftdmchan->chan_id - 1] &= ~FTDM_READ;
+			if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
+				io->num_voice_readers--;
+			}
+			return;
+		}
+	}
+}
+
+static void sngisdn_io_update(sngisdn_io_t *io, ftdm_channel_t *ftdmchan)
+{
+	/* We always read the d-channel */
+	if (!FTDM_IS_VOICE_CHANNEL(ftdmchan) || ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED)) {
+		sngisdn_io_register(io, ftdmchan);
+	} else {
+		sngisdn_io_unregister(io, ftdmchan);
+	}
+}
+
 static void *ftdm_sangoma_isdn_io_run(ftdm_thread_t *me, void *obj)
 {
 	uint8_t data[8192];
 	unsigned i = 0;
 	ftdm_status_t status = FTDM_SUCCESS;
 	ftdm_span_t *span = (ftdm_span_t*) obj;
+	sngisdn_span_data_t *signal_data = (sngisdn_span_data_t*) span->signal_data;
 	ftdm_size_t len = 0;
 	ftdm_channel_t *ftdmchan = NULL;
-	unsigned waitms = 10000;
-	ftdm_iterator_t *chaniter = NULL;
-	ftdm_iterator_t *citer = NULL;
+	unsigned waitms = SNGISDN_IO_POLL_RATE;
 	ftdm_event_t *event;
-	short *poll_events = ftdm_malloc(sizeof(short) * span->chan_count);
+	sngisdn_io_t io;
 
-	/* Initialize the d-channel */
-	chaniter = ftdm_span_get_chan_iterator(span, NULL);
-	if (!chaniter) {
-		ftdm_log(FTDM_LOG_CRIT, "Failed to allocate channel iterator for span %s!\n", span->name);
+	memset(&io, 0, sizeof(io));
+	io.poll_events = ftdm_calloc(span->chan_count, sizeof(short));
+	io.readers = ftdm_calloc(span->chan_count, sizeof(ftdm_channel_t*));
+	if (!io.poll_events || !io.readers) {
+		ftdm_log(FTDM_LOG_CRIT, "Failed to allocate the I/O poll set for span %s!\n", span->name);
 		goto done;
 	}
 
-	while (ftdm_running() && !(ftdm_test_flag(span, FTDM_SPAN_STOP_THREAD))) {
-		len = 1000;
-		waitms = 1000;
-		memset(poll_events, 0, sizeof(short)*span->chan_count);
-
-		for (i = 0, citer = ftdm_span_get_chan_iterator(span, chaniter); citer; citer = ftdm_iterator_next(citer), i++) {
-			ftdmchan = ftdm_iterator_current(citer);
+	/* Initialize the poll set, the d-channel and the channels already RX-disabled are read */
+	signal_data->io_resync = 1;
 
-			poll_events[i] |= FTDM_EVENTS;
-			if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
-				if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED)) {
-					poll_events[i] |= FTDM_READ;
-					waitms = 20;
-				}
-			} else {
-				/* We always read the d-channel */
-				poll_events[i] |= FTDM_READ;
+	while (ftdm_running() && !(ftdm_test_flag(span, FTDM_SPAN_STOP_THREAD))) {
+		if (signal_data->io_resync) {
+			signal_data->io_resync = 0;
+			for (i = 1; i <= span->chan_count; i++) {
+				io.poll_events[i - 1] |= FTDM_EVENTS;
+				sngisdn_io_update(&io, span->channels[i]);
 			}
 		}
+		while ((ftdmchan = ftdm_queue_dequeue(signal_data->io_queue))) {
+			sngisdn_io_update(&io, ftdmchan);
+		}
 
-		status = ftdm_span_poll_event(span, waitms, poll_events);
+		waitms = io.num_voice_readers ? SNGISDN_IO_RX_POLL_RATE : SNGISDN_IO_POLL_RATE;
+
+		status = ftdm_span_poll_event(span, waitms, io.poll_events);
 		switch (status) {
 			case FTDM_FAIL:
 				ftdm_log(FTDM_LOG_CRIT, "Failed to poll span for IO\n");
@@ -388,32 +437,32 @@ static void *ftdm_sangoma_isdn_io_run(ftdm_thread_t *me, void *obj)
 			case FTDM_TIMEOUT:
 				break;
 			case FTDM_SUCCESS:
-				/* Check if there are any channels that have data available */
-				for (citer = ftdm_span_get_chan_iterator(span, chaniter); citer; citer = ftdm_iterator_next(citer)) {
+				/* Check if any of the channels we read have data available */
+				for (i = 0; i < io.num_readers; i++) {
 					len = sizeof(data);
-					ftdmchan = ftdm_iterator_current(citer);
+					ftdmchan = io.readers[i];
+					if (!ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ)) {
+						continue;
+					}
 					if (FTDM_IS_VOICE_CHANNEL(ftdmchan)) {
+						/* RX may have been enabled since the poll set was updated */
 						if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED)) {
-							if (ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ)) {
-								status = ftdm_raw_read(ftdmchan, data, &len);
-								if (status != FTDM_SUCCESS) {
-									ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "raw I/O read failed\n");
-									continue;
-								}
-
-								status = ftdm_channel_process_media(ftdmchan, data, &len);
-								if (status != FTDM_SUCCESS) {
-									ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "Failed to process media\n");
-									continue;
-								}
+							status = ftdm_raw_read(ftdmchan, data, &len);
+							if (status != FTDM_SUCCESS) {
+								ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "raw I/O read failed\n");
+								continue;
+							}
+
+							status = ftdm_channel_process_media(ftdmchan, data, &len);
+							if (status != FTDM_SUCCESS) {
+								ftdm_log_chan_msg(ftdmchan, FTDM_LOG_WARNING, "Failed to process media\n");
+								continue;
 							}
 						}
 					} else {
-						if (ftdm_test_io_flag(ftdmchan, FTDM_CHANNEL_IO_READ)) {
-							status = ftdm_channel_read(ftdmchan, data, &len);
-							if (status == FTDM_SUCCESS) {
-								sngisdn_snd_data(ftdmchan, data, len);
-							}
+						status = ftdm_channel_read(ftdmchan, data, &len);
+						if (status == FTDM_SUCCESS) {
+							sngisdn_snd_data(ftdmchan, data, len);
 						}
 					}
 				}
@@ -425,12 +474,13 @@ static void *ftdm_sangoma_isdn_io_run(ftdm_thread_t *me, void *obj)
 				
 				break;
 			default:
-				ftdm_log_chan_msg(ftdmchan, FTDM_LOG_CRIT, "Unhandled IO event\n");
+				ftdm_log(FTDM_LOG_CRIT, "Unhandled IO event on span %s\n", span->name);
 		}
 	}
 done:
-	ftdm_iterator_free(chaniter);
-	ftdm_safe_free(poll_events);
+	ftdm_safe_free(io.poll_events);
+	ftdm_safe_free(io.readers);
+	signal_data->io_running = 0;
 	return NULL;
 }
 
@@ -466,6 +516,7 @@ static void *ftdm_sangoma_isdn_run(ftdm_thread_t *me, void *obj)
 	}
 
 	while (ftdm_running() && !(ftdm_test_flag(span, FTDM_SPAN_STOP_THREAD))) {
+		ftdm_span_metrics_loop_mark(span);
 		/* Check if there are any timers to process */
 		ftdm_sched_run(signal_data->sched);
 		ftdm_span_trigger_signals(span);
@@ -1066,7 +1117,9 @@ static ftdm_status_t ftdm_sangoma_isdn_perform_start(ftdm_span_t *span)
 	}
 
 	/*start the dchan monitor thread*/
+	signal_data->io_running = 1;
 	if (ftdm_thread_create_detached(ftdm_sangoma_isdn_io_run, span) != FTDM_SUCCESS) {
+		signal_data->io_running = 0;
 		ftdm_log(FTDM_LOG_CRIT,"Failed to start Sangoma ISDN d-channel Monitor Thread!\n");
 		return FTDM_FAIL;
 	}
@@ -1149,6 +1202,12 @@ static ftdm_status_t ftdm_sangoma_isdn_stop(ftdm_span_t *span)
 		ftdm_sleep(10);
 	}
 
+	/* the I/O thread uses the io_queue */
+	while (signal_data->io_running) {
+		ftdm_log(FTDM_LOG_DEBUG, "Waiting for I/O thread to end for span %s\n", span->name);
+		ftdm_sleep(10);
+	}
+
 	if (sngisdn_stack_stop(span) != FTDM_SUCCESS) {
 		ftdm_log(FTDM_LOG_CRIT, "Failed to stop span %s\n", span->name);
 	}
@@ -1162,6 +1221,7 @@ static ftdm_status_t ftdm_sangoma_isdn_stop(ftdm_span_t *span)
 
 	ftdm_sched_destroy(&signal_data->sched);
 	ftdm_queue_destroy(&signal_data->event_queue);
+	ftdm_queue_destroy(&signal_data->io_queue);
 	for (i = 0 ; i < signal_data->num_local_numbers ; i++) {
 		if (signal_data->local_numbers[i] != NULL) {
 			ftdm_safe_free(signal_data->local_numbers[i]);
@@ -1328,6 +1388,9 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_sangoma_isdn_span_config)
 	/* Initialize the event queue */
 	ftdm_assert(ftdm_queue_create(&((sngisdn_span_data_t*)span->signal_data)->event_queue, SNGISDN_EVENT_QUEUE_SIZE) == FTDM_SUCCESS, "Failed to create a new queue!!");
 
+	/* Initialize the queue of RX_DISABLED changes for the I/O thread */
+	ftdm_assert(ftdm_queue_create(&((sngisdn_span_data_t*)span->signal_data)->io_queue, NUM_E1_CHANNELS_PER_SPAN) == FTDM_SUCCESS, "Failed to create a new queue!!");
+
 	ftdm_log(FTDM_LOG_INFO, "Finished configuring ftmod_sangoma_isdn span = %s\n", span->name);
 	return FTDM_SUCCESS;
 }
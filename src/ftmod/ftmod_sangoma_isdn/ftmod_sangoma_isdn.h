@@ -67,6 +67,8 @@
 #define SNGISDN_EVENT_POLL_RATE		100
 #define SNGISDN_NUM_LOCAL_NUMBERS	8
 #define SNGISDN_DCHAN_QUEUE_LEN		200
+#define SNGISDN_IO_POLL_RATE		1000
+#define SNGISDN_IO_RX_POLL_RATE		20
 #define MAX_NFAS_GROUP_NAME			50
 
 #define NSG
@@ -312,6 +314,9 @@ typedef struct sngisdn_span_data {
 	ftdm_timer_id_t timers[SNGISDN_NUM_SPAN_TIMERS];
 	ftdm_sched_t 	*sched;
 	ftdm_queue_t 	*event_queue;
+	ftdm_queue_t	*io_queue;		/* voice channels whose RX_DISABLED flag changed, read by the I/O thread */
+	volatile uint8_t	io_resync;	/* io_queue overflowed, the I/O thread must rescan the span */
+	volatile uint8_t	io_running;
 
 	struct nfas_info {
 		sngisdn_nfas_data_t *trunk;
@@ -423,6 +428,7 @@ ftdm_status_t sngisdn_set_span_avail_rate(ftdm_span_t *span, sngisdn_avail_t ava
 ftdm_status_t sngisdn_set_chan_avail_rate(ftdm_channel_t *chan, sngisdn_avail_t avail);
 void sngisdn_set_span_sig_status(ftdm_span_t *ftdmspan, ftdm_signaling_status_t status);
 void sngisdn_set_chan_sig_status(ftdm_channel_t *ftdmchan, ftdm_signaling_status_t status);
+void sngisdn_set_chan_rx_disabled(ftdm_channel_t *ftdmchan, uint8_t disabled);
 
 ftdm_status_t sngisdn_activate_trace(ftdm_span_t *span, sngisdn_tracetype_t trace_opt);
 
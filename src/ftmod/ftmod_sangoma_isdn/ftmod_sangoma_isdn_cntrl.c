@@ -82,6 +82,23 @@ void sngisdn_set_span_sig_status(ftdm_span_t *span, ftdm_signaling_status_t stat
 	return;
 }
 
+void sngisdn_set_chan_rx_disabled(ftdm_channel_t *ftdmchan, uint8_t disabled)
+{
+	sngisdn_span_data_t *signal_data = (sngisdn_span_data_t*)ftdmchan->span->signal_data;
+
+	if (disabled) {
+		ftdm_set_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+	} else {
+		ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+	}
+
+	/* The I/O thread reads the RX-disabled channels, tell it to update its poll set */
+	if (ftdm_queue_enqueue(signal_data->io_queue, ftdmchan) != FTDM_SUCCESS) {
+		signal_data->io_resync = 1;
+	}
+	return;
+}
+
 
 /* For Emacs:
  * Local Variables:
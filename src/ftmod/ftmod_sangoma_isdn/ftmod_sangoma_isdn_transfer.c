@@ -63,7 +63,7 @@ static transfer_interface_t transfer_interfaces[] = {
 void att_courtesy_transfer_complete(sngisdn_chan_data_t *sngisdn_info, ftdm_transfer_response_t response)
 {
 	ftdm_channel_t *ftdmchan = sngisdn_info->ftdmchan;
-	ftdm_clear_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+	sngisdn_set_chan_rx_disabled(ftdmchan, 0);
 	ftdm_channel_command(ftdmchan, FTDM_COMMAND_DISABLE_DTMF_DETECT, NULL);
 
 	sngisdn_info->transfer_data.type = SNGISDN_TRANSFER_NONE;
@@ -139,7 +139,7 @@ static ftdm_status_t att_courtesy_vru(ftdm_channel_t *ftdmchan, sngisdn_transfer
 
 			/* We will be polling the channel for IO so that we can receive the DTMF events,
 			 * Disable user RX otherwise it is a race between who calls channel_read */
-			ftdm_set_flag(ftdmchan, FTDM_CHANNEL_RX_DISABLED);
+			sngisdn_set_chan_rx_disabled(ftdmchan, 1);
 
 			ftdm_channel_command(ftdmchan, FTDM_COMMAND_ENABLE_DTMF_DETECT, NULL);
 			ftdm_channel_command(ftdmchan, FTDM_COMMAND_SEND_DTMF, dtmf_digits);
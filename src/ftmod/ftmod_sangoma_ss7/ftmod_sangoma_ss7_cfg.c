@@ -412,15 +412,15 @@ int  ft_to_sngss7_cfg_all(void)
 		} /* if (sngss7_test_flag(&g_ftdm_sngss7_data.cfg, SNGSS7_ISUP)) */
 
 		x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-		while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+		while (sngss7_get_ckt(x)->id != 0) {
 
 			if (g_ftdm_sngss7_data.cfg.procId > 1) {
 				break;
 			}
 
 			/* check if this link has been configured already */
-			if ((g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) &&
-				(!(g_ftdm_sngss7_data.cfg.isupCkt[x].flags & SNGSS7_CONFIGURED))) {
+			if ((sngss7_get_ckt(x)->id != 0) &&
+				(!(sngss7_get_ckt(x)->flags & SNGSS7_CONFIGURED))) {
 
 				if (ftmod_ss7_isup_ckt_config(x)) {
 					SS7_CRITICAL("ISUP CKT %d configuration FAILED!\n", x);
@@ -430,11 +430,11 @@ int  ft_to_sngss7_cfg_all(void)
 				}
 
 				/* set the SNGSS7_CONFIGURED flag */
-				g_ftdm_sngss7_data.cfg.isupCkt[x].flags |= SNGSS7_CONFIGURED;
+				sngss7_get_ckt(x)->flags |= SNGSS7_CONFIGURED;
 			} /* if !SNGSS7_CONFIGURED */
 			
 			x++;
-		} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+		} /* while (sngss7_get_ckt(x)->id != 0) */
 	}
 
 	/* go through all the relays channels and configure it */
@@ -1409,7 +1409,7 @@ int ftmod_ss7_isup_ckt_config(int id)
 	SiMngmt			 cfg;
 	Pst				 pst;
 	U32				 tmp_flag;
-	sng_isup_ckt_t	*k = &g_ftdm_sngss7_data.cfg.isupCkt[id];
+	sng_isup_ckt_t	*k = sngss7_get_ckt(id);
 
 	/* initalize the post structure */
 	smPstInit(&pst);
@@ -393,6 +393,11 @@ ftdm_status_t ftdm_sngss7_handle_cli_cmd(ftdm_stream_handle_t *stream, const cha
 		/**********************************************************************/
 			handle_show_procId(stream);
 
+		/**********************************************************************/
+		} else if (!strcasecmp(argv[c], "events")) {
+		/**********************************************************************/
+			sngss7_event_pools_show(stream);
+
 		/**********************************************************************/
 		} else{ 
 	    /**********************************************************************/
@@ -894,6 +899,7 @@ static ftdm_status_t handle_print_usage(ftdm_stream_handle_t *stream)
 	stream->write_function(stream, "ftdm ss7 show status mtp2 X\n");
 	stream->write_function(stream, "ftdm ss7 show status mtp3 X\n");
 	stream->write_function(stream, "ftdm ss7 show status linkset X\n");
+	stream->write_function(stream, "ftdm ss7 show events\n");
 	stream->write_function(stream, "\n");
     
 	stream->write_function(stream, "ftmod_sangoma_ss7 circuit information:\n");
@@ -1002,18 +1008,18 @@ static ftdm_status_t handle_set_message_trace(ftdm_stream_handle_t *stream, int
 /******************************************************************************/
 static ftdm_status_t handle_show_free(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	int				 free;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
 	free = 0;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1052,10 +1058,7 @@ static ftdm_status_t handle_show_free(ftdm_stream_handle_t *stream, int span, in
 				} /* switch (ftdmchan->state) */
 			} /* if ( span and chan) */
 		} /* if ( cic != 0) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	stream->write_function(stream, "\nTotal # of CICs free = %d\n",free);
 
@@ -1065,18 +1068,18 @@ static ftdm_status_t handle_show_free(ftdm_stream_handle_t *stream, int span, in
 /******************************************************************************/
 static ftdm_status_t handle_show_inuse(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	int				 in_use;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
 	in_use = 0;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1122,10 +1125,7 @@ static ftdm_status_t handle_show_inuse(ftdm_stream_handle_t *stream, int span, i
 				} /* switch (ftdmchan->state) */
 			} /* if ( span and chan) */
 		} /* if ( cic != 0) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	stream->write_function(stream, "\nTotal # of CICs in use = %d\n",in_use);
 
@@ -1135,18 +1135,18 @@ static ftdm_status_t handle_show_inuse(ftdm_stream_handle_t *stream, int span, i
 /******************************************************************************/
 static ftdm_status_t handle_show_inreset(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	int				 in_reset;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
 	in_reset = 0;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1181,10 +1181,7 @@ static ftdm_status_t handle_show_inreset(ftdm_stream_handle_t *stream, int span,
 				} /* if ((sngss7_test_ckt_flag(ss7_info, FLAG_RESET_RX) ... */
 			} /* if ( span and chan) */
 		} /* if ( cic != 0) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	stream->write_function(stream, "\nTotal # of CICs in reset = %d\n",in_reset);
 
@@ -1196,17 +1193,17 @@ static ftdm_status_t handle_show_flags(ftdm_stream_handle_t *stream, int span, i
 {
 	sngss7_chan_data_t	*ss7_info;
 	ftdm_channel_t		*ftdmchan;
-	int					x;
+	uint32_t			i;
+	sng_isup_ckt_t		*ckt;
 	int					bit;
 	int					lspan;
 	int					lchan;
 	const char			*text;
 	int					flag;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1251,10 +1248,7 @@ static ftdm_status_t handle_show_flags(ftdm_stream_handle_t *stream, int span, i
 			} /* if ( span and chan) */
 
 		} /* if ( cic != 0) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	return FTDM_SUCCESS;
 }
@@ -1262,16 +1256,16 @@ static ftdm_status_t handle_show_flags(ftdm_stream_handle_t *stream, int span, i
 /******************************************************************************/
 static ftdm_status_t handle_show_blocks(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1337,10 +1331,7 @@ static ftdm_status_t handle_show_blocks(ftdm_stream_handle_t *stream, int span,
 			} /* if ( span and chan) */
 
 		} /* if ( cic != 0) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	return FTDM_SUCCESS;
 }
@@ -1349,6 +1340,7 @@ static ftdm_status_t handle_show_blocks(ftdm_stream_handle_t *stream, int span,
 static ftdm_status_t handle_show_status(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
 	int				 			x;
+	uint32_t					i;
 	sngss7_chan_data_t  		*ss7_info;
 	ftdm_channel_t	  			*ftdmchan;
 	int				 			lspan;
@@ -1356,11 +1348,7 @@ static ftdm_status_t handle_show_status(ftdm_stream_handle_t *stream, int span,
 	ftdm_signaling_status_t		sigstatus = FTDM_SIG_STATE_DOWN;
 	sng_isup_ckt_t				*ckt;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-			/* extract the circuit to make it easier to work with */
-			ckt = &g_ftdm_sngss7_data.cfg.isupCkt[x];
-
+	sngss7_for_each_ckt(i, ckt) {
 			/* if span == 0 then all spans should be printed */
 			if (span == 0) {
 				lspan = ckt->span;
@@ -1388,7 +1376,7 @@ static ftdm_status_t handle_show_status(ftdm_stream_handle_t *stream, int span,
 							ckt->chan,
 							ckt->cic);
 				} else {
-					ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+					ss7_info = (sngss7_chan_data_t *)ckt->obj;
 					ftdmchan = ss7_info->ftdmchan;
 
 					if (ftdmchan == NULL) {
@@ -1456,9 +1444,7 @@ static ftdm_status_t handle_show_status(ftdm_stream_handle_t *stream, int span,
 					stream->write_function(stream, "\n");
 				} /* if ( hole, sig, voice) */
 			} /* if ( span and chan) */
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	/* Look spans that are being used by M2UA SG links */
 	for (x = 1; x < ftdm_array_len(g_ftdm_sngss7_data.cfg.g_m2ua_cfg.nif); x++) {
@@ -1493,16 +1479,16 @@ static ftdm_status_t handle_show_status(ftdm_stream_handle_t *stream, int span,
 /******************************************************************************/
 static ftdm_status_t handle_tx_blo(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1537,8 +1523,6 @@ static ftdm_status_t handle_tx_blo(ftdm_stream_handle_t *stream, int span, int c
 			}
 
 		}
-
-		x++;
 	}
 
 	handle_show_blocks(stream, span, chan, verbose);
@@ -1549,16 +1533,16 @@ static ftdm_status_t handle_tx_blo(ftdm_stream_handle_t *stream, int span, int c
 /******************************************************************************/
 static ftdm_status_t handle_tx_ubl(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 x;
+	uint32_t		 i;
+	sng_isup_ckt_t	 *ckt;
 	sngss7_chan_data_t  *ss7_info;
 	ftdm_channel_t	  *ftdmchan;
 	int				 lspan;
 	int				 lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = ss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1597,9 +1581,6 @@ static ftdm_status_t handle_tx_ubl(ftdm_stream_handle_t *stream, int span, int c
 			}
 
 		}
-
-		/* go the next circuit */
-		x++;
 	}
 
 	handle_show_blocks(stream, span, chan, verbose);
@@ -1740,16 +1721,16 @@ success:
 /******************************************************************************/
 static ftdm_status_t handle_tx_rsc(ftdm_stream_handle_t *stream, int span, int chan, int verbose)
 {
-	int				 	x;
+	uint32_t			i;
+	sng_isup_ckt_t		*ckt;
 	sngss7_chan_data_t  *sngss7_info;
 	ftdm_channel_t	  	*ftdmchan;
 	int				 	lspan;
 	int				 	lchan;
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 
 			/* if span == 0 then all spans should be printed */
@@ -1794,10 +1775,7 @@ static ftdm_status_t handle_tx_rsc(ftdm_stream_handle_t *stream, int span, int c
 			} /* if ( span and chan) */
 
 		} /* if ( cic == voice) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	/* print the status of channels */
 	handle_show_status(stream, span, chan, verbose);
@@ -1813,7 +1791,8 @@ static ftdm_status_t handle_tx_grs(ftdm_stream_handle_t *stream, int span, int c
 	sngss7_chan_data_t *sngss7_info = NULL;
 	ftdm_channel_t *ftdmchan = NULL;
 	sngss7_span_data_t *sngss7_span = NULL;
-	int x = 0;
+	uint32_t i;
+	sng_isup_ckt_t *ckt;
 	int basefound = 0;
 
 	if (range > 31) {
@@ -1826,11 +1805,10 @@ static ftdm_status_t handle_tx_grs(ftdm_stream_handle_t *stream, int span, int c
 		return FTDM_SUCCESS;
 	}
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -1871,16 +1849,12 @@ static ftdm_status_t handle_tx_grs(ftdm_stream_handle_t *stream, int span, int c
 			}
 
 		}
-
-		/* go the next circuit */
-		x++;
 	}
 	
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -1890,10 +1864,7 @@ static ftdm_status_t handle_tx_grs(ftdm_stream_handle_t *stream, int span, int c
 				handle_show_status(stream, span, chan, verbose);
 			}
 		} /* if ( cic == voice) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 
 	return FTDM_SUCCESS;
 }
@@ -1901,7 +1872,8 @@ static ftdm_status_t handle_tx_grs(ftdm_stream_handle_t *stream, int span, int c
 /******************************************************************************/
 static ftdm_status_t handle_tx_cgb(ftdm_stream_handle_t *stream, int span, int chan, int range, int verbose)
 {
-	int					x;
+	uint32_t			i;
+	sng_isup_ckt_t		*ckt;
 	sngss7_chan_data_t	*sngss7_info;
 	ftdm_channel_t		*ftdmchan;
 	ftdm_channel_t		*main_chan = NULL;
@@ -1918,12 +1890,11 @@ static ftdm_status_t handle_tx_cgb(ftdm_stream_handle_t *stream, int span, int c
 		return FTDM_SUCCESS;
 	}
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
 			/* extract the channel and span info for this circuit */
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -1967,8 +1938,6 @@ static ftdm_status_t handle_tx_cgb(ftdm_stream_handle_t *stream, int span, int c
 				ftdm_channel_unlock(ftdmchan);
 			}
 		}
-		/* go the next circuit */
-		x++;
 	}
 
 	if (!main_chan) {
@@ -1979,11 +1948,10 @@ static ftdm_status_t handle_tx_cgb(ftdm_stream_handle_t *stream, int span, int c
 	/* send the circuit group block */
 	ft_to_sngss7_cgb(main_chan);
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -1993,10 +1961,7 @@ static ftdm_status_t handle_tx_cgb(ftdm_stream_handle_t *stream, int span, int c
 				handle_show_status(stream, ftdmchan->physical_span_id, ftdmchan->physical_chan_id, verbose);
 			}
 		} /* if ( cic == voice) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 	
 
 	return FTDM_SUCCESS;
@@ -2011,6 +1976,8 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 	sngss7_span_data_t *sngss7_span = NULL;
 	sngss7_chan_data_t *ubl_sng_info[MAX_CIC_MAP_LENGTH+1];
 	int x = 0;
+	uint32_t i;
+	sng_isup_ckt_t *ckt;
 	int byte = 0;
 	int bit = 0;
 	int ubl_sng_info_idx = 1;
@@ -2026,10 +1993,9 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 
 	/* verify that there is not hardware block in the range. 
 	 * if there is any channel within the group unblock range, do not execute the group unblock */
-	x = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -2042,16 +2008,14 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 				return FTDM_SUCCESS;
 			}
 		}
-		x++;
 	}
 
 
-	x = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
 			/* extract the channel and span info for this circuit */
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -2099,8 +2063,6 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 				ftdm_channel_unlock(ftdmchan);
 			}
 		}
-		/* go the next circuit */
-		x++;
 	}
 
 	if (!main_chan) {
@@ -2118,11 +2080,10 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 		sngss7_clear_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_TX_DN);
 	}
 
-	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+	sngss7_for_each_ckt(i, ckt) {
+		if (ckt->type == SNG_CKT_VOICE) {
 
-			sngss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = (sngss7_chan_data_t *)ckt->obj;
 			ftdmchan = sngss7_info->ftdmchan;
 			sngss7_span = ftdmchan->span->signal_data;
 
@@ -2133,10 +2094,7 @@ static ftdm_status_t handle_tx_cgu(ftdm_stream_handle_t *stream, int span, int c
 
 			}
 		} /* if ( cic == voice) */
-
-		/* go the next circuit */
-		x++;
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x]id != 0) */
+	} /* sngss7_for_each_ckt() */
 	
 
 	return FTDM_SUCCESS;
@@ -2417,7 +2375,7 @@ static ftdm_status_t handle_status_isup_ckt(ftdm_stream_handle_t *stream, char *
 	id = atoi(id_name);
 
 	/* extract the global config circuit structure */
-	ckt = &g_ftdm_sngss7_data.cfg.isupCkt[id];
+	ckt = sngss7_get_ckt(id);
 
 	/* confirm the ckt exists */
 	if (ckt->id == 0) {
@@ -2432,7 +2390,7 @@ static ftdm_status_t handle_status_isup_ckt(ftdm_stream_handle_t *stream, char *
 	}
 
 	/* extract the global structure */
-	ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[id].obj;
+	ss7_info = (sngss7_chan_data_t *)sngss7_get_ckt(id)->obj;
 	ftdmchan = ss7_info->ftdmchan;
 
 	/* query the isup stack for the state of the ckt */
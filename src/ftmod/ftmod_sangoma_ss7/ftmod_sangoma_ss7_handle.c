@@ -1093,9 +1093,9 @@ ftdm_status_t handle_sta_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is active on our side otherwise move to the next circuit */
-	if (!sngss7_test_flag(&g_ftdm_sngss7_data.cfg.isupCkt[circuit], SNGSS7_ACTIVE)) {
+	if (!sngss7_test_flag(sngss7_get_ckt(circuit), SNGSS7_ACTIVE)) {
 		SS7_ERROR("[CIC:%d]Rx %s but circuit is not active yet, skipping!\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 		return FTDM_FAIL;
 	}
@@ -1296,9 +1296,9 @@ ftdm_status_t handle_reattempt(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1312,7 +1312,7 @@ ftdm_status_t handle_reattempt(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1386,36 +1386,32 @@ ftdm_status_t handle_pause(uint32_t suInstId, uint32_t spInstId, uint32_t circui
 	
 	sngss7_chan_data_t  *sngss7_info = NULL;
 	ftdm_channel_t	  *ftdmchan = NULL;
+	sng_isup_ckt_t	  *ckt = NULL;
 	int				 infId;
-	int				 i;
+	uint32_t		 i;
 	
 	ftdm_running_return(FTDM_FAIL);
 	
 	/* extract the affected infId from the circuit structure */
-	infId = g_ftdm_sngss7_data.cfg.isupCkt[circuit].infId;
+	infId = sngss7_get_ckt(circuit)->infId;
 
 	/* set the interface to paused */
 	sngss7_set_flag(&g_ftdm_sngss7_data.cfg.isupIntf[infId], SNGSS7_PAUSED);
 	
-	/* go through all the circuits now and find any other circuits on this infId */
-	i = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[i].id != 0) {
-		
+	/* go through all the circuits of our procId now and find any other circuits on this infId */
+	sngss7_for_each_ckt(i, ckt) {
 		/* check that the infId matches and that this is not a siglink */
-		if ((g_ftdm_sngss7_data.cfg.isupCkt[i].infId == infId) && 
-			(g_ftdm_sngss7_data.cfg.isupCkt[i].type == SNG_CKT_VOICE)) {
+		if ((ckt->infId == infId) && (ckt->type == SNG_CKT_VOICE)) {
 
 			/* confirm that the circuit is active on our side otherwise move to the next circuit */
-			if (!sngss7_test_flag(&g_ftdm_sngss7_data.cfg.isupCkt[i], SNGSS7_ACTIVE)) {
-				SS7_ERROR("[CIC:%d]Circuit is not active yet, skipping!\n",g_ftdm_sngss7_data.cfg.isupCkt[i].cic);
-				i++;
+			if (!sngss7_test_flag(ckt, SNGSS7_ACTIVE)) {
+				SS7_ERROR("[CIC:%d]Circuit is not active yet, skipping!\n",ckt->cic);
 				continue;
 			}
 	
 			/* get the ftdmchan and ss7_chan_data from the circuit */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			if (extract_chan_data(ckt->id, &sngss7_info, &ftdmchan)) {
 				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", circuit);
-				i++;
 				continue;
 			}
 	
@@ -1435,12 +1431,8 @@ ftdm_status_t handle_pause(uint32_t suInstId, uint32_t spInstId, uint32_t circui
 			/* unlock the channel again before we exit */
 			ftdm_mutex_unlock(ftdmchan->mutex);
 	
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[i].infId == infId) */
-	
-		/* move to the next circuit */
-		i++;
-	
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[i].id != 0) */
+		} /* if (ckt->infId == infId) */
+	} /* sngss7_for_each_ckt() */
 	
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 	return FTDM_SUCCESS;
@@ -1453,36 +1445,32 @@ ftdm_status_t handle_resume(uint32_t suInstId, uint32_t spInstId, uint32_t circu
 
 	sngss7_chan_data_t  *sngss7_info = NULL;
 	ftdm_channel_t	  *ftdmchan = NULL;
+	sng_isup_ckt_t	  *ckt = NULL;
 	int				 infId;
-	int				 i;
+	uint32_t		 i;
 	
 	ftdm_running_return(FTDM_FAIL);
 
 	/* extract the affect infId from the circuit structure */
-	infId = g_ftdm_sngss7_data.cfg.isupCkt[circuit].infId;
+	infId = sngss7_get_ckt(circuit)->infId;
 
 	/* set the interface to resumed */
 	sngss7_clear_flag(&g_ftdm_sngss7_data.cfg.isupIntf[infId], SNGSS7_PAUSED);
 
-	/* go through all the circuits now and find any other circuits on this infId */
-	i = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[i].id != 0) {
-
+	/* go through all the circuits of our procId now and find any other circuits on this infId */
+	sngss7_for_each_ckt(i, ckt) {
 		/* check that the infId matches and that this is not a siglink */
-		if ((g_ftdm_sngss7_data.cfg.isupCkt[i].infId == infId) && 
-			(g_ftdm_sngss7_data.cfg.isupCkt[i].type == SNG_CKT_VOICE)) {
+		if ((ckt->infId == infId) && (ckt->type == SNG_CKT_VOICE)) {
 
 			/* confirm that the circuit is active on our side otherwise move to the next circuit */
-			if (!sngss7_test_flag(&g_ftdm_sngss7_data.cfg.isupCkt[i], SNGSS7_ACTIVE)) {
-				ftdm_log(FTDM_LOG_DEBUG, "[CIC:%d]Circuit is not active yet, skipping!\n",g_ftdm_sngss7_data.cfg.isupCkt[i].cic);
-				i++;
+			if (!sngss7_test_flag(ckt, SNGSS7_ACTIVE)) {
+				ftdm_log(FTDM_LOG_DEBUG, "[CIC:%d]Circuit is not active yet, skipping!\n",ckt->cic);
 				continue;
 			}
 
 			/* get the ftdmchan and ss7_chan_data from the circuit */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			if (extract_chan_data(ckt->id, &sngss7_info, &ftdmchan)) {
 				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", circuit);
-				i++;
 				continue;
 			}
 
@@ -1503,12 +1491,8 @@ ftdm_status_t handle_resume(uint32_t suInstId, uint32_t spInstId, uint32_t circu
 			/* unlock the channel again before we exit */
 			ftdm_mutex_unlock(ftdmchan->mutex);
 
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[i].infId == infId) */
-
-		/* move to the next circuit */
-		i++;
-
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[i].id != 0) */
+		} /* if (ckt->infId == infId) */
+	} /* sngss7_for_each_ckt() */
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 	return FTDM_SUCCESS;
@@ -1525,9 +1509,9 @@ ftdm_status_t handle_cot_start(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1541,7 +1525,7 @@ ftdm_status_t handle_cot_start(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1582,9 +1566,9 @@ ftdm_status_t handle_cot_stop(uint32_t suInstId, uint32_t spInstId, uint32_t cir
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1598,7 +1582,7 @@ ftdm_status_t handle_cot_stop(uint32_t suInstId, uint32_t spInstId, uint32_t cir
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1629,9 +1613,9 @@ ftdm_status_t handle_cot(uint32_t suInstId, uint32_t spInstId, uint32_t circuit,
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1645,7 +1629,7 @@ ftdm_status_t handle_cot(uint32_t suInstId, uint32_t spInstId, uint32_t circuit,
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1673,9 +1657,9 @@ ftdm_status_t handle_cot(uint32_t suInstId, uint32_t spInstId, uint32_t circuit,
 
 	if ( (siStaEvnt->contInd.eh.pres > 0) && (siStaEvnt->contInd.contInd.pres > 0)) {
 		SS7_INFO("Continuity Test result for CIC = %d (span %d, chan %d) is: \"%s\"\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].span,
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].chan,
+					sngss7_get_ckt(circuit)->cic,
+					sngss7_get_ckt(circuit)->span,
+					sngss7_get_ckt(circuit)->chan,
 					(siStaEvnt->contInd.contInd.val) ? "PASS" : "FAIL");
 	} else {
 		SS7_ERROR("Recieved Continuity report containing no results!\n");
@@ -1699,9 +1683,9 @@ ftdm_status_t handle_blo_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1715,7 +1699,7 @@ ftdm_status_t handle_blo_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1752,9 +1736,9 @@ ftdm_status_t handle_blo_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1768,7 +1752,7 @@ ftdm_status_t handle_blo_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1795,9 +1779,9 @@ ftdm_status_t handle_ubl_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1811,7 +1795,7 @@ ftdm_status_t handle_ubl_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1820,7 +1804,7 @@ ftdm_status_t handle_ubl_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 
 	/* check if the channel is blocked */
 	if (!(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_RX)) && !sngss7_test_ckt_blk_flag(sngss7_info, FLAG_GRP_MN_BLOCK_RX)) {
-		SS7_WARN("Received UBL on circuit that is not blocked! span= %d, chan= %d , flag = %x \n", g_ftdm_sngss7_data.cfg.isupCkt[circuit].span, g_ftdm_sngss7_data.cfg.isupCkt[circuit].chan,sngss7_info->blk_flags  );
+		SS7_WARN("Received UBL on circuit that is not blocked! span= %d, chan= %d , flag = %x \n", sngss7_get_ckt(circuit)->span, sngss7_get_ckt(circuit)->chan,sngss7_info->blk_flags  );
 	}
 
 	/* throw the unblock flag */
@@ -1850,9 +1834,9 @@ ftdm_status_t handle_ubl_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_channel_t	  *ftdmchan = NULL;
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1866,7 +1850,7 @@ ftdm_status_t handle_ubl_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1885,9 +1869,9 @@ ftdm_status_t handle_rsc_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1901,7 +1885,7 @@ ftdm_status_t handle_rsc_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -1947,9 +1931,9 @@ ftdm_status_t handle_local_rsc_req(uint32_t suInstId, uint32_t spInstId, uint32_
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -1963,7 +1947,7 @@ ftdm_status_t handle_local_rsc_req(uint32_t suInstId, uint32_t spInstId, uint32_
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 	/* lock the channel */
@@ -2007,9 +1991,9 @@ ftdm_status_t handle_rsc_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2023,7 +2007,7 @@ ftdm_status_t handle_rsc_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2093,15 +2077,14 @@ ftdm_status_t handle_grs_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 
 	sngss7_chan_data_t *sngss7_info = NULL;
 	ftdm_channel_t *ftdmchan = NULL;
-	sngss7_span_data_t *sngss7_span = NULL;
 	int range = 0;
 	
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2115,7 +2098,7 @@ ftdm_status_t handle_grs_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2128,8 +2111,6 @@ ftdm_status_t handle_grs_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		return FTDM_FAIL;
 	}
 
-	/* fill in the span structure for this circuit */
-	sngss7_span = ftdmchan->span->signal_data;
 	if (sngss7_info->rx_grs.range) {
 		SS7_CRITICAL("Cannot handle another GRS on CIC = %d\n", sngss7_info->circuit->cic);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2138,8 +2119,12 @@ ftdm_status_t handle_grs_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	sngss7_info->rx_grs.circuit = circuit; 
 	sngss7_info->rx_grs.range = range;
 
-	ftdm_set_flag(sngss7_span, SNGSS7_RX_GRS_PENDING);
-	/* the reset will be started in the main thread by "check_if_rx_grs_started" */
+	/* the reset will be started in the main thread by "check_for_range_ops" */
+	if (sngss7_range_op_start(ftdmchan->span, circuit, range) != FTDM_SUCCESS) {
+		memset(&sngss7_info->rx_grs, 0, sizeof(sngss7_info->rx_grs));
+		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
+		return FTDM_FAIL;
+	}
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 	return FTDM_SUCCESS;
@@ -2158,9 +2143,9 @@ ftdm_status_t handle_grs_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2174,7 +2159,7 @@ ftdm_status_t handle_grs_rsp(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2224,9 +2209,9 @@ ftdm_status_t handle_local_blk(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2240,7 +2225,7 @@ ftdm_status_t handle_local_blk(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2276,9 +2261,9 @@ ftdm_status_t handle_local_ubl(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2292,7 +2277,7 @@ ftdm_status_t handle_local_ubl(uint32_t suInstId, uint32_t spInstId, uint32_t ci
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2332,9 +2317,9 @@ ftdm_status_t handle_ucic(uint32_t suInstId, uint32_t spInstId, uint32_t circuit
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2348,7 +2333,7 @@ ftdm_status_t handle_ucic(uint32_t suInstId, uint32_t spInstId, uint32_t circuit
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2420,9 +2405,9 @@ ftdm_status_t handle_cgb_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	memset(&status[0], '\0', sizeof(status));
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2436,7 +2421,7 @@ ftdm_status_t handle_cgb_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 	/* grab the span info */
@@ -2483,7 +2468,7 @@ ftdm_status_t handle_cgb_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	loop_range = circuit + range + 1;
 	x = circuit;
 	while( x < loop_range ) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type != SNG_CKT_VOICE)  {
+		if (sngss7_get_ckt(x)->type != SNG_CKT_VOICE)  {
 			loop_range++;
 		}
 		else {
@@ -2566,9 +2551,9 @@ ftdm_status_t handle_cgu_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	memset(&status[0], '\0', sizeof(status));
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2582,7 +2567,7 @@ ftdm_status_t handle_cgu_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
@@ -2630,7 +2615,7 @@ ftdm_status_t handle_cgu_req(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	loop_range = circuit + range + 1;
 	x = circuit;
 	while( x < loop_range ) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type != SNG_CKT_VOICE)  {
+		if (sngss7_get_ckt(x)->type != SNG_CKT_VOICE)  {
 			loop_range++;
 		} else {
 			if (extract_chan_data(x, &sngss7_info, &ftdmchan)) {
@@ -2707,9 +2692,9 @@ ftdm_status_t handle_olm_msg(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 	ftdm_running_return(FTDM_FAIL);
 
 	/* confirm that the circuit is voice channel */
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("[CIC:%d]Rx %s on non-voice CIC\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+					sngss7_get_ckt(circuit)->cic,
 					DECODE_LCC_EVENT(evntType));
 
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
@@ -2723,7 +2708,7 @@ ftdm_status_t handle_olm_msg(uint32_t suInstId, uint32_t spInstId, uint32_t circ
 		}
 
 		SS7_INFO_CHAN(ftdmchan, "[CIC:%d]Rx %s\n",
-			g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+			sngss7_get_ckt(circuit)->cic,
 			DECODE_LCC_EVENT(evntType));
 	}
 
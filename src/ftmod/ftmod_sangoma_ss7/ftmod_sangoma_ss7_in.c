@@ -66,7 +66,7 @@ void sngss7_con_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -80,14 +80,12 @@ void sngss7_con_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
-	
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -97,7 +95,7 @@ void sngss7_con_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	memcpy(&sngss7_event->event.siConEvnt, siConEvnt, sizeof(*siConEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -111,7 +109,7 @@ void sngss7_con_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -125,13 +123,12 @@ void sngss7_con_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -141,7 +138,7 @@ void sngss7_con_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCo
 	memcpy(&sngss7_event->event.siConEvnt, siConEvnt, sizeof(*siConEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -155,7 +152,7 @@ void sngss7_con_sta(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCn
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -169,13 +166,12 @@ void sngss7_con_sta(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCn
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -186,7 +182,7 @@ void sngss7_con_sta(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiCn
 	memcpy(&sngss7_event->event.siCnStEvnt, siCnStEvnt, sizeof(*siCnStEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -200,7 +196,7 @@ void sngss7_rel_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -214,13 +210,12 @@ void sngss7_rel_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -230,7 +225,7 @@ void sngss7_rel_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	memcpy(&sngss7_event->event.siRelEvnt, siRelEvnt, sizeof(*siRelEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -244,7 +239,7 @@ void sngss7_rel_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -258,13 +253,12 @@ void sngss7_rel_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -274,7 +268,7 @@ void sngss7_rel_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiRe
 	memcpy(&sngss7_event->event.siRelEvnt, siRelEvnt, sizeof(*siRelEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -288,7 +282,7 @@ void sngss7_dat_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiIn
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -302,13 +296,12 @@ void sngss7_dat_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiIn
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -318,7 +311,7 @@ void sngss7_dat_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiIn
 	memcpy(&sngss7_event->event.siInfoEvnt, siInfoEvnt, sizeof(*siInfoEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -332,7 +325,7 @@ void sngss7_fac_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -346,13 +339,12 @@ void sngss7_fac_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -363,7 +355,7 @@ void sngss7_fac_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	memcpy(&sngss7_event->event.siFacEvnt, siFacEvnt, sizeof(*siFacEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -377,7 +369,7 @@ void sngss7_fac_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -391,13 +383,12 @@ void sngss7_fac_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -408,7 +399,7 @@ void sngss7_fac_cfm(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	memcpy(&sngss7_event->event.siFacEvnt, siFacEvnt, sizeof(*siFacEvnt));
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 }
@@ -422,7 +413,7 @@ void sngss7_umsg_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit)
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -436,13 +427,12 @@ void sngss7_umsg_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit)
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -451,7 +441,7 @@ void sngss7_umsg_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit)
 	sngss7_event->event_id	= SNGSS7_UMSG_IND_EVENT;
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 
@@ -479,29 +469,29 @@ void sngss7_sta_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 		 * a non-voice cic so we also need to find the first voice cic on this 
 		 * system with the same intfId.
 		 */
-		intfId = g_ftdm_sngss7_data.cfg.isupCkt[circuit].infId;
+		intfId = sngss7_get_ckt(circuit)->infId;
 
-		if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 			SS7_DEBUG("Rx %s on circuit that is not a voice CIC (%d) finding a new circuit\n", 
 						DECODE_LCC_EVENT(evntType),
-						g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic);
+						sngss7_get_ckt(circuit)->cic);
 		}
 
 		x = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + 1;
-		while ((g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) &&
-			   (g_ftdm_sngss7_data.cfg.isupCkt[x].id < ((g_ftdm_sngss7_data.cfg.procId + 1) * MAX_CIC_MAP_LENGTH))) {
+		while ((sngss7_get_ckt(x)->id != 0) &&
+			   (sngss7_get_ckt(x)->id < ((g_ftdm_sngss7_data.cfg.procId + 1) * MAX_CIC_MAP_LENGTH))) {
 			/**********************************************************************/
 			/* confirm this is a voice channel and not a gap/sig (no ftdmchan there) */
-			if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+			if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 				/* compare the intfIds */
-				if (g_ftdm_sngss7_data.cfg.isupCkt[x].infId == intfId) {
+				if (sngss7_get_ckt(x)->infId == intfId) {
 					/* we have a match, setup the pointers to the correct values */
 					circuit = x;
 
 					/* confirm that the circuit is active on our side otherwise move to the next circuit */
-					if (!sngss7_test_flag(&g_ftdm_sngss7_data.cfg.isupCkt[circuit], SNGSS7_ACTIVE)) {
+					if (!sngss7_test_flag(sngss7_get_ckt(circuit), SNGSS7_ACTIVE)) {
 						SS7_DEBUG("[CIC:%d]Rx %s but circuit is not active yet, skipping!\n",
-									g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic,
+									sngss7_get_ckt(circuit)->cic,
 									DECODE_LCC_EVENT(evntType));
 						x++;
 						continue;
@@ -532,9 +522,9 @@ void sngss7_sta_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 		break;
 	/**************************************************************************/
 	default:
-		if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 			ftdm_log(FTDM_LOG_DEBUG, "Rx %s on circuit that is not a voice CIC (%d) (circuit:%d)\n",
-						DECODE_LCC_EVENT(evntType), g_ftdm_sngss7_data.cfg.isupCkt[circuit].cic, circuit);
+						DECODE_LCC_EVENT(evntType), sngss7_get_ckt(circuit)->cic, circuit);
 			SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 			return;
 		}
@@ -550,13 +540,12 @@ void sngss7_sta_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	} /* switch (evntType) */
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -567,10 +556,12 @@ void sngss7_sta_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, uint
 	sngss7_event->event_id	= SNGSS7_STA_IND_EVENT;
 	if (siStaEvnt != NULL) {
 		memcpy(&sngss7_event->event.siStaEvnt, siStaEvnt, sizeof(*siStaEvnt));
+	} else {
+		memset(&sngss7_event->event.siStaEvnt, 0x0, sizeof(sngss7_event->event.siStaEvnt));
 	}
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 }
 
 /******************************************************************************/
@@ -582,7 +573,7 @@ void sngss7_susp_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiS
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -596,13 +587,12 @@ void sngss7_susp_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiS
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -611,10 +601,12 @@ void sngss7_susp_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiS
 	sngss7_event->event_id	= SNGSS7_SUSP_IND_EVENT;
 	if (siSuspEvnt != NULL) {
 		memcpy(&sngss7_event->event.siSuspEvnt, siSuspEvnt, sizeof(*siSuspEvnt));
+	} else {
+		memset(&sngss7_event->event.siSuspEvnt, 0x0, sizeof(sngss7_event->event.siSuspEvnt));
 	}
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 
@@ -629,7 +621,7 @@ void sngss7_resm_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiR
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_event_data_t	*sngss7_event = NULL;
 
-	if (g_ftdm_sngss7_data.cfg.isupCkt[circuit].type != SNG_CKT_VOICE) {
+	if (sngss7_get_ckt(circuit)->type != SNG_CKT_VOICE) {
 		SS7_ERROR("Rx sig event on circuit that is not a voice CIC (%d)\n", circuit);
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
@@ -643,13 +635,12 @@ void sngss7_resm_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiR
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -658,10 +649,12 @@ void sngss7_resm_ind(uint32_t suInstId, uint32_t spInstId, uint32_t circuit, SiR
 	sngss7_event->event_id	= SNGSS7_RESM_IND_EVENT;
 	if (siResmEvnt != NULL) {
 		memcpy(&sngss7_event->event.siResmEvnt, siResmEvnt, sizeof(*siResmEvnt));
+	} else {
+		memset(&sngss7_event->event.siResmEvnt, 0x0, sizeof(sngss7_event->event.siResmEvnt));
 	}
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 
@@ -684,13 +677,12 @@ void sngss7_ssp_sta_cfm(uint32_t infId)
 	}
 
 	/* initalize the sngss7_event */
-	sngss7_event = ftdm_malloc(sizeof(*sngss7_event));
+	sngss7_event = sngss7_event_alloc(&((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->ind_pool);
 	if (sngss7_event == NULL) {
 		SS7_ERROR("Failed to allocate memory for sngss7_event!\n");
 		SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 		return;
 	}
-	memset(sngss7_event, 0x0, sizeof(*sngss7_event));
 
 	/* fill in the sngss7_event struct */
 	sngss7_event->spInstId	= spInstId;
@@ -699,10 +691,12 @@ void sngss7_ssp_sta_cfm(uint32_t infId)
 	sngss7_event->event_id	= SNGSS7_RESM_IND_EVENT;
 	if (siSuspEvnt != NULL) {
 		memcpy(&sngss7_event->event.siResmEvnt, siResmEvnt, sizeof(*siResmEvnt));
+	} else {
+		memset(&sngss7_event->event.siResmEvnt, 0x0, sizeof(sngss7_event->event.siResmEvnt));
 	}
 
 	/* enqueue this event */
-	ftdm_queue_enqueue(((sngss7_span_data_t*)sngss7_info->ftdmchan->span->signal_data)->event_queue, sngss7_event);
+	sngss7_enqueue_stack_event(sngss7_info, sngss7_event);
 #endif
 	SS7_FUNC_TRACE_EXIT(__FTDM_FUNC__);
 
@@ -289,22 +289,24 @@ static void handle_hw_alarm(ftdm_event_t *e)
 {
 	sngss7_chan_data_t *ss7_info = NULL;
 	ftdm_channel_t *ftdmchan = NULL;
-	int x = 0;
+	sng_isup_ckt_t *ckt = NULL;
+	uint32_t x = 0;
 
 	ftdm_assert(e != NULL, "Null event!\n");
 					
 	SS7_DEBUG("handle_hw_alarm event [%d/%d]\n",e->channel->physical_span_id,e->channel->physical_chan_id);
 
-	for (x = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + 1; g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0; x++) {
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-			ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+	for (x = 0; x < g_ftdm_sngss7_data.cfg.isupCkt.count; x++) {
+		ckt = g_ftdm_sngss7_data.cfg.isupCkt.list[x];
+		if (ckt->procId == g_ftdm_sngss7_data.cfg.procId && ckt->type == SNG_CKT_VOICE) {
+			ss7_info = (sngss7_chan_data_t *)ckt->obj;
 
 			/* NC. Its possible for alarms to come in the middle of configuration
 			   especially on large systems */
 			if (!ss7_info || !ss7_info->ftdmchan) {
-				SS7_DEBUG("handle_hw_alarm: span=%i chan=%i ckt=%i x=%i - ss7_info=%p ftdmchan=%p\n",
+				SS7_DEBUG("handle_hw_alarm: span=%i chan=%i ckt=%i - ss7_info=%p ftdmchan=%p\n",
 						ftdmchan->physical_span_id,ftdmchan->physical_chan_id,
-						g_ftdm_sngss7_data.cfg.isupCkt[x].id,x,
+						ckt->id,
 						ss7_info,ss7_info?ss7_info->ftdmchan:NULL);
 				continue;
 			}
@@ -313,8 +315,8 @@ static void handle_hw_alarm(ftdm_event_t *e)
 			
 			if (e->channel->physical_span_id == ftdmchan->physical_span_id && 
 			    e->channel->physical_chan_id == ftdmchan->physical_chan_id) {
-				SS7_DEBUG_CHAN(ftdmchan,"handle_hw_alarm: span=%i chan=%i ckt=%i x=%i\n",
-						ftdmchan->physical_span_id,ftdmchan->physical_chan_id,g_ftdm_sngss7_data.cfg.isupCkt[x].id,x);
+				SS7_DEBUG_CHAN(ftdmchan,"handle_hw_alarm: span=%i chan=%i ckt=%i\n",
+						ftdmchan->physical_span_id,ftdmchan->physical_chan_id,ckt->id);
 				if (e->enum_id == FTDM_OOB_ALARM_TRAP) {
 					SS7_DEBUG_CHAN(ftdmchan,"handle_hw_alarm: Set FLAG_GRP_HW_BLOCK_TX %s\n", " ");
 					sngss7_set_ckt_blk_flag(ss7_info, FLAG_GRP_HW_BLOCK_TX);
@@ -431,13 +433,14 @@ static void *ftdm_sangoma_ss7_run(ftdm_thread_t * me, void *obj)
 	}
 
 	while (ftdm_running () && !(ftdm_test_flag (ftdmspan, FTDM_SPAN_STOP_THREAD))) {
-		int x = 0;
+		uint32_t x = 0;
+		ftdm_span_metrics_loop_mark(ftdmspan);
 		if (b_alarm_test) {
 			b_alarm_test = 0;
-			for (x = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + 1; 
-			     g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0; x++) {	
-				if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
-					ss7_info = (sngss7_chan_data_t *)g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			for (x = 0; x < g_ftdm_sngss7_data.cfg.isupCkt.count; x++) {
+				sng_isup_ckt_t *ckt = g_ftdm_sngss7_data.cfg.isupCkt.list[x];
+				if (ckt->procId == g_ftdm_sngss7_data.cfg.procId && ckt->type == SNG_CKT_VOICE) {
+					ss7_info = (sngss7_chan_data_t *)ckt->obj;
 					ftdmchan = ss7_info->ftdmchan;
 					if (!ftdmchan) {
 						continue;
@@ -478,7 +481,7 @@ static void *ftdm_sangoma_ss7_run(ftdm_thread_t * me, void *obj)
 					/* clean out all pending stack events in the peer channel */
 					while ((sngss7_event = ftdm_queue_dequeue(chan_info->event_queue))) {
 						ftdm_sangoma_ss7_process_peer_stack_event(ftdmchan, sngss7_event);
-					       	ftdm_safe_free(sngss7_event);
+						sngss7_event_free(sngss7_event);
 					}
 				}
  
@@ -489,7 +492,7 @@ static void *ftdm_sangoma_ss7_run(ftdm_thread_t * me, void *obj)
 			/* clean out all pending stack events */
 			while ((sngss7_event = ftdm_queue_dequeue(sngss7_span->event_queue))) {
 				ftdm_sangoma_ss7_process_stack_event(sngss7_event);
-				ftdm_safe_free(sngss7_event);
+				sngss7_event_free(sngss7_event);
 			}
 
 			/* signal the core that sig events are queued for processing */
@@ -521,11 +524,8 @@ static void *ftdm_sangoma_ss7_run(ftdm_thread_t * me, void *obj)
 
 		/* check if there is a GRS being processed on the span */
 		if (ftdm_test_flag(sngss7_span, SNGSS7_RX_GRS_PENDING)) {
-			/* check if the rx_grs has started */
-			check_if_rx_grs_started(ftdmspan);
-
-			/* check if the rx_grs has cleared */
-			check_if_rx_grs_processed(ftdmspan);
+			/* start the new ones and complete the ones with all their circuits out of reset */
+			check_for_range_ops(ftdmspan);
 		}
 
 		/* check if there is a UCIC to be processed on the span */
@@ -534,11 +534,8 @@ static void *ftdm_sangoma_ss7_run(ftdm_thread_t * me, void *obj)
 			process_span_ucic(ftdmspan);
 		}
 
-		/* check each channel on the span to see if there is an un-procressed SUS/RES flag */
-		check_for_res_sus_flag(ftdmspan);
-
-		/* check each channel on the span to see if it needs to be reconfigured */
-		check_for_reconfig_flag(ftdmspan);
+		/* check the channels flagged with an un-procressed SUS/RES or a reconfiguration */
+		check_for_dirty_ckts(ftdmspan);
 		
 		check_span_oob_events(ftdmspan);
 	}
@@ -618,9 +615,8 @@ static void ftdm_sangoma_ss7_process_stack_event (sngss7_event_data_t *sngss7_ev
 
 	/* clone the event and save it for later usage, we do not clone RLC messages */
 	if (clone_event) {
-		event_clone = ftdm_calloc(1, sizeof(*sngss7_event));
+		event_clone = sngss7_event_clone(&((sngss7_span_data_t *)ftdmchan->span->signal_data)->clone_pool, sngss7_event);
 		if (event_clone) {
-			memcpy(event_clone, sngss7_event, sizeof(*sngss7_event));
 			/* if we have already a peer channel then enqueue the event in their queue */
 			if (sngss7_info->peer_data) {
 				ftdm_span_t *peer_span = sngss7_info->peer_data->ftdmchan->span;
@@ -1343,7 +1339,7 @@ ftdm_status_t ftdm_sangoma_ss7_process_state_change (ftdm_channel_t *ftdmchan)
 				sngss7_set_ckt_flag(sngss7_info, FLAG_SENT_ACM);
 				ft_to_sngss7_acm(ftdmchan);
 			}
-			if (g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].cpg_on_progress == FTDM_TRUE) {
+			if (sngss7_get_ckt(sngss7_info->circuit->id)->cpg_on_progress == FTDM_TRUE) {
 				if (!sngss7_test_ckt_flag(sngss7_info, FLAG_SENT_CPG)) {
 					sngss7_set_ckt_flag(sngss7_info, FLAG_SENT_CPG);
 					ft_to_sngss7_cpg(ftdmchan);
@@ -1368,7 +1364,7 @@ ftdm_status_t ftdm_sangoma_ss7_process_state_change (ftdm_channel_t *ftdmchan)
 				sngss7_set_ckt_flag(sngss7_info, FLAG_SENT_ACM);
 				ft_to_sngss7_acm(ftdmchan);
 			}
-			if (g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].cpg_on_progress_media == FTDM_TRUE) {
+			if (sngss7_get_ckt(sngss7_info->circuit->id)->cpg_on_progress_media == FTDM_TRUE) {
 				if (!sngss7_test_ckt_flag(sngss7_info, FLAG_SENT_CPG)) {
 					sngss7_set_ckt_flag(sngss7_info, FLAG_SENT_CPG);
 					ft_to_sngss7_cpg(ftdmchan);
@@ -1757,6 +1753,9 @@ ftdm_status_t ftdm_sangoma_ss7_process_state_change (ftdm_channel_t *ftdmchan)
 		if (sngss7_test_ckt_flag (sngss7_info, FLAG_GRP_RESET_RX)) {
 			/* set the grp reset done flag so we know we have finished this reset */
 			sngss7_set_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN);
+
+			/* let the span thread know this member of the GRS is done */
+			sngss7_range_op_member_done(sngss7_info);
 		} /* if (sngss7_test_ckt_flag (sngss7_info, FLAG_GRP_RESET_RX)) */
 
 
@@ -2523,6 +2522,13 @@ static FIO_CONFIGURE_SPAN_SIGNALING_FUNCTION(ftdm_sangoma_ss7_span_config)
 		return FTDM_FAIL;
 	}
 
+	/* preallocate the stack events for this span */
+	if (sngss7_event_pool_create(&ss7_span_info->ind_pool, SNGSS7_IND_EVENT_POOL_SIZE) != FTDM_SUCCESS ||
+		sngss7_event_pool_create(&ss7_span_info->clone_pool, SNGSS7_CLONE_EVENT_POOL_SIZE) != FTDM_SUCCESS) {
+		SS7_CRITICAL("Unable to allocate the event pools!\n");
+		return FTDM_FAIL;
+	}
+
 	/*setup the span structure with the info so far */
 	g_ftdm_sngss7_data.sig_cb 		= sig_cb;
 	span->start 					= ftdm_sangoma_ss7_start;
@@ -2631,6 +2637,8 @@ static FIO_SIG_LOAD_FUNCTION(ftdm_sangoma_ss7_init)
 	sng_isup_version(&major, &minor, &build);
 	SS7_INFO("Loaded LibSng-SS7 %d.%d.%d\n", major, minor, build);
 
+	ftdm_metrics_collector_register(sngss7_event_pools_collector, NULL);
+
 	return FTDM_SUCCESS;
 }
 
@@ -2643,6 +2651,7 @@ static FIO_SIG_UNLOAD_FUNCTION(ftdm_sangoma_ss7_unload)
 
 	ftdm_log (FTDM_LOG_INFO, "Starting ftmod_sangoma_ss7 unload...\n");
 
+	ftdm_metrics_collector_unregister(sngss7_event_pools_collector, NULL);
 
 	if (sngss7_test_flag(&g_ftdm_sngss7_data.cfg, SNGSS7_CC_STARTED)) {
 		sng_isup_free_cc();
@@ -2712,6 +2721,8 @@ static FIO_SIG_UNLOAD_FUNCTION(ftdm_sangoma_ss7_unload)
 
 	sng_isup_free_gen();
 
+	sngss7_free_ckts();
+
 	ftdm_log (FTDM_LOG_INFO, "Finished ftmod_sangoma_ss7 unload!\n");
 	return FTDM_SUCCESS;
 }
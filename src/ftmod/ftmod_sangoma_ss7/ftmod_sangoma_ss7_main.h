@@ -66,6 +66,10 @@
 #define SNGSS7_EVENT_QUEUE_SIZE	100
 #define SNGSS7_PEER_CHANS_QUEUE_SIZE 100
 #define SNGSS7_CHAN_EVENT_QUEUE_SIZE 100
+/* preallocated stack events per span, indications can not exceed the span event queue size,
+ * clones wait in the channel queues of bridged calls, the heap is used when a pool runs out */
+#define SNGSS7_IND_EVENT_POOL_SIZE		(SNGSS7_EVENT_QUEUE_SIZE + 4)
+#define SNGSS7_CLONE_EVENT_POOL_SIZE	64
 
 #define MAX_SIZEOF_SUBADDR_IE	24	/* as per Q931 4.5.9 */
 
@@ -77,7 +81,7 @@
 			do { \
 					void *__queue_data = NULL; \
 					while ((__queue_data = ftdm_queue_dequeue(queue))) { \
-						ftdm_safe_free(__queue_data); \
+						sngss7_event_free(__queue_data); \
 					} \
 			} while (0)
 
@@ -401,6 +405,25 @@ typedef struct sng_isup_ckt {
 	uint16_t		tval;
 } sng_isup_ckt_t;
 
+/* Circuits are allocated one at a time as they are configured and indexed by stack circuit id
+ * (procId * MAX_CIC_MAP_LENGTH + n) through a two level table where only the pages holding
+ * configured circuits are allocated */
+#define SNGSS7_CKT_PAGE_BITS	8
+#define SNGSS7_CKT_PAGE_SIZE	(1 << SNGSS7_CKT_PAGE_BITS)
+#define SNGSS7_CKT_PAGE_MASK	(SNGSS7_CKT_PAGE_SIZE - 1)
+
+typedef struct sng_isup_ckt_map {
+	sng_isup_ckt_t	***pages;
+	uint32_t		num_pages;
+} sng_isup_ckt_map_t;
+
+typedef struct sng_isup_ckt_table {
+	sng_isup_ckt_map_t	by_id;
+	sng_isup_ckt_t		**list;		/* all the configured circuits sorted by id */
+	uint32_t			count;
+	uint32_t			size;
+} sng_isup_ckt_table_t;
+
 typedef struct sng_nsap {
 	uint32_t		flags;
 	uint32_t		id;
@@ -488,7 +511,7 @@ typedef struct sng_ss7_cfg {
 	sng_link_set_t		mtpLinkSet[MAX_MTP_LINKSETS+1];
 	sng_route_t			mtpRoute[MAX_MTP_ROUTES+1];
 	sng_isup_inf_t		isupIntf[MAX_ISUP_INFS+1];
-	sng_isup_ckt_t		isupCkt[10000]; 	/* KONRAD - only need 2000 ( and 0-1000 aren't used) since other servers are registerd else where */
+	sng_isup_ckt_table_t	isupCkt;		/* use sngss7_get_ckt() and friends */
 	sng_nsap_t			nsap[MAX_NSAPS+1];
 	sng_isap_t			isap[MAX_ISAPS+1];	
 	sng_glare_resolution	glareResolution;
@@ -556,6 +579,7 @@ typedef struct sngss7_chan_data {
 	sngss7_timer_data_t		t10;
 	sngss7_timer_data_t		t39;
 	sngss7_group_data_t		rx_grs;
+	ftdm_span_t				*rx_grs_span;	/* span running the received GRS this circuit is resetting for */
 	sngss7_group_data_t		rx_gra;
 	sngss7_group_data_t		tx_grs;
 	sngss7_group_data_t		ucic;
@@ -567,6 +591,42 @@ typedef struct sngss7_chan_data {
 #define SNGSS7_RX_GRS_PENDING (1 << 0)
 #define SNGSS7_UCIC_PENDING (1 << 1)
 #define SNGSS7_RX_GRA_PENDING (1 << 2)
+
+/* circuits with pending PAUSED/RESUME/RECONFIG work, set by sngss7_set_ckt_flag(), indexed by chan_id */
+#define SNGSS7_DIRTY_CKT_WORDS ((FTDM_MAX_CHANNELS_SPAN / 32) + 1)
+struct sngss7_event_data;
+
+/* Stack event slab
+ * Only one thread allocates from a pool, events are released from any thread to the lock-free
+ * returned list, the allocator takes the whole returned list at once when its own free list is empty */
+typedef struct sngss7_event_pool {
+	struct sngss7_event_data	*events;		/* the slab */
+	struct sngss7_event_data	*free;			/* allocator thread only */
+	void * volatile				returned;		/* released events not yet taken back by the allocator */
+	uint32_t					size;
+	uint64_t					allocs;			/* allocator thread only */
+	volatile uint32_t			exhausted;		/* allocations served from the heap */
+	volatile uint32_t			in_use;			/* pooled events not released yet */
+} sngss7_event_pool_t;
+
+/* Received group reset, one per GRS whatever its range
+ * Members report the end of their reset through sngss7_range_op_member_done(), the span thread
+ * only looks at the operations with a member that moved, see check_for_range_ops() */
+#define SNGSS7_RANGE_OP_MAX_CKTS 256	/* the range field is one octet */
+#define SNGSS7_RANGE_DONE_WORDS ((MAX_CIC_MAP_LENGTH / 32) + 1)
+
+typedef struct sngss7_range_op {
+	sngss7_chan_data_t		*base;			/* circuit the GRS was received on, the operation ends when its rx_grs is cleared */
+	uint32_t				circuit;		/* base circuit id */
+	uint32_t				range;			/* the operation covers range + 1 circuits */
+	uint32_t				members;		/* voice circuits in the range */
+	uint32_t				pending;		/* members still resetting */
+	uint8_t					started;		/* the members were moved to RESTART */
+	uint8_t					finished;		/* the members were moved to DOWN, the GRA goes out with the base circuit */
+	ftdm_bitmap_t			done[(SNGSS7_RANGE_OP_MAX_CKTS / FTDM_BITMAP_NBITS) + 1];	/* by offset from circuit */
+	struct sngss7_range_op	*next;
+} sngss7_range_op_t;
+
 typedef struct sngss7_span_data {
 	ftdm_sched_t			*sched;
 	uint32_t                        flags;
@@ -575,10 +635,20 @@ typedef struct sngss7_span_data {
 	sngss7_group_data_t		rx_cgu;
 	sngss7_group_data_t		tx_cgu;
 	ftdm_queue_t 			*event_queue;
+	sngss7_event_pool_t		ind_pool;		/* stack indications, allocated by the stack thread */
+	sngss7_event_pool_t		clone_pool;		/* events cloned for bridged calls, allocated by the span thread */
+	volatile uint32_t		dirty_ckts[SNGSS7_DIRTY_CKT_WORDS];
+	volatile uint32_t		dirty;			/* any bit set in dirty_ckts */
+	uint32_t				dirty_pass[SNGSS7_DIRTY_CKT_WORDS];	/* circuits of the current check_for_dirty_ckts() pass */
+	sngss7_range_op_t		*range_ops;		/* received GRS in progress, span thread only */
+	volatile uint32_t		range_done_ckts[SNGSS7_RANGE_DONE_WORDS];	/* members done since the last pass, by circuit id within the procId */
+	volatile uint32_t		range_done;		/* any bit set in range_done_ckts */
 } sngss7_span_data_t;
 
 typedef struct sngss7_event_data
 {
+	sngss7_event_pool_t			*pool;	/* NULL for events allocated from the heap */
+	struct sngss7_event_data	*next;	/* pool free list */
 	uint32_t		event_id;
 	uint32_t		spId;
 	uint32_t		suId;
@@ -787,6 +857,7 @@ extern sng_cic_cntrl_type_t 	sng_cic_cntrl_type_map[];
 extern uint32_t					sngss7_id;
 extern ftdm_sched_t				*sngss7_sched;
 extern int						cmbLinkSetId;
+extern sng_isup_ckt_t			sngss7_null_ckt;
 /******************************************************************************/
 
 /* PROTOTYPES *****************************************************************/
@@ -995,12 +1066,23 @@ ftdm_status_t copy_tknStr_to_sngss7(char* str, TknStr *tknStr, TknU8 *oddEven);
 int check_for_state_change(ftdm_channel_t *ftdmchan);
 int check_for_reset(sngss7_chan_data_t *sngss7_info);
 ftdm_status_t extract_chan_data(uint32_t circuit, sngss7_chan_data_t **sngss7_info, ftdm_channel_t **ftdmchan);
+sng_isup_ckt_t *sngss7_add_ckt(uint32_t id);
+uint32_t sngss7_ckt_lower_bound(uint32_t id);
+void sngss7_free_ckts(void);
+
+ftdm_status_t sngss7_event_pool_create(sngss7_event_pool_t *pool, uint32_t size);
+sngss7_event_data_t *sngss7_event_alloc(sngss7_event_pool_t *pool);
+sngss7_event_data_t *sngss7_event_clone(sngss7_event_pool_t *pool, const sngss7_event_data_t *event);
+void sngss7_event_free(sngss7_event_data_t *event);
+void sngss7_enqueue_stack_event(sngss7_chan_data_t *sngss7_info, sngss7_event_data_t *sngss7_event);
+void sngss7_event_pools_show(ftdm_stream_handle_t *stream);
+void sngss7_event_pools_collector(ftdm_stream_handle_t *stream, void *data);
 unsigned long get_unique_id(void);
 
-ftdm_status_t check_if_rx_grs_started(ftdm_span_t *ftdmspan);
-ftdm_status_t check_if_rx_grs_processed(ftdm_span_t *ftdmspan);
+ftdm_status_t sngss7_range_op_start(ftdm_span_t *ftdmspan, uint32_t circuit, uint32_t range);
+ftdm_status_t check_for_range_ops(ftdm_span_t *ftdmspan);
 ftdm_status_t check_if_rx_gra_started(ftdm_span_t *ftdmspan);
-ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan);
+ftdm_status_t check_for_dirty_ckts(ftdm_span_t *ftdmspan);
 
 ftdm_status_t process_span_ucic(ftdm_span_t *ftdmspan);
 
@@ -1022,7 +1104,6 @@ int find_ssf_type_in_map(const char *ssfType);
 int find_cic_cntrl_in_map(const char *cntrlType);
 
 ftdm_status_t check_status_of_all_isup_intf(void);
-ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan);
 
 void sngss7_send_signal(sngss7_chan_data_t *sngss7_info, ftdm_signal_event_t event_id);
 void sngss7_set_sig_status(sngss7_chan_data_t *sngss7_info, ftdm_signaling_status_t status);
@@ -1174,7 +1255,14 @@ if (ftdmchan->state == new_state) { \
 
 #define sngss7_test_ckt_flag(obj, flag)  ((obj)->ckt_flags & flag)
 #define sngss7_clear_ckt_flag(obj, flag) ((obj)->ckt_flags &= ~(flag))
-#define sngss7_set_ckt_flag(obj, flag)   ((obj)->ckt_flags |= (flag))
+#define sngss7_set_ckt_flag(obj, flag)   do { (obj)->ckt_flags |= (flag); \
+										  if ((flag) & SNGSS7_CKT_WORK_FLAGS) { \
+											  sngss7_mark_ckt_dirty(obj); \
+										  } \
+									 } while (0)
+
+/* circuit flags the span thread has to act on, see check_for_dirty_ckts() */
+#define SNGSS7_CKT_WORK_FLAGS (FLAG_INFID_PAUSED | FLAG_INFID_RESUME | FLAG_CKT_RECONFIG)
 
 #define sngss7_test_ckt_blk_flag(obj, flag)  ((obj)->blk_flags & flag)
 #define sngss7_clear_ckt_blk_flag(obj, flag) ((obj)->blk_flags &= ~(flag))
@@ -1217,6 +1305,66 @@ if (ftdmchan->state == new_state) { \
 										  sngss7_set_ckt_flag((obj), (FLAG_RESET_TX)); \
 								     } while (0);
  
+static __inline__ sng_isup_ckt_t *sngss7_ckt_map_find(const sng_isup_ckt_map_t *map, uint32_t key)
+{
+	uint32_t page = key >> SNGSS7_CKT_PAGE_BITS;
+
+	if (page >= map->num_pages || !map->pages[page]) {
+		return NULL;
+	}
+	return map->pages[page][key & SNGSS7_CKT_PAGE_MASK];
+}
+
+/* the configured circuit with this stack circuit id, NULL if there is none */
+static __inline__ sng_isup_ckt_t *sngss7_find_ckt(uint32_t id)
+{
+	return sngss7_ckt_map_find(&g_ftdm_sngss7_data.cfg.isupCkt.by_id, id);
+}
+
+/* same as sngss7_find_ckt() but ids that are not configured read as an all zero circuit (id 0),
+ * so the scans walking the circuit ids until id == 0 stop at the first unconfigured one, never write through it */
+static __inline__ sng_isup_ckt_t *sngss7_get_ckt(uint32_t id)
+{
+	sng_isup_ckt_t *ckt = sngss7_find_ckt(id);
+	return ckt ? ckt : &sngss7_null_ckt;
+}
+
+/* queue the circuit for the next check_for_dirty_ckts() pass of its span thread, any thread can call it */
+static __inline__ void sngss7_mark_ckt_dirty(sngss7_chan_data_t *sngss7_info)
+{
+	ftdm_channel_t *ftdmchan = sngss7_info->ftdmchan;
+	sngss7_span_data_t *sngss7_span;
+
+	if (!ftdmchan || !ftdmchan->span || !(sngss7_span = ftdmchan->span->signal_data)) {
+		return;
+	}
+	ftdm_atomic_or32(&sngss7_span->dirty_ckts[ftdmchan->chan_id / 32], 1U << (ftdmchan->chan_id % 32));
+	ftdm_atomic_set32(&sngss7_span->dirty, 1);
+}
+
+/* the circuit finished its part of a received GRS, picked up by the next check_for_range_ops() pass
+ * of the span the GRS was received on, which is not always the span of the circuit */
+static __inline__ void sngss7_range_op_member_done(sngss7_chan_data_t *sngss7_info)
+{
+	ftdm_span_t *ftdmspan = sngss7_info->rx_grs_span;
+	sngss7_span_data_t *sngss7_span;
+	uint32_t bn;
+
+	if (!ftdmspan || !(sngss7_span = ftdmspan->signal_data)) {
+		return;
+	}
+	bn = sngss7_info->circuit->id % MAX_CIC_MAP_LENGTH;
+	ftdm_atomic_or32(&sngss7_span->range_done_ckts[bn / 32], 1U << (bn % 32));
+	ftdm_atomic_set32(&sngss7_span->range_done, 1);
+}
+
+/* walk the configured circuits of this node (cfg.procId) in id order, i is the index in the circuit list */
+#define sngss7_for_each_ckt(i, ckt) \
+	for ((i) = sngss7_ckt_lower_bound(g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH); \
+		 (i) < g_ftdm_sngss7_data.cfg.isupCkt.count && \
+		 ((ckt) = g_ftdm_sngss7_data.cfg.isupCkt.list[(i)])->id < ((g_ftdm_sngss7_data.cfg.procId + 1) * MAX_CIC_MAP_LENGTH); \
+		 (i)++)
+
 
 
 #ifdef SMG_RELAY_DBG
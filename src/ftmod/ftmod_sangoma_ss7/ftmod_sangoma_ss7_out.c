@@ -175,7 +175,7 @@ void ft_to_sngss7_iam (ftdm_channel_t * ftdmchan)
 		/* Transmission medium requirements */
 		copy_txMedReq_to_sngss7(ftdmchan, &iam.txMedReq);
 
-		if (SNGSS7_SWITCHTYPE_ANSI(g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType)) {
+		if (SNGSS7_SWITCHTYPE_ANSI(sngss7_get_ckt(sngss7_info->circuit->id)->switchType)) {
 			/* User Service Info A */
 			copy_usrServInfoA_to_sngss7(ftdmchan, &iam.usrServInfoA);
 		}
@@ -243,7 +243,7 @@ void ft_to_sngss7_iam (ftdm_channel_t * ftdmchan)
 		ftdm_channel_advance_states(ftdmchan);
 	}
 	
-	ftdm_safe_free(event_clone);
+	sngss7_event_free(event_clone);
 
 	SS7_FUNC_TRACE_EXIT (__FTDM_FUNC__);
 	return;
@@ -405,8 +405,8 @@ void ft_to_sngss7_acm (ftdm_channel_t * ftdmchan)
 	acm.bckCallInd.sccpMethInd.val		= SCCPMTH_NOIND;
 
 	/* fill in any optional parameters */
-	if (sngss7_test_options(&g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id], SNGSS7_ACM_OBCI_BITA)) {
-		SS7_DEBUG_CHAN(ftdmchan, "Found ACM_OBCI_BITA flag:0x%X\n", g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].options);
+	if (sngss7_test_options(sngss7_get_ckt(sngss7_info->circuit->id), SNGSS7_ACM_OBCI_BITA)) {
+		SS7_DEBUG_CHAN(ftdmchan, "Found ACM_OBCI_BITA flag:0x%X\n", sngss7_get_ckt(sngss7_info->circuit->id)->options);
 		acm.optBckCalInd.eh.pres				= PRSNT_NODEF;
 		acm.optBckCalInd.inbndInfoInd.pres		= PRSNT_NODEF;
 		acm.optBckCalInd.inbndInfoInd.val		= 0x1;
@@ -129,14 +129,14 @@ ftdm_status_t disable_all_ckts_for_relay(void)
 	SS7_INFO("Disabling all ckts becuase of Relay loss\n");
 
 	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+	while (sngss7_get_ckt(x)->id != 0) {
 	/**********************************************************************/
 		/* make sure this is voice channel */
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 	
 			/* get the ftdmchan and ss7_chan_data from the circuit */
-			if (extract_chan_data(g_ftdm_sngss7_data.cfg.isupCkt[x].id, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+			if (extract_chan_data(sngss7_get_ckt(x)->id, &sngss7_info, &ftdmchan)) {
+				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", sngss7_get_ckt(x)->id);
 				x++;
 				continue;
 			}
@@ -147,12 +147,12 @@ ftdm_status_t disable_all_ckts_for_relay(void)
 			/* throw the channel infId status flags to PAUSED ... they will be executed next process cycle */
 			sngss7_clear_ckt_flag(sngss7_info, FLAG_INFID_RESUME);
 			sngss7_set_ckt_flag(sngss7_info, FLAG_INFID_PAUSED);
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) */
+		} /* if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) */
 
 		/* move along */
 		x++;
 	/**********************************************************************/
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+	} /* while (sngss7_get_ckt(x)->id != 0) */
 
 	return FTDM_SUCCESS;
 }
@@ -168,14 +168,14 @@ ftdm_status_t enable_all_ckts_for_relay(void)
 	SS7_INFO("Enabling all ckts becuase of Relay connection\n");
 
 	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+	while (sngss7_get_ckt(x)->id != 0) {
 	/**********************************************************************/
 		/* make sure this is voice channel */
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 	
 			/* get the ftdmchan and ss7_chan_data from the circuit */
-			if (extract_chan_data(g_ftdm_sngss7_data.cfg.isupCkt[x].id, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+			if (extract_chan_data(sngss7_get_ckt(x)->id, &sngss7_info, &ftdmchan)) {
+				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", sngss7_get_ckt(x)->id);
 				x++;
 				continue;
 			}
@@ -183,7 +183,7 @@ ftdm_status_t enable_all_ckts_for_relay(void)
 			/* bring the relay_down flag down */
 			sngss7_clear_ckt_flag(sngss7_info, FLAG_RELAY_DOWN);
 
-			sngIntf = &g_ftdm_sngss7_data.cfg.isupIntf[g_ftdm_sngss7_data.cfg.isupCkt[x].infId];
+			sngIntf = &g_ftdm_sngss7_data.cfg.isupIntf[sngss7_get_ckt(x)->infId];
 
 			/* check if the interface is paused or resumed */
 			if (sngss7_test_flag(sngIntf, SNGSS7_PAUSED)) {
@@ -195,12 +195,12 @@ ftdm_status_t enable_all_ckts_for_relay(void)
 				sngss7_set_ckt_flag(sngss7_info, FLAG_INFID_RESUME);
 				sngss7_clear_ckt_flag(sngss7_info, FLAG_INFID_PAUSED);
 			}
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) */
+		} /* if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) */
 
 		/* move along */
 		x++;
 	/**********************************************************************/
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+	} /* while (sngss7_get_ckt(x)->id != 0) */
 
 	return FTDM_SUCCESS;
 }
@@ -213,11 +213,11 @@ ftdm_status_t reconfig_all_ckts_for_relay(void)
 
 	/* go through all the circuits on our ProcId */
 	x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+	while (sngss7_get_ckt(x)->id != 0) {
 	/**************************************************************************/
-		if ( g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+		if ( sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 			/* grab the private data structure */
-			sngss7_info = g_ftdm_sngss7_data.cfg.isupCkt[x].obj;
+			sngss7_info = sngss7_get_ckt(x)->obj;
 			
 			/* mark the circuit for re-configuration */
 			sngss7_set_ckt_flag(sngss7_info, FLAG_CKT_RECONFIG);
@@ -229,7 +229,7 @@ ftdm_status_t reconfig_all_ckts_for_relay(void)
 		/* move to the next circuit */
 		x++;
 	/**************************************************************************/
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+	} /* while (sngss7_get_ckt(x)->id != 0) */
 
 	return FTDM_SUCCESS;
 }
@@ -242,28 +242,28 @@ ftdm_status_t block_all_ckts_for_relay(uint32_t procId)
 
 	/* we just lost connection to this procId, send out a block for all these circuits */
 	x = (procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+	while (sngss7_get_ckt(x)->id != 0) {
 	/**************************************************************************/
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 
 			/* send a block request via stack manager */
-			ret = ftmod_ss7_block_isup_ckt_nowait(g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+			ret = ftmod_ss7_block_isup_ckt_nowait(sngss7_get_ckt(x)->id);
 			if (ret) {
 				SS7_INFO("Successfully BLOcked CIC:%d(ckt:%d) due to Relay failure\n", 
-							g_ftdm_sngss7_data.cfg.isupCkt[x].cic,
-							g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+							sngss7_get_ckt(x)->cic,
+							sngss7_get_ckt(x)->id);
 			} else {
 				SS7_ERROR("Failed to BLOck CIC:%d(ckt:%d) due to Relay failure\n",
-							g_ftdm_sngss7_data.cfg.isupCkt[x].cic,
-							g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+							sngss7_get_ckt(x)->cic,
+							sngss7_get_ckt(x)->id);
 			}
 	
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) */
+		} /* if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) */
 
 		/* move along */
 		x++;
 	/**************************************************************************/
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+	} /* while (sngss7_get_ckt(x)->id != 0) */
 
 	return FTDM_SUCCESS;
 }
@@ -303,28 +303,28 @@ static ftdm_status_t unblock_all_ckts_for_relay(uint32_t procId)
 	 * since we blocked them when we lost the connection	
  	 */
 	x = (procId * 1000) + 1;
-	while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+	while (sngss7_get_ckt(x)->id != 0) {
 	/**************************************************************************/
-		if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) {
+		if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) {
 
 			/* send a block request via stack manager */
-			ret = ftmod_ss7_unblock_isup_ckt(g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+			ret = ftmod_ss7_unblock_isup_ckt(sngss7_get_ckt(x)->id);
 			if (ret) {
 				SS7_INFO("Successfully unblocked CIC:%d(ckt:%d) due to Relay connection\n", 
-							g_ftdm_sngss7_data.cfg.isupCkt[x].cic,
-							g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+							sngss7_get_ckt(x)->cic,
+							sngss7_get_ckt(x)->id);
 			} else {
 				SS7_ERROR("Failed to unblock CIC:%d(ckt:%d) due to Relay connection\n",
-							g_ftdm_sngss7_data.cfg.isupCkt[x].cic,
-							g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+							sngss7_get_ckt(x)->cic,
+							sngss7_get_ckt(x)->id);
 			}
 	
-		} /* if (g_ftdm_sngss7_data.cfg.isupCkt[x].type == SNG_CKT_VOICE) */
+		} /* if (sngss7_get_ckt(x)->type == SNG_CKT_VOICE) */
 
 		/* move along */
 		x++;
 	/**************************************************************************/
-	} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+	} /* while (sngss7_get_ckt(x)->id != 0) */
 
 	return FTDM_SUCCESS;
 }
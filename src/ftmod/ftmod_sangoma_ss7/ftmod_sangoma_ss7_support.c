@@ -33,6 +33,7 @@
 
 /* INCLUDE ********************************************************************/
 #include "ftmod_sangoma_ss7_main.h"
+#include <stddef.h>
 #ifdef HAVE_ZLIB
 #include <zlib.h>
 #endif
@@ -43,6 +44,7 @@
 
 /* GLOBALS ********************************************************************/
 uint32_t sngss7_id;
+sng_isup_ckt_t sngss7_null_ckt;
 /******************************************************************************/
 
 /* PROTOTYPES *****************************************************************/
@@ -53,10 +55,12 @@ unsigned long get_unique_id(void);
 
 ftdm_status_t extract_chan_data(uint32_t circuit, sngss7_chan_data_t **sngss7_info, ftdm_channel_t **ftdmchan);
 
-ftdm_status_t check_if_rx_grs_started(ftdm_span_t *ftdmspan);
-ftdm_status_t check_if_rx_grs_processed(ftdm_span_t *ftdmspan);
+ftdm_status_t sngss7_range_op_start(ftdm_span_t *ftdmspan, uint32_t circuit, uint32_t range);
+ftdm_status_t check_for_range_ops(ftdm_span_t *ftdmspan);
 ftdm_status_t check_if_rx_gra_started(ftdm_span_t *ftdmspan);
-ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan);
+ftdm_status_t check_for_dirty_ckts(ftdm_span_t *ftdmspan);
+static ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan);
+static ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan);
 
 ftdm_status_t process_span_ucic(ftdm_span_t *ftdmspan);
 
@@ -70,7 +74,6 @@ int find_ssf_type_in_map(const char *ssfType);
 int find_cic_cntrl_in_map(const char *cntrlType);
 
 ftdm_status_t check_status_of_all_isup_intf(void);
-ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan);
 
 void sngss7_send_signal(sngss7_chan_data_t *sngss7_info, ftdm_signal_event_t event_id);
 void sngss7_set_sig_status(sngss7_chan_data_t *sngss7_info, ftdm_signaling_status_t status);
@@ -157,7 +160,7 @@ ftdm_status_t copy_cgPtyNum_to_sngss7(ftdm_channel_t *ftdmchan, SiCgPtyNum *cgPt
 	cgPtyNum->eh.pres		   = PRSNT_NODEF;
 	
 	cgPtyNum->natAddrInd.pres   = PRSNT_NODEF;
-	cgPtyNum->natAddrInd.val = g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].clg_nadi;
+	cgPtyNum->natAddrInd.val = sngss7_get_ckt(sngss7_info->circuit->id)->clg_nadi;
 
 	
 	cgPtyNum->scrnInd.pres	  = PRSNT_NODEF;
@@ -225,7 +228,7 @@ ftdm_status_t copy_cdPtyNum_to_sngss7(ftdm_channel_t *ftdmchan, SiCdPtyNum *cdPt
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Called NADI value \"%s\"\n", val);
 		cdPtyNum->natAddrInd.val	= atoi(val);
 	} else {
-		cdPtyNum->natAddrInd.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].cld_nadi;
+		cdPtyNum->natAddrInd.val	= sngss7_get_ckt(sngss7_info->circuit->id)->cld_nadi;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied NADI value found for CLD, using \"%d\"\n", cdPtyNum->natAddrInd.val);
 	}
 
@@ -266,7 +269,7 @@ ftdm_status_t copy_locPtyNum_to_sngss7(ftdm_channel_t *ftdmchan, SiCgPtyNum *loc
 
         locPtyNum->eh.pres = pres_val;
         locPtyNum->natAddrInd.pres = pres_val;
-        locPtyNum->natAddrInd.val = g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].loc_nadi;
+        locPtyNum->natAddrInd.val = sngss7_get_ckt(sngss7_info->circuit->id)->loc_nadi;
 
         locPtyNum->scrnInd.pres = pres_val;
 		val = ftdm_usrmsg_get_var(ftdmchan->usrmsg, "ss7_loc_screen_ind");
@@ -298,7 +301,7 @@ ftdm_status_t copy_locPtyNum_to_sngss7(ftdm_channel_t *ftdmchan, SiCgPtyNum *loc
 			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Location Reference NADI value \"%s\"\n", loc_nadi);
 			locPtyNum->natAddrInd.val = atoi(loc_nadi);
         } else {
-			locPtyNum->natAddrInd.val = g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].loc_nadi;
+			locPtyNum->natAddrInd.val = sngss7_get_ckt(sngss7_info->circuit->id)->loc_nadi;
 			ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied NADI value found for LOC, using \"%d\"\n", locPtyNum->natAddrInd.val);
 	}
 
@@ -329,7 +332,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"%s\"\n", val);
 		genNmb->nmbQual.val	= atoi(val);
 	} else {
-		genNmb->nmbQual.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_nmbqual;
+		genNmb->nmbQual.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_nmbqual;
 		ftdm_log_chan_msg(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \n");
 	}
 	genNmb->natAddrInd.pres = PRSNT_NODEF;
@@ -338,7 +341,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"nature of address\" \"%s\"\n", val);
 		genNmb->natAddrInd.val	= atoi(val);
 	} else {
-		genNmb->natAddrInd.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_nadi;
+		genNmb->natAddrInd.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_nadi;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \"nature of address\" \"%d\"\n", genNmb->natAddrInd.val);
 	}
 	genNmb->scrnInd.pres = PRSNT_NODEF;
@@ -347,7 +350,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"screening indicator\" \"%s\"\n", val);
 		genNmb->scrnInd.val	= atoi(val);
 	} else {
-		genNmb->natAddrInd.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_screen_ind;
+		genNmb->natAddrInd.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_screen_ind;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \"screening indicator\" \"%d\"\n", genNmb->natAddrInd.val);
 	}
 	genNmb->presRest.pres = PRSNT_NODEF;
@@ -356,7 +359,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"presentation indicator\" \"%s\"\n", val);
 		genNmb->presRest.val	= atoi(val);
 	} else {
-		genNmb->presRest.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_pres_ind;
+		genNmb->presRest.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_pres_ind;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \"presentation indicator\" \"%d\"\n", genNmb->presRest.val);
 	}
 	genNmb->numPlan.pres = PRSNT_NODEF;
@@ -365,7 +368,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"numbering plan\" \"%s\"\n", val);
 		genNmb->numPlan.val	= atoi(val);
 	} else {
-	genNmb->numPlan.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_npi;
+	genNmb->numPlan.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_npi;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \"numbering plan\" \"%d\"\n", genNmb->numPlan.val);
 	}
 	genNmb->niInd.pres = PRSNT_NODEF;
@@ -374,7 +377,7 @@ ftdm_status_t copy_genNmb_to_sngss7(ftdm_channel_t *ftdmchan, SiGenNum *genNmb)
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Found user supplied Generic Number \"number incomplete indicator\" \"%s\"\n", val);
 		genNmb->niInd.val	= atoi(val);
 	} else {
-		genNmb->niInd.val	= g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].gn_num_inc_ind;
+		genNmb->niInd.val	= sngss7_get_ckt(sngss7_info->circuit->id)->gn_num_inc_ind;
 		ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "No user supplied Generic Number \"number incomplete indicator\" \"%d\"\n", genNmb->niInd.val);
 	}
 	return FTDM_SUCCESS;
@@ -474,7 +477,7 @@ ftdm_status_t copy_redirgNum_to_sngss7(ftdm_channel_t *ftdmchan, SiRedirNum *red
 	if (!ftdm_strlen_zero(val)) {
 		redirgNum->natAddr.val = atoi(val);
 	} else {		
-		redirgNum->natAddr.val = g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].rdnis_nadi;
+		redirgNum->natAddr.val = sngss7_get_ckt(sngss7_info->circuit->id)->rdnis_nadi;
 	}
 	ftdm_log_chan(ftdmchan, FTDM_LOG_DEBUG, "Redirecting Number NADI:%d\n", redirgNum->natAddr.val);
 
@@ -1192,9 +1195,9 @@ ftdm_status_t copy_fwdCallInd_to_sngss7(ftdm_channel_t *ftdmchan, SiFwdCallInd *
 			fwdCallInd->isdnUsrPrtPrfInd.val 	= (fwdCallInd->isdnUsrPrtPrfInd.val==0x03)?0x0:fwdCallInd->isdnUsrPrtPrfInd.val;
 			fwdCallInd->isdnAccInd.val 		= val_hex & 0x1;
 			
-			if ((g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS88) ||
-				(g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS92) ||
-				(g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS95)) {
+			if ((sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS88) ||
+				(sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS92) ||
+				(sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS95)) {
 
 				/* include only if we're running ANSI */
 				fwdCallInd->transCallNInd.pres   = PRSNT_NODEF;
@@ -1224,9 +1227,9 @@ ftdm_status_t copy_fwdCallInd_to_sngss7(ftdm_channel_t *ftdmchan, SiFwdCallInd *
 
 	fwdCallInd->isdnAccInd.val 		= acc_val;
 
-	if ((g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS88) ||
-		(g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS92) ||
-		(g_ftdm_sngss7_data.cfg.isupCkt[sngss7_info->circuit->id].switchType == LSI_SW_ANS95)) {
+	if ((sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS88) ||
+		(sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS92) ||
+		(sngss7_get_ckt(sngss7_info->circuit->id)->switchType == LSI_SW_ANS95)) {
 
 		/* include only if we're running ANSI */
 		fwdCallInd->transCallNInd.pres   = PRSNT_NODEF;
@@ -1633,12 +1636,14 @@ int check_for_state_change(ftdm_channel_t *ftdmchan)
 /******************************************************************************/
 ftdm_status_t extract_chan_data(uint32_t circuit, sngss7_chan_data_t **sngss7_info, ftdm_channel_t **ftdmchan)
 {
-	if (!g_ftdm_sngss7_data.cfg.isupCkt[circuit].obj) {
+	sng_isup_ckt_t *ckt = sngss7_find_ckt(circuit);
+
+	if (!ckt || !ckt->obj) {
 		SS7_ERROR("No ss7 info for circuit #%d\n", circuit);
 		return FTDM_FAIL;
 	}
 
-	*sngss7_info = g_ftdm_sngss7_data.cfg.isupCkt[circuit].obj;
+	*sngss7_info = ckt->obj;
 
 	if (!(*sngss7_info)->ftdmchan) {
 		SS7_ERROR("No ftdmchan for circuit #%d\n", circuit);
@@ -1700,53 +1705,89 @@ unsigned long get_unique_id(void)
 }
 
 /******************************************************************************/
-ftdm_status_t check_if_rx_grs_started(ftdm_span_t *ftdmspan)
+static void sngss7_range_op_set_done(sngss7_range_op_t *op, uint32_t circuit)
 {
-	ftdm_iterator_t *iter = NULL;
-	ftdm_iterator_t *curr = NULL;
-	ftdm_channel_t *ftdmchan = NULL;
+	uint32_t bn = circuit - op->circuit;
+
+	if (!ftdm_map_test_bit(op->done, bn)) {
+		ftdm_map_set_bit(op->done, bn);
+		op->pending--;
+	}
+}
+
+/******************************************************************************/
+ftdm_status_t sngss7_range_op_start(ftdm_span_t *ftdmspan, uint32_t circuit, uint32_t range)
+{
+	sngss7_span_data_t *sngss7_span = ftdmspan->signal_data;
 	sngss7_chan_data_t *sngss7_info = NULL;
-	sngss7_chan_data_t *cinfo = NULL;
-	int i = 0;
+	ftdm_channel_t *ftdmchan = NULL;
+	sngss7_range_op_t *op = NULL;
+	uint32_t i;
 
-	iter = ftdm_span_get_chan_iterator(ftdmspan, NULL);
-	for (curr = iter; curr; curr = ftdm_iterator_next(curr)) {
-		ftdm_channel_t *fchan = ftdm_iterator_current(curr);
+	if (range >= SNGSS7_RANGE_OP_MAX_CKTS) {
+		SS7_ERROR("Invalid GRS range %d on circuit = %d\n", range, circuit);
+		return FTDM_FAIL;
+	}
 
-		ftdm_channel_lock(fchan);
-	
-		cinfo = fchan->call_data;
+	if (extract_chan_data(circuit, &sngss7_info, &ftdmchan)) {
+		SS7_ERROR("Failed to extract channel data for circuit = %d!\n", circuit);
+		return FTDM_FAIL;
+	}
 
-		if (!cinfo->rx_grs.range) {
-			ftdm_channel_unlock(fchan);
-			continue;
+	op = ftdm_calloc(1, sizeof(*op));
+	if (!op) {
+		return FTDM_ENOMEM;
+	}
+	op->base = sngss7_info;
+	op->circuit = circuit;
+	op->range = range;
+	for (i = circuit; i <= (circuit + range); i++) {
+		if (sngss7_get_ckt(i)->type == SNG_CKT_VOICE) {
+			op->members++;
 		}
+	}
+	op->pending = op->members;
 
-		SS7_INFO("Rx GRS (%d:%d)\n", 
-				g_ftdm_sngss7_data.cfg.isupCkt[cinfo->rx_grs.circuit].cic, 
-				(g_ftdm_sngss7_data.cfg.isupCkt[cinfo->rx_grs.circuit].cic + cinfo->rx_grs.range));
+	/* the reset is started by the next check_for_range_ops() pass */
+	op->next = sngss7_span->range_ops;
+	sngss7_span->range_ops = op;
 
-		for (i = cinfo->rx_grs.circuit; i < (cinfo->rx_grs.circuit + cinfo->rx_grs.range + 1); i++) {
+	ftdm_set_flag(sngss7_span, SNGSS7_RX_GRS_PENDING);
 
-			/* confirm this is a voice channel, otherwise we do nothing */ 
-			if (g_ftdm_sngss7_data.cfg.isupCkt[i].type != SNG_CKT_VOICE) {
-				continue;
-			} 
+	return FTDM_SUCCESS;
+}
 
-			/* extract the channel in question */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", i);
-				continue;
-			}
+/******************************************************************************/
+static void sngss7_range_op_begin(ftdm_span_t *ftdmspan, sngss7_range_op_t *op)
+{
+	ftdm_channel_t *ftdmchan = NULL;
+	sngss7_chan_data_t *sngss7_info = NULL;
+	uint32_t i = 0;
 
-			/* check if the GRP_RESET_RX flag is already up */
-			if (sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX)) {
-				/* we have already processed this channel...move along */
-				continue;
-			}
+	SS7_INFO("Rx GRS (%d:%d)\n", 
+			sngss7_get_ckt(op->circuit)->cic, 
+			(sngss7_get_ckt(op->circuit)->cic + op->range));
 
-			/* lock the channel */
-			ftdm_channel_lock(ftdmchan);
+	op->started = 1;
+
+	for (i = op->circuit; i <= (op->circuit + op->range); i++) {
+
+		/* confirm this is a voice channel, otherwise we do nothing */ 
+		if (sngss7_get_ckt(i)->type != SNG_CKT_VOICE) {
+			continue;
+		} 
+
+		/* extract the channel in question */
+		if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			SS7_ERROR("Failed to extract channel data for circuit = %d!\n", i);
+			continue;
+		}
+
+		/* lock the channel */
+		ftdm_channel_lock(ftdmchan);
+
+		/* check if the GRP_RESET_RX flag is already up */
+		if (!sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX)) {
 
 			/* clear up any pending state changes */
 			while (ftdm_test_flag (ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
@@ -1756,6 +1797,9 @@ ftdm_status_t check_if_rx_grs_started(ftdm_span_t *ftdmspan)
 			/* flag the channel as having received a reset */
 			sngss7_set_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX);
 
+			/* the member may sit on another span, it reports the end of its reset to this one */
+			sngss7_info->rx_grs_span = ftdmspan;
+
 			switch (ftdmchan->state) {
 			/**************************************************************************/
 			case FTDM_CHANNEL_STATE_RESTART:
@@ -1772,157 +1816,184 @@ ftdm_status_t check_if_rx_grs_started(ftdm_span_t *ftdmspan)
 				break;
 			/**************************************************************************/
 			}
+		}
 
-			/* unlock the channel again before we exit */
-			ftdm_channel_unlock(ftdmchan);
-
+		/* a circuit already reset by an overlapping GRS will not report again */
+		if (sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN)) {
+			sngss7_range_op_set_done(op, i);
 		}
 
-		ftdm_channel_unlock(fchan);
+		/* unlock the channel again before we exit */
+		ftdm_channel_unlock(ftdmchan);
 	}
-
-	ftdm_iterator_free(iter);
-
-	return FTDM_SUCCESS;
 }
 
 /******************************************************************************/
-ftdm_status_t check_if_rx_grs_processed(ftdm_span_t *ftdmspan)
+static void sngss7_range_op_finish(sngss7_range_op_t *op)
 {
-	ftdm_iterator_t *iter = NULL;
-	ftdm_iterator_t *curr = NULL;
 	ftdm_channel_t *ftdmchan = NULL;
 	sngss7_chan_data_t *sngss7_info = NULL;
-	sngss7_chan_data_t *cinfo = NULL;
-	int i = 0, bn = 0;
+	sngss7_chan_data_t *cinfo = op->base;
+	ftdm_bitmap_t lockmap[ftdm_array_len(op->done)];
+	uint32_t i = 0, bn = 0;
 	int byte = 0, bit = 0;
-	int cic_start = 0, cic_end = 0, num_cics = 0;
-	ftdm_bitmap_t *lockmap = 0;
-	ftdm_size_t mapsize = 0;
-
-	iter = ftdm_span_get_chan_iterator(ftdmspan, NULL);
-	for (curr = iter; curr; curr = ftdm_iterator_next(curr)) {
-		ftdm_channel_t *fchan = ftdm_iterator_current(curr);
+	int ready = 1;
 
-		ftdm_channel_lock(fchan);
-
-		cinfo = fchan->call_data;
+	memset(lockmap, 0, sizeof(lockmap));
 
-		if (!cinfo->rx_grs.range) {
-
-			ftdm_channel_unlock(fchan);
+	/* lock all the members, they are moved to DOWN together */
+	for (i = op->circuit, bn = 0; i <= (op->circuit + op->range); i++, bn++) {
 
+		/* confirm this is a voice channel, otherwise we do nothing */ 
+		if (sngss7_get_ckt(i)->type != SNG_CKT_VOICE) {
 			continue;
 		}
 
-		cic_start = cinfo->rx_grs.circuit;
-		cic_end = cinfo->rx_grs.circuit + cinfo->rx_grs.range;
-		num_cics = cinfo->rx_grs.range + 1;
-		mapsize = (num_cics / FTDM_BITMAP_NBITS) + 1;
+		/* extract the channel in question */
+		if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			SS7_ERROR("Failed to extract channel data for circuit = %d!\n", i);
+			ftdm_assert(FTDM_FALSE, "Failed to extract channel data during GRS\n");
+			continue;
+		}
 
-		lockmap = ftdm_calloc(mapsize, sizeof(*lockmap));
-		if (!lockmap) {
-			ftdm_channel_unlock(fchan);
-			return FTDM_ENOMEM;
+		/* lock the channel */
+		ftdm_channel_lock(ftdmchan);
+		ftdm_map_set_bit(lockmap, bn);
+
+		/* check if there is a state change pending on the channel */
+		if (ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
+			/* try again on the next pass */
+			ready = 0;
+		} else if (!sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN)) {
+			/* the reset of this circuit was restarted, wait for it to report again */
+			ftdm_map_clear_bit(op->done, bn);
+			op->pending++;
+			ready = 0;
 		}
+	}
 
-		/* check all the circuits in the range to see if they are done resetting */
-		for (i = cic_start, bn = 0; i <= cic_end; i++, bn++) {
+	if (!ready) {
+		goto GRS_UNLOCK_ALL;
+	}
 
-			/* confirm this is a voice channel, otherwise we do nothing */ 
-			if (g_ftdm_sngss7_data.cfg.isupCkt[i].type != SNG_CKT_VOICE) {
-				continue;
-			}
+	SS7_DEBUG("All circuits out of reset for GRS: circuit=%d, range=%d\n", op->circuit, op->range);
+	for (i = op->circuit; i <= (op->circuit + op->range); i++) {
 
-			/* extract the channel in question */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", i);
-				ftdm_assert(FTDM_FALSE, "Failed to extract channel data during GRS\n");
-				continue;
-			}
+		/* confirm this is a voice channel, otherwise we do nothing */ 
+		if (sngss7_get_ckt(i)->type != SNG_CKT_VOICE) {
+			continue;
+		}
 
-			/* lock the channel */
-			ftdm_channel_lock(ftdmchan);
-			ftdm_map_set_bit(lockmap, bn);
-
-			/* check if there is a state change pending on the channel */
-			if (!ftdm_test_flag(ftdmchan, FTDM_CHANNEL_STATE_CHANGE)) {
-				/* check the state to the GRP_RESET_RX_DN flag */
-				if (!sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN)) {
-					/* this channel is still resetting...do nothing */
-					goto GRS_UNLOCK_ALL;
-				} /* if (!sngss7_test_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN)) */
-			} else {
-				/* state change pending */
-				goto GRS_UNLOCK_ALL;
-			}
+		/* extract the channel in question */
+		if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			continue;
+		}
+
+		/* throw the GRP reset flag complete flag */
+		sngss7_set_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_CMPLT);
+
+		/* move the channel to the down state */
+		ftdm_set_state(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
 
+		/* update the status map if the ckt is in blocked state */
+		if ((sngss7_test_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_RX)) ||
+			(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_TX)) ||
+			(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_GRP_MN_BLOCK_RX)) ||
+			(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_GRP_MN_BLOCK_RX))) {
+		
+			cinfo->rx_grs.status[byte] = (cinfo->rx_grs.status[byte] | (1 << bit));
 		}
 
-		SS7_DEBUG("All circuits out of reset for GRS: circuit=%d, range=%d\n", cinfo->rx_grs.circuit, cinfo->rx_grs.range);
-		for (i = cic_start; i <= cic_end; i++) {
+		/* update the bit and byte counter*/
+		bit ++;
+		if (bit == 8) {
+			byte++;
+			bit = 0;
+		}
+	}
 
-			/* confirm this is a voice channel, otherwise we do nothing */ 
-			if (g_ftdm_sngss7_data.cfg.isupCkt[i].type != SNG_CKT_VOICE) {
-				continue;
-			}
+	/* the GRA goes out once the base circuit reaches DOWN */
+	op->finished = 1;
 
-			/* extract the channel in question */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n",i);
-				ftdm_assert(FTDM_FALSE, "Failed to extract channel data during GRS\n");
-				continue;
-			}
+GRS_UNLOCK_ALL:
+	for (i = op->circuit, bn = 0; i <= (op->circuit + op->range); i++, bn++) {
+		if (!ftdm_map_test_bit(lockmap, bn)) {
+			continue;
+		}
 
-			/* throw the GRP reset flag complete flag */
-			sngss7_set_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_CMPLT);
+		/* extract the channel in question */
+		if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
+			continue;
+		}
 
-			/* move the channel to the down state */
-			ftdm_set_state(ftdmchan, FTDM_CHANNEL_STATE_DOWN);
+		/* unlock the channel */
+		ftdm_channel_unlock(ftdmchan);
+	}
+}
 
-			/* update the status map if the ckt is in blocked state */
-			if ((sngss7_test_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_RX)) ||
-				(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_CKT_MN_BLOCK_TX)) ||
-				(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_GRP_MN_BLOCK_RX)) ||
-				(sngss7_test_ckt_blk_flag(sngss7_info, FLAG_GRP_MN_BLOCK_RX))) {
-			
-				cinfo->rx_grs.status[byte] = (cinfo->rx_grs.status[byte] | (1 << bit));
-			}
+/******************************************************************************/
+ftdm_status_t check_for_range_ops(ftdm_span_t *ftdmspan)
+{
+	sngss7_span_data_t	*sngss7_span = ftdmspan->signal_data;
+	sngss7_range_op_t	**link = NULL;
+	sngss7_range_op_t	*op = NULL;
+	uint32_t			bits;
+	uint32_t			w;
+	uint32_t			b;
+	uint32_t			circuit;
+
+	/* drop the operations cleared by clear_rx_grs_data(), the GRA went out or the reset was abandoned */
+	for (link = &sngss7_span->range_ops; (op = *link); ) {
+		if (!op->base->rx_grs.range) {
+			*link = op->next;
+			ftdm_safe_free(op);
+			continue;
+		}
+		link = &op->next;
+	}
 
-			/* update the bit and byte counter*/
-			bit ++;
-			if (bit == 8) {
-				byte++;
-				bit = 0;
-			}
+	if (!sngss7_span->range_ops) {
+		ftdm_clear_flag(sngss7_span, SNGSS7_RX_GRS_PENDING);
+		return FTDM_SUCCESS;
+	}
 
+	/* move the members of the new operations to RESTART */
+	for (op = sngss7_span->range_ops; op; op = op->next) {
+		if (!op->started) {
+			sngss7_range_op_begin(ftdmspan, op);
 		}
-GRS_UNLOCK_ALL:
-		for (i = cic_start, bn = 0; i <= cic_end; i++, bn++) {
-			/* confirm this is a voice channel, otherwise we do nothing */ 
-			if (g_ftdm_sngss7_data.cfg.isupCkt[i].type != SNG_CKT_VOICE) {
-				continue;
-			}
+	}
 
-			/* extract the channel in question */
-			if (extract_chan_data(i, &sngss7_info, &ftdmchan)) {
-				SS7_ERROR("Failed to extract channel data for circuit = %d!\n", i);
-				ftdm_assert(FTDM_FALSE, "Failed to extract channel data during GRS\n");
+	/* credit the members that finished their reset since the last pass */
+	if (ftdm_atomic_xchg32(&sngss7_span->range_done, 0)) {
+		for (w = 0; w < ftdm_array_len(sngss7_span->range_done_ckts); w++) {
+			if (!sngss7_span->range_done_ckts[w]) {
 				continue;
 			}
-			if (ftdm_map_test_bit(lockmap, bn)) {
-				/* unlock the channel */
-				ftdm_channel_unlock(ftdmchan);
-				ftdm_map_clear_bit(lockmap, bn);
-			}
-		}
+			bits = ftdm_atomic_xchg32(&sngss7_span->range_done_ckts[w], 0);
 
-		ftdm_safe_free(lockmap);
+			for (b = 0; bits; b++, bits >>= 1) {
+				if (!(bits & 1)) {
+					continue;
+				}
 
-		ftdm_channel_unlock(fchan);
+				circuit = (g_ftdm_sngss7_data.cfg.procId * MAX_CIC_MAP_LENGTH) + (w * 32) + b;
+				for (op = sngss7_span->range_ops; op; op = op->next) {
+					if (op->started && !op->finished &&
+						circuit >= op->circuit && circuit <= (op->circuit + op->range)) {
+						sngss7_range_op_set_done(op, circuit);
+					}
+				}
+			}
+		}
 	}
 
-	ftdm_iterator_free(iter);
+	/* move the members of the completed operations to DOWN */
+	for (op = sngss7_span->range_ops; op; op = op->next) {
+		if (op->started && !op->finished && !op->pending) {
+			sngss7_range_op_finish(op);
+		}
+	}
 
 	return FTDM_SUCCESS;
 }
@@ -1953,13 +2024,13 @@ ftdm_status_t check_if_rx_gra_started(ftdm_span_t *ftdmspan)
 		}
 
 		SS7_INFO("Rx GRA (%d:%d)\n", 
-				g_ftdm_sngss7_data.cfg.isupCkt[cinfo->rx_gra.circuit].cic, 
-				(g_ftdm_sngss7_data.cfg.isupCkt[cinfo->rx_gra.circuit].cic + cinfo->rx_gra.range));
+				sngss7_get_ckt(cinfo->rx_gra.circuit)->cic, 
+				(sngss7_get_ckt(cinfo->rx_gra.circuit)->cic + cinfo->rx_gra.range));
 
 		for (i = cinfo->rx_gra.circuit; i < (cinfo->rx_gra.circuit + cinfo->rx_gra.range + 1); i++) {
 
 			/* confirm this is a voice channel, otherwise we do nothing */ 
-			if (g_ftdm_sngss7_data.cfg.isupCkt[i].type != SNG_CKT_VOICE) {
+			if (sngss7_get_ckt(i)->type != SNG_CKT_VOICE) {
 				continue;
 			} 
 
@@ -2037,14 +2108,36 @@ ftdm_status_t check_if_rx_gra_started(ftdm_span_t *ftdmspan)
 }
 
 /******************************************************************************/
-ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan)
+/* the next channel after chan_id in the circuits of the current check_for_dirty_ckts() pass, 0 at the end */
+static uint32_t sngss7_next_dirty_ckt(ftdm_span_t *ftdmspan, uint32_t chan_id)
+{
+	sngss7_span_data_t	*sngss7_span = ftdmspan->signal_data;
+	uint32_t			bits;
+
+	for (chan_id++; chan_id <= ftdmspan->chan_count; chan_id++) {
+		bits = sngss7_span->dirty_pass[chan_id / 32] >> (chan_id % 32);
+		if (!bits) {
+			/* nothing left in this word */
+			chan_id |= 31;
+			continue;
+		}
+		if (bits & 1) {
+			return chan_id;
+		}
+	}
+
+	return 0;
+}
+
+/******************************************************************************/
+static ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan)
 {
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_chan_data_t	*sngss7_info = NULL;
 	ftdm_sigmsg_t 		sigev;
 	int 				x;
 
-	for (x = 1; x < (ftdmspan->chan_count + 1); x++) {
+	for (x = sngss7_next_dirty_ckt(ftdmspan, 0); x; x = sngss7_next_dirty_ckt(ftdmspan, x)) {
 
 		/* extract the channel structure and sngss7 channel data */
 		ftdmchan = ftdmspan->channels[x];
@@ -2093,7 +2186,46 @@ ftdm_status_t check_for_res_sus_flag(ftdm_span_t *ftdmspan)
 		/* unlock the channel */
 		ftdm_mutex_unlock(ftdmchan->mutex);
 
-	} /* for (x = 1; x < (span->chan_count + 1); x++) */
+	} /* for each circuit of this pass */
+
+	return FTDM_SUCCESS;
+}
+
+/******************************************************************************/
+/* Only the circuits flagged through sngss7_set_ckt_flag() since the last pass are visited.
+ * The circuits whose SUS/RES or reconfiguration is not done yet are queued again for the next pass */
+ftdm_status_t check_for_dirty_ckts(ftdm_span_t *ftdmspan)
+{
+	sngss7_span_data_t	*sngss7_span = ftdmspan->signal_data;
+	ftdm_channel_t		*ftdmchan = NULL;
+	sngss7_chan_data_t	*sngss7_info = NULL;
+	uint32_t			chan_id;
+	uint32_t			w;
+
+	if (ftdm_atomic_xchg32(&sngss7_span->dirty, 0)) {
+		for (w = 0; w < ftdm_array_len(sngss7_span->dirty_ckts); w++) {
+			sngss7_span->dirty_pass[w] = sngss7_span->dirty_ckts[w] ? ftdm_atomic_xchg32(&sngss7_span->dirty_ckts[w], 0) : 0;
+		}
+
+		/* check each flagged channel to see if there is an un-procressed SUS/RES flag */
+		check_for_res_sus_flag(ftdmspan);
+
+		/* check each flagged channel to see if it needs to be reconfigured */
+		check_for_reconfig_flag(ftdmspan);
+
+		for (chan_id = sngss7_next_dirty_ckt(ftdmspan, 0); chan_id; chan_id = sngss7_next_dirty_ckt(ftdmspan, chan_id)) {
+			ftdmchan = ftdmspan->channels[chan_id];
+			if (!(sngss7_info = ftdmchan->call_data)) {
+				continue;
+			}
+
+			/* a PAUSED circuit only needs work while its sig status is still up */
+			if (sngss7_test_ckt_flag(sngss7_info, (FLAG_INFID_RESUME | FLAG_CKT_RECONFIG)) ||
+				(sngss7_test_ckt_flag(sngss7_info, FLAG_INFID_PAUSED) && ftdm_test_flag(ftdmchan, FTDM_CHANNEL_SIG_UP))) {
+				sngss7_mark_ckt_dirty(sngss7_info);
+			}
+		}
+	}
 
 	/* signal the core that sig events are queued for processing */
 	ftdm_span_trigger_signals(ftdmspan);
@@ -2175,6 +2307,7 @@ ftdm_status_t clear_rx_grs_flags(sngss7_chan_data_t *sngss7_info)
 	sngss7_clear_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX);
 	sngss7_clear_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_DN);
 	sngss7_clear_ckt_flag(sngss7_info, FLAG_GRP_RESET_RX_CMPLT);
+	sngss7_info->rx_grs_span = NULL;
 
 	return FTDM_SUCCESS;
 }
@@ -2182,37 +2315,9 @@ ftdm_status_t clear_rx_grs_flags(sngss7_chan_data_t *sngss7_info)
 /******************************************************************************/
 ftdm_status_t clear_rx_grs_data(sngss7_chan_data_t *sngss7_info)
 {
-	ftdm_iterator_t *iter = NULL;
-	ftdm_iterator_t *curr = NULL;
-	sngss7_chan_data_t *cinfo = NULL;
-	ftdm_channel_t *ftdmchan = sngss7_info->ftdmchan;
-	sngss7_span_data_t *sngss7_span = (sngss7_span_data_t *)ftdmchan->span->signal_data;
-
+	/* the range operation based on this circuit is dropped by the next check_for_range_ops() pass */
 	memset(&sngss7_info->rx_grs, 0, sizeof(sngss7_info->rx_grs));
 
-	iter = ftdm_span_get_chan_iterator(ftdmchan->span, NULL);
-	curr = iter;
-	for (curr = iter; curr; curr = ftdm_iterator_next(curr)) {
-		ftdm_channel_t *fchan = ftdm_iterator_current(curr);
-
-		ftdm_channel_lock(fchan);
-
-		cinfo = fchan->call_data;
-		if (cinfo->rx_grs.range) {
-			/* there is still another grs pending, do not clear the SNGSS7_RX_GRS_PENDING flag yet */
-			ftdm_channel_unlock(fchan);
-			goto done;
-		}
-
-		ftdm_channel_unlock(fchan);
-	}
-
-	/* if we're here is because there is no other grs going on now in this span */
-	ftdm_clear_flag(sngss7_span, SNGSS7_RX_GRS_PENDING);
-
-done:
-	ftdm_iterator_free(iter);
-
 	return FTDM_SUCCESS;
 }
 
@@ -2859,7 +2964,7 @@ ftdm_status_t check_for_invalid_states(ftdm_channel_t *ftmchan)
 	
 
 /******************************************************************************/
-ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan)
+static ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan)
 {
 	ftdm_channel_t		*ftdmchan = NULL;
 	sngss7_chan_data_t	*sngss7_info = NULL;
@@ -2872,7 +2977,7 @@ ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan)
 	int					ret;
 	ret=0;
 
-	for (x = 1; x < (ftdmspan->chan_count + 1); x++) {
+	for (x = sngss7_next_dirty_ckt(ftdmspan, 0); x; x = sngss7_next_dirty_ckt(ftdmspan, x)) {
 	/**************************************************************************/
 		/* extract the channel structure and sngss7 channel data */
 		ftdmchan = ftdmspan->channels[x];
@@ -3066,7 +3171,7 @@ ftdm_status_t check_for_reconfig_flag(ftdm_span_t *ftdmspan)
 			sngss7_clear_ckt_flag(sngss7_info, FLAG_CKT_RECONFIG);
 
 		} 
-	} /* for (x = 1; x < (span->chan_count + 1); x++) */
+	} /* for each circuit of this pass */
 
 	return FTDM_SUCCESS;
 }
@@ -3401,6 +3506,301 @@ done:
 #endif
 }
 
+
+/******************************************************************************/
+static sng_isup_ckt_t **sngss7_ckt_map_slot(sng_isup_ckt_map_t *map, uint32_t key)
+{
+	uint32_t page = key >> SNGSS7_CKT_PAGE_BITS;
+
+	if (page >= map->num_pages) {
+		sng_isup_ckt_t ***pages;
+		uint32_t num_pages = map->num_pages ? map->num_pages : 4;
+
+		while (num_pages <= page) {
+			num_pages *= 2;
+		}
+		pages = ftdm_realloc(map->pages, num_pages * sizeof(*pages));
+		if (!pages) {
+			return NULL;
+		}
+		memset(&pages[map->num_pages], 0, (num_pages - map->num_pages) * sizeof(*pages));
+		map->pages = pages;
+		map->num_pages = num_pages;
+	}
+
+	if (!map->pages[page]) {
+		map->pages[page] = ftdm_calloc(SNGSS7_CKT_PAGE_SIZE, sizeof(sng_isup_ckt_t *));
+		if (!map->pages[page]) {
+			return NULL;
+		}
+	}
+
+	return &map->pages[page][key & SNGSS7_CKT_PAGE_MASK];
+}
+
+static void sngss7_ckt_map_free(sng_isup_ckt_map_t *map)
+{
+	uint32_t i;
+
+	for (i = 0; i < map->num_pages; i++) {
+		ftdm_safe_free(map->pages[i]);
+	}
+	ftdm_safe_free(map->pages);
+	map->pages = NULL;
+	map->num_pages = 0;
+}
+
+/******************************************************************************/
+sng_isup_ckt_t *sngss7_add_ckt(uint32_t id)
+{
+	sng_isup_ckt_table_t *table = &g_ftdm_sngss7_data.cfg.isupCkt;
+	sng_isup_ckt_t **slot = NULL;
+	sng_isup_ckt_t *ckt = NULL;
+	uint32_t pos;
+
+	if (!id) {
+		/* id 0 is the end of list marker */
+		return NULL;
+	}
+
+	if (!(slot = sngss7_ckt_map_slot(&table->by_id, id))) {
+		return NULL;
+	}
+
+	if (*slot) {
+		/* reconfiguration, the circuit keeps its address */
+		return *slot;
+	}
+
+	if (table->count == table->size) {
+		uint32_t size = table->size ? table->size * 2 : 64;
+		sng_isup_ckt_t **list = ftdm_realloc(table->list, size * sizeof(*list));
+		if (!list) {
+			return NULL;
+		}
+		table->list = list;
+		table->size = size;
+	}
+
+	if (!(ckt = ftdm_calloc(1, sizeof(*ckt)))) {
+		return NULL;
+	}
+
+	/* circuits are mostly configured in id order, look for the insert position from the end */
+	pos = table->count;
+	while (pos > 0 && table->list[pos - 1]->id > id) {
+		pos--;
+	}
+	memmove(&table->list[pos + 1], &table->list[pos], (table->count - pos) * sizeof(*table->list));
+	table->list[pos] = ckt;
+	table->count++;
+
+	ckt->id = id;
+	*slot = ckt;
+
+	return ckt;
+}
+
+/******************************************************************************/
+/* index in the circuit list of the first circuit with an id >= id */
+uint32_t sngss7_ckt_lower_bound(uint32_t id)
+{
+	sng_isup_ckt_table_t *table = &g_ftdm_sngss7_data.cfg.isupCkt;
+	uint32_t low = 0;
+	uint32_t high = table->count;
+
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+
+		if (table->list[mid]->id < id) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/******************************************************************************/
+void sngss7_free_ckts(void)
+{
+	sng_isup_ckt_table_t *table = &g_ftdm_sngss7_data.cfg.isupCkt;
+	uint32_t i;
+
+	for (i = 0; i < table->count; i++) {
+		ftdm_safe_free(table->list[i]);
+	}
+	ftdm_safe_free(table->list);
+	sngss7_ckt_map_free(&table->by_id);
+	memset(table, 0, sizeof(*table));
+}
+
+/******************************************************************************/
+ftdm_status_t sngss7_event_pool_create(sngss7_event_pool_t *pool, uint32_t size)
+{
+	uint32_t i;
+
+	memset(pool, 0, sizeof(*pool));
+
+	pool->events = ftdm_calloc(size, sizeof(*pool->events));
+	if (!pool->events) {
+		return FTDM_FAIL;
+	}
+	pool->size = size;
+
+	for (i = 0; i < size; i++) {
+		pool->events[i].pool = pool;
+		pool->events[i].next = (i + 1 < size) ? &pool->events[i + 1] : NULL;
+	}
+	pool->free = pool->events;
+
+	return FTDM_SUCCESS;
+}
+
+/******************************************************************************/
+static sngss7_event_data_t *sngss7_event_get(sngss7_event_pool_t *pool)
+{
+	sngss7_event_data_t *event = pool->free;
+
+	if (!event) {
+		/* take back everything released so far in one go, the returned list only ever
+		 * loses all of its entries at once so there is no ABA to care about */
+		do {
+			event = ftdm_atomic_get_ptr(&pool->returned);
+		} while (event && !ftdm_atomic_cas_ptr(&pool->returned, event, NULL));
+	}
+
+	if (event) {
+		pool->free = event->next;
+		ftdm_atomic_inc32(&pool->in_use);
+	} else {
+		ftdm_atomic_inc32(&pool->exhausted);
+		event = ftdm_malloc(sizeof(*event));
+		if (!event) {
+			return NULL;
+		}
+		event->pool = NULL;
+	}
+	pool->allocs++;
+	event->next = NULL;
+
+	return event;
+}
+
+/* the event payload is left to the caller to fill */
+sngss7_event_data_t *sngss7_event_alloc(sngss7_event_pool_t *pool)
+{
+	sngss7_event_data_t *event = sngss7_event_get(pool);
+
+	if (event) {
+		memset(&event->event_id, 0, offsetof(sngss7_event_data_t, event) - offsetof(sngss7_event_data_t, event_id));
+	}
+	return event;
+}
+
+/******************************************************************************/
+sngss7_event_data_t *sngss7_event_clone(sngss7_event_pool_t *pool, const sngss7_event_data_t *event)
+{
+	sngss7_event_data_t *clone = sngss7_event_get(pool);
+
+	if (clone) {
+		memcpy(&clone->event_id, &event->event_id, sizeof(*event) - offsetof(sngss7_event_data_t, event_id));
+	}
+	return clone;
+}
+
+/******************************************************************************/
+void sngss7_event_free(sngss7_event_data_t *event)
+{
+	sngss7_event_pool_t *pool;
+	void *head;
+
+	if (!event) {
+		return;
+	}
+
+	if (!(pool = event->pool)) {
+		ftdm_free(event);
+		return;
+	}
+
+	do {
+		head = ftdm_atomic_get_ptr(&pool->returned);
+		event->next = head;
+	} while (!ftdm_atomic_cas_ptr(&pool->returned, head, event));
+	ftdm_atomic_dec32(&pool->in_use);
+}
+
+/******************************************************************************/
+void sngss7_enqueue_stack_event(sngss7_chan_data_t *sngss7_info, sngss7_event_data_t *sngss7_event)
+{
+	sngss7_span_data_t *sngss7_span = sngss7_info->ftdmchan->span->signal_data;
+
+	if (ftdm_queue_enqueue(sngss7_span->event_queue, sngss7_event) != FTDM_SUCCESS) {
+		SS7_ERROR("[CIC:%d]Failed to enqueue stack event %d, dropping it!\n",
+					sngss7_info->circuit->cic, sngss7_event->event_id);
+		sngss7_event_free(sngss7_event);
+	}
+}
+
+/******************************************************************************/
+void sngss7_event_pools_show(ftdm_stream_handle_t *stream)
+{
+	ftdm_iterator_t *iter = ftdm_get_span_iterator(NULL);
+	ftdm_iterator_t *cur = NULL;
+
+	stream->write_function(stream, "%-16s %-6s %6s %6s %14s %10s\n", "span", "pool", "size", "in use", "allocs", "exhausted");
+	for (cur = iter; cur; cur = ftdm_iterator_next(cur)) {
+		ftdm_span_t *span = ftdm_iterator_current(cur);
+		sngss7_span_data_t *sngss7_span = NULL;
+		int i;
+
+		if (!span || span->signal_type != FTDM_SIGTYPE_SS7 || !(sngss7_span = span->signal_data)) {
+			continue;
+		}
+		for (i = 0; i < 2; i++) {
+			sngss7_event_pool_t *pool = i ? &sngss7_span->clone_pool : &sngss7_span->ind_pool;
+			stream->write_function(stream, "%-16s %-6s %6u %6u %14"FTDM_UINT64_FMT" %10u\n",
+									span->name, i ? "clone" : "ind", pool->size,
+									ftdm_atomic_get32(&pool->in_use), pool->allocs,
+									ftdm_atomic_get32(&pool->exhausted));
+		}
+	}
+	ftdm_iterator_free(iter);
+}
+
+/******************************************************************************/
+void sngss7_event_pools_collector(ftdm_stream_handle_t *stream, void *data)
+{
+	static const char *names[] = { "freetdm_ss7_event_pool_allocs", "freetdm_ss7_event_pool_exhausted", "freetdm_ss7_event_pool_in_use" };
+	static const char *helps[] = { "SS7 stack events allocated", "SS7 stack events allocated from the heap because the pool was empty",
+									"SS7 stack events from the pool not released yet" };
+	ftdm_iterator_t *iter = NULL;
+	ftdm_iterator_t *cur = NULL;
+	int m, i;
+
+	for (m = 0; m < 3; m++) {
+		ftdm_metrics_render_family(stream, names[m], m < 2 ? FTDM_METRIC_COUNTER : FTDM_METRIC_GAUGE, helps[m]);
+		iter = ftdm_get_span_iterator(iter);
+		for (cur = iter; cur; cur = ftdm_iterator_next(cur)) {
+			ftdm_span_t *span = ftdm_iterator_current(cur);
+			sngss7_span_data_t *sngss7_span = NULL;
+
+			if (!span || span->signal_type != FTDM_SIGTYPE_SS7 || !(sngss7_span = span->signal_data)) {
+				continue;
+			}
+			for (i = 0; i < 2; i++) {
+				sngss7_event_pool_t *pool = i ? &sngss7_span->clone_pool : &sngss7_span->ind_pool;
+				uint64_t value = m == 0 ? pool->allocs : m == 1 ? ftdm_atomic_get32(&pool->exhausted) : ftdm_atomic_get32(&pool->in_use);
+				stream->write_function(stream, "%s%s{span=\"%s\",pool=\"%s\"} %"FTDM_UINT64_FMT"\n",
+										names[m], m < 2 ? "_total" : "", span->name, i ? "clone" : "ind", value);
+			}
+		}
+	}
+	ftdm_iterator_free(iter);
+}
+
 /******************************************************************************/
 /* For Emacs:
  * Local Variables:
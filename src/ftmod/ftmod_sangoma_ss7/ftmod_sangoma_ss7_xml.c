@@ -3014,6 +3014,7 @@ static int ftmod_ss7_fill_in_ccSpan(sng_ccSpan_t *ccSpan)
 {
 	sng_timeslot_t		timeslot;
 	sngss7_chan_data_t	*ss7_info = NULL;
+	sng_isup_ckt_t		*ckt = NULL;
 	int					x;
 	int					count = 1;
 	int					flag;
@@ -3033,7 +3034,7 @@ static int ftmod_ss7_fill_in_ccSpan(sng_ccSpan_t *ccSpan)
 		while (flag == 0) {
 		/**********************************************************************/
 			/* check the id value ( 0 = new, 0 > circuit can be existing) */
-			if (g_ftdm_sngss7_data.cfg.isupCkt[x].id == 0) {
+			if (sngss7_get_ckt(x)->id == 0) {
 				/* we're at the end of the list of circuitsl aka this is new */
 				SS7_DEBUG("Found a new circuit %d, ccSpanId=%d, chan=%d\n",
 							x, 
@@ -3044,8 +3045,8 @@ static int ftmod_ss7_fill_in_ccSpan(sng_ccSpan_t *ccSpan)
 				flag = 1;
 			} else {
 				/* check the ccspan.id and chan to see if the circuit already exists */
-				if ((g_ftdm_sngss7_data.cfg.isupCkt[x].ccSpanId == ccSpan->id) &&
-					(g_ftdm_sngss7_data.cfg.isupCkt[x].chan == count)) {
+				if ((sngss7_get_ckt(x)->ccSpanId == ccSpan->id) &&
+					(sngss7_get_ckt(x)->chan == count)) {
 
 					/* we are processing a circuit that already exists */
 					SS7_DEVEL_DEBUG("Found an existing circuit %d, ccSpanId=%d, chan%d\n",
@@ -3067,121 +3068,127 @@ static int ftmod_ss7_fill_in_ccSpan(sng_ccSpan_t *ccSpan)
 		/**********************************************************************/
 		} /* while (flag == 0) */
 
+		/* allocate the circuit in the global table */
+		if (!(ckt = sngss7_add_ckt(x))) {
+			SS7_CRITICAL("Failed to allocate circuit %d!\n", x);
+			return FTDM_FAIL;
+		}
+
 		/* prepare the global info sturcture */
 		ss7_info = ftdm_calloc(1, sizeof(sngss7_chan_data_t));
 		ss7_info->ftdmchan = NULL;
 		if (ftdm_queue_create(&ss7_info->event_queue, SNGSS7_CHAN_EVENT_QUEUE_SIZE) != FTDM_SUCCESS) {
 			SS7_CRITICAL("Failed to create ss7 cic event queue\n");
 		}
-		ss7_info->circuit = &g_ftdm_sngss7_data.cfg.isupCkt[x];
+		ss7_info->circuit = ckt;
 
-		g_ftdm_sngss7_data.cfg.isupCkt[x].obj			= ss7_info;
+		ckt->obj			= ss7_info;
 
 		/* fill in the rest of the global structure */
-		g_ftdm_sngss7_data.cfg.isupCkt[x].procId	  	= ccSpan->procId;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].id		  	= x;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].ccSpanId		= ccSpan->id;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].span			= 0;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].chan			= count;
+		ckt->procId	  	= ccSpan->procId;
+		ckt->id		  	= x;
+		ckt->ccSpanId		= ccSpan->id;
+		ckt->span			= 0;
+		ckt->chan			= count;
 
 		if (timeslot.siglink) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].type		= SNG_CKT_SIG;
+			ckt->type		= SNG_CKT_SIG;
 		} else if (timeslot.gap) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].type		= SNG_CKT_HOLE;
+			ckt->type		= SNG_CKT_HOLE;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].type		= SNG_CKT_VOICE;
+			ckt->type		= SNG_CKT_VOICE;
 			
 			/* throw the flag to indicate that we need to start call control */
 			sngss7_set_flag(&g_ftdm_sngss7_data.cfg, SNGSS7_CC_PRESENT);
 		}
 
 		if (timeslot.channel) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].cic		= ccSpan->cicbase;
+			ckt->cic		= ccSpan->cicbase;
 			ccSpan->cicbase++;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].cic		= 0;
+			ckt->cic		= 0;
 		}
 
-		g_ftdm_sngss7_data.cfg.isupCkt[x].infId						= ccSpan->isupInf;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].typeCntrl					= ccSpan->typeCntrl;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].ssf						= ccSpan->ssf;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].cld_nadi					= ccSpan->cld_nadi;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].clg_nadi					= ccSpan->clg_nadi;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].rdnis_nadi					= ccSpan->rdnis_nadi;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].loc_nadi					= ccSpan->loc_nadi;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].options					= ccSpan->options;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].switchType					= ccSpan->switchType;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].min_digits					= ccSpan->min_digits;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].itx_auto_reply				= ccSpan->itx_auto_reply;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].transparent_iam				= ccSpan->transparent_iam;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].transparent_iam_max_size		= ccSpan->transparent_iam_max_size;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].cpg_on_progress_media			= ccSpan->cpg_on_progress_media;
-		g_ftdm_sngss7_data.cfg.isupCkt[x].cpg_on_progress	 		    = ccSpan->cpg_on_progress;
+		ckt->infId						= ccSpan->isupInf;
+		ckt->typeCntrl					= ccSpan->typeCntrl;
+		ckt->ssf						= ccSpan->ssf;
+		ckt->cld_nadi					= ccSpan->cld_nadi;
+		ckt->clg_nadi					= ccSpan->clg_nadi;
+		ckt->rdnis_nadi					= ccSpan->rdnis_nadi;
+		ckt->loc_nadi					= ccSpan->loc_nadi;
+		ckt->options					= ccSpan->options;
+		ckt->switchType					= ccSpan->switchType;
+		ckt->min_digits					= ccSpan->min_digits;
+		ckt->itx_auto_reply				= ccSpan->itx_auto_reply;
+		ckt->transparent_iam				= ccSpan->transparent_iam;
+		ckt->transparent_iam_max_size		= ccSpan->transparent_iam_max_size;
+		ckt->cpg_on_progress_media			= ccSpan->cpg_on_progress_media;
+		ckt->cpg_on_progress	 		    = ccSpan->cpg_on_progress;
 
 		if (ccSpan->t3 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t3			= 1200;
+			ckt->t3			= 1200;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t3			= ccSpan->t3;
+			ckt->t3			= ccSpan->t3;
 		}
 		if (ccSpan->t10 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t10		= 50;
+			ckt->t10		= 50;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t10		= ccSpan->t10;
+			ckt->t10		= ccSpan->t10;
 		}
 		if (ccSpan->t12 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t12		= 300;
+			ckt->t12		= 300;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t12		= ccSpan->t12;
+			ckt->t12		= ccSpan->t12;
 		}
 		if (ccSpan->t13 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t13		= 3000;
+			ckt->t13		= 3000;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t13		= ccSpan->t13;
+			ckt->t13		= ccSpan->t13;
 		}
 		if (ccSpan->t14 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t14		= 300;
+			ckt->t14		= 300;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t14		= ccSpan->t14;
+			ckt->t14		= ccSpan->t14;
 		}
 		if (ccSpan->t15 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t15		= 3000;
+			ckt->t15		= 3000;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t15		= ccSpan->t15;
+			ckt->t15		= ccSpan->t15;
 		}
 		if (ccSpan->t16 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t16		= 300;
+			ckt->t16		= 300;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t16		= ccSpan->t16;
+			ckt->t16		= ccSpan->t16;
 		}
 		if (ccSpan->t17 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t17		= 3000;
+			ckt->t17		= 3000;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t17		= ccSpan->t17;
+			ckt->t17		= ccSpan->t17;
 		}
 		if (ccSpan->t35 == 0) {
 			/* Q.764 2.2.5 Address incomplete (T35 is 15-20 seconds according to Table A.1/Q.764) */
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t35		= 170;
+			ckt->t35		= 170;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t35		= ccSpan->t35;
+			ckt->t35		= ccSpan->t35;
 		}
 		if (ccSpan->t39 == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t39		= 120;
+			ckt->t39		= 120;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].t39		= ccSpan->t39;
+			ckt->t39		= ccSpan->t39;
 		}
 		
 		if (ccSpan->tval == 0) {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].tval		= 10;
+			ckt->tval		= 10;
 		} else {
-			g_ftdm_sngss7_data.cfg.isupCkt[x].tval		= ccSpan->tval;
+			ckt->tval		= ccSpan->tval;
 		}
 
 		SS7_INFO("Added procId=%d, spanId = %d, chan = %d, cic = %d, ISUP cirId = %d\n",
-					g_ftdm_sngss7_data.cfg.isupCkt[x].procId,
-					g_ftdm_sngss7_data.cfg.isupCkt[x].ccSpanId,
-					g_ftdm_sngss7_data.cfg.isupCkt[x].chan,
-					g_ftdm_sngss7_data.cfg.isupCkt[x].cic,
-					g_ftdm_sngss7_data.cfg.isupCkt[x].id);
+					ckt->procId,
+					ckt->ccSpanId,
+					ckt->chan,
+					ckt->cic,
+					ckt->id);
 
 move_along:
 		/* increment the span channel count */
@@ -3215,10 +3222,10 @@ static int ftmod_ss7_fill_in_circuits(sng_span_t *sngSpan)
 		/* find the equivalent channel in the global structure */
 		x = (g_ftdm_sngss7_data.cfg.procId * 1000) + 1;
 		flag = 0;
-		while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) {
+		while (sngss7_get_ckt(x)->id != 0) {
 		/**********************************************************************/
 			/* pull out the circuit to make it easier to work with */
-			isupCkt = &g_ftdm_sngss7_data.cfg.isupCkt[x];
+			isupCkt = sngss7_get_ckt(x);
 
 			/* if the ccSpanId's match fill in the span value...this is for sigs
 			 * because they will never have a channel that matches since they 
@@ -3246,7 +3253,7 @@ static int ftmod_ss7_fill_in_circuits(sng_span_t *sngSpan)
 				break;
 			}
 		/**********************************************************************/
-		} /* while (g_ftdm_sngss7_data.cfg.isupCkt[x].id != 0) */
+		} /* while (sngss7_get_ckt(x)->id != 0) */
 
 		/* check we found the ckt or not */
 		if (!flag) {
@@ -1085,6 +1085,43 @@ FT_DECLARE(ftdm_status_t) _ftdm_channel_call_hangup(const char *file, const char
 /*! \brief Hangup the call with cause recording the source code point where it was called (see ftdm_channel_call_hangup_with_cause for an easy to use macro) */
 FT_DECLARE(ftdm_status_t) _ftdm_channel_call_hangup_with_cause(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_call_cause_t, ftdm_usrmsg_t *usrmsg);
 
+/*! \brief Non-blocking call control
+ *
+ *  The _async variants of answer, indicate, hangup and call place return as soon as the request is queued to the
+ *  signaling stack, no matter the blocking mode of the span (see ftdm_span_set_blocking_mode), so a single
+ *  application thread can drive many calls. The completion is reported through the span signaling callback
+ *  (which may be a per span queue with FTDM_SPAN_USE_SIGNALS_QUEUE):
+ *   - answer and indicate: FTDM_SIGEVENT_INDICATION_COMPLETED with the request status
+ *   - hangup: FTDM_SIGEVENT_RELEASED once the channel is released
+ *   - call place: FTDM_SIGEVENT_DIALING, or FTDM_SIGEVENT_STOP if the call failed
+ *
+ *  \note When these functions return anything else than FTDM_SUCCESS the request failed right away and no
+ *        completion event will be delivered. Completion events may be delivered before the function returns
+ */
+#define ftdm_channel_call_answer_async(ftdmchan) _ftdm_channel_call_answer_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), NULL)
+#define ftdm_channel_call_answer_async_ex(ftdmchan, usrmsg) _ftdm_channel_call_answer_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), (usrmsg))
+
+/*! \brief Non-blocking answer (see ftdm_channel_call_answer_async for an easy to use macro) */
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_answer_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_usrmsg_t *usrmsg);
+
+#define ftdm_channel_call_indicate_async(ftdmchan, indication) _ftdm_channel_call_indicate_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), (indication), NULL)
+#define ftdm_channel_call_indicate_async_ex(ftdmchan, indication, usrmsg) _ftdm_channel_call_indicate_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), (indication), (usrmsg))
+
+/*! \brief Non-blocking indication (see ftdm_channel_call_indicate_async for an easy to use macro) */
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_indicate_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_channel_indication_t indication, ftdm_usrmsg_t *usrmsg);
+
+#define ftdm_channel_call_hangup_async(ftdmchan, cause) _ftdm_channel_call_hangup_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), (cause), NULL)
+#define ftdm_channel_call_hangup_async_ex(ftdmchan, cause, usrmsg) _ftdm_channel_call_hangup_async(__FILE__, __FTDM_FUNC__, __LINE__, (ftdmchan), (cause), (usrmsg))
+
+/*! \brief Non-blocking hangup with cause (see ftdm_channel_call_hangup_async for an easy to use macro) */
+FT_DECLARE(ftdm_status_t) _ftdm_channel_call_hangup_async(const char *file, const char *func, int line, ftdm_channel_t *ftdmchan, ftdm_call_cause_t cause, ftdm_usrmsg_t *usrmsg);
+
+#define ftdm_call_place_async(callerdata, hunting) _ftdm_call_place_async(__FILE__, __FTDM_FUNC__, __LINE__, (callerdata), (hunting), NULL)
+#define ftdm_call_place_async_ex(callerdata, hunting, usrmsg) _ftdm_call_place_async(__FILE__, __FTDM_FUNC__, __LINE__, (callerdata), (hunting), (usrmsg))
+
+/*! \brief Non-blocking call place, same return codes as _ftdm_call_place (see ftdm_call_place_async for an easy to use macro) */
+FT_DECLARE(ftdm_status_t) _ftdm_call_place_async(const char *file, const char *func, int line, ftdm_caller_data_t *caller_data, ftdm_hunting_scheme_t *hunting, ftdm_usrmsg_t *usrmsg);
+
 /*! \brief Transfer call. This can also be accomplished by ftdm_channel_call_indicate with FTDM_CHANNEL_INDICATE_TRANSFER, in both
  *         cases you will get a FTDM_SIGEVENT_INDICATION_COMPLETED when the indication is sent (or an error occurs).
  *         Just as with ftdm_channel_call_indicate you won't receive FTDM_SIGEVENT_INDICATION_COMPLETED when this function
@@ -1765,6 +1802,23 @@ FT_DECLARE(ftdm_iterator_t *) ftdm_get_span_iterator(ftdm_iterator_t *iter);
  */
 FT_DECLARE(char *) ftdm_api_execute(const char *cmd);
 
+/*! 
+ * \brief Render the core metrics and the metrics registered by the modules in OpenMetrics text format
+ *
+ * \retval The rendered text, must be free'd, NULL on failure
+ */
+FT_DECLARE(char *) ftdm_metrics_render(void);
+
+/*! 
+ * \brief Render the metrics to a file, the file is replaced atomically so scrapers never read a partial file
+ *
+ * \param path The file path
+ *
+ * \retval FTDM_SUCCESS success 
+ * \retval FTDM_FAIL failure 
+ */
+FT_DECLARE(ftdm_status_t) ftdm_metrics_render_to_file(const char *path);
+
 /*! 
  * \brief Create a configuration node
  *
@@ -1927,6 +1981,22 @@ FT_DECLARE(void) ftdm_global_set_logger(ftdm_logger_t logger);
 /*! \brief Set the default logger level */
 FT_DECLARE(void) ftdm_global_set_default_logger(int level);
 
+/*!
+ * \brief Log asynchronously. Messages are formatted by the calling thread into its own ring buffer
+ *        and handed to the given logger by a background thread, so logging never waits on the logger I/O.
+ *        Messages are dropped (and the drop reported) when a thread logs faster than the logger keeps up.
+ *        Setting another logger stops the background thread after writing any pending message.
+ * \param logger The logger to hand the messages to, NULL for the default (stderr) logger
+ * \param level Messages above this level are discarded before formatting
+ */
+FT_DECLARE(ftdm_status_t) ftdm_global_set_async_logger(ftdm_logger_t logger, int level);
+
+/*!
+ * \brief Discard messages above the given level before calling the logger
+ *        The default, restored by ftdm_global_set_logger(), is FTDM_LOG_LEVEL_DEBUG (everything)
+ */
+FT_DECLARE(void) ftdm_global_set_log_level(int level);
+
 /*! \brief Set the directory to look for modules */
 FT_DECLARE(void) ftdm_global_set_mod_directory(const char *path);
 
@@ -1972,6 +2042,9 @@ FT_DECLARE(ftdm_status_t) ftdm_backtrace_chan(ftdm_channel_t *chan);
 
 FT_DECLARE_DATA extern ftdm_logger_t ftdm_log;
 
+/*! \brief Highest level passed to the logger, see ftdm_global_set_log_level() */
+FT_DECLARE_DATA extern int ftdm_log_threshold;
+
 /*! \brief Basic transcoding function prototype */
 #define FIO_CODEC_ARGS (void *data, ftdm_size_t max, ftdm_size_t *datalen)
 #define FIO_CODEC_FUNCTION(name) FT_DECLARE_NONSTD(ftdm_status_t) name FIO_CODEC_ARGS
@@ -2005,6 +2078,25 @@ FIO_CODEC_FUNCTION(fio_alaw2ulaw);
 #define FTDM_LOG_ALERT FTDM_PRE, FTDM_LOG_LEVEL_ALERT
 #define FTDM_LOG_EMERG FTDM_PRE, FTDM_LOG_LEVEL_EMERG
 
+/*!
+ * \brief Highest log level compiled in, log calls with a constant level above it are removed by the compiler.
+ *        Define it before including freetdm.h, ie: -DFTDM_LOG_LEVEL_COMPILED=FTDM_LOG_LEVEL_INFO
+ */
+#ifndef FTDM_LOG_LEVEL_COMPILED
+#define FTDM_LOG_LEVEL_COMPILED FTDM_LOG_LEVEL_DEBUG
+#endif
+
+/*!
+ * \brief Filter log calls by level before evaluating the arguments or calling the logger, disabled levels
+ *        cost a compare. The expansion step splits FTDM_LOG_XXX in its file, func, line and level arguments
+ *        (ftdm_log used as a variable, ie: ftdm_log = logger, is not affected by the macro)
+ */
+#define FTDM_LOG_EXPAND(x) x
+#define ftdm_log(...) FTDM_LOG_EXPAND(ftdm_log_filtered(__VA_ARGS__))
+#define ftdm_log_filtered(file, func, line, level, ...) \
+	(((level) > FTDM_LOG_LEVEL_COMPILED || (level) > ftdm_log_threshold) ? \
+	 (void)0 : (ftdm_log)(file, func, line, level, __VA_ARGS__))
+
 #ifdef __cplusplus
 } /* extern C */
 #endif
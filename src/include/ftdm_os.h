@@ -63,6 +63,13 @@ typedef uint64_t ftdm_time_t;
 #define ftdm_sleep(x) usleep(x * 1000)
 #endif
 
+/*! \brief thread local storage class */
+#ifdef __WINDOWS__
+#define FTDM_THREAD_LOCAL __declspec(thread)
+#else
+#define FTDM_THREAD_LOCAL __thread
+#endif
+
 /*! \brief strncpy replacement */
 #define ftdm_copy_string(x,y,z) strncpy(x, y, z - 1)
 
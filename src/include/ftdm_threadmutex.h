@@ -59,6 +59,36 @@ FT_DECLARE(ftdm_status_t) ftdm_interrupt_wait(ftdm_interrupt_t *cond, int ms);
 FT_DECLARE(ftdm_status_t) ftdm_interrupt_multiple_wait(ftdm_interrupt_t *interrupts[], ftdm_size_t size, int ms);
 FT_DECLARE(ftdm_wait_flag_t) ftdm_interrupt_device_ready(ftdm_interrupt_t *interrupt);
 
+/*! \brief Atomically increment a counter, returns the incremented value */
+FT_DECLARE(uint32_t) ftdm_atomic_inc32(volatile uint32_t *value);
+
+/*! \brief Atomically decrement a counter, returns the decremented value */
+FT_DECLARE(uint32_t) ftdm_atomic_dec32(volatile uint32_t *value);
+
+/*!
+ * \brief Atomically replace a pointer if it still has the expected value (full memory barrier)
+ * \return FTDM_TRUE if the pointer was replaced, FTDM_FALSE if it had a different value
+ */
+FT_DECLARE(ftdm_bool_t) ftdm_atomic_cas_ptr(void * volatile *ptr, void *oldval, void *newval);
+
+/*! \brief Read a pointer published with ftdm_atomic_cas_ptr, anything written before publishing it is visible */
+FT_DECLARE(void *) ftdm_atomic_get_ptr(void * volatile *ptr);
+
+/*! \brief Read a value published with ftdm_atomic_set32 (acquire), anything written before publishing it is visible */
+FT_DECLARE(uint32_t) ftdm_atomic_get32(volatile uint32_t *value);
+
+/*! \brief Publish a value (release), anything written before is visible to ftdm_atomic_get32 readers */
+FT_DECLARE(void) ftdm_atomic_set32(volatile uint32_t *value, uint32_t newval);
+
+/*! \brief Atomically set bits (full memory barrier), returns the previous value */
+FT_DECLARE(uint32_t) ftdm_atomic_or32(volatile uint32_t *value, uint32_t bits);
+
+/*! \brief Atomically replace a value (full memory barrier), returns the previous value */
+FT_DECLARE(uint32_t) ftdm_atomic_xchg32(volatile uint32_t *value, uint32_t newval);
+
+/*! \brief Full memory barrier, no load or store crosses it in either direction */
+FT_DECLARE(void) ftdm_atomic_fence(void);
+
 #ifdef __cplusplus
 }
 #endif
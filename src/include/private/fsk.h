@@ -73,10 +73,10 @@ typedef struct
 {
 	fsk_state_t			state;
 	dsp_fsk_attr_t		attr;							/* attributes structure */
-	double				*correlates[4];					/* one for each of sin/cos for mark/space */
-	int					corrsize;						/* correlate size (also number of samples in ring buffer) */
-	double				*buffer;						/* sample ring buffer */
-	int					ringstart;						/* ring buffer start offset */
+	float				*correlates[4];					/* one for each of sin/cos for mark/space */
+	int					corrsize;						/* correlate size (number of samples in the correlation window) */
+	float				*window;						/* sample history (corrsize - 1 samples) followed by the block being processed */
+	int					window_pos;						/* samples fed by dsp_fsk_sample since the history was last moved back */
 	double				cellpos;						/* bit cell position */
 	double				celladj;						/* bit cell adjustment for each sample */
 	int					previous_bit;					/* previous bit (for detecting a transition to sync-up cell position) */
@@ -94,7 +94,7 @@ typedef struct
  *		a) create the attributes structure (dsp_fsk_attr_init)
  *		b) initialize fields in the attributes structure (dsp_fsk_attr_set_*)
  *		c) create a Bell-202 handle (dsp_fsk_create)
- *		d) feed samples through the handler (dsp_fsk_sample)
+ *		d) feed samples through the handler (dsp_fsk_block)
 */
 
 void					dsp_fsk_attr_init(dsp_fsk_attr_t *attributes);
@@ -109,7 +109,13 @@ int						dsp_fsk_attr_set_samplerate(dsp_fsk_attr_t *attributes, int samplerate)
 dsp_fsk_handle_t *	dsp_fsk_create(dsp_fsk_attr_t *attributes);
 void					dsp_fsk_destroy(dsp_fsk_handle_t **handle);
 
+/*
+ *	Deprecated: dsp_fsk_sample is only kept for existing users, it is about as fast
+ *	as the previous double precision demodulator.  Use dsp_fsk_block, which is
+ *	much faster since it correlates several samples at once.
+*/
 void					dsp_fsk_sample(dsp_fsk_handle_t *handle, double normalized_sample);
+void					dsp_fsk_block(dsp_fsk_handle_t *handle, const int16_t *samples, int count);
 
 extern fsk_modem_definition_t fsk_modem_definitions[];
 
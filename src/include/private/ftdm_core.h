@@ -120,6 +120,12 @@
 #include "ftdm_buffer.h"
 #include "ftdm_threadmutex.h"
 #include "ftdm_sched.h"
+#include "ftdm_metrics.h"
+#include "ftdm_log.h"
+#include "ftdm_recorder.h"
+#include "ftdm_tone_cache.h"
+#include "ftdm_tone_service.h"
+#include "ftdm_wheel.h"
 #include "ftdm_call_utils.h"
 
 #ifdef __cplusplus
@@ -393,14 +399,30 @@ typedef struct {
 
 /* 2^8 table size, one for each byte (sample) value */
 #define FTDM_GAINS_TABLE_SIZE 256
+/*!
+ * \brief Channel data not needed on the media path nor when scanning channels (hunting, polling, state dumps)
+ *        It is allocated out of line by ftdm_span_add_channel and only used by the core
+ */
+typedef struct ftdm_channel_cold {
+	ftdm_state_history_entry_t history[10];
+	uint8_t hindex;
+	char tokens[FTDM_MAX_TOKENS+1][FTDM_TOKEN_STRLEN];
+	teletone_dtmf_detect_state_t dtmf_detect;
+	teletone_generation_session_t tone_session;
+	ftdm_fsk_data_state_t fsk;
+	uint8_t fsk_buf[80];
+	ftdm_dtmf_debug_t dtmfdbg;
+	ftdm_io_dump_t rxdump;
+	ftdm_io_dump_t txdump;
+	ftdm_channel_metrics_t metrics;
+	ftdm_recorder_t recorder; /*!< Flight recorder, see ftdm_recorder.h */
+} ftdm_channel_cold_t;
+
 struct ftdm_channel {
+	/* hot: used on every frame and when scanning channels, keep these together at the start */
 	ftdm_data_type_t data_type;
 	uint32_t span_id;
 	uint32_t chan_id;
-	uint32_t physical_span_id;
-	uint32_t physical_chan_id;
-	uint32_t rate;
-	uint32_t extra_id;
 	ftdm_chan_type_t type;
 	ftdm_socket_t sockfd;
 	uint64_t flags;
@@ -417,68 +439,68 @@ struct ftdm_channel {
 	ftdm_channel_state_t state;
 	ftdm_state_status_t state_status;
 	ftdm_channel_state_t last_state;
-	ftdm_channel_state_t init_state;
 	ftdm_channel_indication_t indication;
-	ftdm_state_history_entry_t history[10];
-	uint8_t hindex;
-	ftdm_mutex_t *mutex;
-	teletone_dtmf_detect_state_t dtmf_detect;
-	uint32_t buffer_delay;
-	ftdm_event_t event_header;
-	char last_error[256];
-	fio_event_cb_t event_callback;
 	uint32_t skip_read_frames;
+	uint32_t buffer_delay;
+	int availability_rate;
+	float rxgain;
+	float txgain;
+	ftdm_mutex_t *mutex;
+	struct ftdm_span *span;
+	struct ftdm_io_interface *fio;
+	/* Private I/O data. Do not touch unless you are an I/O module */
+	void *io_data;
+	/* Private signaling data. Do not touch unless you are a signaling module */
+	void *call_data;
 	ftdm_buffer_t *dtmf_buffer;
 	ftdm_buffer_t *gen_dtmf_buffer;
 	ftdm_buffer_t *pre_buffer;
 	ftdm_buffer_t *digit_buffer;
 	ftdm_buffer_t *fsk_buffer;
 	ftdm_mutex_t *pre_buffer_mutex;
+	uint32_t pre_buffer_size;
+	ftdm_tone_service_entry_t *tone_entry; /*!< Tone service attachment (NULL if not attached) */
+	ftdm_channel_cold_t *cold; /*!< Out of line cold data (core only) */
+
+	/* warm: per call / per event data */
+	uint32_t physical_span_id;
+	uint32_t physical_chan_id;
+	uint32_t rate;
+	uint32_t extra_id;
+	ftdm_channel_state_t init_state;
 	uint32_t dtmf_on;
 	uint32_t dtmf_off;
 	char *dtmf_hangup_buf;
-	teletone_generation_session_t tone_session;
 	ftdm_time_t last_event_time;
 	ftdm_time_t ring_time;
-	char tokens[FTDM_MAX_TOKENS+1][FTDM_TOKEN_STRLEN];
+	uint32_t token_count;
 	uint8_t needed_tones[FTDM_TONEMAP_INVALID];
 	uint8_t detected_tones[FTDM_TONEMAP_INVALID];
 	ftdm_tonemap_t last_detected_tone;	
-	uint32_t token_count;
-	char chan_name[128];
-	char chan_number[32];
 	ftdm_filehandle_t fds[2];
-	ftdm_fsk_data_state_t fsk;
-	uint8_t fsk_buf[80];
 	uint32_t ring_count;
 	ftdm_polarity_t polarity;
-	/* Private I/O data. Do not touch unless you are an I/O module */
-	void *io_data;
-	/* Private signaling data. Do not touch unless you are a signaling module */
-	void *call_data;
-	struct ftdm_caller_data caller_data;
-	struct ftdm_span *span;
-	struct ftdm_io_interface *fio;
 	unsigned char rx_cas_bits;
-	uint32_t pre_buffer_size;
-	uint8_t rxgain_table[FTDM_GAINS_TABLE_SIZE];
-	uint8_t txgain_table[FTDM_GAINS_TABLE_SIZE];
-	float rxgain;
-	float txgain;
-	int availability_rate;
 	void *user_private;
 	ftdm_timer_id_t hangup_timer;
-	ftdm_channel_iostats_t iostats;
-	ftdm_dtmf_debug_t dtmfdbg;
-	ftdm_dtmf_detect_t dtmfdetect;
-	ftdm_io_dump_t rxdump;
-	ftdm_io_dump_t txdump;
+	fio_event_cb_t event_callback;
 	ftdm_interrupt_t *state_completed_interrupt; /*!< Notify when a state change is completed */
 	int32_t txdrops;
 	int32_t rxdrops;
 	ftdm_usrmsg_t *usrmsg;
 	ftdm_time_t last_state_change_time;
 	ftdm_time_t last_release_time;
+	ftdm_dtmf_detect_t dtmfdetect;
+	uint8_t rxgain_table[FTDM_GAINS_TABLE_SIZE];
+	uint8_t txgain_table[FTDM_GAINS_TABLE_SIZE];
+
+	/* cold: large data still used directly by the modules */
+	ftdm_event_t event_header;
+	char last_error[256];
+	char chan_name[128];
+	char chan_number[32];
+	struct ftdm_caller_data caller_data;
+	ftdm_channel_iostats_t iostats;
 };
 
 struct ftdm_span {
@@ -525,9 +547,12 @@ struct ftdm_span {
 	char *dtmf_hangup;
 	size_t dtmf_hangup_len;
 	ftdm_state_map_t *state_map;
+	ftdm_state_matrix_t state_matrix; /*!< state_map compiled when the span signaling is configured */
 	ftdm_caller_data_t default_caller_data;
 	ftdm_queue_t *pendingchans; /*!< Channels pending of state processing */
+	ftdm_dirty_map_t dirty; /*!< Channels pending of state processing (FTDM_SPAN_USE_DIRTY_MAP) */
 	ftdm_queue_t *pendingsignals; /*!< Signals pending from being delivered to the user */
+	ftdm_span_metrics_t metrics; /*!< Latency metrics, see ftdm_metrics.h */
 	struct ftdm_span *next;
 };
 
@@ -644,7 +669,7 @@ FT_DECLARE(ftdm_status_t) ftdm_span_next_event(ftdm_span_t *span, ftdm_event_t *
 FT_DECLARE(ftdm_status_t) ftdm_channel_queue_dtmf(ftdm_channel_t *ftdmchan, const char *dtmf);
 
 /* dequeue pending signals and notify the user via the span signal callback */
-FT_DECLARE(ftdm_status_t) ftdm_span_trigger_signals(const ftdm_span_t *span);
+FT_DECLARE(ftdm_status_t) ftdm_span_trigger_signals(ftdm_span_t *span);
 
 /*! \brief clear the tone detector state */
 FT_DECLARE(void) ftdm_channel_clear_detected_tones(ftdm_channel_t *ftdmchan);
@@ -708,6 +733,7 @@ FT_DECLARE(ftdm_status_t) ftdm_get_channel_from_string(const char *string_id, ft
 #define ftdm_assert(assertion, msg) \
 	if (!(assertion)) { \
 		ftdm_log(FTDM_LOG_CRIT, "%s", msg); \
+		ftdm_recorder_assert_dump(); \
 		if (g_ftdm_crash_policy & FTDM_CRASH_ON_ASSERT) { \
 			ftdm_abort();  \
 		} \
@@ -719,6 +745,7 @@ FT_DECLARE(ftdm_status_t) ftdm_get_channel_from_string(const char *string_id, ft
 #define ftdm_assert_return(assertion, retval, msg) \
 	if (!(assertion)) { \
 		ftdm_log(FTDM_LOG_CRIT, "%s", msg); \
+		ftdm_recorder_assert_dump(); \
 		if (g_ftdm_crash_policy & FTDM_CRASH_ON_ASSERT) { \
 			ftdm_abort();  \
 		} else { \
@@ -761,7 +788,7 @@ FT_DECLARE(ftdm_status_t) ftdm_get_channel_from_string(const char *string_id, ft
 			if (!ftdm_test_flag((fchan), FTDM_CHANNEL_MEDIA)) { \
 				ftdm_set_flag((fchan), FTDM_CHANNEL_MEDIA); \
 				ftdm_set_echocancel_call_begin((fchan)); \
-				if ((fchan)->dtmfdbg.requested) { \
+				if ((fchan)->cold->dtmfdbg.requested) { \
 					ftdm_channel_command((fchan), FTDM_COMMAND_ENABLE_DEBUG_DTMF, NULL); \
 				} \
 			} \
@@ -790,6 +817,32 @@ static __inline__ int16_t ftdm_saturated_add(int16_t sample1, int16_t sample2)
 	return (int16_t)addres;
 }
 
+/*!
+ * \brief Claim a free slot of a call id registry (slots 1 to size) without locking
+ *        The cursor is bumped atomically and the slot it points to is claimed with a compare-and-swap,
+ *        a busy slot just moves on to the next id
+ * \return The call id or 0 if every slot is busy
+ */
+static __inline__ uint32_t ftdm_call_ids_claim(ftdm_caller_data_t * volatile *slots, volatile uint32_t *cursor, uint32_t size, ftdm_caller_data_t *caller_data)
+{
+	uint32_t call_id;
+	uint32_t tries;
+
+	for (tries = 0; tries < size; tries++) {
+		call_id = (ftdm_atomic_inc32(cursor) % size) + 1;
+		if (ftdm_atomic_cas_ptr((void * volatile *)&slots[call_id], NULL, caller_data)) {
+			return call_id;
+		}
+	}
+	return 0;
+}
+
+/*! \brief Release a call id claimed with ftdm_call_ids_claim(), fails if the slot is not held by caller_data */
+static __inline__ ftdm_bool_t ftdm_call_ids_release(ftdm_caller_data_t * volatile *slots, uint32_t call_id, ftdm_caller_data_t *caller_data)
+{
+	return ftdm_atomic_cas_ptr((void * volatile *)&slots[call_id], caller_data, NULL);
+}
+
 /* Bitmap helper functions */
 typedef long ftdm_bitmap_t;
 #define FTDM_BITMAP_NBITS (sizeof(ftdm_bitmap_t) * 8)
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __FTDM_LOG_H__
+#define __FTDM_LOG_H__
+
+#include "freetdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Size of each thread log ring (power of 2) */
+#define FTDM_LOG_RING_SIZE (64 * 1024)
+
+/*! \brief How often (ms) the drain thread hands the queued messages to the logger */
+#define FTDM_LOG_DRAIN_INTERVAL 10
+
+/*! \brief Longest message, longer ones are truncated (same as the default logger) */
+#define FTDM_LOG_MAX_MSG 1024
+
+/*!
+ * \brief Queue a message in the calling thread ring, used as ftdm_log while the async logger runs
+ *        The message is formatted here, file and func are copied, nothing points back to the caller
+ */
+FT_DECLARE_NONSTD(void) ftdm_log_async_write(const char *file, const char *func, int line, int level, const char *fmt, ...) __ftdm_check_printf(5, 6);
+
+/*! \brief Start the drain thread handing the queued messages to sink, or just switch the sink if it is running */
+FT_DECLARE(ftdm_status_t) ftdm_log_async_start(ftdm_logger_t sink);
+
+/*!
+ * \brief Stop the drain thread after writing the pending messages and release the rings of exited threads
+ *        ftdm_log must not point to ftdm_log_async_write anymore, the rings of running threads are kept
+ */
+FT_DECLARE(void) ftdm_log_async_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
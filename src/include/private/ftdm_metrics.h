@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FTDM_METRICS_H__
+#define __FTDM_METRICS_H__
+
+#include "freetdm.h"
+#include "ftdm_types.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Latency histograms
+ *        Values are nanoseconds, bucketed log-linear (HDR style): every power of 2 is split in
+ *        FTDM_HISTOGRAM_SUB_BUCKETS buckets, so any value is reported within 25% of its real value.
+ *        Values above 2^FTDM_HISTOGRAM_MAX_BIT ns (~4.5 minutes) all land in the last bucket
+ */
+#define FTDM_HISTOGRAM_SUB_BITS 2
+#define FTDM_HISTOGRAM_SUB_BUCKETS (1 << FTDM_HISTOGRAM_SUB_BITS)
+#define FTDM_HISTOGRAM_MAX_BIT 38
+#define FTDM_HISTOGRAM_BUCKETS ((FTDM_HISTOGRAM_MAX_BIT - FTDM_HISTOGRAM_SUB_BITS + 2) * FTDM_HISTOGRAM_SUB_BUCKETS)
+
+/*!
+ * \brief Latency histogram, updates are not atomic, each histogram is expected to be updated by a single
+ *        thread at a time (the channel or span owner), readers get a best effort snapshot
+ */
+typedef struct ftdm_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint32_t buckets[FTDM_HISTOGRAM_BUCKETS];
+} ftdm_histogram_t;
+
+/*! \brief Per channel metrics */
+typedef struct ftdm_channel_metrics {
+	ftdm_histogram_t state;		/*!< time from setting a state until it is completed */
+	ftdm_histogram_t read;		/*!< fio->read duration */
+	ftdm_histogram_t write;		/*!< fio->write duration */
+	ftdm_histogram_t jitter;	/*!< deviation of the read inter-arrival time from the channel interval */
+	uint64_t state_start;		/*!< time the current state was set */
+	uint64_t last_read;		/*!< time the last read completed, 0 if there was no read since the channel was opened */
+} ftdm_channel_metrics_t;
+
+/*! \brief Per span metrics */
+typedef struct ftdm_span_metrics {
+	ftdm_histogram_t signal;	/*!< user signal callback duration */
+	ftdm_histogram_t loop;		/*!< signaling module loop iteration time */
+	uint64_t loop_start;		/*!< start time of the current loop iteration */
+} ftdm_span_metrics_t;
+
+typedef enum {
+	FTDM_METRICS_FORMAT_TEXT,
+	FTDM_METRICS_FORMAT_JSON,
+} ftdm_metrics_format_t;
+
+/*! \brief Monotonic time in nanoseconds, only meaningful to compute intervals */
+FT_DECLARE(uint64_t) ftdm_metrics_now(void);
+
+static __inline__ uint32_t ftdm_histogram_bucket(uint64_t value)
+{
+	uint32_t msb;
+
+	if (value < FTDM_HISTOGRAM_SUB_BUCKETS) {
+		return (uint32_t)value;
+	}
+#if defined(__GNUC__)
+	msb = 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	{
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		msb = index;
+	}
+#else
+	for (msb = 63; !(value & ((uint64_t)1 << msb)); msb--);
+#endif
+	if (msb > FTDM_HISTOGRAM_MAX_BIT) {
+		return FTDM_HISTOGRAM_BUCKETS - 1;
+	}
+	return ((msb - FTDM_HISTOGRAM_SUB_BITS + 1) << FTDM_HISTOGRAM_SUB_BITS) +
+		(uint32_t)((value >> (msb - FTDM_HISTOGRAM_SUB_BITS)) & (FTDM_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/*! \brief Record a value (ns) in a histogram */
+static __inline__ void ftdm_histogram_record(ftdm_histogram_t *histogram, uint64_t value)
+{
+	histogram->buckets[ftdm_histogram_bucket(value)]++;
+	if (!histogram->count || value < histogram->min) {
+		histogram->min = value;
+	}
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+	histogram->count++;
+	histogram->sum += value;
+}
+
+/*!
+ * \brief Record a value (ns) in a histogram that may be updated by several threads at once
+ *        Readers still get a best effort snapshot, the fields are not updated as a whole
+ */
+FT_DECLARE(void) ftdm_histogram_record_atomic(ftdm_histogram_t *histogram, uint64_t value);
+
+/*! \brief Record the time elapsed since start (a ftdm_metrics_now() value) and return the current time */
+static __inline__ uint64_t ftdm_histogram_record_since(ftdm_histogram_t *histogram, uint64_t start)
+{
+	uint64_t now = ftdm_metrics_now();
+	ftdm_histogram_record(histogram, now - start);
+	return now;
+}
+
+/*! \brief Add all the values recorded in src to dst */
+FT_DECLARE(void) ftdm_histogram_merge(ftdm_histogram_t *dst, const ftdm_histogram_t *src);
+
+/*! \brief Get the value (ns) at the given percentile (0-100), 0 if nothing was recorded */
+FT_DECLARE(uint64_t) ftdm_histogram_percentile(const ftdm_histogram_t *histogram, double percentile);
+
+/*!
+ * \brief Mark the start of a signaling module loop iteration, the time since the previous mark is recorded
+ *        Signaling modules should call it once per iteration of their span thread loop
+ */
+FT_DECLARE(void) ftdm_span_metrics_loop_mark(ftdm_span_t *span);
+
+/*!
+ * \brief Print the metrics
+ * \param stream The stream to print to
+ * \param span The span to print, NULL to print all spans
+ * \param ftdmchan The channel to print (span must be given), NULL to print the channels aggregated per span
+ * \param format Output format
+ */
+FT_DECLARE(void) ftdm_metrics_print(ftdm_stream_handle_t *stream, ftdm_span_t *span, ftdm_channel_t *ftdmchan, ftdm_metrics_format_t format);
+
+/*! \brief Reset the metrics of a span and its channels, NULL resets all spans */
+FT_DECLARE(void) ftdm_metrics_reset(ftdm_span_t *span);
+
+/*!
+ * \brief Metrics registry
+ *        Modules register named counters, gauges and histograms, ftdm_metrics_render() exports them along with
+ *        the core span and channel metrics in OpenMetrics text format
+ */
+typedef enum {
+	FTDM_METRIC_COUNTER,
+	FTDM_METRIC_GAUGE,
+	FTDM_METRIC_HISTOGRAM,
+} ftdm_metric_type_t;
+
+/*! \brief Counters are split in shards, each thread updates its own shard so updates do not bounce a cache line */
+#define FTDM_METRIC_SHARDS 16
+#define FTDM_METRIC_CACHE_LINE 64
+
+typedef struct {
+	volatile uint64_t value;
+	char pad[FTDM_METRIC_CACHE_LINE - sizeof(uint64_t)];
+} ftdm_metric_shard_t;
+
+typedef struct ftdm_metric ftdm_metric_t;
+
+/*! \brief A registered metric, the owner keeps it allocated (usually static) until it is unregistered */
+struct ftdm_metric {
+	ftdm_metric_shard_t shards[FTDM_METRIC_SHARDS];	/*!< counter value, the sum of all the shards */
+	volatile int64_t gauge;				/*!< gauge value */
+	const ftdm_histogram_t *histogram;		/*!< histogram owned by the registering module */
+	ftdm_metric_type_t type;
+	char *name;
+	char *labels;					/*!< optional, OpenMetrics label set without braces, ie: span="s1" */
+	char *help;
+	ftdm_metric_t *next;
+};
+
+/*!
+ * \brief Collector callback, called on every render to write whole metric families (# TYPE line included)
+ *        for values cheaper to compute at scrape time than to keep up to date
+ */
+typedef void (*ftdm_metrics_collector_t)(ftdm_stream_handle_t *stream, void *data);
+
+/*! \brief Register a counter or a gauge, name must not include the _total counter suffix */
+FT_DECLARE(ftdm_status_t) ftdm_metric_register(ftdm_metric_t *metric, ftdm_metric_type_t type,
+		const char *name, const char *labels, const char *help);
+
+/*! \brief Register a histogram, values recorded in it are exported in seconds */
+FT_DECLARE(ftdm_status_t) ftdm_metric_register_histogram(ftdm_metric_t *metric, const ftdm_histogram_t *histogram,
+		const char *name, const char *labels, const char *help);
+
+FT_DECLARE(ftdm_status_t) ftdm_metric_unregister(ftdm_metric_t *metric);
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_collector_register(ftdm_metrics_collector_t collector, void *data);
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_collector_unregister(ftdm_metrics_collector_t collector, void *data);
+
+/*! \brief Add to a counter with a relaxed atomic add on the calling thread shard */
+FT_DECLARE(void) ftdm_metric_add(ftdm_metric_t *metric, uint64_t value);
+
+/*! \brief Set a gauge */
+FT_DECLARE(void) ftdm_metric_set(ftdm_metric_t *metric, int64_t value);
+
+/*! \brief Current counter value, the sum of all the shards */
+FT_DECLARE(uint64_t) ftdm_metric_value(const ftdm_metric_t *metric);
+
+/*! \brief Write the # TYPE and # HELP lines of a metric family */
+FT_DECLARE(void) ftdm_metrics_render_family(ftdm_stream_handle_t *stream, const char *name, ftdm_metric_type_t type, const char *help);
+
+/*! \brief Write the samples of a histogram (ns values) as an OpenMetrics histogram in seconds */
+FT_DECLARE(void) ftdm_metrics_render_histogram(ftdm_stream_handle_t *stream, const char *name, const char *labels,
+		const ftdm_histogram_t *histogram);
+
+/*! \brief Render all the metrics to a stream, see ftdm_metrics_render() */
+FT_DECLARE(void) ftdm_metrics_render_stream(ftdm_stream_handle_t *stream);
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_global_init(void);
+
+FT_DECLARE(ftdm_status_t) ftdm_metrics_global_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __FTDM_RECORDER_H__
+#define __FTDM_RECORDER_H__
+
+#include "freetdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Channel flight recorder
+ *        Every channel keeps its last FTDM_RECORDER_SIZE events (state changes, OOB events, sigmsgs, indications,
+ *        DTMF, I/O errors, timers ...) in a fixed ring of small binary entries. It is always on, recording an event
+ *        costs an atomic increment and a clock read. The ring is printed with 'ftdm core recorder', dumped in binary
+ *        with 'ftdm core recorder dump' or automatically on ftdm_assert() when a dump directory is configured.
+ *        Binary dumps are decoded with the decode_recorder tool.
+ */
+
+/*! \brief Events kept per channel (power of 2) */
+#define FTDM_RECORDER_SIZE 128
+
+typedef enum {
+	FTDM_RECORDER_NONE,
+	FTDM_RECORDER_STATE,		/*!< state set, arg: new state, arg2: previous state */
+	FTDM_RECORDER_STATE_DONE,	/*!< state completed, arg: state */
+	FTDM_RECORDER_STATE_CANCEL,	/*!< state cancelled, arg: cancelled state, arg2: restored state */
+	FTDM_RECORDER_OOB,		/*!< OOB event from the io module, arg: ftdm_oob_event_t */
+	FTDM_RECORDER_SIGMSG,		/*!< signal sent to the user, arg: ftdm_signal_event_t */
+	FTDM_RECORDER_INDICATE,		/*!< indication requested, arg: ftdm_channel_indication_t */
+	FTDM_RECORDER_INDICATE_DONE,	/*!< indication completed, arg: ftdm_channel_indication_t, arg2: ftdm_status_t */
+	FTDM_RECORDER_PLACE,		/*!< outgoing call requested */
+	FTDM_RECORDER_HANGUP,		/*!< hangup requested, arg: ftdm_call_cause_t */
+	FTDM_RECORDER_DTMF_RX,		/*!< DTMF digit queued to the user, arg: digit */
+	FTDM_RECORDER_DTMF_TX,		/*!< DTMF digit sent, arg: digit */
+	FTDM_RECORDER_READ_ERROR,	/*!< io read failure, arg: ftdm_status_t, arg2: errno */
+	FTDM_RECORDER_WRITE_ERROR,	/*!< io write failure, arg: ftdm_status_t, arg2: errno */
+	FTDM_RECORDER_TIMER,		/*!< timer fired, arg: timer id (module specific, 0 is the core safety hangup timer) */
+	FTDM_RECORDER_INVALID
+} ftdm_recorder_event_t;
+#define RECORDER_EVENT_STRINGS "NONE", "STATE", "STATE_DONE", "STATE_CANCEL", "OOB", "SIGMSG", "INDICATE", "INDICATE_DONE", \
+	"PLACE", "HANGUP", "DTMF_RX", "DTMF_TX", "READ_ERROR", "WRITE_ERROR", "TIMER", "INVALID"
+FTDM_STR2ENUM_P(ftdm_str2ftdm_recorder_event, ftdm_recorder_event2str, ftdm_recorder_event_t)
+
+/*! \brief A recorded event, this is also the layout of the entries in binary dumps */
+typedef struct ftdm_recorder_entry {
+	uint64_t time;		/*!< ftdm_metrics_now() ns */
+	uint32_t seq;		/*!< event number, starting at 1, 0 if the slot was never written */
+	uint16_t type;		/*!< ftdm_recorder_event_t */
+	uint16_t arg2;
+	uint32_t arg;
+	uint32_t thread;	/*!< small id of the recording thread, only meaningful within a process */
+} ftdm_recorder_entry_t;
+
+typedef struct ftdm_recorder {
+	volatile uint32_t seq;
+	ftdm_recorder_entry_t entries[FTDM_RECORDER_SIZE];
+} ftdm_recorder_t;
+
+#define FTDM_RECORDER_DUMP_MAGIC "FTDMREC1"
+
+/*! \brief Binary dump block header, one per channel, followed by its entries from the oldest to the newest */
+typedef struct ftdm_recorder_dump_header {
+	char magic[8];		/*!< FTDM_RECORDER_DUMP_MAGIC */
+	uint32_t entry_size;	/*!< sizeof(ftdm_recorder_entry_t) */
+	uint32_t count;		/*!< entries following the header */
+	uint32_t span_id;
+	uint32_t chan_id;
+	uint32_t physical_span_id;
+	uint32_t physical_chan_id;
+	uint64_t dump_time;	/*!< ftdm_metrics_now() when the dump was taken */
+	uint64_t dump_wall_time;	/*!< wall clock (ms since the epoch) when the dump was taken */
+	char span_name[32];
+} ftdm_recorder_dump_header_t;
+
+/*! \brief Record an event in a channel recorder, safe to call from any thread */
+FT_DECLARE(void) ftdm_recorder_record(ftdm_recorder_t *recorder, ftdm_recorder_event_t type, uint32_t arg, uint16_t arg2);
+
+/*! \brief Record an event with a time (ftdm_metrics_now()) the caller already read */
+FT_DECLARE(void) ftdm_recorder_record_at(ftdm_recorder_t *recorder, uint64_t time, ftdm_recorder_event_t type, uint32_t arg, uint16_t arg2);
+
+#define ftdm_channel_record(fchan, type, arg, arg2) ftdm_recorder_record(&(fchan)->cold->recorder, (type), (arg), (arg2))
+#define ftdm_channel_record_at(fchan, time, type, arg, arg2) ftdm_recorder_record_at(&(fchan)->cold->recorder, (time), (type), (arg), (arg2))
+
+/*! \brief Describe an entry (without its time) */
+FT_DECLARE(char *) ftdm_recorder_entry_str(const ftdm_recorder_entry_t *entry, char *buf, ftdm_size_t len);
+
+/*! \brief Print the events of a channel, newest last, times relative to now */
+FT_DECLARE(void) ftdm_recorder_print(ftdm_stream_handle_t *stream, ftdm_channel_t *fchan);
+
+/*! \brief Write a binary dump of a channel, a span (fchan NULL) or all spans (both NULL) */
+FT_DECLARE(ftdm_status_t) ftdm_recorder_dump(const char *path, ftdm_span_t *span, ftdm_channel_t *fchan);
+
+/*! \brief Directory for the automatic dumps taken on ftdm_assert(), NULL disables them */
+FT_DECLARE(void) ftdm_recorder_set_dump_directory(const char *directory);
+
+/*! \brief Called by ftdm_assert(), dump all spans if a dump directory is configured */
+FT_DECLARE(void) ftdm_recorder_assert_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -107,6 +107,14 @@ FT_DECLARE(ftdm_status_t) ftdm_channel_advance_states(ftdm_channel_t *fchan);
 
 FT_DECLARE(ftdm_status_t) _ftdm_channel_complete_state(const char *file, const char *function, int line, ftdm_channel_t *fchan);
 #define ftdm_channel_complete_state(obj) _ftdm_channel_complete_state(__FILE__, __FTDM_FUNC__, __LINE__, obj)
+
+/*!
+ * \brief Set the next state of a non-blocking answer or progress media indication once the current state is completed
+ *        ftdm_channel_advance_states() does it after the state processor returns, signaling modules processing
+ *        the states on their own must call it after they are done with the state, it does nothing otherwise
+ */
+FT_DECLARE(ftdm_status_t) _ftdm_channel_advance_indication(const char *file, const char *function, int line, ftdm_channel_t *fchan);
+#define ftdm_channel_advance_indication(obj) _ftdm_channel_advance_indication(__FILE__, __FTDM_FUNC__, __LINE__, obj)
 FT_DECLARE(int) ftdm_check_state_all(ftdm_span_t *span, ftdm_channel_state_t state);
 
 /*!
@@ -181,6 +189,50 @@ struct ftdm_state_map {
 };
 typedef struct ftdm_state_map ftdm_state_map_t;
 
+/*!
+ * \brief State map compiled in a transition bit matrix, the transition from -> to in a given direction is valid
+ *        if bit 'to' of allowed[direction][from] is set. It is built from the span state map when the span
+ *        signaling is configured so validating a transition does not walk the map nodes
+ */
+typedef struct ftdm_state_matrix {
+	const ftdm_state_map_t *map; /*!< map the matrix was compiled from, NULL if not compiled */
+	uint32_t allowed[ZSD_OUTBOUND + 1][FTDM_CHANNEL_STATE_INVALID];
+} ftdm_state_matrix_t;
+
+/*!
+ * \brief Channels of a span with a state change pending, one bit per channel id (see FTDM_SPAN_USE_DIRTY_MAP)
+ *        The summary has one bit per word of the map so the signaling thread only visits the dirty words
+ */
+#define FTDM_DIRTY_MAP_WORDS ((FTDM_MAX_CHANNELS_SPAN / 32) + 1)
+#define FTDM_DIRTY_MAP_SUMMARY_WORDS ((FTDM_DIRTY_MAP_WORDS + 31) / 32)
+typedef struct ftdm_dirty_map {
+	volatile uint32_t summary[FTDM_DIRTY_MAP_SUMMARY_WORDS];
+	volatile uint32_t words[FTDM_DIRTY_MAP_WORDS];
+	volatile uint32_t armed; /*!< the interrupt was signaled and the map was not processed since */
+	ftdm_interrupt_t *interrupt; /*!< signaled once per batch of state changes */
+} ftdm_dirty_map_t;
+
+/*!
+ * \brief Process the pending states of the dirty channels of a span (locking each channel), and only those
+ *        The span must use FTDM_SPAN_USE_DIRTY_MAP, the signaling thread calls it when the dirty interrupt fires
+ * \return The number of channels processed
+ */
+FT_DECLARE(uint32_t) ftdm_span_advance_all_states(ftdm_span_t *span);
+
+/*!
+ * \brief Take the dirty channels of a span out of the map without processing them, for signaling modules
+ *        that advance the states along with their own per channel work (see ftdm_span_advance_all_states)
+ * \param chans Array of at least span->chan_count entries
+ * \return The number of channels stored in chans
+ */
+FT_DECLARE(uint32_t) ftdm_span_collect_dirty(ftdm_span_t *span, ftdm_channel_t **chans);
+
+/*!\brief Get the interrupt signaled when channels of a span become dirty (the span must use FTDM_SPAN_USE_DIRTY_MAP) */
+FT_DECLARE(ftdm_status_t) ftdm_span_get_dirty_interrupt(ftdm_span_t *span, ftdm_interrupt_t **interrupt);
+
+/*!\brief Compile a state map in a transition matrix, the result is the same the map walk would give for every transition */
+FT_DECLARE(ftdm_status_t) ftdm_state_map_compile(const ftdm_state_map_t *map, ftdm_state_matrix_t *matrix);
+
 /*!\brief Cancel the state processing for a channel (the channel must be locked when calling this function)
  * \note Only the core should use this function
  */ 
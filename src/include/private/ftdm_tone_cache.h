@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __FTDM_TONE_CACHE_H__
+#define __FTDM_TONE_CACHE_H__
+
+#include "freetdm.h"
+#include "ftdm_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * \brief Pre-rendered tone segment
+ *        Segments are owned by the cache and immutable once created, they stay valid
+ *        until the cache is destroyed so users can keep the pointer without locking
+ */
+typedef struct ftdm_tone_segment {
+	const uint8_t *data;	/*!< audio data, encoded in codec */
+	ftdm_size_t len;	/*!< length of the data in bytes */
+	uint32_t samples;	/*!< number of samples */
+	ftdm_codec_t codec;	/*!< FTDM_CODEC_SLIN, FTDM_CODEC_ULAW or FTDM_CODEC_ALAW */
+} ftdm_tone_segment_t;
+
+/*! \brief Global initialization, called just once, this is called by FreeTDM core, other users MUST not call it */
+FT_DECLARE(ftdm_status_t) ftdm_tone_cache_global_init(void);
+
+/*! \brief Global destroy, releases all segments, called by FreeTDM core, other users MUST not call it */
+FT_DECLARE(ftdm_status_t) ftdm_tone_cache_global_destroy(void);
+
+/*!
+ * \brief Get a DTMF digit, rendered (and cached) on first use
+ * \param digit The DTMF digit (0-9, *, #, A-D)
+ * \param rate Sampling rate
+ * \param volume Volume in dB
+ * \param on_ms Duration of the tone in ms
+ * \param off_ms Duration of the silence following the tone in ms
+ * \param codec Codec of the segment (SLIN, ULAW or ALAW)
+ * \return The segment or NULL on failure (invalid arguments or memory error)
+ */
+FT_DECLARE(const ftdm_tone_segment_t *) ftdm_tone_cache_get_dtmf(char digit, uint32_t rate, int volume, uint32_t on_ms, uint32_t off_ms, ftdm_codec_t codec);
+
+/*!
+ * \brief Get a tone described by a teletone script (a span tone map entry), rendered (and cached) on first use
+ * \param tone The teletone script, ie: "%(1000,4000,425)"
+ * \param rate Sampling rate
+ * \param codec Codec of the segment (SLIN, ULAW or ALAW)
+ * \return The segment or NULL on failure (empty tone, invalid arguments or memory error)
+ */
+FT_DECLARE(const ftdm_tone_segment_t *) ftdm_tone_cache_get_tone(const char *tone, uint32_t rate, ftdm_codec_t codec);
+
+/*!
+ * \brief Encode linear samples into the codec of a tone segment
+ * \param codec Target codec (SLIN, ULAW or ALAW)
+ * \param in Linear samples
+ * \param samples Number of samples
+ * \param out Output buffer, at least samples * 2 bytes long for SLIN, samples bytes otherwise
+ * \return Number of bytes written to out
+ */
+FT_DECLARE(ftdm_size_t) ftdm_tone_cache_encode(ftdm_codec_t codec, const int16_t *in, uint32_t samples, uint8_t *out);
+
+/*! \brief Print cache statistics (entries, memory, hits and misses) */
+FT_DECLARE(void) ftdm_tone_cache_print_stats(ftdm_stream_handle_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FTDM_TONE_SERVICE_H__
+#define __FTDM_TONE_SERVICE_H__
+
+#include "freetdm.h"
+#include "ftdm_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Media clock of the tone service (ms) */
+#define FTDM_TONE_SERVICE_INTERVAL 20
+
+/*! \brief Max number of tone service worker threads */
+#define FTDM_TONE_SERVICE_MAX_WORKERS 16
+
+/*!
+ * \brief Tone service channel callback, called by a tone worker on every media clock tick
+ *        before media is processed for the channel. The callback *must* not block since every
+ *        other channel served by the same worker would be delayed.
+ * \param ftdmchan The attached channel
+ * \param tone The tone to generate on the channel, FTDM_TONEMAP_NONE generates no audio
+ *             (media is still read, so in-band detection on the channel keeps running)
+ * \param data The user data given on attach
+ * \return FTDM_SUCCESS to keep the channel attached, FTDM_BREAK to detach it
+ * \note Called with the channel lock held
+ */
+typedef ftdm_status_t (*ftdm_tone_service_cb_t)(ftdm_channel_t *ftdmchan, ftdm_tonemap_t *tone, void *data);
+
+typedef struct ftdm_tone_service_entry ftdm_tone_service_entry_t;
+
+/*! \brief Global initialization, called just once, this is called by FreeTDM core, other users MUST not call it */
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_global_init(void);
+
+/*! \brief Global destroy, stops the workers and detaches all channels, called by FreeTDM core, other users MUST not call it */
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_global_destroy(void);
+
+/*!
+ * \brief Attach a channel to the tone service, the worker pool is started on first use
+ * \param ftdmchan The channel to attach, it must be opened by the caller (or by the callback)
+ * \param callback Callback selecting the tone to play on every tick (required)
+ * \param data Optional data to pass to the callback
+ */
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_attach(ftdm_channel_t *ftdmchan, ftdm_tone_service_cb_t callback, void *data);
+
+/*!
+ * \brief Detach a channel from the tone service
+ *        This function does not block (it can be called with the channel lock held), the entry is
+ *        released by the worker on its next tick. Workers run the callback and the channel I/O with
+ *        the channel lock held, when detach is called with that lock held (ie: right before closing
+ *        the channel) the worker is guaranteed not to touch the channel anymore
+ * \param ftdmchan The channel to detach
+ */
+FT_DECLARE(ftdm_status_t) ftdm_tone_service_detach(ftdm_channel_t *ftdmchan);
+
+/*! \brief Checks if a channel is attached to the tone service */
+FT_DECLARE(ftdm_bool_t) ftdm_tone_service_attached(const ftdm_channel_t *ftdmchan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -196,8 +196,12 @@ typedef enum {
 	FTDM_SPAN_NON_STOPPABLE = (1 << 13),
 	/* If this flag is set, then this span supports TRANSFER state */
 	FTDM_SPAN_USE_TRANSFER = (1 << 14),
+	/* Signaling modules set this flag to get the channels with a state change pending
+	 * from the span dirty channel map (see ftdm_span_advance_all_states()) instead of the
+	 * pendingchans queue or the FTDM_SPAN_STATE_CHANGE flag */
+	FTDM_SPAN_USE_DIRTY_MAP = (1 << 15),
 	/* This is the last flag, no more flags bigger than this */
-	FTDM_SPAN_MAX_FLAG = (1 << 15),
+	FTDM_SPAN_MAX_FLAG = (1 << 16),
 } ftdm_span_flag_t;
 
 /*! \brief Channel supported features */
@@ -270,9 +274,13 @@ typedef enum {
 #define FTDM_CHANNEL_NATIVE_SIGBRIDGE (1ULL << 37)
 /*!< Native signaling DTMF detection */
 #define FTDM_CHANNEL_SIG_DTMF_DETECTION (1ULL << 38)
+/*!< The user request being executed must not block (set only while the async API holds the channel lock) */
+#define FTDM_CHANNEL_ASYNC           (1ULL << 39)
+/*!< The completed state must be followed by the next state of a non-blocking answer or progress media indication */
+#define FTDM_CHANNEL_IND_CHAIN       (1ULL << 40)
 
 /*!< This no more flags after this flag */
-#define FTDM_CHANNEL_MAX_FLAG 	     (1ULL << 39)
+#define FTDM_CHANNEL_MAX_FLAG 	     (1ULL << 41)
 /*!<When adding a new flag, need to update ftdm_io.c:channel_flag_strs */
 
 #include "ftdm_state.h"
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2007-2014, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __FTDM_WHEEL_H__
+#define __FTDM_WHEEL_H__
+
+#include "freetdm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! \brief Resolution of a timer wheel slot (ms) */
+#define FTDM_WHEEL_MS 5
+
+/*! \brief Number of slots of a timer wheel, a turn of the wheel covers 320ms */
+#define FTDM_WHEEL_SLOTS 64
+
+/*! \brief Max. number of ticks / frames ftdm_wheel_service() runs an object for before serving the next one */
+#define FTDM_WHEEL_MAX_STEPS 8
+
+/*! \brief What must be done next with a call after a tick or a frame */
+typedef enum {
+	FTDM_WHEEL_IO,		/*!< wait for the channel to be readable and run the io callback */
+	FTDM_WHEEL_SLEEP,	/*!< nothing to do during the next interval */
+	FTDM_WHEEL_AGAIN,	/*!< tick again right away */
+	FTDM_WHEEL_DONE		/*!< the call is over */
+} ftdm_wheel_action_t;
+
+/*!
+ * \brief Timer of an object scheduled on a wheel, usually embedded in the object
+ *        The wheel is not thread safe, timers must only be touched by the thread serving the wheel
+ */
+typedef struct ftdm_wheel_timer {
+	void *obj;			/*!< object passed to the callbacks */
+	ftdm_time_t due;		/*!< time of the slot of the timer */
+	ftdm_time_t last;		/*!< time the object last ran in ftdm_wheel_service() */
+	uint8_t scheduled;		/*!< in a slot of the wheel */
+	struct ftdm_wheel_timer *next;	/*!< slot or list of expired timers */
+} ftdm_wheel_timer_t;
+
+/*! \brief Hashed timer wheel */
+typedef struct ftdm_wheel {
+	ftdm_wheel_timer_t *slots[FTDM_WHEEL_SLOTS];
+	ftdm_time_t current;		/*!< time of the next slot to expire */
+} ftdm_wheel_t;
+
+/*! \brief Callbacks of the objects run by ftdm_wheel_service() */
+typedef struct ftdm_wheel_ops {
+	/*! runs the state machine and the timeouts, elapsed is the time (ms) since the previous tick */
+	ftdm_wheel_action_t (*tick)(void *obj, uint32_t elapsed);
+	/*! handles one frame of the readable channel */
+	ftdm_wheel_action_t (*io)(void *obj);
+} ftdm_wheel_ops_t;
+
+/*!
+ * \brief Initialize an empty wheel
+ * \param wheel The wheel
+ * \param now Current time (ms)
+ */
+FT_DECLARE(void) ftdm_wheel_init(ftdm_wheel_t *wheel, ftdm_time_t now);
+
+/*!
+ * \brief Schedule a timer, the timer must not be scheduled already
+ * \param wheel The wheel
+ * \param timer The timer
+ * \param due Time (ms) the timer expires, rounded up to the slot resolution
+ */
+FT_DECLARE(void) ftdm_wheel_add(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer, ftdm_time_t due);
+
+/*!
+ * \brief Unschedule a timer
+ * \param wheel The wheel
+ * \param timer The timer
+ * \return FTDM_TRUE if the timer was scheduled, FTDM_FALSE otherwise
+ */
+FT_DECLARE(ftdm_bool_t) ftdm_wheel_cancel(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer);
+
+/*!
+ * \brief Remove the timers due up to now
+ * \param wheel The wheel
+ * \param now Current time (ms)
+ * \return List of expired timers, linked through next
+ */
+FT_DECLARE(ftdm_wheel_timer_t *) ftdm_wheel_expire(ftdm_wheel_t *wheel, ftdm_time_t now);
+
+/*!
+ * \brief Remove all the timers, ie: when the thread serving the wheel stops
+ * \param wheel The wheel
+ * \return List of the timers that were scheduled, linked through next
+ */
+FT_DECLARE(ftdm_wheel_timer_t *) ftdm_wheel_flush(ftdm_wheel_t *wheel);
+
+/*!
+ * \brief Run the object of an expired timer until it has nothing left to do and schedule its next run
+ *        Reads never block, the object runs again when its next frame is due
+ * \param wheel The wheel
+ * \param timer The expired timer
+ * \param ftdmchan Channel of the object
+ * \param interval I/O interval of the channel (ms)
+ * \param ops Callbacks of the object
+ * \param now Current time (ms)
+ * \return FTDM_WHEEL_DONE when the object is done and was not scheduled again, the last action otherwise
+ */
+FT_DECLARE(ftdm_wheel_action_t) ftdm_wheel_service(ftdm_wheel_t *wheel, ftdm_wheel_timer_t *timer, ftdm_channel_t *ftdmchan,
+		uint32_t interval, const ftdm_wheel_ops_t *ops, ftdm_time_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
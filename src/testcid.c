@@ -17,6 +17,282 @@ ftdm_status_t my_write_sample(int16_t *buf, ftdm_size_t buflen, void *user_data)
 	return FTDM_SUCCESS;
 }
 
+struct bench_audio {
+	int16_t *samples;
+	size_t len;
+	size_t size;
+};
+
+static ftdm_status_t bench_write_sample(int16_t *buf, ftdm_size_t buflen, void *user_data)
+{
+	struct bench_audio *audio = (struct bench_audio *) user_data;
+
+	if (audio->len + buflen > audio->size) {
+		return FTDM_FAIL;
+	}
+	memcpy(audio->samples + audio->len, buf, buflen * sizeof(int16_t));
+	audio->len += buflen;
+	return FTDM_SUCCESS;
+}
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* previous double precision demodulator (ring buffer, one sample at a time), kept as the baseline */
+struct bench_ref {
+	double *correlates[4];
+	double *buffer;
+	int ringstart;
+};
+
+static int bench_ref_init(struct bench_ref *ref, dsp_fsk_handle_t *handle, int sample_rate)
+{
+	double phi_mark, phi_space;
+	int i;
+
+	memset(ref, 0, sizeof(*ref));
+	for (i = 0; i < 4; i++) {
+		if (!(ref->correlates[i] = calloc(handle->corrsize, sizeof(double)))) {
+			return -1;
+		}
+	}
+	if (!(ref->buffer = calloc(handle->corrsize, sizeof(double)))) {
+		return -1;
+	}
+
+	phi_mark = 2. * M_PI / ((double) sample_rate / (double) handle->downsampling_count / (double) fsk_modem_definitions[FSK_BELL202].freq_mark);
+	phi_space = 2. * M_PI / ((double) sample_rate / (double) handle->downsampling_count / (double) fsk_modem_definitions[FSK_BELL202].freq_space);
+
+	for (i = 0; i < handle->corrsize; i++) {
+		ref->correlates[0][i] = sin(phi_mark * (double) i);
+		ref->correlates[1][i] = cos(phi_mark * (double) i);
+		ref->correlates[2][i] = sin(phi_space * (double) i);
+		ref->correlates[3][i] = cos(phi_space * (double) i);
+	}
+	return 0;
+}
+
+static void bench_ref_destroy(struct bench_ref *ref)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		free(ref->correlates[i]);
+	}
+	free(ref->buffer);
+}
+
+/* dsp_fsk_sample() as it was before the block demodulator, it drives the same handle state */
+static void bench_ref_sample(dsp_fsk_handle_t *handle, struct bench_ref *ref, double normalized_sample)
+{
+	double val;
+	double factors[4];
+	int i, j;
+
+	if (handle->downsampling_count != 1) {
+		if (handle->current_downsample < handle->downsampling_count) {
+			handle->current_downsample++;
+			return;
+		}
+		handle->current_downsample = 1;
+	}
+
+	ref->buffer[ref->ringstart++] = normalized_sample;
+	if (ref->ringstart >= handle->corrsize) {
+		ref->ringstart = 0;
+	}
+
+	factors[0] = factors[1] = factors[2] = factors[3] = 0;
+	j = ref->ringstart;
+	for (i = 0; i < handle->corrsize; i++) {
+		if (j >= handle->corrsize) {
+			j = 0;
+		}
+		val = ref->buffer[j];
+		factors[0] += ref->correlates[0][i] * val;
+		factors[1] += ref->correlates[1][i] * val;
+		factors[2] += ref->correlates[2][i] * val;
+		factors[3] += ref->correlates[3][i] * val;
+		j++;
+	}
+
+	handle->previous_bit = handle->current_bit;
+	handle->current_bit = (factors[0] * factors[0] + factors[1] * factors[1] > factors[2] * factors[2] + factors[3] * factors[3]);
+
+	if (handle->previous_bit != handle->current_bit) {
+		handle->cellpos = 0.5;
+	}
+	handle->cellpos += handle->celladj;
+
+	if (handle->cellpos > 1.0) {
+		handle->cellpos -= 1.0;
+
+		switch (handle->state) {
+		case FSK_STATE_DATA:
+			(*handle->attr.bithandler) (handle->attr.bithandler_arg, handle->current_bit);
+			break;
+		case FSK_STATE_CHANSEIZE:
+			if (handle->last_bit != handle->current_bit) {
+				handle->conscutive_state_bits++;
+			} else {
+				handle->conscutive_state_bits = 0;
+			}
+			if (handle->conscutive_state_bits > 15) {
+				handle->state = FSK_STATE_CARRIERSIG;
+				handle->conscutive_state_bits = 0;
+			}
+			break;
+		case FSK_STATE_CARRIERSIG:
+			if (handle->current_bit) {
+				handle->conscutive_state_bits++;
+			} else {
+				handle->conscutive_state_bits = 0;
+			}
+			if (handle->conscutive_state_bits > 15) {
+				handle->state = FSK_STATE_DATA;
+				handle->conscutive_state_bits = 0;
+			}
+			break;
+		}
+
+		handle->last_bit = handle->current_bit;
+	}
+}
+
+typedef enum {
+	BENCH_BLOCK,
+	BENCH_PER_SAMPLE,
+	BENCH_BASELINE
+} bench_mode_t;
+
+static const char *bench_mode_names[] = { "block", "per sample", "baseline (double)" };
+
+/* demodulate the samples and check we got back the caller id we sent */
+static int bench_decode(int16_t *samples, size_t len, bench_mode_t mode)
+{
+	ftdm_fsk_data_state_t fsk_data = {0};
+	uint8_t fbuf[256];
+	size_t type, mlen, x;
+	char *sp;
+	int fields = 0;
+	struct bench_ref ref;
+
+	if (ftdm_fsk_demod_init(&fsk_data, 8000, fbuf, sizeof(fbuf))) {
+		return 0;
+	}
+
+	if (mode == BENCH_BASELINE && bench_ref_init(&ref, fsk_data.fsk1200_handle, 8000)) {
+		bench_ref_destroy(&ref);
+		ftdm_fsk_demod_destroy(&fsk_data);
+		return 0;
+	}
+
+	for (x = 0; x < len; x += 160) {
+		size_t chunk = (len - x) > 160 ? 160 : (len - x);
+
+		if (mode != BENCH_BLOCK) {
+			size_t i;
+			for (i = 0; i < chunk && !(fsk_data.dlen && fsk_data.bpos >= fsk_data.dlen); i++) {
+				if (mode == BENCH_BASELINE) {
+					bench_ref_sample(fsk_data.fsk1200_handle, &ref, (double) samples[x + i] / 32767.0);
+				} else {
+					dsp_fsk_sample(fsk_data.fsk1200_handle, (double) samples[x + i] / 32767.0);
+				}
+			}
+			if (i < chunk) {
+				break;
+			}
+		} else if (ftdm_fsk_demod_feed(&fsk_data, samples + x, chunk) != FTDM_SUCCESS) {
+			break;
+		}
+	}
+
+	while (ftdm_fsk_data_parse(&fsk_data, &type, &sp, &mlen) == FTDM_SUCCESS) {
+		if ((type == MDMF_PHONE_NUM && mlen == 7 && !memcmp(sp, "1414936", 7)) ||
+		    (type == MDMF_PHONE_NAME && mlen == 10 && !memcmp(sp, "Fred Smith", 10))) {
+			fields++;
+		}
+	}
+
+	if (mode == BENCH_BASELINE) {
+		bench_ref_destroy(&ref);
+	}
+	ftdm_fsk_demod_destroy(&fsk_data);
+	return fields == 2 && !fsk_data.checksum;
+}
+
+/* accuracy (with white noise) and throughput of the baseline, per sample and block demodulators */
+static int bench(int iterations)
+{
+	static const int noise_levels[] = { 0, 1000, 2000, 4000 };
+	struct ftdm_fsk_modulator fsk_trans;
+	ftdm_fsk_data_state_t fsk_data = {0};
+	uint8_t databuf[1024] = "";
+	struct bench_audio audio = {0};
+	int16_t *noisy = NULL;
+	ftdm_time_t baseline_ms = 0;
+	uint32_t seed = 1;
+	size_t x;
+	int i, n;
+
+	audio.size = 8000 * 4;
+	audio.samples = calloc(audio.size, sizeof(int16_t));
+	noisy = calloc(audio.size, sizeof(int16_t));
+	if (!audio.samples || !noisy) {
+		fprintf(stderr, "Memory Error!\n");
+		return -1;
+	}
+
+	ftdm_fsk_data_init(&fsk_data, databuf, sizeof(databuf));
+	ftdm_fsk_data_add_mdmf(&fsk_data, MDMF_DATETIME, (uint8_t *)"06091213", 8);
+	ftdm_fsk_data_add_mdmf(&fsk_data, MDMF_PHONE_NUM, (uint8_t *)"14149361212", 7);
+	ftdm_fsk_data_add_mdmf(&fsk_data, MDMF_PHONE_NAME, (uint8_t *)"Fred Smith", 10);
+	ftdm_fsk_data_add_checksum(&fsk_data);
+
+	ftdm_fsk_modulator_init(&fsk_trans, FSK_BELL202, 8000, &fsk_data, -14, 180, 5, 300, bench_write_sample, &audio);
+	ftdm_fsk_modulator_send_all((&fsk_trans));
+
+	printf("Caller id: %u bytes, %u samples (%u ms)\n", (unsigned) fsk_data.dlen, (unsigned) audio.len, (unsigned) (audio.len / 8));
+
+	for (n = 0; n < (int) (sizeof(noise_levels) / sizeof(noise_levels[0])); n++) {
+		int ok_baseline = 0, ok_sample = 0, ok_block = 0;
+
+		for (i = 0; i < iterations; i++) {
+			for (x = 0; x < audio.len; x++) {
+				int32_t v;
+				seed = seed * 1103515245 + 12345;
+				v = audio.samples[x] + (int32_t) ((int32_t) ((seed >> 16) & 0x7fff) - 0x4000) * noise_levels[n] / 0x4000;
+				noisy[x] = (int16_t) (v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+			}
+			ok_baseline += bench_decode(noisy, audio.len, BENCH_BASELINE);
+			ok_sample += bench_decode(noisy, audio.len, BENCH_PER_SAMPLE);
+			ok_block += bench_decode(noisy, audio.len, BENCH_BLOCK);
+		}
+		printf("Noise +/-%5d: baseline %d/%d, per sample %d/%d, block %d/%d decoded\n", noise_levels[n],
+				ok_baseline, iterations, ok_sample, iterations, ok_block, iterations);
+	}
+
+	for (n = BENCH_BASELINE; n >= BENCH_BLOCK; n--) {
+		ftdm_time_t start = ftdm_current_time_in_ms(), elapsed;
+
+		for (i = 0; i < iterations; i++) {
+			bench_decode(audio.samples, audio.len, n);
+		}
+		elapsed = ftdm_current_time_in_ms() - start;
+		if (n == BENCH_BASELINE) {
+			baseline_ms = elapsed;
+		}
+		printf("%s: %d caller ids in %"FTDM_UINT64_FMT" ms (%.1f x realtime, %.2f x baseline)\n", bench_mode_names[n],
+				iterations, elapsed, elapsed ? ((double) iterations * audio.len / 8.0) / (double) elapsed : 0.0,
+				elapsed ? (double) baseline_ms / (double) elapsed : 0.0);
+	}
+
+	free(audio.samples);
+	free(noisy);
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct ftdm_fsk_modulator fsk_trans;
@@ -35,6 +311,10 @@ int main(int argc, char *argv[])
 	struct tm tm;
 	time_t now;
 	
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		return bench(argc > 2 ? atoi(argv[2]) : 100);
+	}
+
 	if (argc < 2) {
 		int x;
 		const char *url = "sip:cool@rad.com";
@@ -0,0 +1,490 @@
+/*
+ * Benchmarks of the FreeTDM core data structures. They run on their own
+ * objects, no configuration and no hardware are needed.
+ *
+ * testcore [chan|call|state [<iterations>]]
+ */
+#include "private/ftdm_core.h"
+#include <stddef.h>
+
+#define BENCH_SPANS 8
+#define BENCH_CHANS_PER_SPAN 31
+
+/* same size as the core call id registry */
+#define BENCH_CALLIDS 6000
+#define BENCH_CALL_THREADS 4
+
+/*!
+ * \brief Measure the cost of walking all channels the way the hunt and the media read paths do
+ *        The channels are allocated like ftdm_span_add_channel() does, this only measures the memory layout cost
+ */
+static int channel_bench(int iterations)
+{
+	ftdm_channel_t *chans[BENCH_SPANS * BENCH_CHANS_PER_SPAN];
+	ftdm_time_t start, hunt_ms, frame_ms;
+	volatile uint64_t acc = 0;
+	uint32_t count = 0;
+	uint32_t i;
+	int it;
+
+	printf("channel size: %"FTDM_SIZE_FMT" bytes (hot %"FTDM_SIZE_FMT", cold block %"FTDM_SIZE_FMT")\n",
+			sizeof(ftdm_channel_t), offsetof(ftdm_channel_t, cold) + sizeof(ftdm_channel_cold_t *),
+			sizeof(ftdm_channel_cold_t));
+
+	for (count = 0; count < ftdm_array_len(chans); count++) {
+		ftdm_channel_t *fchan = ftdm_calloc(1, sizeof(*fchan));
+
+		if (!fchan || !(fchan->cold = ftdm_calloc(1, sizeof(*fchan->cold)))) {
+			fprintf(stderr, "memory error\n");
+			ftdm_safe_free(fchan);
+			break;
+		}
+		fchan->span_id = (count / BENCH_CHANS_PER_SPAN) + 1;
+		fchan->chan_id = (count % BENCH_CHANS_PER_SPAN) + 1;
+		fchan->state = FTDM_CHANNEL_STATE_DOWN;
+		/* every other channel is busy, the hunt checks all of them */
+		ftdm_set_flag(fchan, FTDM_CHANNEL_READY);
+		if (count % 2) {
+			ftdm_set_flag(fchan, FTDM_CHANNEL_INUSE);
+		}
+		chans[count] = fchan;
+	}
+
+	if (count != ftdm_array_len(chans)) {
+		goto done;
+	}
+
+	/* hunt: the availability checks done on every channel of a group or span */
+	start = ftdm_current_time_in_ms();
+	for (it = 0; it < iterations; it++) {
+		for (i = 0; i < count; i++) {
+			ftdm_channel_t *fchan = chans[i];
+			if (ftdm_test_flag(fchan, FTDM_CHANNEL_READY) &&
+			    !ftdm_test_flag(fchan, FTDM_CHANNEL_INUSE) &&
+			    !fchan->alarm_flags &&
+			    fchan->state == FTDM_CHANNEL_STATE_DOWN) {
+				acc += fchan->availability_rate + 1;
+			}
+		}
+	}
+	hunt_ms = ftdm_current_time_in_ms() - start;
+
+	/* frame: the fields checked on every media frame read */
+	start = ftdm_current_time_in_ms();
+	for (it = 0; it < iterations; it++) {
+		for (i = 0; i < count; i++) {
+			ftdm_channel_t *fchan = chans[i];
+			acc += fchan->flags + fchan->io_flags + fchan->effective_codec + fchan->native_codec +
+				fchan->packet_len + fchan->skip_read_frames + (fchan->dtmf_buffer != NULL) +
+				(fchan->fsk_buffer != NULL) + (fchan->pre_buffer_size) + (fchan->tone_entry != NULL) +
+				(uint64_t)fchan->rxgain;
+		}
+	}
+	frame_ms = ftdm_current_time_in_ms() - start;
+
+	printf("%u channels, %d iterations\n", count, iterations);
+	printf("hunt scan: %"FTDM_UINT64_FMT" ms (%.2f ns/channel)\n",
+			hunt_ms, ((double)hunt_ms * 1000000.0) / ((double)count * iterations));
+	printf("frame read fields: %"FTDM_UINT64_FMT" ms (%.2f ns/channel)\n",
+			frame_ms, ((double)frame_ms * 1000000.0) / ((double)count * iterations));
+
+done:
+	for (i = 0; i < count; i++) {
+		ftdm_safe_free(chans[i]->cold);
+		ftdm_safe_free(chans[i]);
+	}
+	return count == ftdm_array_len(chans) ? 0 : 1;
+}
+
+typedef struct {
+	ftdm_caller_data_t * volatile call_ids[BENCH_CALLIDS+1];
+	volatile uint32_t last_call_id;
+	int iterations;
+	volatile uint32_t failed;
+	volatile uint32_t done;
+} call_bench_t;
+
+static void *call_bench_run(ftdm_thread_t *me, void *obj)
+{
+	call_bench_t *bench = obj;
+	ftdm_caller_data_t caller_data;
+	uint32_t call_id;
+	int i;
+
+	memset(&caller_data, 0, sizeof(caller_data));
+
+	for (i = 0; i < bench->iterations; i++) {
+		call_id = ftdm_call_ids_claim(bench->call_ids, &bench->last_call_id, BENCH_CALLIDS, &caller_data);
+		if (!call_id || !ftdm_call_ids_release(bench->call_ids, call_id, &caller_data)) {
+			ftdm_atomic_inc32(&bench->failed);
+			break;
+		}
+	}
+
+	ftdm_atomic_inc32(&bench->done);
+	return NULL;
+}
+
+/*!
+ * \brief Measure call id allocation and release throughput with several threads churning calls
+ *        The threads use a registry of their own, built like the core one
+ */
+static int call_bench(int threads, int iterations)
+{
+	call_bench_t *bench;
+	ftdm_time_t start, elapsed;
+	int started = 0;
+	int busy = 0;
+	int i;
+
+	if (!(bench = ftdm_calloc(1, sizeof(*bench)))) {
+		fprintf(stderr, "memory error\n");
+		return 1;
+	}
+	bench->iterations = iterations;
+
+	start = ftdm_current_time_in_ms();
+	for (i = 0; i < threads; i++) {
+		if (ftdm_thread_create_detached(call_bench_run, bench) != FTDM_SUCCESS) {
+			fprintf(stderr, "failed to start bench thread %d\n", i);
+			break;
+		}
+		started++;
+	}
+
+	while (bench->done != (uint32_t)started) {
+		ftdm_sleep(1);
+	}
+	elapsed = ftdm_current_time_in_ms() - start;
+
+	/* every call released its id */
+	for (i = 1; i <= BENCH_CALLIDS; i++) {
+		if (bench->call_ids[i]) {
+			busy++;
+		}
+	}
+
+	printf("%d threads, %d calls each, %u failures, %d ids left busy\n", started, iterations, bench->failed, busy);
+	printf("call churn: %"FTDM_UINT64_FMT" ms (%.2f calls/ms)\n", elapsed,
+			elapsed ? ((double)started * iterations) / (double)elapsed : 0.0);
+
+	i = (started != threads || bench->failed || busy) ? 1 : 0;
+	ftdm_safe_free(bench);
+	return i;
+}
+
+/* inbound calls only, in the style of the signaling module maps: the states listed can be moved to */
+static ftdm_state_map_t bench_state_map = {
+	{
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_ANY, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_RESET, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_RESET, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_DOWN, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_DOWN, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_COLLECT, FTDM_CHANNEL_STATE_RING, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_COLLECT, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_RING, FTDM_CHANNEL_STATE_TERMINATING, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_TERMINATING, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_HANGUP, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_RING, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_HANGUP, FTDM_CHANNEL_STATE_TERMINATING, FTDM_CHANNEL_STATE_PROGRESS, FTDM_CHANNEL_STATE_UP, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_PROGRESS, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_HANGUP, FTDM_CHANNEL_STATE_TERMINATING, FTDM_CHANNEL_STATE_UP, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_UP, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_HANGUP, FTDM_CHANNEL_STATE_TERMINATING, FTDM_CHANNEL_STATE_END}
+		},
+		{
+			ZSD_INBOUND,
+			ZSM_UNACCEPTABLE,
+			{FTDM_CHANNEL_STATE_HANGUP, FTDM_CHANNEL_STATE_END},
+			{FTDM_CHANNEL_STATE_DOWN, FTDM_CHANNEL_STATE_END}
+		},
+	}
+};
+
+/* the call every bench channel goes through */
+static ftdm_channel_state_t bench_next_state(ftdm_channel_state_t state)
+{
+	switch (state) {
+	case FTDM_CHANNEL_STATE_DOWN:
+		return FTDM_CHANNEL_STATE_RING;
+	case FTDM_CHANNEL_STATE_RING:
+		return FTDM_CHANNEL_STATE_UP;
+	case FTDM_CHANNEL_STATE_UP:
+		return FTDM_CHANNEL_STATE_HANGUP;
+	default:
+		return FTDM_CHANNEL_STATE_DOWN;
+	}
+}
+
+static volatile uint32_t bench_processed;
+
+static ftdm_status_t bench_state_processor(ftdm_channel_t *fchan)
+{
+	bench_processed++;
+	ftdm_channel_complete_state(fchan);
+	return FTDM_SUCCESS;
+}
+
+static void state_bench_destroy(ftdm_span_t *span)
+{
+	uint32_t i;
+
+	for (i = 1; i <= span->chan_count; i++) {
+		ftdm_channel_t *fchan = span->channels[i];
+
+		if (fchan->state_completed_interrupt) {
+			ftdm_interrupt_destroy(&fchan->state_completed_interrupt);
+		}
+		ftdm_mutex_destroy(&fchan->mutex);
+		ftdm_safe_free(fchan->cold);
+		ftdm_safe_free(fchan);
+	}
+	if (span->pendingchans) {
+		ftdm_queue_destroy(&span->pendingchans);
+	}
+	if (span->mutex) {
+		ftdm_mutex_destroy(&span->mutex);
+	}
+	ftdm_safe_free(span);
+}
+
+/* a span with the bench state map and its own channels, all down */
+static ftdm_span_t *state_bench_create(void)
+{
+	ftdm_span_t *span = ftdm_calloc(1, sizeof(*span));
+	uint32_t i;
+
+	if (!span || ftdm_mutex_create(&span->mutex) != FTDM_SUCCESS) {
+		ftdm_safe_free(span);
+		return NULL;
+	}
+	span->span_id = 1;
+	span->state_map = &bench_state_map;
+	span->state_processor = bench_state_processor;
+
+	for (i = 1; i <= BENCH_CHANS_PER_SPAN; i++) {
+		ftdm_channel_t *fchan = ftdm_calloc(1, sizeof(*fchan));
+
+		if (!fchan || !(fchan->cold = ftdm_calloc(1, sizeof(*fchan->cold))) ||
+		    ftdm_mutex_create(&fchan->mutex) != FTDM_SUCCESS) {
+			if (fchan) {
+				ftdm_safe_free(fchan->cold);
+			}
+			ftdm_safe_free(fchan);
+			state_bench_destroy(span);
+			return NULL;
+		}
+		fchan->span = span;
+		fchan->span_id = span->span_id;
+		fchan->chan_id = i;
+		fchan->state = FTDM_CHANNEL_STATE_DOWN;
+		fchan->state_status = FTDM_STATE_STATUS_COMPLETED;
+		ftdm_set_flag(fchan, FTDM_CHANNEL_READY | FTDM_CHANNEL_NONBLOCK);
+		span->channels[++span->chan_count] = fchan;
+	}
+	return span;
+}
+
+/* move a channel to its next state, the way a signaling module does on a protocol event */
+static ftdm_status_t state_bench_change(ftdm_channel_t *fchan)
+{
+	ftdm_status_t status;
+
+	ftdm_channel_lock(fchan);
+	status = ftdm_channel_set_state(__FILE__, __FTDM_FUNC__, __LINE__, fchan, bench_next_state(fchan->state), 0, NULL);
+	ftdm_channel_unlock(fchan);
+	return status;
+}
+
+typedef enum {
+	STATE_BENCH_ADVANCE,	/* change and advance the channel right away */
+	STATE_BENCH_FLAGS,	/* scan the span channels for the state change flag */
+	STATE_BENCH_QUEUE,	/* the span pending channels queue */
+	STATE_BENCH_DIRTY	/* the span dirty channel map */
+} state_bench_lookup_t;
+
+/* one state change per iteration, on the channels in turn, then find and process it; returns the elapsed ns */
+static uint64_t state_bench_run(ftdm_span_t *span, state_bench_lookup_t lookup, int iterations, uint32_t *failed)
+{
+	ftdm_channel_t *fchan;
+	uint64_t start;
+	uint32_t j;
+	int i;
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		fchan = span->channels[(i % span->chan_count) + 1];
+		if (state_bench_change(fchan) != FTDM_SUCCESS) {
+			(*failed)++;
+			continue;
+		}
+		switch (lookup) {
+		case STATE_BENCH_ADVANCE:
+			ftdm_channel_lock(fchan);
+			ftdm_channel_advance_states(fchan);
+			ftdm_channel_unlock(fchan);
+			break;
+		case STATE_BENCH_FLAGS:
+			for (j = 1; j <= span->chan_count; j++) {
+				if (ftdm_test_flag(span->channels[j], FTDM_CHANNEL_STATE_CHANGE)) {
+					ftdm_channel_lock(span->channels[j]);
+					ftdm_channel_advance_states(span->channels[j]);
+					ftdm_channel_unlock(span->channels[j]);
+				}
+			}
+			break;
+		case STATE_BENCH_QUEUE:
+			while ((fchan = ftdm_queue_dequeue(span->pendingchans))) {
+				ftdm_channel_lock(fchan);
+				ftdm_channel_advance_states(fchan);
+				ftdm_channel_unlock(fchan);
+			}
+			break;
+		case STATE_BENCH_DIRTY:
+			ftdm_span_advance_all_states(span);
+			break;
+		}
+	}
+	return ftdm_metrics_now() - start;
+}
+
+/*!
+ * \brief Measure the state change cost (validation, set, process and complete) with the map walk and the compiled
+ *        matrix, then the cost of finding the channel to process among the span channels with each pending method
+ *        Every change must be processed exactly once, it fails otherwise
+ */
+static int state_bench(int iterations)
+{
+	static const struct {
+		state_bench_lookup_t lookup;
+		const char *name;
+	} runs[] = {
+		{ STATE_BENCH_ADVANCE, "state change, map walk" },
+		{ STATE_BENCH_ADVANCE, "state change, compiled matrix" },
+		{ STATE_BENCH_FLAGS, "pending lookup, state change flag scan" },
+		{ STATE_BENCH_QUEUE, "pending lookup, pending channels queue" },
+		{ STATE_BENCH_DIRTY, "pending lookup, dirty channel map" },
+	};
+	ftdm_span_t *span;
+	uint32_t failed = 0;
+	uint32_t busy = 0;
+	uint64_t elapsed;
+	uint32_t r, j;
+
+	if (!(span = state_bench_create())) {
+		fprintf(stderr, "memory error\n");
+		return 1;
+	}
+
+	printf("%u channels, %d state changes\n", span->chan_count, iterations);
+	for (r = 0; r < ftdm_array_len(runs); r++) {
+		if (r == 1 && ftdm_state_map_compile(span->state_map, &span->state_matrix) != FTDM_SUCCESS) {
+			fprintf(stderr, "failed to compile the state map\n");
+			failed++;
+			break;
+		}
+		if (runs[r].lookup == STATE_BENCH_QUEUE && ftdm_queue_create(&span->pendingchans, SPAN_PENDING_CHANS_QUEUE_SIZE) != FTDM_SUCCESS) {
+			fprintf(stderr, "failed to create the pending channels queue\n");
+			failed++;
+			break;
+		}
+		if (runs[r].lookup == STATE_BENCH_DIRTY) {
+			ftdm_queue_destroy(&span->pendingchans);
+			ftdm_set_flag(span, FTDM_SPAN_USE_DIRTY_MAP);
+		}
+
+		bench_processed = 0;
+		elapsed = state_bench_run(span, runs[r].lookup, iterations, &failed);
+		if (bench_processed != (uint32_t)iterations) {
+			printf("%s: %u of %d state changes processed\n", runs[r].name, bench_processed, iterations);
+			failed++;
+		}
+		printf("%s: %.1f ns\n", runs[r].name, (double)elapsed / iterations);
+	}
+
+	/* nothing left pending */
+	for (j = 1; j <= span->chan_count; j++) {
+		if (span->channels[j]->state_status != FTDM_STATE_STATUS_COMPLETED ||
+		    ftdm_test_flag(span->channels[j], FTDM_CHANNEL_STATE_CHANGE)) {
+			busy++;
+		}
+	}
+	if (failed || busy) {
+		printf("%u failed state changes, %u channels left pending\n", failed, busy);
+	}
+
+	state_bench_destroy(span);
+	return (failed || busy) ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *bench = argc > 1 ? argv[1] : NULL;
+	int iterations = argc > 2 ? atoi(argv[2]) : 0;
+	int rc = 0;
+
+	if (argc > 2 && iterations <= 0) {
+		fprintf(stderr, "invalid number of iterations %s\n", argv[2]);
+		return 1;
+	}
+
+	if (bench && strcasecmp(bench, "chan") && strcasecmp(bench, "call") && strcasecmp(bench, "state")) {
+		fprintf(stderr, "usage: %s [chan|call|state [<iterations>]]\n", argv[0]);
+		return 1;
+	}
+
+	if (!bench || !strcasecmp(bench, "chan")) {
+		rc |= channel_bench(iterations ? iterations : 100000);
+	}
+	if (!bench || !strcasecmp(bench, "call")) {
+		rc |= call_bench(BENCH_CALL_THREADS, iterations ? iterations : 100000);
+	}
+	if (!bench || !strcasecmp(bench, "state")) {
+		rc |= state_bench(iterations ? iterations : 100000);
+	}
+
+	return rc;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
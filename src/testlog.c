@@ -0,0 +1,270 @@
+/*
+ * Check the async logger: messages that do not fit in a thread ring are dropped and reported,
+ * everything queued is written on stop, also for threads that already exited.
+ * With -b measure the caller side cost of a log call instead. No hardware is needed.
+ */
+#include "private/ftdm_core.h"
+
+#ifdef WIN32
+#define BENCH_NULL_FILE "NUL"
+#else
+#define BENCH_NULL_FILE "/dev/null"
+#endif
+
+/* far more than a ring holds, records are at least 32 bytes */
+#define OVERFLOW_MESSAGES (FTDM_LOG_RING_SIZE / 16)
+#define THREAD_MESSAGES 1000
+
+static struct {
+	volatile uint32_t received;	/* test messages */
+	volatile uint32_t next;		/* sequence number expected in the next message */
+	volatile uint32_t unordered;
+	volatile uint32_t dropped;	/* reported by the drop warnings */
+	volatile int block;		/* hold the drain thread in the sink */
+	volatile int blocked;
+} sink_state;
+
+static void test_sink(const char *file, const char *func, int line, int level, const char *fmt, ...)
+{
+	char data[FTDM_LOG_MAX_MSG];
+	unsigned int seq, dropped;
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(data, sizeof(data), fmt, ap);
+	va_end(ap);
+
+	if (sscanf(data, "Dropped %u log messages", &dropped) == 1) {
+		sink_state.dropped += dropped;
+		return;
+	}
+
+	if (!strcmp(data, "block\n")) {
+		sink_state.blocked = 1;
+		while (sink_state.block) {
+			ftdm_sleep(1);
+		}
+		return;
+	}
+
+	if (sscanf(data, "message %u", &seq) == 1) {
+		if (seq != sink_state.next) {
+			sink_state.unordered++;
+		}
+		sink_state.next = seq + 1;
+		sink_state.received++;
+	}
+}
+
+static void reset_sink(void)
+{
+	memset((void *)&sink_state, 0, sizeof(sink_state));
+}
+
+/* returns the number of errors */
+static int check_overflow(void)
+{
+	uint32_t i;
+	int errors = 0;
+
+	reset_sink();
+	if (ftdm_log_async_start(test_sink) != FTDM_SUCCESS) {
+		printf("overflow: failed to start the async logger\n");
+		return 1;
+	}
+
+	/* park the drain thread in the sink so the ring fills up */
+	sink_state.block = 1;
+	ftdm_log_async_write(__FILE__, __func__, __LINE__, FTDM_LOG_LEVEL_DEBUG, "block\n");
+	while (!sink_state.blocked) {
+		ftdm_sleep(1);
+	}
+
+	for (i = 0; i < OVERFLOW_MESSAGES; i++) {
+		ftdm_log_async_write(__FILE__, __func__, __LINE__, FTDM_LOG_LEVEL_DEBUG, "message %u\n", i);
+	}
+
+	/* stop right away, the queued messages and the drop warning must still be written */
+	sink_state.block = 0;
+	ftdm_log_async_stop();
+
+	printf("overflow: %u messages written, %u received, %u dropped\n", OVERFLOW_MESSAGES, sink_state.received, sink_state.dropped);
+	if (!sink_state.dropped || !sink_state.received) {
+		printf("overflow: expected both written and dropped messages\n");
+		errors++;
+	}
+	if (sink_state.received + sink_state.dropped != OVERFLOW_MESSAGES) {
+		printf("overflow: %u messages unaccounted for\n", OVERFLOW_MESSAGES - sink_state.received - sink_state.dropped);
+		errors++;
+	}
+	/* the ring keeps the oldest messages, the newest are dropped */
+	if (sink_state.unordered) {
+		printf("overflow: %u messages out of order\n", sink_state.unordered);
+		errors++;
+	}
+	return errors;
+}
+
+static void *writer_run(ftdm_thread_t *me, void *obj)
+{
+	volatile int *done = obj;
+	uint32_t i;
+
+	ftdm_unused_arg(me);
+
+	for (i = 0; i < THREAD_MESSAGES; i++) {
+		ftdm_log_async_write(__FILE__, __func__, __LINE__, FTDM_LOG_LEVEL_DEBUG, "message %u\n", i);
+	}
+	*done = 1;
+	return NULL;
+}
+
+/* returns the number of errors */
+static int check_stop(void)
+{
+	volatile int done = 0;
+	uint32_t i;
+	int errors = 0;
+
+	/* restart, the main thread ring is used again */
+	reset_sink();
+	if (ftdm_log_async_start(test_sink) != FTDM_SUCCESS) {
+		printf("stop: failed to start the async logger\n");
+		return 1;
+	}
+	for (i = 0; i < THREAD_MESSAGES; i++) {
+		ftdm_log_async_write(__FILE__, __func__, __LINE__, FTDM_LOG_LEVEL_DEBUG, "message %u\n", i);
+	}
+	ftdm_log_async_stop();
+	if (sink_state.received != THREAD_MESSAGES || sink_state.unordered || sink_state.dropped) {
+		printf("stop: %u received, %u out of order, %u dropped of %u\n", sink_state.received,
+				sink_state.unordered, sink_state.dropped, THREAD_MESSAGES);
+		errors++;
+	}
+
+	/* a thread that exited before the stop, its ring is drained then released */
+	reset_sink();
+	if (ftdm_log_async_start(test_sink) != FTDM_SUCCESS) {
+		printf("stop: failed to start the async logger\n");
+		return errors + 1;
+	}
+	if (ftdm_thread_create_detached(writer_run, (void *)&done) != FTDM_SUCCESS) {
+		printf("stop: failed to start the writer thread\n");
+		ftdm_log_async_stop();
+		return errors + 1;
+	}
+	while (!done) {
+		ftdm_sleep(1);
+	}
+	ftdm_log_async_stop();
+	if (sink_state.received != THREAD_MESSAGES || sink_state.unordered || sink_state.dropped) {
+		printf("stop: thread %u received, %u out of order, %u dropped of %u\n", sink_state.received,
+				sink_state.unordered, sink_state.dropped, THREAD_MESSAGES);
+		errors++;
+	}
+	return errors;
+}
+
+static FILE *bench_file;
+
+/* what the default logger does, synchronously on the caller thread */
+static void bench_sync_logger(const char *file, const char *func, int line, int level, const char *fmt, ...)
+{
+	char data[FTDM_LOG_MAX_MSG];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(data, sizeof(data), fmt, ap);
+	fprintf(bench_file, "[%s] %s:%d %s() %s", "DEBUG", file, line, func, data);
+	va_end(ap);
+	ftdm_unused_arg(level);
+}
+
+static void bench_null_sink(const char *file, const char *func, int line, int level, const char *fmt, ...)
+{
+	ftdm_unused_arg(file);
+	ftdm_unused_arg(func);
+	ftdm_unused_arg(line);
+	ftdm_unused_arg(level);
+	ftdm_unused_arg(fmt);
+}
+
+static int bench(int iterations)
+{
+	volatile int filtered_level = FTDM_LOG_LEVEL_DEBUG + 1;
+	uint64_t start, filtered_ns, sync_ns, async_ns;
+	int i;
+
+	bench_file = fopen(BENCH_NULL_FILE, "w");
+	if (!bench_file) {
+		fprintf(stderr, "failed to open %s\n", BENCH_NULL_FILE);
+		return 1;
+	}
+	/* stderr is not buffered, neither is the default logger */
+	setvbuf(bench_file, NULL, _IONBF, 0);
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_log(__FILE__, __func__, __LINE__, filtered_level, "[s%dc%d][%d:%d] bench message %d\n", 1, 1, 1, 1, i);
+	}
+	filtered_ns = ftdm_metrics_now() - start;
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		bench_sync_logger(FTDM_LOG_DEBUG, "[s%dc%d][%d:%d] bench message %d\n", 1, 1, 1, 1, i);
+	}
+	sync_ns = ftdm_metrics_now() - start;
+
+	/* the drain thread may not keep up, dropped messages are formatted all the same */
+	if (ftdm_log_async_start(bench_null_sink) != FTDM_SUCCESS) {
+		fprintf(stderr, "failed to start the async logger\n");
+		fclose(bench_file);
+		return 1;
+	}
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_log_async_write(FTDM_LOG_DEBUG, "[s%dc%d][%d:%d] bench message %d\n", 1, 1, 1, 1, i);
+	}
+	async_ns = ftdm_metrics_now() - start;
+	ftdm_log_async_stop();
+
+	printf("%d iterations\n", iterations);
+	printf("filtered out level: %.1f ns\n", (double)filtered_ns / iterations);
+	printf("synchronous (format + unbuffered write): %.1f ns\n", (double)sync_ns / iterations);
+	printf("async (format + ring copy): %.1f ns\n", (double)async_ns / iterations);
+
+	fclose(bench_file);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int errors = 0;
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+
+		if (iterations <= 0) {
+			fprintf(stderr, "invalid number of iterations %s\n", argv[2]);
+			return 1;
+		}
+		return bench(iterations);
+	}
+
+	errors += check_overflow();
+	errors += check_stop();
+
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
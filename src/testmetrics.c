@@ -0,0 +1,204 @@
+/*
+ * Check the latency histograms (bucket placement and percentiles) against known inputs,
+ * with -b measure the recording overhead instead. No hardware is needed.
+ */
+#include "private/ftdm_core.h"
+
+/* smallest value of a bucket and bucket width, as ftdm_histogram_percentile() sees them */
+static void bucket_range(uint32_t bucket, uint64_t *low, uint64_t *width)
+{
+	uint32_t group = bucket >> FTDM_HISTOGRAM_SUB_BITS;
+	uint32_t sub = bucket & (FTDM_HISTOGRAM_SUB_BUCKETS - 1);
+
+	if (!group) {
+		*low = sub;
+		*width = 1;
+	} else {
+		*low = (uint64_t)(FTDM_HISTOGRAM_SUB_BUCKETS + sub) << (group - 1);
+		*width = (uint64_t)1 << (group - 1);
+	}
+}
+
+/* returns the number of errors */
+static int check_buckets(void)
+{
+	static const struct {
+		uint64_t value;
+		uint32_t bucket;
+	} known[] = {
+		{ 0, 0 }, { 1, 1 }, { 3, 3 }, { 4, 4 }, { 7, 7 }, { 8, 8 }, { 9, 8 }, { 10, 9 },
+		{ 15, 11 }, { 16, 12 }, { 1000, 35 }, { 1000000, 75 },
+		{ (uint64_t)1 << FTDM_HISTOGRAM_MAX_BIT, FTDM_HISTOGRAM_BUCKETS - 4 },
+		{ ((uint64_t)1 << (FTDM_HISTOGRAM_MAX_BIT + 1)) - 1, FTDM_HISTOGRAM_BUCKETS - 1 },
+		{ (uint64_t)1 << (FTDM_HISTOGRAM_MAX_BIT + 1), FTDM_HISTOGRAM_BUCKETS - 1 },
+		{ (uint64_t)-1, FTDM_HISTOGRAM_BUCKETS - 1 },
+	};
+	uint64_t low, width;
+	uint32_t i;
+	int errors = 0;
+
+	for (i = 0; i < ftdm_array_len(known); i++) {
+		if (ftdm_histogram_bucket(known[i].value) != known[i].bucket) {
+			printf("value %"FTDM_UINT64_FMT": bucket %u, expected %u\n", known[i].value,
+					ftdm_histogram_bucket(known[i].value), known[i].bucket);
+			errors++;
+		}
+	}
+
+	/* every bucket holds [low, low + width), the buckets are contiguous and at most 25% wide */
+	for (i = 0; i < FTDM_HISTOGRAM_BUCKETS; i++) {
+		bucket_range(i, &low, &width);
+		if (ftdm_histogram_bucket(low) != i || ftdm_histogram_bucket(low + width - 1) != i ||
+		    (i && ftdm_histogram_bucket(low - 1) != i - 1) ||
+		    (i >= FTDM_HISTOGRAM_SUB_BUCKETS && width * FTDM_HISTOGRAM_SUB_BUCKETS > low)) {
+			printf("bucket %u: [%"FTDM_UINT64_FMT", %"FTDM_UINT64_FMT") misplaced\n", i, low, low + width);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static int check_percentile(const char *name, const ftdm_histogram_t *histogram, double percentile, uint64_t expected)
+{
+	uint64_t value = ftdm_histogram_percentile(histogram, percentile);
+
+	if (value != expected) {
+		printf("%s: p%g is %"FTDM_UINT64_FMT", expected %"FTDM_UINT64_FMT"\n", name, percentile, value, expected);
+		return 1;
+	}
+	return 0;
+}
+
+/* returns the number of errors */
+static int check_percentiles(void)
+{
+	ftdm_histogram_t histogram, atomic;
+	uint64_t i;
+	int errors = 0;
+
+	memset(&histogram, 0, sizeof(histogram));
+	errors += check_percentile("empty", &histogram, 50, 0);
+
+	/* a single value is reported exactly, the bucket middle is clamped to the recorded range */
+	ftdm_histogram_record(&histogram, 12345);
+	errors += check_percentile("single", &histogram, 0, 12345);
+	errors += check_percentile("single", &histogram, 50, 12345);
+	errors += check_percentile("single", &histogram, 100, 12345);
+
+	/* 100 x 10ns and one 1ms outlier: 10 is in [10, 12), 1000000 in [917504, 1048576) */
+	memset(&histogram, 0, sizeof(histogram));
+	for (i = 0; i < 100; i++) {
+		ftdm_histogram_record(&histogram, 10);
+	}
+	ftdm_histogram_record(&histogram, 1000000);
+	errors += check_percentile("outlier", &histogram, 0, 11);
+	errors += check_percentile("outlier", &histogram, 50, 11);
+	errors += check_percentile("outlier", &histogram, 99, 11);
+	errors += check_percentile("outlier", &histogram, 100, 983040);
+
+	/* 1..1000us, the percentiles are the middle of the bucket holding the exact value */
+	memset(&histogram, 0, sizeof(histogram));
+	memset(&atomic, 0, sizeof(atomic));
+	for (i = 1; i <= 1000; i++) {
+		ftdm_histogram_record(&histogram, i * 1000);
+		ftdm_histogram_record_atomic(&atomic, i * 1000);
+	}
+	/* 500000 is in [458752, 524288), 900000 and 990000 in [786432, 917504) and [917504, 1048576) */
+	errors += check_percentile("linear", &histogram, 50, 491520);
+	errors += check_percentile("linear", &histogram, 90, 851968);
+	errors += check_percentile("linear", &histogram, 99, 983040);
+	errors += check_percentile("linear", &histogram, 100, 983040);
+	errors += check_percentile("linear", &histogram, 0, 1000);
+	if (histogram.count != 1000 || histogram.min != 1000 || histogram.max != 1000000 || histogram.sum != 500500000) {
+		printf("linear: count %"FTDM_UINT64_FMT", min %"FTDM_UINT64_FMT", max %"FTDM_UINT64_FMT", sum %"FTDM_UINT64_FMT"\n",
+				histogram.count, histogram.min, histogram.max, histogram.sum);
+		errors++;
+	}
+	if (memcmp(&histogram, &atomic, sizeof(histogram))) {
+		printf("linear: ftdm_histogram_record_atomic() and ftdm_histogram_record() disagree\n");
+		errors++;
+	}
+	return errors;
+}
+
+static void bench(int iterations)
+{
+	ftdm_histogram_t *histogram = NULL;
+	ftdm_metric_t counter;
+	uint64_t start, clock_ns, record_ns, sample_ns, counter_ns;
+	volatile uint64_t sink = 0;
+	int i;
+
+	histogram = ftdm_calloc(1, sizeof(*histogram));
+	if (!histogram) {
+		return;
+	}
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		sink += ftdm_metrics_now();
+	}
+	clock_ns = ftdm_metrics_now() - start;
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_histogram_record(histogram, (uint64_t)i * 997);
+	}
+	record_ns = ftdm_metrics_now() - start;
+
+	/* what every instrumented call pays: take the start time, then record the time since */
+	memset(histogram, 0, sizeof(*histogram));
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_histogram_record_since(histogram, ftdm_metrics_now());
+	}
+	sample_ns = ftdm_metrics_now() - start;
+
+	memset(&counter, 0, sizeof(counter));
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_metric_add(&counter, 1);
+	}
+	counter_ns = ftdm_metrics_now() - start;
+
+	printf("%d iterations\n", iterations);
+	printf("clock read: %.1f ns\n", (double)clock_ns / iterations);
+	printf("histogram record: %.1f ns\n", (double)record_ns / iterations);
+	printf("timed sample (2 clock reads + record): %.1f ns\n", (double)sample_ns / iterations);
+	printf("counter add (sharded, relaxed atomic): %.1f ns\n", (double)counter_ns / iterations);
+
+	ftdm_safe_free(histogram);
+}
+
+int main(int argc, char *argv[])
+{
+	int errors = 0;
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		int iterations = argc > 2 ? atoi(argv[2]) : 1000000;
+
+		if (iterations <= 0) {
+			fprintf(stderr, "invalid number of iterations %s\n", argv[2]);
+			return 1;
+		}
+		bench(iterations);
+		return 0;
+	}
+
+	errors += check_buckets();
+	errors += check_percentiles();
+
+	printf("%d errors over %d buckets\n", errors, FTDM_HISTOGRAM_BUCKETS);
+	return errors ? 1 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
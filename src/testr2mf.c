@@ -0,0 +1,117 @@
+/*
+ * Check that every implementation of the R2 MF detector of ftmod_r2 gives the same results,
+ * down to the last bit of the goertzel filter states, and that they all detect and clear each
+ * forward and backward tone. No openr2 and no hardware are needed.
+ */
+#include "private/ftdm_core.h"
+#include "ftmod/ftmod_r2/ftmod_r2_mf.h"
+
+/* 300ms of tone followed by 200ms of silence */
+#define TONE_SAMPLES 2400
+#define SILENCE_SAMPLES 1600
+#define TOTAL_SAMPLES (TONE_SAMPLES + SILENCE_SAMPLES)
+/* largest number of samples fed at once, chunks are picked at random so they end anywhere in a block */
+#define MAX_CHUNK 200
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7fff;
+}
+
+/* returns the number of errors */
+static int check_tone(int fwd, int tone, int noise)
+{
+	ftdm_r2_mf_rx_t rx[FTDM_R2_MF_IMPL_COUNT];
+	int available[FTDM_R2_MF_IMPL_COUNT];
+	int detected[FTDM_R2_MF_IMPL_COUNT] = { 0 };
+	int16_t amp[TOTAL_SAMPLES];
+	ftdm_r2_mf_tx_t tx;
+	int impl, offset, chunk, i;
+	int seen = 0, exact = 1, errors = 0;
+
+	ftdm_r2_mf_tx_init(&tx, fwd);
+	ftdm_r2_mf_tx_select(&tx, tone);
+	ftdm_r2_mf_tx(&tx, amp, TONE_SAMPLES);
+	ftdm_r2_mf_tx_select(&tx, 0);
+	ftdm_r2_mf_tx(&tx, amp + TONE_SAMPLES, SILENCE_SAMPLES);
+	for (i = 0; noise && i < TOTAL_SAMPLES; i++) {
+		amp[i] += (int16_t)((int)next_random() % (2 * noise + 1) - noise);
+	}
+
+	for (impl = 0; impl < FTDM_R2_MF_IMPL_COUNT; impl++) {
+		ftdm_r2_mf_rx_init(&rx[impl], fwd);
+		available[impl] = (ftdm_r2_mf_rx_set_impl(&rx[impl], impl) == FTDM_SUCCESS);
+	}
+
+	for (offset = 0; offset < TOTAL_SAMPLES; offset += chunk) {
+		chunk = (int)(next_random() % MAX_CHUNK) + 1;
+		if (chunk > TOTAL_SAMPLES - offset) {
+			chunk = TOTAL_SAMPLES - offset;
+		}
+		for (impl = 0; impl < FTDM_R2_MF_IMPL_COUNT; impl++) {
+			if (!available[impl]) {
+				continue;
+			}
+			detected[impl] = ftdm_r2_mf_rx(&rx[impl], amp + offset, chunk);
+			if (detected[impl] != detected[FTDM_R2_MF_SCALAR] ||
+				rx[impl].hit != rx[FTDM_R2_MF_SCALAR].hit ||
+				rx[impl].samples != rx[FTDM_R2_MF_SCALAR].samples ||
+				memcmp(rx[impl].v2, rx[FTDM_R2_MF_SCALAR].v2, sizeof(rx[impl].v2[0]) * FTDM_R2_MF_FREQS) ||
+				memcmp(rx[impl].v3, rx[FTDM_R2_MF_SCALAR].v3, sizeof(rx[impl].v3[0]) * FTDM_R2_MF_FREQS)) {
+				exact = 0;
+			}
+		}
+		if (offset + chunk <= TONE_SAMPLES) {
+			seen |= (detected[FTDM_R2_MF_SCALAR] == tone);
+		}
+	}
+
+	if (!exact) {
+		fprintf(stderr, "%s tone %d (noise %d): the detector implementations are not bit exact\n",
+				fwd ? "forward" : "backward", tone, noise);
+		errors++;
+	}
+	if (!seen || detected[FTDM_R2_MF_SCALAR]) {
+		fprintf(stderr, "%s tone %d (noise %d): %s\n", fwd ? "forward" : "backward", tone, noise,
+				!seen ? "not detected" : "not cleared");
+		errors++;
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	int impl, fwd, tone;
+	int errors = 0;
+	ftdm_r2_mf_rx_t rx;
+
+	ftdm_r2_mf_rx_init(&rx, 1);
+	for (impl = 0; impl < FTDM_R2_MF_IMPL_COUNT; impl++) {
+		printf("%s: %s\n", ftdm_r2_mf_impl_name(impl),
+				ftdm_r2_mf_rx_set_impl(&rx, impl) == FTDM_SUCCESS ? "checked" : "not built in");
+	}
+
+	for (fwd = 0; fwd < 2; fwd++) {
+		for (tone = 1; tone <= 15; tone++) {
+			errors += check_tone(fwd, tone, 0);
+			errors += check_tone(fwd, tone, 200);
+		}
+	}
+
+	printf("%d errors over 60 tones\n", errors);
+	return errors ? 1 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
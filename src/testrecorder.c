@@ -0,0 +1,263 @@
+/*
+ * Check the channel recorder: record events, write a binary dump and decode it back the way
+ * decode_recorder does. With -b measure the per event recording overhead instead.
+ * No hardware is needed.
+ *
+ * testrecorder [<dump file>]	keep the dump in the given file (run decode_recorder on it)
+ * testrecorder -b [<iterations>]
+ */
+#include "private/ftdm_core.h"
+
+#define TEST_SPAN_ID 3
+#define TEST_SPAN_NAME "recorder-test"
+#define TEST_CHANNELS 2
+/* events of the second channel, enough to wrap its ring */
+#define TEST_WRAP_EVENTS (FTDM_RECORDER_SIZE * 2 + 44)
+
+/* a span with its own channels, only what the recorder dump reads is set */
+static ftdm_span_t *create_span(void)
+{
+	ftdm_span_t *span = ftdm_calloc(1, sizeof(*span));
+	uint32_t i;
+
+	if (!span || !(span->name = ftdm_strdup(TEST_SPAN_NAME))) {
+		ftdm_safe_free(span);
+		return NULL;
+	}
+	span->span_id = TEST_SPAN_ID;
+
+	for (i = 1; i <= TEST_CHANNELS; i++) {
+		ftdm_channel_t *fchan = ftdm_calloc(1, sizeof(*fchan));
+
+		if (!fchan || !(fchan->cold = ftdm_calloc(1, sizeof(*fchan->cold)))) {
+			ftdm_safe_free(fchan);
+			break;
+		}
+		fchan->span = span;
+		fchan->span_id = span->span_id;
+		fchan->chan_id = i;
+		fchan->physical_span_id = 1;
+		fchan->physical_chan_id = i + 16;
+		span->channels[++span->chan_count] = fchan;
+	}
+	return span;
+}
+
+static void destroy_span(ftdm_span_t *span)
+{
+	uint32_t i;
+
+	for (i = 1; i <= span->chan_count; i++) {
+		ftdm_safe_free(span->channels[i]->cold);
+		ftdm_safe_free(span->channels[i]);
+	}
+	ftdm_safe_free(span->name);
+	ftdm_safe_free(span);
+}
+
+/* check an entry of the second channel, it recorded DTMF digits, event n has arg '0' + n % 10 */
+static int check_wrapped_entry(const ftdm_recorder_entry_t *entry, uint32_t seq)
+{
+	char desc[128];
+	char expected[32];
+
+	snprintf(expected, sizeof(expected), "DTMF_RX %c", '0' + ((seq - 1) % 10));
+	ftdm_recorder_entry_str(entry, desc, sizeof(desc));
+	if (entry->seq != seq || entry->type != FTDM_RECORDER_DTMF_RX || strcmp(desc, expected)) {
+		printf("chan 2: event %u is #%u %s, expected %s\n", seq, entry->seq, desc, expected);
+		return 1;
+	}
+	return 0;
+}
+
+/* returns the number of errors */
+static int check_dump(const char *path)
+{
+	/* first channel: a short call */
+	static const struct {
+		ftdm_recorder_event_t type;
+		uint32_t arg;
+		uint16_t arg2;
+		const char *desc;
+	} events[] = {
+		{ FTDM_RECORDER_STATE, FTDM_CHANNEL_STATE_RING, FTDM_CHANNEL_STATE_DOWN, "STATE DOWN -> RING" },
+		{ FTDM_RECORDER_STATE_DONE, FTDM_CHANNEL_STATE_RING, 0, "STATE_DONE RING" },
+		{ FTDM_RECORDER_SIGMSG, FTDM_SIGEVENT_START, 0, "SIGMSG START" },
+		{ FTDM_RECORDER_INDICATE, FTDM_CHANNEL_INDICATE_ANSWER, 0, "INDICATE ANSWER" },
+		{ FTDM_RECORDER_DTMF_TX, '5', 0, "DTMF_TX 5" },
+		{ FTDM_RECORDER_HANGUP, FTDM_CAUSE_NORMAL_CLEARING, 0, "HANGUP cause 16" },
+		{ FTDM_RECORDER_TIMER, 0, 0, "TIMER 0" },
+	};
+	ftdm_recorder_dump_header_t header;
+	ftdm_recorder_entry_t entry;
+	ftdm_span_t *span = NULL;
+	uint64_t last_time = 0;
+	char desc[128];
+	FILE *file = NULL;
+	uint32_t i, e;
+	int errors = 0;
+
+	if (!(span = create_span()) || span->chan_count != TEST_CHANNELS) {
+		printf("failed to create the test span\n");
+		if (span) {
+			destroy_span(span);
+		}
+		return 1;
+	}
+
+	for (i = 0; i < ftdm_array_len(events); i++) {
+		ftdm_channel_record(span->channels[1], events[i].type, events[i].arg, events[i].arg2);
+	}
+	for (i = 0; i < TEST_WRAP_EVENTS; i++) {
+		ftdm_channel_record(span->channels[2], FTDM_RECORDER_DTMF_RX, '0' + (i % 10), 0);
+	}
+
+	if (ftdm_recorder_dump(path, span, NULL) != FTDM_SUCCESS) {
+		printf("failed to write %s\n", path);
+		destroy_span(span);
+		return 1;
+	}
+
+	if (!(file = fopen(path, "rb"))) {
+		printf("failed to open %s: %s\n", path, strerror(errno));
+		destroy_span(span);
+		return 1;
+	}
+
+	for (i = 1; i <= TEST_CHANNELS; i++) {
+		uint32_t expected = i == 1 ? ftdm_array_len(events) : FTDM_RECORDER_SIZE;
+
+		if (fread(&header, sizeof(header), 1, file) != 1) {
+			printf("chan %u: block missing\n", i);
+			errors++;
+			break;
+		}
+		if (memcmp(header.magic, FTDM_RECORDER_DUMP_MAGIC, sizeof(header.magic)) ||
+		    header.entry_size != sizeof(ftdm_recorder_entry_t) || header.count != expected ||
+		    header.span_id != TEST_SPAN_ID || header.chan_id != i ||
+		    header.physical_span_id != 1 || header.physical_chan_id != i + 16 ||
+		    strcmp(header.span_name, TEST_SPAN_NAME) || !header.dump_time || !header.dump_wall_time) {
+			printf("chan %u: bad header (%u:%u, %u events of %u bytes, span %.32s)\n", i, header.span_id,
+					header.chan_id, header.count, header.entry_size, header.span_name);
+			errors++;
+			break;
+		}
+
+		for (e = 0; e < header.count; e++) {
+			if (fread(&entry, sizeof(entry), 1, file) != 1) {
+				printf("chan %u: truncated after %u events\n", i, e);
+				errors++;
+				break;
+			}
+			/* oldest first, all recorded before the dump */
+			if (entry.time < last_time || entry.time > header.dump_time || !entry.thread) {
+				printf("chan %u: event #%u out of order\n", i, entry.seq);
+				errors++;
+			}
+			last_time = entry.time;
+
+			if (i == 2) {
+				/* only the newest events are kept */
+				errors += check_wrapped_entry(&entry, TEST_WRAP_EVENTS - FTDM_RECORDER_SIZE + 1 + e);
+				continue;
+			}
+			ftdm_recorder_entry_str(&entry, desc, sizeof(desc));
+			if (entry.seq != e + 1 || entry.type != events[e].type || entry.arg != events[e].arg ||
+			    entry.arg2 != events[e].arg2 || strcmp(desc, events[e].desc)) {
+				printf("chan 1: event #%u is %s, expected %s\n", entry.seq, desc, events[e].desc);
+				errors++;
+			}
+		}
+		last_time = 0;
+	}
+
+	if (!errors && fread(&header, 1, 1, file)) {
+		printf("trailing data after the last channel\n");
+		errors++;
+	}
+
+	fclose(file);
+	destroy_span(span);
+	return errors;
+}
+
+static int bench(int iterations)
+{
+	ftdm_span_t *span = NULL;
+	uint64_t start, record_ns, dump_ns;
+	int dumps = iterations / FTDM_RECORDER_SIZE + 1;
+	int i;
+
+	if (!(span = create_span()) || !span->chan_count) {
+		fprintf(stderr, "memory error\n");
+		if (span) {
+			destroy_span(span);
+		}
+		return 1;
+	}
+
+	start = ftdm_metrics_now();
+	for (i = 0; i < iterations; i++) {
+		ftdm_channel_record(span->channels[1], FTDM_RECORDER_STATE, i & 0xff, 0);
+	}
+	record_ns = ftdm_metrics_now() - start;
+
+	/* a full ring, file open and close included */
+	start = ftdm_metrics_now();
+	for (i = 0; i < dumps; i++) {
+#ifdef WIN32
+		ftdm_recorder_dump("NUL", NULL, span->channels[1]);
+#else
+		ftdm_recorder_dump("/dev/null", NULL, span->channels[1]);
+#endif
+	}
+	dump_ns = ftdm_metrics_now() - start;
+
+	printf("%d iterations\n", iterations);
+	printf("record event: %.1f ns\n", (double)record_ns / iterations);
+	printf("dump %d events: %.1f ns\n", FTDM_RECORDER_SIZE, (double)dump_ns / dumps);
+
+	destroy_span(span);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	char path[256];
+	int errors;
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		int iterations = argc > 2 ? atoi(argv[2]) : 1000000;
+
+		if (iterations <= 0) {
+			fprintf(stderr, "invalid number of iterations %s\n", argv[2]);
+			return 1;
+		}
+		return bench(iterations);
+	}
+
+	if (argc > 1) {
+		ftdm_copy_string(path, argv[1], sizeof(path));
+	} else {
+		snprintf(path, sizeof(path), "testrecorder-%d.bin", (int)getpid());
+	}
+
+	errors = check_dump(path);
+	if (argc < 2) {
+		unlink(path);
+	}
+
+	printf("%d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */
@@ -0,0 +1,136 @@
+/*
+ * Check the DTMF segments of the tone cache and compare the cost of rendering the digits
+ * with teletone (what the channels did for every digit) with the cost of using the cache.
+ * No hardware is needed.
+ */
+#include "private/ftdm_core.h"
+
+static const char digits[] = "0123456789*#ABCD";
+
+/* returns the number of errors */
+static int check_digits(uint32_t rate, ftdm_codec_t codec)
+{
+	uint32_t samples = (FTDM_DEFAULT_DTMF_ON + FTDM_DEFAULT_DTMF_OFF) * (rate / 1000);
+	ftdm_size_t len = codec == FTDM_CODEC_SLIN ? samples * 2 : samples;
+	int errors = 0;
+	uint32_t d;
+
+	for (d = 0; d < sizeof(digits) - 1; d++) {
+		const ftdm_tone_segment_t *segment = ftdm_tone_cache_get_dtmf(digits[d], rate, -7,
+						FTDM_DEFAULT_DTMF_ON, FTDM_DEFAULT_DTMF_OFF, codec);
+		if (!segment) {
+			printf("digit %c: not rendered\n", digits[d]);
+			errors++;
+			continue;
+		}
+		if (segment->codec != codec || segment->samples != samples || segment->len != len) {
+			printf("digit %c: codec %d, %u samples, %"FTDM_SIZE_FMT" bytes (expected codec %d, %u samples, %"FTDM_SIZE_FMT" bytes)\n",
+					digits[d], segment->codec, segment->samples, segment->len, codec, samples, len);
+			errors++;
+		}
+		/* a second lookup must hit the cache */
+		if (ftdm_tone_cache_get_dtmf(digits[d], rate, -7, FTDM_DEFAULT_DTMF_ON, FTDM_DEFAULT_DTMF_OFF, codec) != segment) {
+			printf("digit %c: rendered twice\n", digits[d]);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static int bench(uint32_t iterations)
+{
+	teletone_generation_session_t ts;
+	uint8_t *out = NULL;
+	ftdm_time_t start, teletone_ms, cache_ms;
+	uint32_t i, d, count;
+
+	memset(&ts, 0, sizeof(ts));
+	teletone_init_session(&ts, 0, NULL, NULL);
+	ts.rate = 8000;
+	ts.duration = FTDM_DEFAULT_DTMF_ON * (ts.rate / 1000);
+	ts.wait = FTDM_DEFAULT_DTMF_OFF * (ts.rate / 1000);
+	ts.volume = -7;
+
+	/* large enough for one digit in SLIN */
+	out = ftdm_malloc((FTDM_DEFAULT_DTMF_ON + FTDM_DEFAULT_DTMF_OFF) * (ts.rate / 1000) * 2);
+	if (!out) {
+		fprintf(stderr, "memory error\n");
+		teletone_destroy_session(&ts);
+		return 1;
+	}
+
+	/* what the channel did for every digit: render with teletone and encode to G.711 */
+	start = ftdm_current_time_in_ms();
+	for (i = 0; i < iterations; i++) {
+		for (d = 0; d < sizeof(digits) - 1; d++) {
+			int wrote = teletone_mux_tones(&ts, &ts.TONES[(int)digits[d]]);
+			ftdm_tone_cache_encode(FTDM_CODEC_ULAW, ts.buffer, wrote, out);
+		}
+	}
+	teletone_ms = ftdm_current_time_in_ms() - start;
+
+	/* cache lookup + copy of the pre-rendered G.711 digit */
+	start = ftdm_current_time_in_ms();
+	for (i = 0; i < iterations; i++) {
+		for (d = 0; d < sizeof(digits) - 1; d++) {
+			const ftdm_tone_segment_t *segment = ftdm_tone_cache_get_dtmf(digits[d], ts.rate, ts.volume,
+							FTDM_DEFAULT_DTMF_ON, FTDM_DEFAULT_DTMF_OFF, FTDM_CODEC_ULAW);
+			if (segment) {
+				memcpy(out, segment->data, segment->len);
+			}
+		}
+	}
+	cache_ms = ftdm_current_time_in_ms() - start;
+
+	count = iterations * (sizeof(digits) - 1);
+	printf("Generated %u digits (%dms on, %dms off, ulaw)\n", count, FTDM_DEFAULT_DTMF_ON, FTDM_DEFAULT_DTMF_OFF);
+	printf("teletone: %"FTDM_UINT64_FMT" ms (%.3f us/digit)\n", teletone_ms, count ? (teletone_ms * 1000.0) / count : 0.0);
+	printf("cache: %"FTDM_UINT64_FMT" ms (%.3f us/digit)\n", cache_ms, count ? (cache_ms * 1000.0) / count : 0.0);
+
+	ftdm_safe_free(out);
+	teletone_destroy_session(&ts);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int errors = 0;
+	int rc = 0;
+
+	if (ftdm_global_init() != FTDM_SUCCESS) {
+		fprintf(stderr, "Error loading FreeTDM\n");
+		exit(-1);
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		int iterations = argc > 2 ? atoi(argv[2]) : 1000;
+
+		if (iterations <= 0) {
+			fprintf(stderr, "invalid number of iterations %s\n", argv[2]);
+			rc = 1;
+		} else {
+			rc = bench(iterations);
+		}
+	} else {
+		errors += check_digits(8000, FTDM_CODEC_SLIN);
+		errors += check_digits(8000, FTDM_CODEC_ULAW);
+		errors += check_digits(8000, FTDM_CODEC_ALAW);
+		errors += check_digits(16000, FTDM_CODEC_SLIN);
+		printf("%d errors over %d digits\n", errors, (int)(sizeof(digits) - 1) * 4);
+		rc = errors ? 1 : 0;
+	}
+
+	ftdm_global_destroy();
+	return rc;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet:
+ */